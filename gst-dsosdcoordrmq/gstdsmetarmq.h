@@ -0,0 +1,197 @@
+/**
+ * Copyright 2022, Kyota Tashiro, Mengheng Lee, and Latona Inc.
+ * License MIT
+ *
+ * version: 0.1
+ */
+
+#ifndef __GST_DSMETARMQ_H__
+#define __GST_DSMETARMQ_H__
+
+#include <gst/gst.h>
+#include <gst/base/gstbasetransform.h>
+#include "gstnvdsmeta.h"
+#include "publisher-pool.h"
+#include "json-writer.h"
+#include "dsmeta-binary.h"
+#include "dsmeta-frame.h"
+#include "dsmeta-delta.h"
+#include "dsmeta-extract.h"
+#include "publish-throttle.h"
+#include "routing-key.h"
+#include "label-table.h"
+#include "latency-histogram.h"
+#include "metrics-server.h"
+
+/* Encoding of the metadata published to RabbitMQ. */
+typedef enum
+{
+  PAYLOAD_FORMAT_JSON,
+  PAYLOAD_FORMAT_BINARY,
+} GstDsMetaRmqPayloadFormat;
+
+/* Delivery guarantee of published messages. */
+typedef enum
+{
+  CONFIRM_MODE_NONE,
+  CONFIRM_MODE_CONFIRMED,
+} GstDsMetaRmqConfirmMode;
+
+/* Type of the exchange declared when publishing to one. */
+typedef enum
+{
+  EXCHANGE_TYPE_DIRECT,
+  EXCHANGE_TYPE_FANOUT,
+  EXCHANGE_TYPE_TOPIC,
+  EXCHANGE_TYPE_HEADERS,
+} GstDsMetaRmqExchangeType;
+
+/* Whether every frame carries all of its detections. */
+typedef enum
+{
+  PUBLISH_MODE_FULL,
+  PUBLISH_MODE_DELTA,
+} GstDsMetaRmqPublishMode;
+
+/* Per source frame stages with their own latency histogram. */
+typedef enum
+{
+  METARMQ_STAGE_META_WALK,
+  METARMQ_STAGE_SERIALIZE,
+  METARMQ_STAGE_ENQUEUE,
+  METARMQ_NUM_STAGES,
+} GstDsMetaRmqStage;
+
+G_BEGIN_DECLS
+/* Standard GStreamer boilerplate */
+#define GST_TYPE_DSMETARMQ \
+  (gst_ds_metarmq_get_type())
+#define GST_DSMETARMQ(obj) \
+  (G_TYPE_CHECK_INSTANCE_CAST((obj),GST_TYPE_DSMETARMQ,GstDsMetaRmq))
+#define GST_DSMETARMQ_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_CAST((klass),GST_TYPE_DSMETARMQ,GstDsMetaRmqClass))
+#define GST_IS_DSMETARMQ(obj) \
+  (G_TYPE_CHECK_INSTANCE_TYPE((obj),GST_TYPE_DSMETARMQ))
+#define GST_IS_DSMETARMQ_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_TYPE((klass),GST_TYPE_DSMETARMQ))
+/* Version number of package */
+#define VERSION "1.8.2"
+#define PACKAGE_DESCRIPTION "Gstreamer plugin to publish object metadata to RabbitMQ"
+/* Define under which licence the package has been released */
+#define PACKAGE_LICENSE "MIT/X11"
+#define PACKAGE_NAME "GStreamer dsmetarmq Plugin"
+/* Define to the home page for this package. */
+#define PACKAGE_URL "https://github.com/latonaio"
+
+typedef struct _GstDsMetaRmq GstDsMetaRmq;
+typedef struct _GstDsMetaRmqClass GstDsMetaRmqClass;
+
+/**
+ * GstDsMetaRmq element structure. A passthrough element that only reads
+ * NvDsBatchMeta, so it never maps the buffer or touches the GPU.
+ */
+struct _GstDsMetaRmq
+{
+  /** Should be the first member when extending from GstBaseTransform. */
+  GstBaseTransform parent_instance;
+
+  /** RabbitMQ connection settings. */
+  gchar *host;
+  guint port;
+  gchar *vhost;
+  gchar *user;
+  gchar *password;
+  gchar *queue;
+  /** amqp:// URI overriding the individual connection settings. */
+  gchar *uri;
+  /** Exchange to publish to instead of the queue, NULL or empty for none. */
+  gchar *exchange;
+  GstDsMetaRmqExchangeType exchange_type;
+  /** Routing key template, e.g. "cam.{source_id}.{label}". */
+  gchar *routing_key;
+  /** routing_key parsed at start, rendered for every message. */
+  routing_key_template routing;
+  /** Key of the message being enqueued, reused across messages. */
+  gchar routing_key_buf[ROUTING_KEY_MAX + 1];
+  /** Number of serialized payloads each publisher thread can queue. */
+  guint queue_depth;
+  /** What to do with a payload when the publish queue is full. */
+  payload_ring_policy overflow_policy;
+  /** Broker connections, each fed by its own publisher thread. */
+  guint connections;
+  /** Publisher threads feeding RabbitMQ off the streaming thread, one per
+   * connection; a source always publishes through the same one. */
+  publisher_pool publishers;
+  /** Encoding of the published metadata. */
+  GstDsMetaRmqPayloadFormat payload_format;
+  /** Upper bound on frames coalesced into one message. */
+  guint batch_max_frames;
+  /** Upper bound on the size of a batched message, 0 for none. */
+  guint batch_max_bytes;
+  /** How long a partial batch may wait before it is published. */
+  guint linger_ms;
+  /** nvinfer labels file naming the classes, NULL to learn them from the
+   * detections. */
+  gchar *labels_file;
+  /** Routing key of the label dictionary when publishing to an exchange. */
+  gchar *labels_routing_key;
+  /** Label of every class id seen so far, pre-escaped for JSON. */
+  label_table labels;
+  /** Generation of labels last handed to the publishers in binary mode. */
+  gulong labels_generation;
+  /** Detections of the source frame being published, reused across frames. */
+  dsmeta_frame frame;
+  /** Full frames, or keyframes and deltas of the changed objects. */
+  GstDsMetaRmqPublishMode publish_mode;
+  /** Pixels a box edge may move before a delta includes it again. */
+  gfloat delta_tolerance;
+  /** Frames of a source between two keyframes in delta mode. */
+  guint keyframe_interval;
+  /** What was last published per source, in delta mode. */
+  dsmeta_delta delta;
+  /** Publish every this many frames of a source. */
+  guint publish_interval;
+  /** Frames per second published per source at most, 0 for no limit. */
+  gdouble max_publish_rate;
+  /** Whether publishing backs off while the publish queue fills up. */
+  gboolean adaptive_throttle;
+  /** Which source frames get published; the video is never throttled. */
+  publish_throttle throttle;
+  /** Source frames extracted since start, throttled ones excluded. */
+  guint64 frames_processed;
+  /** AMQP heartbeat interval in seconds. */
+  guint heartbeat;
+  /** Unsent messages kept while the broker is unreachable. */
+  guint replay_depth;
+  /** Whether the broker confirms every published message. */
+  GstDsMetaRmqConfirmMode confirm_mode;
+  /** Unconfirmed messages allowed in flight. */
+  guint confirm_window;
+  /** How long a confirm may take before the message is retried. */
+  guint confirm_timeout_ms;
+  /** Reusable buffer the per-frame JSON payload is serialized into. */
+  json_writer json;
+  /** Reusable buffer the per-frame binary payload is serialized into. */
+  dsmeta_bin_writer bin;
+  /** Latency of each hot-path stage, readable through the stats property. */
+  latency_histogram latency[METARMQ_NUM_STAGES];
+  /** Seconds between stats log lines, 0 to disable. */
+  guint stats_interval;
+  /** Monotonic time in ns at which the stats are logged next. */
+  guint64 next_stats_log_ns;
+  /** Port of the Prometheus metrics endpoint, 0 to disable. */
+  guint metrics_port;
+  /** Thread answering metrics scrapes without involving the streaming thread. */
+  metrics_server metrics;
+};
+
+/* GStreamer boilerplate. */
+struct _GstDsMetaRmqClass
+{
+  GstBaseTransformClass parent_class;
+};
+
+GType gst_ds_metarmq_get_type (void);
+
+G_END_DECLS
+#endif /* __GST_DSMETARMQ_H__ */
@@ -10,7 +10,9 @@
  * version: 0.1
  */
 
+#include <math.h>
 #include <stdio.h>
+#include <time.h>
 #include <gst/gst.h>
 
 #include <gst/video/video.h>
@@ -18,12 +20,9 @@
 #include "gstdsosdcoordrmq.h"
 #include <cuda.h>
 #include <cuda_runtime.h>
-#include <jansson.h>
 
 #include "nvbufsurface.h"
 #include "nvtx3/nvToolsExt.h"
-#include "rabbitmq-client.h"
-#include "rabbitmq-client.c"
 
 GST_DEBUG_CATEGORY_STATIC (gst_ds_osdcoordrmq_debug);
 #define GST_CAT_DEFAULT gst_ds_osdcoordrmq_debug
@@ -31,7 +30,6 @@ GST_DEBUG_CATEGORY_STATIC (gst_ds_osdcoordrmq_debug);
 /* For hw blending, color should be of the form:
    class_id1, R, G, B, A:class_id2, R, G, B, A */
 #define DEFAULT_CLR "0,0.0,1.0,0.0,0.3:1,0.0,1.0,1.0,0.3:2,0.0,0.0,1.0,0.3:3,1.0,1.0,0.0,0.3"
-#define MAX_OSD_ELEMS 1024
 
 /* Filter signals and args */
 enum
@@ -56,7 +54,11 @@ enum
   PROP_GPU_DEVICE_ID,
   PROP_SHOW_BBOX,
   PROP_SHOW_MASK,
-  PROP_SHOW_COORD,
+  PROP_STATS,
+  PROP_STATS_INTERVAL,
+  PROP_SURFACE_THREADS,
+  PROP_CPU_THREADS,
+  PROP_TEXT_CACHE_SIZE,
 };
 
 /* the capabilities of the inputs and outputs. */
@@ -86,6 +88,16 @@ GST_STATIC_PAD_TEMPLATE ("src",
 #endif
 #define MAX_FONT_SIZE 60
 #define DEFAULT_BORDER_WIDTH 4
+#define DEFAULT_STATS_INTERVAL 0
+#define MAX_STATS_INTERVAL 3600
+#define DEFAULT_SURFACE_THREADS 1
+#define DEFAULT_CPU_THREADS 0
+#define DEFAULT_TEXT_CACHE_SIZE 0
+#define MAX_TEXT_CACHE_SIZE (256 * 1024 * 1024)
+/* Clock drawn from the text cache, in the local time zone. */
+#define CLOCK_FORMAT "%H:%M:%S"
+/* Bound on the pixel coordinates handed to the tiled renderer. */
+#define MAX_PIXEL_COORD 1048576
 
 /* Define our element type. Standard GObject/GStreamer boilerplate stuff */
 #define gst_ds_osdcoordrmq_parent_class parent_class
@@ -95,6 +107,17 @@ G_DEFINE_TYPE (GstDsOsdCoordRmq, gst_ds_osdcoordrmq, GST_TYPE_BASE_TRANSFORM);
 
 static GQuark _dsmeta_quark;
 
+/* Field name prefixes of the stages in the stats structure. */
+static const gchar *const stage_names[OSD_NUM_STAGES] = {
+  [OSD_STAGE_META_WALK] = "meta-walk",
+  [OSD_STAGE_DRAW_RECTANGLES] = "draw-rectangles",
+  [OSD_STAGE_DRAW_SEGMENT_MASKS] = "draw-segment-masks",
+  [OSD_STAGE_PUT_TEXT] = "put-text",
+  [OSD_STAGE_DRAW_LINES] = "draw-lines",
+  [OSD_STAGE_DRAW_ARROWS] = "draw-arrows",
+  [OSD_STAGE_DRAW_CIRCLES] = "draw-circles",
+};
+
 static GType
 gst_ds_osdcoordrmq_process_mode_get_type (void)
 {
@@ -133,8 +156,10 @@ static gboolean gst_ds_osdcoordrmq_parse_hw_blend_color_attrs (GstDsOsdCoordRmq
     const gchar * arr);
 static gboolean gst_ds_osdcoordrmq_get_hw_blend_color_attrs (GValue * value,
     GstDsOsdCoordRmq * dsosdcoordrmq);
-
-json_t* build_json(METADATA* metadata_arr, int cnt);
+static void gst_ds_osdcoordrmq_surface_thread (gpointer data,
+    gpointer user_data);
+static GstStructure *gst_ds_osdcoordrmq_get_stats (GstDsOsdCoordRmq *
+    dsosdcoordrmq);
 
 /**
  * Called when source / sink pad capabilities have been negotiated.
@@ -148,6 +173,8 @@ gst_ds_osdcoordrmq_set_caps (GstBaseTransform * trans, GstCaps * incaps,
   GstDsOsdCoordRmq *dsosdcoordrmq = GST_DSOSDCOORDRMQ (trans);
   gint width = 0, height = 0;
   cudaError_t CUerr = cudaSuccess;
+  void *conv_buf;
+  guint i;
 
   dsosdcoordrmq->frame_num = 0;
 
@@ -177,13 +204,16 @@ gst_ds_osdcoordrmq_set_caps (GstBaseTransform * trans, GstCaps * incaps,
   dsosdcoordrmq->width = width;
   dsosdcoordrmq->height = height;
 
-  if (dsosdcoordrmq->show_clock)
-    nvll_osd_set_clock_params (dsosdcoordrmq->dsosdcoordrmq_context,
-        &dsosdcoordrmq->clock_text_params);
+  for (i = 0; i < dsosdcoordrmq->num_contexts; i++) {
+    if (dsosdcoordrmq->show_clock)
+      nvll_osd_set_clock_params (dsosdcoordrmq->contexts[i],
+          &dsosdcoordrmq->clock_text_params);
 
-  dsosdcoordrmq->conv_buf =
-      nvll_osd_set_params (dsosdcoordrmq->dsosdcoordrmq_context, dsosdcoordrmq->width,
-      dsosdcoordrmq->height);
+    conv_buf = nvll_osd_set_params (dsosdcoordrmq->contexts[i],
+        dsosdcoordrmq->width, dsosdcoordrmq->height);
+    if (i == 0)
+      dsosdcoordrmq->conv_buf = conv_buf;
+  }
 
 exit_set_caps:
   GST_OBJECT_UNLOCK (dsosdcoordrmq);
@@ -197,6 +227,8 @@ static gboolean
 gst_ds_osdcoordrmq_start (GstBaseTransform * btrans)
 {
   GstDsOsdCoordRmq *dsosdcoordrmq = GST_DSOSDCOORDRMQ (btrans);
+  guint threads;
+  guint i;
 
   cudaError_t CUerr = cudaSuccess;
   CUerr = cudaSetDevice (dsosdcoordrmq->gpu_id);
@@ -222,16 +254,84 @@ gst_ds_osdcoordrmq_start (GstBaseTransform * btrans)
     dsosdcoordrmq->dsosdcoordrmq_mode = MODE_GPU;
   }
 
+  /* Surfaces are only drawn in parallel in CPU mode, where nvll_osd renders
+   * on the calling thread. */
+  dsosdcoordrmq->contexts[0] = dsosdcoordrmq->dsosdcoordrmq_context;
+  dsosdcoordrmq->num_contexts = 1;
+  if (dsosdcoordrmq->dsosdcoordrmq_mode == MODE_CPU) {
+    while (dsosdcoordrmq->num_contexts < dsosdcoordrmq->surface_threads) {
+      void *context = nvll_osd_create_context ();
+
+      if (!context)
+        break;
+      dsosdcoordrmq->contexts[dsosdcoordrmq->num_contexts++] = context;
+    }
+  }
+  if (dsosdcoordrmq->num_contexts > 1) {
+    GError *error = NULL;
+
+    dsosdcoordrmq->surface_pool =
+        g_thread_pool_new (gst_ds_osdcoordrmq_surface_thread, dsosdcoordrmq,
+        dsosdcoordrmq->num_contexts - 1, TRUE, &error);
+    if (!dsosdcoordrmq->surface_pool) {
+      GST_WARNING_OBJECT (dsosdcoordrmq, "no surface threads: %s",
+          error->message);
+      g_error_free (error);
+    }
+  }
+  threads = dsosdcoordrmq->surface_pool ? dsosdcoordrmq->num_contexts : 1;
+  if (dsosdcoordrmq->dsosdcoordrmq_mode == MODE_CPU &&
+      threads < dsosdcoordrmq->surface_threads)
+    GST_ELEMENT_WARNING (dsosdcoordrmq, RESOURCE, FAILED,
+        ("Drawing surfaces with %u of %u threads", threads,
+            dsosdcoordrmq->surface_threads), NULL);
+
+  if (dsosdcoordrmq->dsosdcoordrmq_mode == MODE_CPU && dsosdcoordrmq->cpu_threads) {
+    threads = cpu_renderer_init (&dsosdcoordrmq->cpu_renderer,
+        dsosdcoordrmq->cpu_threads);
+    dsosdcoordrmq->cpu_render = TRUE;
+    if (threads < dsosdcoordrmq->cpu_threads)
+      GST_ELEMENT_WARNING (dsosdcoordrmq, RESOURCE, FAILED,
+          ("Rendering with %u of %u CPU threads", threads,
+              dsosdcoordrmq->cpu_threads), NULL);
+
+#ifdef WITH_TEXT_CACHE
+    if (dsosdcoordrmq->text_cache_size) {
+      PangoFontMap *font_map = pango_cairo_font_map_new ();
+
+      dsosdcoordrmq->pango_context = pango_font_map_create_context (font_map);
+      g_object_unref (font_map);
+      text_atlas_init (&dsosdcoordrmq->text_atlas,
+          dsosdcoordrmq->text_cache_size);
+      dsosdcoordrmq->clock_advance = 0;
+      dsosdcoordrmq->text_cache = TRUE;
+    }
+#else
+    if (dsosdcoordrmq->text_cache_size)
+      GST_ELEMENT_WARNING (dsosdcoordrmq, RESOURCE, SETTINGS,
+          ("Built without the text cache, drawing text with nvll_osd"),
+          ("text-cache-size=%u needs a build with TEXT_CACHE=1",
+              dsosdcoordrmq->text_cache_size));
+#endif
+  }
+
   if (dsosdcoordrmq->num_class_entries == 0) {
     gst_ds_osdcoordrmq_parse_hw_blend_color_attrs (dsosdcoordrmq, DEFAULT_CLR);
   }
 
-  nvll_osd_init_colors_for_hw_blend (dsosdcoordrmq->dsosdcoordrmq_context,
-      dsosdcoordrmq->color_info, dsosdcoordrmq->num_class_entries);
+  dsosdcoordrmq->next_stats_log_ns =
+      latency_now_ns () + dsosdcoordrmq->stats_interval * GST_SECOND;
+
+  for (i = 0; i < dsosdcoordrmq->num_contexts; i++) {
+    nvll_osd_init_colors_for_hw_blend (dsosdcoordrmq->contexts[i],
+        dsosdcoordrmq->color_info, dsosdcoordrmq->num_class_entries);
 
-  if (dsosdcoordrmq->show_clock) {
-    nvll_osd_set_clock_params (dsosdcoordrmq->dsosdcoordrmq_context,
-        &dsosdcoordrmq->clock_text_params);
+    /* Also with the text cache: nvll_osd only adds the clock to the text it
+     * draws, so it shows it on the surfaces the element could not map. */
+    if (dsosdcoordrmq->show_clock) {
+      nvll_osd_set_clock_params (dsosdcoordrmq->contexts[i],
+          &dsosdcoordrmq->clock_text_params);
+    }
   }
 
   return TRUE;
@@ -244,6 +344,7 @@ static gboolean
 gst_ds_osdcoordrmq_stop (GstBaseTransform * btrans)
 {
   GstDsOsdCoordRmq *dsosdcoordrmq = GST_DSOSDCOORDRMQ (btrans);
+  guint i;
 
   cudaError_t CUerr = cudaSuccess;
   CUerr = cudaSetDevice (dsosdcoordrmq->gpu_id);
@@ -255,6 +356,29 @@ gst_ds_osdcoordrmq_stop (GstBaseTransform * btrans)
   GST_LOG_OBJECT (dsosdcoordrmq, "SETTING CUDA DEVICE = %d in dsosdcoordrmq func=%s\n",
       dsosdcoordrmq->gpu_id, __func__);
 
+  if (dsosdcoordrmq->surface_pool) {
+    g_thread_pool_free (dsosdcoordrmq->surface_pool, FALSE, TRUE);
+    dsosdcoordrmq->surface_pool = NULL;
+  }
+  for (i = 1; i < dsosdcoordrmq->num_contexts; i++)
+    nvll_osd_destroy_context (dsosdcoordrmq->contexts[i]);
+  dsosdcoordrmq->num_contexts = 0;
+
+  if (dsosdcoordrmq->cpu_render) {
+    cpu_renderer_free (&dsosdcoordrmq->cpu_renderer);
+    dsosdcoordrmq->cpu_render = FALSE;
+  }
+  if (dsosdcoordrmq->text_cache) {
+    g_mutex_lock (&dsosdcoordrmq->text_lock);
+    text_atlas_free (&dsosdcoordrmq->text_atlas);
+#ifdef WITH_TEXT_CACHE
+    g_object_unref (dsosdcoordrmq->pango_context);
+    dsosdcoordrmq->pango_context = NULL;
+#endif
+    dsosdcoordrmq->text_cache = FALSE;
+    g_mutex_unlock (&dsosdcoordrmq->text_lock);
+  }
+
   if (dsosdcoordrmq->dsosdcoordrmq_context)
     nvll_osd_destroy_context (dsosdcoordrmq->dsosdcoordrmq_context);
 
@@ -265,10 +389,586 @@ gst_ds_osdcoordrmq_stop (GstBaseTransform * btrans)
   return TRUE;
 }
 
-int frame_num = 0;
-int fnum_tmp=0;
-json_t *root;
-rabbitmq_cli cli;
+/* Makes room for the surfaces of a buffer. Batches are kept across buffers,
+ * so only a larger batch than seen before allocates. */
+static void
+gst_ds_osdcoordrmq_reserve_surfaces (GstDsOsdCoordRmq * dsosdcoordrmq,
+    guint count)
+{
+  guint i;
+
+  if (count <= dsosdcoordrmq->surfaces_capacity)
+    return;
+  dsosdcoordrmq->surfaces = g_renew (GstDsOsdCoordRmqSurface,
+      dsosdcoordrmq->surfaces, count);
+  for (i = dsosdcoordrmq->surfaces_capacity; i < count; i++) {
+    osd_batch_init (&dsosdcoordrmq->surfaces[i].batch);
+    cpu_render_list_init (&dsosdcoordrmq->surfaces[i].cpu_list);
+    dsosdcoordrmq->surfaces[i].text_runs = NULL;
+    dsosdcoordrmq->surfaces[i].text_runs_capacity = 0;
+  }
+  dsosdcoordrmq->surfaces_capacity = count;
+}
+
+/* What the properties ask to be drawn, and by whom. */
+static void
+gst_ds_osdcoordrmq_draw_options (GstDsOsdCoordRmq * dsosdcoordrmq,
+    osd_draw_options * options)
+{
+  options->draw_bbox = dsosdcoordrmq->draw_bbox;
+  options->draw_mask = dsosdcoordrmq->draw_mask;
+  options->draw_text = dsosdcoordrmq->draw_text;
+  options->show_clock = dsosdcoordrmq->show_clock;
+  options->cpu_render = dsosdcoordrmq->cpu_render;
+  options->text_cache = dsosdcoordrmq->text_cache;
+}
+
+#ifdef PLATFORM_TEGRA
+/* In case of hardware blending, values set in hw-blend-color-attr should be
+ * considered as rect bg color values. */
+static void
+gst_ds_osdcoordrmq_blend_object (NvOSD_RectParams * rect_params,
+    const NvDsObjectMeta * object_meta, void *user_data)
+{
+  GstDsOsdCoordRmq *dsosdcoordrmq = GST_DSOSDCOORDRMQ (user_data);
+  int idx;
+
+  for (idx = 0; idx < dsosdcoordrmq->num_class_entries; idx++) {
+    if (dsosdcoordrmq->color_info[idx].id == object_meta->class_id) {
+      rect_params->color_id = idx;
+      rect_params->has_bg_color = TRUE;
+      rect_params->bg_color.red = dsosdcoordrmq->color_info[idx].color.red;
+      rect_params->bg_color.blue = dsosdcoordrmq->color_info[idx].color.blue;
+      rect_params->bg_color.green = dsosdcoordrmq->color_info[idx].color.green;
+      rect_params->bg_color.alpha = dsosdcoordrmq->color_info[idx].color.alpha;
+      break;
+    }
+  }
+}
+#endif
+
+/**
+ * Copies what the batch meta asks to be drawn into the batch of the surface
+ * each frame belongs to. Nothing is drawn here, so each primitive type ends
+ * up in one array per surface however many objects the frame carries.
+ */
+static void
+gst_ds_osdcoordrmq_collect (GstDsOsdCoordRmq * dsosdcoordrmq,
+    NvBufSurface * surface, NvDsBatchMeta * batch_meta)
+{
+  NvDsMetaList *l_frame = NULL;
+  NvDsFrameMeta *frame_meta = NULL;
+  osd_draw_object_func object_func = NULL;
+  osd_draw_options options;
+  guint i;
+
+  gst_ds_osdcoordrmq_reserve_surfaces (dsosdcoordrmq, surface->numFilled);
+  for (i = 0; i < surface->numFilled; i++) {
+    osd_batch_reset (&dsosdcoordrmq->surfaces[i].batch);
+    dsosdcoordrmq->surfaces[i].surface = surface;
+    dsosdcoordrmq->surfaces[i].index = i;
+  }
+  dsosdcoordrmq->num_surfaces = surface->numFilled;
+  if (!batch_meta)
+    return;
+
+  gst_ds_osdcoordrmq_draw_options (dsosdcoordrmq, &options);
+#ifdef PLATFORM_TEGRA
+  if (dsosdcoordrmq->dsosdcoordrmq_mode == MODE_HW && dsosdcoordrmq->hw_blend)
+    object_func = gst_ds_osdcoordrmq_blend_object;
+#endif
+  for (l_frame = batch_meta->frame_meta_list; l_frame != NULL;
+      l_frame = l_frame->next) {
+    frame_meta = (NvDsFrameMeta *) (l_frame->data);
+    if (frame_meta->batch_id >= dsosdcoordrmq->num_surfaces) {
+      GST_WARNING_OBJECT (dsosdcoordrmq,
+          "frame with batch_id %u in a buffer of %u surfaces",
+          frame_meta->batch_id, dsosdcoordrmq->num_surfaces);
+      continue;
+    }
+    osd_draw_collect_frame (&dsosdcoordrmq->surfaces[frame_meta->batch_id].batch,
+        frame_meta, &options, object_func, dsosdcoordrmq);
+  }
+}
+
+/* Byte value of a color component given in [0, 1]. */
+static guint8
+gst_ds_osdcoordrmq_color_byte (double value)
+{
+  return (guint8) (CLAMP (value, 0.0, 1.0) * 255.0 + 0.5);
+}
+
+static void
+gst_ds_osdcoordrmq_color_bytes (const NvOSD_ColorParams * color,
+    guint8 bytes[4])
+{
+  bytes[0] = gst_ds_osdcoordrmq_color_byte (color->red);
+  bytes[1] = gst_ds_osdcoordrmq_color_byte (color->green);
+  bytes[2] = gst_ds_osdcoordrmq_color_byte (color->blue);
+  bytes[3] = gst_ds_osdcoordrmq_color_byte (color->alpha);
+}
+
+/* Nearest pixel of a coordinate, bounded so that sums of coordinates cannot
+ * overflow in the renderer. */
+static gint
+gst_ds_osdcoordrmq_pixel (float value)
+{
+  return (gint) floorf (CLAMP (value, -MAX_PIXEL_COORD, MAX_PIXEL_COORD) +
+      0.5f);
+}
+
+/* Draws the rectangles of target with the tiled renderer. Returns 0 like the
+ * nvll_osd call it replaces. */
+static int
+gst_ds_osdcoordrmq_cpu_draw_rects (GstDsOsdCoordRmq * dsosdcoordrmq,
+    GstDsOsdCoordRmqSurface * target, const cpu_render_target * render_target)
+{
+  cpu_render_list *list = &target->cpu_list;
+  const NvOSD_RectParams *params;
+  cpu_render_rect *rect;
+  guint i;
+
+  cpu_render_list_reset (list);
+  for (i = 0; i < target->batch.num_rects; i++) {
+    params = &target->batch.rects[i];
+    if (!(rect = cpu_render_list_add_rect (list)))
+      break;
+    rect->left = gst_ds_osdcoordrmq_pixel (params->left);
+    rect->top = gst_ds_osdcoordrmq_pixel (params->top);
+    rect->width = gst_ds_osdcoordrmq_pixel (params->width);
+    rect->height = gst_ds_osdcoordrmq_pixel (params->height);
+    rect->border_width = MIN (params->border_width, MAX_PIXEL_COORD);
+    gst_ds_osdcoordrmq_color_bytes (&params->border_color, rect->border_color);
+    rect->has_bg_color = params->has_bg_color;
+    gst_ds_osdcoordrmq_color_bytes (&params->bg_color, rect->bg_color);
+  }
+  cpu_renderer_draw (&dsosdcoordrmq->cpu_renderer, render_target, list);
+  return 0;
+}
+
+/* Draws the segment masks of target with the tiled renderer, each in the
+ * border color of its box. */
+static int
+gst_ds_osdcoordrmq_cpu_draw_masks (GstDsOsdCoordRmq * dsosdcoordrmq,
+    GstDsOsdCoordRmqSurface * target, const cpu_render_target * render_target)
+{
+  cpu_render_list *list = &target->cpu_list;
+  const NvOSD_RectParams *params;
+  cpu_render_mask *mask;
+  guint i;
+
+  cpu_render_list_reset (list);
+  for (i = 0; i < target->batch.num_masks; i++) {
+    params = &target->batch.mask_rects[i];
+    if (!(mask = cpu_render_list_add_mask (list)))
+      break;
+    mask->left = gst_ds_osdcoordrmq_pixel (params->left);
+    mask->top = gst_ds_osdcoordrmq_pixel (params->top);
+    mask->width = gst_ds_osdcoordrmq_pixel (params->width);
+    mask->height = gst_ds_osdcoordrmq_pixel (params->height);
+    mask->data = target->batch.masks[i].data;
+    mask->mask_width = target->batch.masks[i].width;
+    mask->mask_height = target->batch.masks[i].height;
+    mask->threshold = target->batch.masks[i].threshold;
+    /* The scores must cover the whole mask, or it is not drawn. */
+    if ((guint64) mask->mask_width * mask->mask_height >
+        target->batch.masks[i].size / sizeof (float))
+      mask->data = NULL;
+    gst_ds_osdcoordrmq_color_bytes (&params->border_color, mask->color);
+  }
+  cpu_renderer_draw (&dsosdcoordrmq->cpu_renderer, render_target, list);
+  return 0;
+}
+
+/* Draws the lines of target with the tiled renderer. */
+static int
+gst_ds_osdcoordrmq_cpu_draw_lines (GstDsOsdCoordRmq * dsosdcoordrmq,
+    GstDsOsdCoordRmqSurface * target, const cpu_render_target * render_target)
+{
+  cpu_render_list *list = &target->cpu_list;
+  const NvOSD_LineParams *params;
+  cpu_render_line *line;
+  guint i;
+
+  cpu_render_list_reset (list);
+  for (i = 0; i < target->batch.num_lines; i++) {
+    params = &target->batch.lines[i];
+    if (!(line = cpu_render_list_add_line (list)))
+      break;
+    line->x1 = MIN (params->x1, MAX_PIXEL_COORD);
+    line->y1 = MIN (params->y1, MAX_PIXEL_COORD);
+    line->x2 = MIN (params->x2, MAX_PIXEL_COORD);
+    line->y2 = MIN (params->y2, MAX_PIXEL_COORD);
+    line->width = MIN (params->line_width, MAX_PIXEL_COORD);
+    gst_ds_osdcoordrmq_color_bytes (&params->line_color, line->color);
+  }
+  cpu_renderer_draw (&dsosdcoordrmq->cpu_renderer, render_target, list);
+  return 0;
+}
+
+#ifdef WITH_TEXT_CACHE
+/* Rasterizes text into a new run of the text atlas, with text_lock held.
+ * NULL when the run cannot be cached, which leaves it undrawn. */
+static const text_atlas_entry *
+gst_ds_osdcoordrmq_rasterize_text (GstDsOsdCoordRmq * dsosdcoordrmq,
+    const gchar * font, guint size, const gchar * text)
+{
+  PangoFontDescription *description = pango_font_description_from_string (font);
+  PangoLayout *layout = pango_layout_new (dsosdcoordrmq->pango_context);
+  text_atlas_entry *run = NULL;
+  PangoRectangle logical;
+  cairo_surface_t *surface;
+  cairo_t *cr;
+  gint stride;
+
+  pango_font_description_set_size (description, size * PANGO_SCALE);
+  pango_layout_set_font_description (layout, description);
+  pango_layout_set_text (layout, text, -1);
+  pango_layout_get_pixel_extents (layout, NULL, &logical);
+  stride = cairo_format_stride_for_width (CAIRO_FORMAT_A8,
+      MAX (logical.width, 1));
+  if (stride > 0)
+    run = text_atlas_add (&dsosdcoordrmq->text_atlas, font, size, text,
+        logical.width, logical.height, stride);
+  if (run && logical.width > 0 && logical.height > 0) {
+    surface = cairo_image_surface_create_for_data (run->coverage,
+        CAIRO_FORMAT_A8, logical.width, logical.height, stride);
+    cr = cairo_create (surface);
+    cairo_move_to (cr, -logical.x, -logical.y);
+    pango_cairo_show_layout (cr, layout);
+    cairo_destroy (cr);
+    cairo_surface_finish (surface);
+    cairo_surface_destroy (surface);
+  }
+  g_object_unref (layout);
+  pango_font_description_free (description);
+  return run;
+}
+#endif
+
+/* Cached run of text in font_params, rasterized on a miss, with text_lock
+ * held. The run is held until text_atlas_release. */
+static const text_atlas_entry *
+gst_ds_osdcoordrmq_text_run (GstDsOsdCoordRmq * dsosdcoordrmq,
+    const NvOSD_FontParams * font_params, const gchar * text)
+{
+  const gchar *font = font_params->font_name ? font_params->font_name :
+      DEFAULT_FONT;
+  guint size = font_params->font_size ? font_params->font_size :
+      DEFAULT_FONT_SIZE;
+  const text_atlas_entry *run =
+      text_atlas_find (&dsosdcoordrmq->text_atlas, font, size, text);
+
+#ifdef WITH_TEXT_CACHE
+  if (!run)
+    run = gst_ds_osdcoordrmq_rasterize_text (dsosdcoordrmq, font, size, text);
+#endif
+  return run;
+}
+
+/* Runs of the glyphs of the current clock into runs, with text_lock held,
+ * and the width each digit takes into advance. The digits and ':' are cached
+ * as one run each, so the clock stops rasterizing once the ten digits were
+ * measured, and the digits are set at the width of the widest one like
+ * tabular figures. Returns the number of glyphs, 0 when the time cannot be
+ * formatted. */
+static guint
+gst_ds_osdcoordrmq_clock_runs (GstDsOsdCoordRmq * dsosdcoordrmq,
+    const text_atlas_entry ** runs, guint * advance)
+{
+  const NvOSD_FontParams *font_params =
+      &dsosdcoordrmq->clock_text_params.font_params;
+  const text_atlas_entry *run;
+  time_t now = time (NULL);
+  struct tm local;
+  gchar glyph[2] = { 0 };
+  guint i;
+
+  if (now != dsosdcoordrmq->clock_second) {
+    if (!localtime_r (&now, &local) ||
+        !strftime (dsosdcoordrmq->clock_text,
+            sizeof (dsosdcoordrmq->clock_text), CLOCK_FORMAT, &local))
+      return 0;
+    dsosdcoordrmq->clock_second = now;
+  }
+  if (!dsosdcoordrmq->clock_advance) {
+    for (glyph[0] = '0'; glyph[0] <= '9'; glyph[0]++) {
+      run = gst_ds_osdcoordrmq_text_run (dsosdcoordrmq, font_params, glyph);
+      if (run) {
+        dsosdcoordrmq->clock_advance =
+            MAX (dsosdcoordrmq->clock_advance, run->width);
+        text_atlas_release (&dsosdcoordrmq->text_atlas, run);
+      }
+    }
+  }
+  *advance = dsosdcoordrmq->clock_advance;
+  for (i = 0; dsosdcoordrmq->clock_text[i]; i++) {
+    glyph[0] = dsosdcoordrmq->clock_text[i];
+    runs[i] = gst_ds_osdcoordrmq_text_run (dsosdcoordrmq, font_params, glyph);
+  }
+  return i;
+}
+
+static void
+gst_ds_osdcoordrmq_blit_text (GstDsOsdCoordRmq * dsosdcoordrmq,
+    const NvOSD_TextParams * params, const text_atlas_entry * run, gint x,
+    gint y, const cpu_render_target * render_target)
+{
+  guint8 color[4];
+  guint8 bg_color[4];
+
+  gst_ds_osdcoordrmq_color_bytes (&params->font_params.font_color, color);
+  gst_ds_osdcoordrmq_color_bytes (&params->text_bg_clr, bg_color);
+  text_atlas_blit (dsosdcoordrmq->cpu_renderer.kernels, render_target, run,
+      x, y, color, params->set_bg_clr ? bg_color : NULL);
+}
+
+/* Blits the glyph runs of the clock left to right from its offsets, each
+ * digit centred in advance pixels and ':' at its own width. A glyph that
+ * could not be cached is left out but keeps its place. */
+static void
+gst_ds_osdcoordrmq_blit_clock (GstDsOsdCoordRmq * dsosdcoordrmq,
+    const text_atlas_entry ** runs, guint num_glyphs, guint advance,
+    const cpu_render_target * render_target)
+{
+  const NvOSD_TextParams *params = &dsosdcoordrmq->clock_text_params;
+  gint x = MIN (params->x_offset, MAX_PIXEL_COORD);
+  gint y = MIN (params->y_offset, MAX_PIXEL_COORD);
+  guint i, width;
+
+  for (i = 0; i < num_glyphs; i++) {
+    if (!runs[i]) {
+      x += advance;
+      continue;
+    }
+    width = g_ascii_isdigit (runs[i]->text[0]) ?
+        MAX (advance, runs[i]->width) : runs[i]->width;
+    gst_ds_osdcoordrmq_blit_text (dsosdcoordrmq, params, runs[i],
+        x + (gint) (width - runs[i]->width) / 2, y, render_target);
+    x += width;
+  }
+}
+
+/* Blits the text of target, and the clock when shown, from the text atlas.
+ * text_lock is only held to look the runs up and to release them, so the
+ * surface threads blit concurrently. Returns 0 like the nvll_osd call it
+ * replaces. */
+static int
+gst_ds_osdcoordrmq_cpu_put_text (GstDsOsdCoordRmq * dsosdcoordrmq,
+    GstDsOsdCoordRmqSurface * target, const cpu_render_target * render_target)
+{
+  const NvOSD_TextParams *params;
+  guint num_texts = target->batch.num_texts;
+  guint num_runs = num_texts + CLOCK_GLYPHS;
+  guint num_glyphs = 0, advance = 0;
+  guint i;
+
+  if (num_runs > target->text_runs_capacity) {
+    target->text_runs = g_renew (const text_atlas_entry *, target->text_runs,
+        num_runs);
+    target->text_runs_capacity = num_runs;
+  }
+
+  g_mutex_lock (&dsosdcoordrmq->text_lock);
+  for (i = 0; i < num_texts; i++) {
+    params = &target->batch.texts[i];
+    target->text_runs[i] = params->display_text && params->display_text[0] ?
+        gst_ds_osdcoordrmq_text_run (dsosdcoordrmq, &params->font_params,
+        params->display_text) : NULL;
+  }
+  if (dsosdcoordrmq->show_clock)
+    num_glyphs = gst_ds_osdcoordrmq_clock_runs (dsosdcoordrmq,
+        target->text_runs + num_texts, &advance);
+  g_mutex_unlock (&dsosdcoordrmq->text_lock);
+
+  for (i = 0; i < num_texts; i++) {
+    params = &target->batch.texts[i];
+    if (target->text_runs[i])
+      gst_ds_osdcoordrmq_blit_text (dsosdcoordrmq, params,
+          target->text_runs[i], MIN (params->x_offset, MAX_PIXEL_COORD),
+          MIN (params->y_offset, MAX_PIXEL_COORD), render_target);
+  }
+  gst_ds_osdcoordrmq_blit_clock (dsosdcoordrmq, target->text_runs + num_texts,
+      num_glyphs, advance, render_target);
+
+  g_mutex_lock (&dsosdcoordrmq->text_lock);
+  for (i = 0; i < num_texts + num_glyphs; i++) {
+    if (target->text_runs[i])
+      text_atlas_release (&dsosdcoordrmq->text_atlas, target->text_runs[i]);
+  }
+  g_mutex_unlock (&dsosdcoordrmq->text_lock);
+  return 0;
+}
+
+/* The surface being drawn by osd_draw_surface, for the tiled renderer. */
+typedef struct
+{
+  GstDsOsdCoordRmq *dsosdcoordrmq;
+  GstDsOsdCoordRmqSurface *target;
+} GstDsOsdCoordRmqCpuDraw;
+
+/* osd_draw_cpu_func drawing boxes, masks, text and lines on the mapped
+ * surface. */
+static int
+gst_ds_osdcoordrmq_cpu_draw (osd_draw_type type, const osd_batch * batch,
+    const cpu_render_target * render_target, void *user_data)
+{
+  GstDsOsdCoordRmqCpuDraw *draw = user_data;
+
+  switch (type) {
+    case OSD_DRAW_RECTANGLES:
+      return gst_ds_osdcoordrmq_cpu_draw_rects (draw->dsosdcoordrmq,
+          draw->target, render_target);
+    case OSD_DRAW_SEGMENT_MASKS:
+      return gst_ds_osdcoordrmq_cpu_draw_masks (draw->dsosdcoordrmq,
+          draw->target, render_target);
+    case OSD_DRAW_PUT_TEXT:
+      return gst_ds_osdcoordrmq_cpu_put_text (draw->dsosdcoordrmq,
+          draw->target, render_target);
+    case OSD_DRAW_LINES:
+      return gst_ds_osdcoordrmq_cpu_draw_lines (draw->dsosdcoordrmq,
+          draw->target, render_target);
+    default:
+      return -1;
+  }
+}
+
+/**
+ * Draws the batch of target with at most one call per primitive type, in the
+ * order rectangles, segment masks, text, lines, arrows and circles. This may
+ * run on a surface thread, so the outcome is only stored in target and
+ * accounted for by gst_ds_osdcoordrmq_account.
+ */
+static void
+gst_ds_osdcoordrmq_draw_surface (GstDsOsdCoordRmq * dsosdcoordrmq,
+    GstDsOsdCoordRmqSurface * target, void *context)
+{
+  GstDsOsdCoordRmqCpuDraw cpu_draw = { dsosdcoordrmq, target };
+  osd_draw_options options;
+
+  gst_ds_osdcoordrmq_draw_options (dsosdcoordrmq, &options);
+  osd_draw_surface (&target->batch, target->surface, target->index, context,
+      dsosdcoordrmq->dsosdcoordrmq_mode, &options, gst_ds_osdcoordrmq_cpu_draw,
+      &cpu_draw, &target->result);
+}
+
+/* Draws surfaces until none is left. Each thread has a context of its own,
+ * nvll_osd contexts must not be shared between threads. */
+static void
+gst_ds_osdcoordrmq_draw_next_surfaces (GstDsOsdCoordRmq * dsosdcoordrmq,
+    guint thread)
+{
+  void *context = dsosdcoordrmq->contexts[thread];
+  gint index;
+
+  while ((index = g_atomic_int_add (&dsosdcoordrmq->next_surface, 1)) <
+      (gint) dsosdcoordrmq->num_surfaces)
+    gst_ds_osdcoordrmq_draw_surface (dsosdcoordrmq,
+        &dsosdcoordrmq->surfaces[index], context);
+}
+
+/* GThreadPool function of the surface threads, data is the thread index. */
+static void
+gst_ds_osdcoordrmq_surface_thread (gpointer data, gpointer user_data)
+{
+  GstDsOsdCoordRmq *dsosdcoordrmq = GST_DSOSDCOORDRMQ (user_data);
+
+  /* The device is per thread; if it cannot be set, the surfaces are left to
+   * the streaming thread. */
+  if (cudaSetDevice (dsosdcoordrmq->gpu_id) == cudaSuccess)
+    gst_ds_osdcoordrmq_draw_next_surfaces (dsosdcoordrmq,
+        GPOINTER_TO_UINT (data));
+
+  g_mutex_lock (&dsosdcoordrmq->surface_lock);
+  if (--dsosdcoordrmq->surface_tasks == 0)
+    g_cond_signal (&dsosdcoordrmq->surface_done);
+  g_mutex_unlock (&dsosdcoordrmq->surface_lock);
+}
+
+/**
+ * Draws every surface of the buffer. The streaming thread draws along with
+ * the surface threads, if any, and returns once all surfaces are done.
+ */
+static void
+gst_ds_osdcoordrmq_draw_surfaces (GstDsOsdCoordRmq * dsosdcoordrmq)
+{
+  guint tasks = 0;
+  guint i;
+
+  g_atomic_int_set (&dsosdcoordrmq->next_surface, 0);
+  if (dsosdcoordrmq->surface_pool && dsosdcoordrmq->num_surfaces > 1) {
+    tasks = MIN (dsosdcoordrmq->num_contexts, dsosdcoordrmq->num_surfaces) - 1;
+    dsosdcoordrmq->surface_tasks = tasks;
+    /* Thread 0 is the streaming thread, so every task gets a context no
+     * other thread uses. */
+    for (i = 1; i <= tasks; i++)
+      g_thread_pool_push (dsosdcoordrmq->surface_pool, GUINT_TO_POINTER (i),
+          NULL);
+  }
+
+  gst_ds_osdcoordrmq_draw_next_surfaces (dsosdcoordrmq, 0);
+
+  if (tasks) {
+    g_mutex_lock (&dsosdcoordrmq->surface_lock);
+    while (dsosdcoordrmq->surface_tasks)
+      g_cond_wait (&dsosdcoordrmq->surface_done, &dsosdcoordrmq->surface_lock);
+    g_mutex_unlock (&dsosdcoordrmq->surface_lock);
+  }
+}
+
+/* Folds the outcome of every surface into the stats and posts an error for
+ * the first call that failed. */
+static gboolean
+gst_ds_osdcoordrmq_account (GstDsOsdCoordRmq * dsosdcoordrmq)
+{
+  static const gchar *const draw_errors[OSD_DRAW_NUM_TYPES] = {
+    [OSD_DRAW_RECTANGLES] = "Unable to draw rectangles",
+    [OSD_DRAW_SEGMENT_MASKS] = "Unable to draw segment masks",
+    [OSD_DRAW_PUT_TEXT] = "Unable to draw text",
+    [OSD_DRAW_LINES] = "Unable to draw lines",
+    [OSD_DRAW_ARROWS] = "Unable to draw arrows",
+    [OSD_DRAW_CIRCLES] = "Unable to draw circles",
+  };
+  GstDsOsdCoordRmqSurface *target;
+  guint64 batch_grows = 0;
+  guint64 batch_dropped = 0;
+  guint i, type, stage;
+
+  /* The stats only read these totals, as the surfaces may be reallocated
+   * while the stats property is read. */
+  for (i = 0; i < dsosdcoordrmq->surfaces_capacity; i++) {
+    batch_grows += dsosdcoordrmq->surfaces[i].batch.grows +
+        dsosdcoordrmq->surfaces[i].cpu_list.grows;
+    batch_dropped += dsosdcoordrmq->surfaces[i].batch.dropped +
+        dsosdcoordrmq->surfaces[i].cpu_list.dropped;
+  }
+  dsosdcoordrmq->batch_grows = batch_grows;
+  dsosdcoordrmq->batch_dropped = batch_dropped;
+
+  for (i = 0; i < dsosdcoordrmq->num_surfaces; i++) {
+    target = &dsosdcoordrmq->surfaces[i];
+    for (type = 0; type < OSD_DRAW_NUM_TYPES; type++) {
+      if (!target->result.drawn[type])
+        continue;
+      stage = OSD_STAGE_DRAW_RECTANGLES + type;
+      latency_histogram_record (&dsosdcoordrmq->latency[stage],
+          target->result.draw_ns[type]);
+      dsosdcoordrmq->draw_calls++;
+      dsosdcoordrmq->primitives[stage] += target->result.primitives[type];
+    }
+  }
+  dsosdcoordrmq->surfaces_drawn += dsosdcoordrmq->num_surfaces;
+
+  for (i = 0; i < dsosdcoordrmq->num_surfaces; i++) {
+    target = &dsosdcoordrmq->surfaces[i];
+    if (target->result.failed != OSD_DRAW_NUM_TYPES) {
+      GST_ELEMENT_ERROR (dsosdcoordrmq, RESOURCE, FAILED,
+          ("%s", draw_errors[target->result.failed]), NULL);
+      return FALSE;
+    }
+  }
+  return TRUE;
+}
 
 /**
  * Called when element recieves an input buffer from upstream element.
@@ -278,33 +978,13 @@ gst_ds_osdcoordrmq_transform_ip (GstBaseTransform * trans, GstBuffer * buf)
 {
   GstDsOsdCoordRmq *dsosdcoordrmq = GST_DSOSDCOORDRMQ (trans);
   GstMapInfo inmap = GST_MAP_INFO_INIT;
-  unsigned int rect_cnt = 0;
-  unsigned int segment_cnt = 0;
-  unsigned int text_cnt = 0;
-  unsigned int line_cnt = 0;
-  unsigned int arrow_cnt = 0;
-  unsigned int circle_cnt = 0;
-  unsigned int i = 0;
-  int idx = 0;
   gpointer state = NULL;
   NvBufSurface *surface = NULL;
   NvDsBatchMeta *batch_meta = NULL;
-
-  METADATA metadata;
-  char *str_obj;
-  METADATA metadata_arr[128];
-  int m_cnt=0;
-
-  char *host_name = "x.x.x.x";
-  int port = 32094;
-  char *vhost_name = "tao";
-  char *rmq_id = "guest";
-  char *rmq_pass = "guest";
-  char *queue_name = "peoplenet-metadata-queue-test";
-
-  if (dsosdcoordrmq->frame_num == 0) {
-    cli = new_rabbitmq_client(host_name, port, vhost_name, rmq_id, rmq_pass);
-  }
+  guint64 buffer_start;
+  guint64 draw_start;
+  guint64 draw_ns;
+  guint64 now;
 
   if (!gst_buffer_map (buf, &inmap, GST_MAP_READ)) {
     GST_ELEMENT_ERROR (dsosdcoordrmq, RESOURCE, FAILED,
@@ -325,6 +1005,7 @@ gst_ds_osdcoordrmq_transform_ip (GstBaseTransform * trans, GstBuffer * buf)
       dsosdcoordrmq->gpu_id, __func__);
 
   surface = (NvBufSurface *) inmap.data;
+  buffer_start = latency_now_ns ();
 
   /* Get metadata. Update rectangle and text params */
   GstMeta *gst_meta;
@@ -343,298 +1024,28 @@ gst_ds_osdcoordrmq_transform_ip (GstBaseTransform * trans, GstBuffer * buf)
     }
   }
 
-  NvDsMetaList *l = NULL;
-  NvDsMetaList *full_obj_meta_list = NULL;
-  if (batch_meta)
-    full_obj_meta_list = batch_meta->obj_meta_pool->full_list;
-  NvDsObjectMeta *object_meta = NULL;
-
-  for (l = full_obj_meta_list; l != NULL; l = l->next) {
-    object_meta = (NvDsObjectMeta *) (l->data);
-    if (dsosdcoordrmq->draw_bbox) {
-      dsosdcoordrmq->rect_params[rect_cnt] = object_meta->rect_params;
-#ifdef PLATFORM_TEGRA
-      /* In case of hardware blending, values set in hw-blend-color-attr
-         should be considered as rect bg color values*/
-      if (dsosdcoordrmq->dsosdcoordrmq_mode == MODE_HW && dsosdcoordrmq->hw_blend) {
-        for (idx = 0; idx < dsosdcoordrmq->num_class_entries; idx++) {
-          if (dsosdcoordrmq->color_info[idx].id == object_meta->class_id) {
-            dsosdcoordrmq->rect_params[rect_cnt].color_id = idx;
-            dsosdcoordrmq->rect_params[rect_cnt].has_bg_color = TRUE;
-            dsosdcoordrmq->rect_params[rect_cnt].bg_color.red =
-              dsosdcoordrmq->color_info[idx].color.red;
-            dsosdcoordrmq->rect_params[rect_cnt].bg_color.blue =
-              dsosdcoordrmq->color_info[idx].color.blue;
-            dsosdcoordrmq->rect_params[rect_cnt].bg_color.green =
-              dsosdcoordrmq->color_info[idx].color.green;
-            dsosdcoordrmq->rect_params[rect_cnt].bg_color.alpha =
-              dsosdcoordrmq->color_info[idx].color.alpha;
-            break;
-          }
-        }
-      }
-#endif
-      rect_cnt++;
-    }
-    /* Get the label and coordinates of the drawn bboxs*/
-    if (dsosdcoordrmq->display_coord) {
-      metadata.frame_number = dsosdcoordrmq->frame_num;
-      metadata.label = object_meta->text_params.display_text;
-      metadata.top_left.x = object_meta->rect_params.left;
-      metadata.top_left.y = object_meta->rect_params.top;
-      metadata.top_right.x = object_meta->rect_params.left + object_meta->rect_params.width;
-      metadata.top_right.y = object_meta->rect_params.top;
-      metadata.bottom_left.x = object_meta->rect_params.left;
-      metadata.bottom_left.y = object_meta->rect_params.top + object_meta->rect_params.height;
-      metadata.bottom_right.x = object_meta->rect_params.left + object_meta->rect_params.width;
-      metadata.bottom_right.y = object_meta->rect_params.top + object_meta->rect_params.height;
-
-      metadata_arr[m_cnt] = metadata;
-      m_cnt++;
-    }
-
-    if (rect_cnt == MAX_OSD_ELEMS) {
-      dsosdcoordrmq->frame_rect_params->num_rects = rect_cnt;
-      dsosdcoordrmq->frame_rect_params->rect_params_list = dsosdcoordrmq->rect_params;
-      dsosdcoordrmq->frame_rect_params->buf_ptr = &surface->surfaceList[0];
-      dsosdcoordrmq->frame_rect_params->mode = dsosdcoordrmq->dsosdcoordrmq_mode;
-      if (nvll_osd_draw_rectangles (dsosdcoordrmq->dsosdcoordrmq_context,
-              dsosdcoordrmq->frame_rect_params) == -1) {
-        GST_ELEMENT_ERROR (dsosdcoordrmq, RESOURCE, FAILED,
-            ("Unable to draw rectangles"), NULL);
-        return GST_FLOW_ERROR;
-      }
-      rect_cnt = 0;
-    }
-    if (dsosdcoordrmq->draw_mask && object_meta->mask_params.data &&
-                              object_meta->mask_params.size > 0) {
-      dsosdcoordrmq->mask_rect_params[segment_cnt] = object_meta->rect_params;
-      dsosdcoordrmq->mask_params[segment_cnt++] = object_meta->mask_params;
-      if (segment_cnt == MAX_OSD_ELEMS) {
-        dsosdcoordrmq->frame_mask_params->num_segments = segment_cnt;
-        dsosdcoordrmq->frame_mask_params->rect_params_list = dsosdcoordrmq->mask_rect_params;
-        dsosdcoordrmq->frame_mask_params->mask_params_list = dsosdcoordrmq->mask_params;
-        dsosdcoordrmq->frame_mask_params->buf_ptr = &surface->surfaceList[0];
-        dsosdcoordrmq->frame_mask_params->mode = dsosdcoordrmq->dsosdcoordrmq_mode;
-        if (nvll_osd_draw_segment_masks (dsosdcoordrmq->dsosdcoordrmq_context,
-                dsosdcoordrmq->frame_mask_params) == -1) {
-          GST_ELEMENT_ERROR (dsosdcoordrmq, RESOURCE, FAILED,
-              ("Unable to draw rectangles"), NULL);
-          return GST_FLOW_ERROR;
-        }
-        segment_cnt = 0;
-      }
-    }
-    if (object_meta->text_params.display_text)
-      dsosdcoordrmq->text_params[text_cnt++] = object_meta->text_params;
-    if (text_cnt == MAX_OSD_ELEMS) {
-      dsosdcoordrmq->frame_text_params->num_strings = text_cnt;
-      dsosdcoordrmq->frame_text_params->text_params_list = dsosdcoordrmq->text_params;
-      dsosdcoordrmq->frame_text_params->buf_ptr = &surface->surfaceList[0];
-      dsosdcoordrmq->frame_text_params->mode = dsosdcoordrmq->dsosdcoordrmq_mode;
-      if (nvll_osd_put_text (dsosdcoordrmq->dsosdcoordrmq_context,
-              dsosdcoordrmq->frame_text_params) == -1) {
-        GST_ELEMENT_ERROR (dsosdcoordrmq, RESOURCE, FAILED,
-            ("Unable to draw text"), NULL);
-        return GST_FLOW_ERROR;
-      }
-      text_cnt = 0;
-    }
-  }
-
-  /* Send metadata in JSON format to RabbitMQ*/
-  root = build_json(metadata_arr, m_cnt);
-  if (m_cnt > 0) {
-    str_obj = json_dumps(root, 0);
-    int reply = rabbitmq_cli_publish(cli , queue_name, str_obj);
-    // printf("%s\n", str_obj);
-  }
-
-  NvDsMetaList *display_meta_list = NULL;
-  if (batch_meta)
-    display_meta_list = batch_meta->display_meta_pool->full_list;
-  NvDsDisplayMeta *display_meta = NULL;
-
-  /* Get objects to be drawn from display meta.
-   * Draw objects if count equals MAX_OSD_ELEMS.
-   */
-  for (l = display_meta_list; l != NULL; l = l->next) {
-    display_meta = (NvDsDisplayMeta *) (l->data);
-
-    unsigned int cnt = 0;
-    for (cnt = 0; cnt < display_meta->num_rects; cnt++) {
-      dsosdcoordrmq->rect_params[rect_cnt++] = display_meta->rect_params[cnt];
-      if (rect_cnt == MAX_OSD_ELEMS) {
-        dsosdcoordrmq->frame_rect_params->num_rects = rect_cnt;
-        dsosdcoordrmq->frame_rect_params->rect_params_list = dsosdcoordrmq->rect_params;
-        dsosdcoordrmq->frame_rect_params->buf_ptr = &surface->surfaceList[0];
-        dsosdcoordrmq->frame_rect_params->mode = dsosdcoordrmq->dsosdcoordrmq_mode;
-        if (nvll_osd_draw_rectangles (dsosdcoordrmq->dsosdcoordrmq_context,
-                dsosdcoordrmq->frame_rect_params) == -1) {
-          GST_ELEMENT_ERROR (dsosdcoordrmq, RESOURCE, FAILED,
-              ("Unable to draw rectangles"), NULL);
-          return GST_FLOW_ERROR;
-        }
-        rect_cnt = 0;
-      }
-    }
-
-    for (cnt = 0; cnt < display_meta->num_labels; cnt++) {
-      if (display_meta->text_params[cnt].display_text) {
-        dsosdcoordrmq->text_params[text_cnt++] = display_meta->text_params[cnt];
-        if (text_cnt == MAX_OSD_ELEMS) {
-          dsosdcoordrmq->frame_text_params->num_strings = text_cnt;
-          dsosdcoordrmq->frame_text_params->text_params_list = dsosdcoordrmq->text_params;
-          dsosdcoordrmq->frame_text_params->buf_ptr = &surface->surfaceList[0];
-          dsosdcoordrmq->frame_text_params->mode = dsosdcoordrmq->dsosdcoordrmq_mode;
-          if (nvll_osd_put_text (dsosdcoordrmq->dsosdcoordrmq_context,
-                  dsosdcoordrmq->frame_text_params) == -1) {
-            GST_ELEMENT_ERROR (dsosdcoordrmq, RESOURCE, FAILED,
-                ("Unable to draw text"), NULL);
-            return GST_FLOW_ERROR;
-          }
-          text_cnt = 0;
-        }
-      }
-    }
-
-    for (cnt = 0; cnt < display_meta->num_lines; cnt++) {
-      dsosdcoordrmq->line_params[line_cnt++] = display_meta->line_params[cnt];
-      if (line_cnt == MAX_OSD_ELEMS) {
-        dsosdcoordrmq->frame_line_params->num_lines = line_cnt;
-        dsosdcoordrmq->frame_line_params->line_params_list = dsosdcoordrmq->line_params;
-        dsosdcoordrmq->frame_line_params->buf_ptr = &surface->surfaceList[0];
-        dsosdcoordrmq->frame_line_params->mode = dsosdcoordrmq->dsosdcoordrmq_mode;
-        if (nvll_osd_draw_lines (dsosdcoordrmq->dsosdcoordrmq_context,
-                dsosdcoordrmq->frame_line_params) == -1) {
-          GST_ELEMENT_ERROR (dsosdcoordrmq, RESOURCE, FAILED,
-              ("Unable to draw lines"), NULL);
-          return GST_FLOW_ERROR;
-        }
-        line_cnt = 0;
-      }
-    }
-
-    for (cnt = 0; cnt < display_meta->num_arrows; cnt++) {
-      dsosdcoordrmq->arrow_params[arrow_cnt++] = display_meta->arrow_params[cnt];
-      if (arrow_cnt == MAX_OSD_ELEMS) {
-        dsosdcoordrmq->frame_arrow_params->num_arrows = arrow_cnt;
-        dsosdcoordrmq->frame_arrow_params->arrow_params_list = dsosdcoordrmq->arrow_params;
-        dsosdcoordrmq->frame_arrow_params->buf_ptr = &surface->surfaceList[0];
-        dsosdcoordrmq->frame_arrow_params->mode = dsosdcoordrmq->dsosdcoordrmq_mode;
-        if (nvll_osd_draw_arrows (dsosdcoordrmq->dsosdcoordrmq_context,
-                dsosdcoordrmq->frame_arrow_params) == -1) {
-          GST_ELEMENT_ERROR (dsosdcoordrmq, RESOURCE, FAILED,
-              ("Unable to draw arrows"), NULL);
-          return GST_FLOW_ERROR;
-        }
-        arrow_cnt = 0;
-      }
-    }
-
-    for (cnt = 0; cnt < display_meta->num_circles; cnt++) {
-      dsosdcoordrmq->circle_params[circle_cnt++] = display_meta->circle_params[cnt];
-      if (circle_cnt == MAX_OSD_ELEMS) {
-        dsosdcoordrmq->frame_circle_params->num_circles = circle_cnt;
-        dsosdcoordrmq->frame_circle_params->circle_params_list =
-            dsosdcoordrmq->circle_params;
-        dsosdcoordrmq->frame_circle_params->buf_ptr = &surface->surfaceList[0];
-        dsosdcoordrmq->frame_circle_params->mode = dsosdcoordrmq->dsosdcoordrmq_mode;
-        if (nvll_osd_draw_circles (dsosdcoordrmq->dsosdcoordrmq_context,
-                dsosdcoordrmq->frame_circle_params) == -1) {
-          GST_ELEMENT_ERROR (dsosdcoordrmq, RESOURCE, FAILED,
-              ("Unable to draw circles"), NULL);
-          return GST_FLOW_ERROR;
-        }
-        circle_cnt = 0;
-      }
-    }
-    i++;
-  }
-
-  dsosdcoordrmq->num_rect = rect_cnt;
-  dsosdcoordrmq->num_segments = segment_cnt;
-  dsosdcoordrmq->num_strings = text_cnt;
-  dsosdcoordrmq->num_lines = line_cnt;
-  dsosdcoordrmq->num_arrows = arrow_cnt;
-  dsosdcoordrmq->num_circles = circle_cnt;
-  if (rect_cnt != 0 && dsosdcoordrmq->draw_bbox) {
-    dsosdcoordrmq->frame_rect_params->num_rects = dsosdcoordrmq->num_rect;
-    dsosdcoordrmq->frame_rect_params->rect_params_list = dsosdcoordrmq->rect_params;
-    dsosdcoordrmq->frame_rect_params->buf_ptr = &surface->surfaceList[0];
-    dsosdcoordrmq->frame_rect_params->mode = dsosdcoordrmq->dsosdcoordrmq_mode;
-    if (nvll_osd_draw_rectangles (dsosdcoordrmq->dsosdcoordrmq_context,
-            dsosdcoordrmq->frame_rect_params) == -1) {
-      GST_ELEMENT_ERROR (dsosdcoordrmq, RESOURCE, FAILED,
-          ("Unable to draw rectangles"), NULL);
-      return GST_FLOW_ERROR;
-    }
-  }
-
-  if (segment_cnt != 0 && dsosdcoordrmq->draw_mask) {
-    dsosdcoordrmq->frame_mask_params->num_segments = dsosdcoordrmq->num_segments;
-    dsosdcoordrmq->frame_mask_params->rect_params_list = dsosdcoordrmq->mask_rect_params;
-    dsosdcoordrmq->frame_mask_params->mask_params_list = dsosdcoordrmq->mask_params;
-    dsosdcoordrmq->frame_mask_params->buf_ptr = &surface->surfaceList[0];
-    dsosdcoordrmq->frame_mask_params->mode = dsosdcoordrmq->dsosdcoordrmq_mode;
-    if (nvll_osd_draw_segment_masks (dsosdcoordrmq->dsosdcoordrmq_context,
-            dsosdcoordrmq->frame_mask_params) == -1) {
-      GST_ELEMENT_ERROR (dsosdcoordrmq, RESOURCE, FAILED,
-          ("Unable to draw segment masks"), NULL);
-      return GST_FLOW_ERROR;
-    }
-  }
-
-  if ((dsosdcoordrmq->show_clock || text_cnt) && dsosdcoordrmq->draw_text) {
-    dsosdcoordrmq->frame_text_params->num_strings = dsosdcoordrmq->num_strings;
-    dsosdcoordrmq->frame_text_params->text_params_list = dsosdcoordrmq->text_params;
-    dsosdcoordrmq->frame_text_params->buf_ptr = &surface->surfaceList[0];
-    dsosdcoordrmq->frame_text_params->mode = dsosdcoordrmq->dsosdcoordrmq_mode;
-    if (nvll_osd_put_text (dsosdcoordrmq->dsosdcoordrmq_context,
-            dsosdcoordrmq->frame_text_params) == -1) {
-      GST_ELEMENT_ERROR (dsosdcoordrmq, RESOURCE, FAILED, ("Unable to draw text"),
-          NULL);
-      return GST_FLOW_ERROR;
-    }
-  }
-
-  if (line_cnt != 0) {
-    dsosdcoordrmq->frame_line_params->num_lines = dsosdcoordrmq->num_lines;
-    dsosdcoordrmq->frame_line_params->line_params_list = dsosdcoordrmq->line_params;
-    dsosdcoordrmq->frame_line_params->buf_ptr = &surface->surfaceList[0];
-    dsosdcoordrmq->frame_line_params->mode = dsosdcoordrmq->dsosdcoordrmq_mode;
-    if (nvll_osd_draw_lines (dsosdcoordrmq->dsosdcoordrmq_context,
-            dsosdcoordrmq->frame_line_params) == -1) {
-      GST_ELEMENT_ERROR (dsosdcoordrmq, RESOURCE, FAILED, ("Unable to draw lines"),
-          NULL);
-      return GST_FLOW_ERROR;
-    }
-  }
-
-  if (arrow_cnt != 0) {
-    dsosdcoordrmq->frame_arrow_params->num_arrows = dsosdcoordrmq->num_arrows;
-    dsosdcoordrmq->frame_arrow_params->arrow_params_list = dsosdcoordrmq->arrow_params;
-    dsosdcoordrmq->frame_arrow_params->buf_ptr = &surface->surfaceList[0];
-    dsosdcoordrmq->frame_arrow_params->mode = dsosdcoordrmq->dsosdcoordrmq_mode;
-    if (nvll_osd_draw_arrows (dsosdcoordrmq->dsosdcoordrmq_context,
-            dsosdcoordrmq->frame_arrow_params) == -1) {
-      GST_ELEMENT_ERROR (dsosdcoordrmq, RESOURCE, FAILED,
-          ("Unable to draw arrows"), NULL);
-      return GST_FLOW_ERROR;
-    }
+  gst_ds_osdcoordrmq_collect (dsosdcoordrmq, surface, batch_meta);
+  draw_start = latency_now_ns ();
+  gst_ds_osdcoordrmq_draw_surfaces (dsosdcoordrmq);
+  draw_ns = latency_now_ns () - draw_start;
+  if (!gst_ds_osdcoordrmq_account (dsosdcoordrmq)) {
+    nvtxRangePop ();
+    gst_buffer_unmap (buf, &inmap);
+    return GST_FLOW_ERROR;
   }
-
-  if (circle_cnt != 0) {
-    dsosdcoordrmq->frame_circle_params->num_circles = dsosdcoordrmq->num_circles;
-    dsosdcoordrmq->frame_circle_params->circle_params_list = dsosdcoordrmq->circle_params;
-    dsosdcoordrmq->frame_circle_params->buf_ptr = &surface->surfaceList[0];
-    dsosdcoordrmq->frame_circle_params->mode = dsosdcoordrmq->dsosdcoordrmq_mode;
-    if (nvll_osd_draw_circles (dsosdcoordrmq->dsosdcoordrmq_context,
-            dsosdcoordrmq->frame_circle_params) == -1) {
-      GST_ELEMENT_ERROR (dsosdcoordrmq, RESOURCE, FAILED,
-          ("Unable to draw circles"), NULL);
-      return GST_FLOW_ERROR;
-    }
+  dsosdcoordrmq->buffers++;
+
+  now = latency_now_ns ();
+  latency_histogram_record (&dsosdcoordrmq->latency[OSD_STAGE_META_WALK],
+      now - buffer_start - draw_ns);
+  if (dsosdcoordrmq->stats_interval &&
+      now >= dsosdcoordrmq->next_stats_log_ns) {
+    GstStructure *stats = gst_ds_osdcoordrmq_get_stats (dsosdcoordrmq);
+
+    GST_INFO_OBJECT (dsosdcoordrmq, "%" GST_PTR_FORMAT, stats);
+    gst_structure_free (stats);
+    dsosdcoordrmq->next_stats_log_ns =
+        now + dsosdcoordrmq->stats_interval * GST_SECOND;
   }
 
   nvtxRangePop ();
@@ -654,24 +1065,20 @@ static void
 gst_ds_osdcoordrmq_finalize (GObject * object)
 {
   GstDsOsdCoordRmq *dsosdcoordrmq = GST_DSOSDCOORDRMQ (object);
+  guint i;
 
   if (dsosdcoordrmq->clock_text_params.font_params.font_name) {
     g_free ((char *) dsosdcoordrmq->clock_text_params.font_params.font_name);
   }
-  g_free (dsosdcoordrmq->rect_params);
-  g_free (dsosdcoordrmq->mask_rect_params);
-  g_free (dsosdcoordrmq->mask_params);
-  g_free (dsosdcoordrmq->text_params);
-  g_free (dsosdcoordrmq->line_params);
-  g_free (dsosdcoordrmq->arrow_params);
-  g_free (dsosdcoordrmq->circle_params);
-
-  g_free (dsosdcoordrmq->frame_rect_params);
-  g_free (dsosdcoordrmq->frame_mask_params);
-  g_free (dsosdcoordrmq->frame_text_params);
-  g_free (dsosdcoordrmq->frame_line_params);
-  g_free (dsosdcoordrmq->frame_arrow_params);
-  g_free (dsosdcoordrmq->frame_circle_params);
+  for (i = 0; i < dsosdcoordrmq->surfaces_capacity; i++) {
+    osd_batch_free (&dsosdcoordrmq->surfaces[i].batch);
+    cpu_render_list_free (&dsosdcoordrmq->surfaces[i].cpu_list);
+    g_free (dsosdcoordrmq->surfaces[i].text_runs);
+  }
+  g_free (dsosdcoordrmq->surfaces);
+  g_mutex_clear (&dsosdcoordrmq->surface_lock);
+  g_cond_clear (&dsosdcoordrmq->surface_done);
+  g_mutex_clear (&dsosdcoordrmq->text_lock);
 
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
@@ -719,10 +1126,6 @@ gst_ds_osdcoordrmq_class_init (GstDsOsdCoordRmqClass * klass)
       g_param_spec_boolean ("display-mask", "text", "Whether to display instance mask",
           TRUE, G_PARAM_READWRITE));
 
-  g_object_class_install_property (gobject_class, PROP_SHOW_COORD,
-      g_param_spec_boolean ("display-coord", "text", "Whether to display coordinate",
-	  TRUE, G_PARAM_READWRITE));
-
   g_object_class_install_property (gobject_class, PROP_CLOCK_FONT,
       g_param_spec_string ("clock-font", "clock-font",
           "Clock Font to be set",
@@ -783,6 +1186,47 @@ gst_ds_osdcoordrmq_class_init (GstDsOsdCoordRmqClass * klass)
           G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
           GST_PARAM_MUTABLE_READY));
 
+  g_object_class_install_property (gobject_class, PROP_STATS,
+      g_param_spec_boxed ("stats", "Stage latency statistics",
+          "Count, mean, p50, p90, p99 and max latency in ns of the meta walk "
+          "and of every nvll_osd draw call type",
+          GST_TYPE_STRUCTURE,
+          G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_STATS_INTERVAL,
+      g_param_spec_uint ("stats-interval", "Stats log interval",
+          "Log the stats structure at INFO level every this many seconds "
+          "(0 = never)",
+          0, MAX_STATS_INTERVAL, DEFAULT_STATS_INTERVAL,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_READY));
+
+  g_object_class_install_property (gobject_class, PROP_SURFACE_THREADS,
+      g_param_spec_uint ("surface-threads", "Surface threads",
+          "Threads drawing the surfaces of a batched buffer in parallel in "
+          "CPU mode, the streaming thread included (1 = one after another)",
+          1, MAX_SURFACE_THREADS, DEFAULT_SURFACE_THREADS,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_READY));
+
+  g_object_class_install_property (gobject_class, PROP_CPU_THREADS,
+      g_param_spec_uint ("cpu-threads", "CPU render threads",
+          "In CPU mode, draw boxes, segment masks and lines with the built-in "
+          "tiled renderer on this many threads, the calling thread included "
+          "(0 = draw them with nvll_osd)",
+          0, CPU_RENDER_MAX_THREADS, DEFAULT_CPU_THREADS,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_READY));
+
+  g_object_class_install_property (gobject_class, PROP_TEXT_CACHE_SIZE,
+      g_param_spec_uint ("text-cache-size", "Text cache size",
+          "With the CPU renderer, rasterize text and the clock once into a "
+          "cache of at most this many bytes and blit them from there "
+          "(0 = draw text with nvll_osd)",
+          0, MAX_TEXT_CACHE_SIZE, DEFAULT_TEXT_CACHE_SIZE,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_READY));
+
   gst_element_class_set_details_simple (gstelement_class,
       "DsOsdCoordRmq plugin",
       "DsOsdCoordRmq functionality",
@@ -819,9 +1263,6 @@ gst_ds_osdcoordrmq_set_property (GObject * object, guint prop_id,
     case PROP_SHOW_MASK:
       dsosdcoordrmq->draw_mask = g_value_get_boolean (value);
       break;
-    case PROP_SHOW_COORD:
-      dsosdcoordrmq->display_coord = g_value_get_boolean (value);
-      break;
     case PROP_CLOCK_FONT:
       if (dsosdcoordrmq->clock_text_params.font_params.font_name) {
         g_free ((char *) dsosdcoordrmq->clock_text_params.font_params.font_name);
@@ -853,6 +1294,18 @@ gst_ds_osdcoordrmq_set_property (GObject * object, guint prop_id,
     case PROP_GPU_DEVICE_ID:
       dsosdcoordrmq->gpu_id = g_value_get_uint (value);
       break;
+    case PROP_STATS_INTERVAL:
+      dsosdcoordrmq->stats_interval = g_value_get_uint (value);
+      break;
+    case PROP_SURFACE_THREADS:
+      dsosdcoordrmq->surface_threads = g_value_get_uint (value);
+      break;
+    case PROP_CPU_THREADS:
+      dsosdcoordrmq->cpu_threads = g_value_get_uint (value);
+      break;
+    case PROP_TEXT_CACHE_SIZE:
+      dsosdcoordrmq->text_cache_size = g_value_get_uint (value);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -881,9 +1334,6 @@ gst_ds_osdcoordrmq_get_property (GObject * object, guint prop_id,
     case PROP_SHOW_MASK:
       g_value_set_boolean (value, dsosdcoordrmq->draw_mask);
       break;
-    case PROP_SHOW_COORD:
-      g_value_set_boolean (value, dsosdcoordrmq->display_coord);
-      break;
     case PROP_CLOCK_FONT:
       g_value_set_string (value, dsosdcoordrmq->font);
       break;
@@ -908,6 +1358,21 @@ gst_ds_osdcoordrmq_get_property (GObject * object, guint prop_id,
     case PROP_GPU_DEVICE_ID:
       g_value_set_uint (value, dsosdcoordrmq->gpu_id);
       break;
+    case PROP_STATS:
+      g_value_take_boxed (value, gst_ds_osdcoordrmq_get_stats (dsosdcoordrmq));
+      break;
+    case PROP_STATS_INTERVAL:
+      g_value_set_uint (value, dsosdcoordrmq->stats_interval);
+      break;
+    case PROP_SURFACE_THREADS:
+      g_value_set_uint (value, dsosdcoordrmq->surface_threads);
+      break;
+    case PROP_CPU_THREADS:
+      g_value_set_uint (value, dsosdcoordrmq->cpu_threads);
+      break;
+    case PROP_TEXT_CACHE_SIZE:
+      g_value_set_uint (value, dsosdcoordrmq->text_cache_size);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -919,38 +1384,120 @@ gst_ds_osdcoordrmq_get_property (GObject * object, guint prop_id,
 static void
 gst_ds_osdcoordrmq_init (GstDsOsdCoordRmq * dsosdcoordrmq)
 {
+  guint i;
+
   dsosdcoordrmq->show_clock = FALSE;
   dsosdcoordrmq->draw_text = TRUE;
   dsosdcoordrmq->draw_bbox = TRUE;
   dsosdcoordrmq->draw_mask = FALSE;
-  dsosdcoordrmq->display_coord = TRUE;
   dsosdcoordrmq->clock_text_params.font_params.font_name = g_strdup (DEFAULT_FONT);
   dsosdcoordrmq->clock_text_params.font_params.font_size = DEFAULT_FONT_SIZE;
   dsosdcoordrmq->dsosdcoordrmq_mode = GST_NV_OSD_DEFAULT_PROCESS_MODE;
   dsosdcoordrmq->border_width = DEFAULT_BORDER_WIDTH;
-  dsosdcoordrmq->num_rect = 0;
-  dsosdcoordrmq->num_segments = 0;
-  dsosdcoordrmq->num_strings = 0;
-  dsosdcoordrmq->num_lines = 0;
   dsosdcoordrmq->clock_text_params.font_params.font_color.red = 1.0;
   dsosdcoordrmq->clock_text_params.font_params.font_color.green = 0.0;
   dsosdcoordrmq->clock_text_params.font_params.font_color.blue = 0.0;
   dsosdcoordrmq->clock_text_params.font_params.font_color.alpha = 1.0;
-  dsosdcoordrmq->rect_params = g_new0 (NvOSD_RectParams, MAX_OSD_ELEMS);
-  dsosdcoordrmq->mask_rect_params = g_new0 (NvOSD_RectParams, MAX_OSD_ELEMS);
-  dsosdcoordrmq->mask_params = g_new0 (NvOSD_MaskParams, MAX_OSD_ELEMS);
-  dsosdcoordrmq->text_params = g_new0 (NvOSD_TextParams, MAX_OSD_ELEMS);
-  dsosdcoordrmq->line_params = g_new0 (NvOSD_LineParams, MAX_OSD_ELEMS);
-  dsosdcoordrmq->arrow_params = g_new0 (NvOSD_ArrowParams, MAX_OSD_ELEMS);
-  dsosdcoordrmq->circle_params = g_new0 (NvOSD_CircleParams, MAX_OSD_ELEMS);
-  dsosdcoordrmq->frame_rect_params = g_new0 (NvOSD_FrameRectParams, MAX_OSD_ELEMS);
-  dsosdcoordrmq->frame_mask_params = g_new0 (NvOSD_FrameSegmentMaskParams, MAX_OSD_ELEMS);
-  dsosdcoordrmq->frame_text_params = g_new0 (NvOSD_FrameTextParams, MAX_OSD_ELEMS);
-  dsosdcoordrmq->frame_line_params = g_new0 (NvOSD_FrameLineParams, MAX_OSD_ELEMS);
-  dsosdcoordrmq->frame_arrow_params = g_new0 (NvOSD_FrameArrowParams, MAX_OSD_ELEMS);
-  dsosdcoordrmq->frame_circle_params =
-      g_new0 (NvOSD_FrameCircleParams, MAX_OSD_ELEMS);
+  dsosdcoordrmq->surfaces = NULL;
+  dsosdcoordrmq->num_surfaces = 0;
+  dsosdcoordrmq->surfaces_capacity = 0;
+  dsosdcoordrmq->surface_threads = DEFAULT_SURFACE_THREADS;
+  dsosdcoordrmq->cpu_threads = DEFAULT_CPU_THREADS;
+  dsosdcoordrmq->cpu_render = FALSE;
+  dsosdcoordrmq->text_cache_size = DEFAULT_TEXT_CACHE_SIZE;
+  dsosdcoordrmq->text_cache = FALSE;
+  text_atlas_init (&dsosdcoordrmq->text_atlas, 0);
+  dsosdcoordrmq->clock_text[0] = '\0';
+  dsosdcoordrmq->clock_second = -1;
+  dsosdcoordrmq->clock_advance = 0;
+#ifdef WITH_TEXT_CACHE
+  dsosdcoordrmq->pango_context = NULL;
+#endif
+  g_mutex_init (&dsosdcoordrmq->text_lock);
+  dsosdcoordrmq->num_contexts = 0;
+  dsosdcoordrmq->surface_pool = NULL;
+  g_mutex_init (&dsosdcoordrmq->surface_lock);
+  g_cond_init (&dsosdcoordrmq->surface_done);
+  dsosdcoordrmq->buffers = 0;
+  dsosdcoordrmq->surfaces_drawn = 0;
+  dsosdcoordrmq->batch_grows = 0;
+  dsosdcoordrmq->batch_dropped = 0;
+  dsosdcoordrmq->draw_calls = 0;
   dsosdcoordrmq->hw_blend = FALSE;
+  for (i = 0; i < OSD_NUM_STAGES; i++) {
+    latency_histogram_init (&dsosdcoordrmq->latency[i]);
+    dsosdcoordrmq->primitives[i] = 0;
+  }
+  dsosdcoordrmq->stats_interval = DEFAULT_STATS_INTERVAL;
+  dsosdcoordrmq->next_stats_log_ns = 0;
+}
+
+/**
+ * Snapshot of the stage latency histograms. Each stage contributes
+ * <stage>-count, -mean-ns, -p50-ns, -p90-ns, -p99-ns and -max-ns fields, and
+ * each draw stage also <stage>-primitives. buffers, surfaces and draw-calls
+ * give the number of nvll_osd calls per surface, batch-dropped the primitives
+ * lost because a batch could not grow. cpu-kernels names the pixel loops of
+ * the CPU renderer while it is in use, and text-cache-* describe the text
+ * cache while it is.
+ */
+static GstStructure *
+gst_ds_osdcoordrmq_get_stats (GstDsOsdCoordRmq * dsosdcoordrmq)
+{
+  GstStructure *stats = gst_structure_new ("dsosdcoordrmq-stats",
+      "buffers", G_TYPE_UINT64, dsosdcoordrmq->buffers,
+      "surfaces", G_TYPE_UINT64, dsosdcoordrmq->surfaces_drawn,
+      "draw-calls", G_TYPE_UINT64, dsosdcoordrmq->draw_calls,
+      "batch-allocations", G_TYPE_UINT64, dsosdcoordrmq->batch_grows,
+      "batch-dropped", G_TYPE_UINT64, dsosdcoordrmq->batch_dropped, NULL);
+  latency_summary summary;
+  gchar field[64];
+  guint i, j;
+
+  if (dsosdcoordrmq->cpu_render)
+    gst_structure_set (stats, "cpu-kernels", G_TYPE_STRING,
+        dsosdcoordrmq->cpu_renderer.kernels->name, NULL);
+  g_mutex_lock (&dsosdcoordrmq->text_lock);
+  if (dsosdcoordrmq->text_cache)
+    gst_structure_set (stats,
+        "text-cache-hits", G_TYPE_UINT64,
+        (guint64) dsosdcoordrmq->text_atlas.hits,
+        "text-cache-misses", G_TYPE_UINT64,
+        (guint64) dsosdcoordrmq->text_atlas.misses,
+        "text-cache-evictions", G_TYPE_UINT64,
+        (guint64) dsosdcoordrmq->text_atlas.evictions,
+        "text-cache-dropped", G_TYPE_UINT64,
+        (guint64) dsosdcoordrmq->text_atlas.dropped,
+        "text-cache-bytes", G_TYPE_UINT64,
+        (guint64) dsosdcoordrmq->text_atlas.bytes, NULL);
+  g_mutex_unlock (&dsosdcoordrmq->text_lock);
+  for (i = 0; i < OSD_NUM_STAGES; i++) {
+    latency_histogram_summarize (&dsosdcoordrmq->latency[i], &summary);
+    const struct
+    {
+      const gchar *suffix;
+      guint64 value;
+    } fields[] = {
+      {"count", summary.count},
+      {"mean-ns", summary.mean_ns},
+      {"p50-ns", summary.p50_ns},
+      {"p90-ns", summary.p90_ns},
+      {"p99-ns", summary.p99_ns},
+      {"max-ns", summary.max_ns},
+    };
+
+    for (j = 0; j < G_N_ELEMENTS (fields); j++) {
+      g_snprintf (field, sizeof (field), "%s-%s", stage_names[i],
+          fields[j].suffix);
+      gst_structure_set (stats, field, G_TYPE_UINT64, fields[j].value, NULL);
+    }
+    if (i != OSD_STAGE_META_WALK) {
+      g_snprintf (field, sizeof (field), "%s-primitives", stage_names[i]);
+      gst_structure_set (stats, field, G_TYPE_UINT64,
+          dsosdcoordrmq->primitives[i], NULL);
+    }
+  }
+  return stats;
 }
 
 /**
@@ -1047,45 +1594,6 @@ gst_ds_osdcoordrmq_get_hw_blend_color_attrs (GValue * value, GstDsOsdCoordRmq *
   return TRUE;
 }
 
-json_t* build_json(METADATA* metadata_arr, int cnt)
-{
-  json_t *root = json_object();
-  json_error_t err;
-  json_t *results = json_array();
-  json_t *object = json_object();
-  json_t *coordinate = json_object();
-  json_t *jtop_left = json_object();
-  json_t *jtop_right = json_object();
-  json_t *jbottom_left = json_object();
-  json_t *jbottom_right = json_object();
-
-  for (int i=0; i<cnt; i++) {
-    json_object_set(jtop_left, "x", json_integer(metadata_arr[i].top_left.x));
-    json_object_set(jtop_left, "y", json_integer(metadata_arr[i].top_left.y));
-    json_object_set(jtop_right, "x", json_integer(metadata_arr[i].top_right.x));
-    json_object_set(jtop_right, "y", json_integer(metadata_arr[i].top_right.y));
-    json_object_set(jbottom_left, "x", json_integer(metadata_arr[i].bottom_left.x));
-    json_object_set(jbottom_left, "y", json_integer(metadata_arr[i].bottom_left.y));
-    json_object_set(jbottom_right, "x", json_integer(metadata_arr[i].bottom_right.x));
-    json_object_set(jbottom_right, "y", json_integer(metadata_arr[i].bottom_right.y));
-
-    json_object_set(coordinate, "topLeft", jtop_left);
-    json_object_set(coordinate, "topRight", jtop_right);
-    json_object_set(coordinate, "bottomLeft", jbottom_left);
-    json_object_set(coordinate, "bottomRight", jbottom_right);
-
-    json_object_set(object, "label", json_string(metadata_arr[i].label));
-    json_object_set(object, "coordinate", coordinate);
-    json_array_append(results, object);
-  }
-
-  json_object_set(root, "frameNumber", json_integer(metadata_arr[0].frame_number));
-  json_object_set(root, "inferredResult", results);
-
-  return root;
-}
-
-
 #ifndef PACKAGE
 #define PACKAGE "dsosdcoordrmq"
 #endif
@@ -17,11 +17,59 @@
 #include <gst/video/video.h>
 #include <gst/video/gstvideofilter.h>
 #include <stdlib.h>
+#ifdef WITH_TEXT_CACHE
+#include <pango/pangocairo.h>
+#endif
 #include "nvll_osd_api.h"
 #include "gstnvdsmeta.h"
+#include "latency-histogram.h"
+#include "osd-batch.h"
+#include "osd-draw.h"
+#include "cpu-render.h"
+#include "text-atlas.h"
 
 #define MAX_BG_CLR 20
 
+/* Hot-path stages with their own latency histogram. The meta walk is the
+ * time spent in transform_ip outside of the nvll_osd calls; the draw stages
+ * follow in the order of osd_draw_type. */
+typedef enum
+{
+  OSD_STAGE_META_WALK,
+  OSD_STAGE_DRAW_RECTANGLES,
+  OSD_STAGE_DRAW_SEGMENT_MASKS,
+  OSD_STAGE_PUT_TEXT,
+  OSD_STAGE_DRAW_LINES,
+  OSD_STAGE_DRAW_ARROWS,
+  OSD_STAGE_DRAW_CIRCLES,
+  OSD_NUM_STAGES,
+} GstDsOsdCoordRmqStage;
+
+/* Upper bound of the surface-threads property. */
+#define MAX_SURFACE_THREADS 16
+
+/* Glyphs of the clock, HH:MM:SS. */
+#define CLOCK_GLYPHS 8
+
+/* One surface of a batched buffer: what is drawn on it and, once drawn, how
+ * each nvll_osd call went. */
+typedef struct
+{
+  /** Primitives of the frame whose batch_id is this surface's index. */
+  osd_batch batch;
+  /** Boxes, masks or lines of batch in the form the tiled renderer takes. */
+  cpu_render_list cpu_list;
+  /** Text atlas runs held while the texts of batch and the clock glyphs are
+      blitted, NULL for those not drawn. */
+  const text_atlas_entry **text_runs;
+  /** Number of allocated text_runs, kept across buffers. */
+  guint text_runs_capacity;
+  NvBufSurface *surface;
+  guint index;
+  /** How each call of the current buffer went. */
+  osd_draw_result result;
+} GstDsOsdCoordRmqSurface;
+
 G_BEGIN_DECLS
 /* Standard GStreamer boilerplate */
 #define GST_TYPE_DSOSDCOORDRMQ \
@@ -70,46 +118,60 @@ struct _GstDsOsdCoordRmq
   /** Structure containing text params for clock. */
   NvOSD_TextParams clock_text_params;
 
-  /** List of strings to be drawn. */
-  NvOSD_TextParams *text_params;
-  /** List of rectangles to be drawn. */
-  NvOSD_RectParams *rect_params;
-  /** List of rectangles for segment masks to be drawn. */
-  NvOSD_RectParams *mask_rect_params;
-  /** List of segment masks to be drawn. */
-  NvOSD_MaskParams *mask_params;
-  /** List of lines to be drawn. */
-  NvOSD_LineParams *line_params;
-  /** List of arrows to be drawn. */
-  NvOSD_ArrowParams *arrow_params;
-  /** List of circles to be drawn. */
-  NvOSD_CircleParams *circle_params;
-
-  /** Number of rectangles to be drawn for a frame. */
-  guint num_rect;
-  /** Number of segment masks to be drawn for a frame. */
-  guint num_segments;
-  /** Number of strings to be drawn for a frame. */
-  guint num_strings;
-  /** Number of lines to be drawn for a frame. */
-  guint num_lines;
-  /** Number of arrows to be drawn for a frame. */
-  guint num_arrows;
-  /** Number of circles to be drawn for a frame. */
-  guint num_circles;
-
-  /** Structure containing details of rectangles to be drawn for a frame. */
-  NvOSD_FrameRectParams *frame_rect_params;
-  /** Structure containing details of segment masks to be drawn for a frame. */
-  NvOSD_FrameSegmentMaskParams *frame_mask_params;
-  /** Structure containing details of text to be overlayed for a frame. */
-  NvOSD_FrameTextParams *frame_text_params;
-  /** Structure containing details of lines to be drawn for a frame. */
-  NvOSD_FrameLineParams *frame_line_params;
-  /** Structure containing details of arrows to be drawn for a frame. */
-  NvOSD_FrameArrowParams *frame_arrow_params;
-  /** Structure containing details of circles to be drawn for a frame. */
-  NvOSD_FrameCircleParams *frame_circle_params;
+  /** Surfaces of the current buffer. Each gets its own batch, so every
+      primitive type is drawn on it with a single nvll_osd call. */
+  GstDsOsdCoordRmqSurface *surfaces;
+  /** Number of surfaces in the current buffer. */
+  guint num_surfaces;
+  /** Number of allocated surfaces, kept across buffers. */
+  guint surfaces_capacity;
+  /** Threads drawing surfaces in parallel in CPU mode, the streaming thread
+      included. */
+  guint surface_threads;
+  /** nvll_osd context of each of those threads, the first being
+      dsosdcoordrmq_context. */
+  void *contexts[MAX_SURFACE_THREADS];
+  /** Number of contexts created. */
+  guint num_contexts;
+  /** Runs the surface threads other than the streaming thread, NULL when
+      surfaces are drawn one after another. */
+  GThreadPool *surface_pool;
+  /** Index of the next surface to be picked up by a thread. */
+  gint next_surface;
+  /** Protects surface_tasks. */
+  GMutex surface_lock;
+  /** Signalled when the last surface thread task of a buffer is done. */
+  GCond surface_done;
+  /** Surface thread tasks of the current buffer still running. */
+  guint surface_tasks;
+  /** Threads of the tiled CPU renderer, 0 to leave all drawing to nvll_osd. */
+  guint cpu_threads;
+  /** Whether cpu_renderer is running, i.e. cpu_threads in CPU mode. */
+  gboolean cpu_render;
+  /** Draws boxes, segment masks and lines on mapped surfaces in CPU mode. */
+  cpu_renderer cpu_renderer;
+  /** Byte budget of the text cache, 0 to leave text to nvll_osd. */
+  guint text_cache_size;
+  /** Whether text and the clock are blitted from text_atlas, i.e.
+      text_cache_size while cpu_render. */
+  gboolean text_cache;
+  /** Rasterized text runs and clock glyphs. */
+  text_atlas text_atlas;
+#ifdef WITH_TEXT_CACHE
+  /** Lays out the text rasterized into text_atlas. */
+  PangoContext *pango_context;
+#endif
+  /** The clock as shown during clock_second, so it is formatted once per
+      second. */
+  gchar clock_text[CLOCK_GLYPHS + 1];
+  gint64 clock_second;
+  /** Width of the widest digit run of the clock, 0 until measured. Every
+      digit takes that much, so the clock does not shift as it ticks. */
+  guint clock_advance;
+  /** Protects text_atlas, pango_context and the clock fields, shared by the
+      surface threads. Runs are looked up and released under it, and
+      blitted outside of it. */
+  GMutex text_lock;
 
   /** Font of the text to be displayed. */
   gchar *font;
@@ -127,8 +189,6 @@ struct _GstDsOsdCoordRmq
   gboolean draw_bbox;
   /** Boolean indicating whether instance mask is to be drawn. */
   gboolean draw_mask;
-  /** Boolean indicating whether coordinate is to be displayed. */
-  gboolean display_coord;
   /**Array containing color info for blending */
   NvOSD_Color_info color_info[MAX_BG_CLR];
   /** Boolean indicating whether hw-blend-color-attr is set. */
@@ -139,6 +199,24 @@ struct _GstDsOsdCoordRmq
   guint gpu_id;
   /** Pointer to the converted buffer. */
   void *conv_buf;
+  /** Latency of each hot-path stage, readable through the stats property. */
+  latency_histogram latency[OSD_NUM_STAGES];
+  /** Buffers drawn so far. */
+  guint64 buffers;
+  /** Surfaces drawn so far, over all buffers. */
+  guint64 surfaces_drawn;
+  /** Allocations made by the surface batches so far. */
+  guint64 batch_grows;
+  /** Primitives the surface batches had no room for so far. */
+  guint64 batch_dropped;
+  /** nvll_osd calls issued so far, over all primitive types. */
+  guint64 draw_calls;
+  /** Primitives handed to the nvll_osd call of each draw stage. */
+  guint64 primitives[OSD_NUM_STAGES];
+  /** Seconds between stats log lines, 0 to disable. */
+  guint stats_interval;
+  /** Monotonic time in ns at which the stats are logged next. */
+  guint64 next_stats_log_ns;
 };
 
 /* GStreamer boilerplate. */
@@ -147,27 +225,6 @@ struct _GstDsOsdCoordRmqClass
   GstBaseTransformClass parent_class;
 };
 
-typedef struct
-{
-  double x;
-  double y;
-} COORD;
-
-COORD top_left;
-COORD top_right;
-COORD bottom_left;
-COORD bottom_right;
-
-typedef struct
-{
-  int frame_number;
-  char *label;
-  COORD top_left;
-  COORD top_right;
-  COORD bottom_left;
-  COORD bottom_right;
-} METADATA;
-
 GType gst_ds_osdcoordrmq_get_type (void);
 
 G_END_DECLS
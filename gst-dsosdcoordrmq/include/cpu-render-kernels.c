@@ -0,0 +1,475 @@
+// Copyright 2022, Kyota Tashiro, Mengheng Lee, and Latona Inc.
+// License MIT
+
+#include <pthread.h>
+#include <string.h>
+#include "cpu-render-kernels.h"
+
+#if defined(__x86_64__)
+#define HAVE_X86_KERNELS 1
+#include <immintrin.h>
+#endif
+
+#if defined(__aarch64__)
+#define HAVE_NEON_KERNELS 1
+#include <arm_neon.h>
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+
+// Rounded x / 255 for x up to 255 * 255.
+static inline uint32_t div255(uint32_t x) {
+  x += 128;
+  return (x + (x >> 8)) >> 8;
+}
+
+static inline void blend_pixel(uint8_t *p, const uint8_t color[4], uint32_t a) {
+  uint32_t keep = 255 - a;
+
+  p[0] = (uint8_t) div255(color[0] * a + p[0] * keep);
+  p[1] = (uint8_t) div255(color[1] * a + p[1] * keep);
+  p[2] = (uint8_t) div255(color[2] * a + p[2] * keep);
+  p[3] = (uint8_t) div255(255 * a + p[3] * keep);
+}
+
+static inline void fill_pixel(uint8_t *p, const uint8_t color[4]) {
+  p[0] = color[0];
+  p[1] = color[1];
+  p[2] = color[2];
+  p[3] = 255;
+}
+
+static void blend_span_scalar(uint8_t *pixels, unsigned int count, const uint8_t color[4]) {
+  uint32_t a = color[3];
+  unsigned int i;
+
+  if (a == 0)
+    return;
+  for (i = 0; i < count; i++, pixels += 4) {
+    if (a == 255)
+      fill_pixel(pixels, color);
+    else
+      blend_pixel(pixels, color, a);
+  }
+}
+
+static void blend_covered_scalar(uint8_t *pixels, const uint8_t *covered, unsigned int count,
+             const uint8_t color[4]) {
+  uint32_t a = color[3];
+  unsigned int i;
+
+  if (a == 0)
+    return;
+  for (i = 0; i < count; i++, pixels += 4) {
+    if (!covered[i])
+      continue;
+    if (a == 255)
+      fill_pixel(pixels, color);
+    else
+      blend_pixel(pixels, color, a);
+  }
+}
+
+// A weight of 255 leaves div255(color * 255) = color, the same bytes as
+// fill_pixel, so opaque pixels need no branch of their own.
+static void blend_coverage_scalar(uint8_t *pixels, const uint8_t *coverage, unsigned int count,
+             const uint8_t color[4]) {
+  unsigned int i;
+
+  if (color[3] == 0)
+    return;
+  for (i = 0; i < count; i++, pixels += 4) {
+    if (coverage[i])
+      blend_pixel(pixels, color, div255(color[3] * coverage[i]));
+  }
+}
+
+static const cpu_render_kernels scalar_kernels = {
+  "scalar", blend_span_scalar, blend_covered_scalar, blend_coverage_scalar,
+};
+
+#ifdef HAVE_X86_KERNELS
+// Two pixels widened to 16 bits per channel: premultiplied color plus
+// channel * keep, then the same rounded division as div255.
+__attribute__((target("sse2")))
+static inline __m128i blend_sse2(__m128i wide, __m128i src, __m128i keep) {
+  __m128i t = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(wide, keep), src),
+                            _mm_set1_epi16(128));
+
+  return _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+}
+
+// Four pixels at once.
+__attribute__((target("sse2")))
+static inline __m128i blend4_sse2(__m128i px, __m128i src, __m128i keep) {
+  __m128i zero = _mm_setzero_si128();
+  __m128i lo = blend_sse2(_mm_unpacklo_epi8(px, zero), src, keep);
+  __m128i hi = blend_sse2(_mm_unpackhi_epi8(px, zero), src, keep);
+
+  return _mm_packus_epi16(lo, hi);
+}
+
+__attribute__((target("sse2")))
+static void blend_span_sse2(uint8_t *pixels, unsigned int count, const uint8_t color[4]) {
+  uint32_t a = color[3];
+  __m128i src = _mm_setr_epi16(
+      (short) (color[0] * a), (short) (color[1] * a), (short) (color[2] * a),
+      (short) (255 * a), (short) (color[0] * a), (short) (color[1] * a),
+      (short) (color[2] * a), (short) (255 * a));
+  __m128i keep = _mm_set1_epi16((short) (255 - a));
+  unsigned int i = 0;
+
+  if (a == 0)
+    return;
+  if (a == 255) {
+    uint32_t opaque;
+    uint8_t bytes[4] = {color[0], color[1], color[2], 255};
+
+    memcpy(&opaque, bytes, sizeof(opaque));
+    for (; i + 4 <= count; i += 4)
+      _mm_storeu_si128((__m128i *) (pixels + i * 4), _mm_set1_epi32((int) opaque));
+    for (; i < count; i++)
+      fill_pixel(pixels + i * 4, color);
+    return;
+  }
+  for (; i + 4 <= count; i += 4) {
+    __m128i px = _mm_loadu_si128((const __m128i *) (pixels + i * 4));
+
+    _mm_storeu_si128((__m128i *) (pixels + i * 4), blend4_sse2(px, src, keep));
+  }
+  for (; i < count; i++)
+    blend_pixel(pixels + i * 4, color, a);
+}
+
+__attribute__((target("sse2")))
+static void blend_covered_sse2(uint8_t *pixels, const uint8_t *covered, unsigned int count,
+             const uint8_t color[4]) {
+  uint32_t a = color[3];
+  __m128i src = _mm_setr_epi16(
+      (short) (color[0] * a), (short) (color[1] * a), (short) (color[2] * a),
+      (short) (255 * a), (short) (color[0] * a), (short) (color[1] * a),
+      (short) (color[2] * a), (short) (255 * a));
+  __m128i keep = _mm_set1_epi16((short) (255 - a));
+  unsigned int i = 0;
+
+  if (a == 0)
+    return;
+  for (; i + 4 <= count; i += 4) {
+    uint32_t four;
+    __m128i mask;
+    __m128i px;
+
+    memcpy(&four, covered + i, sizeof(four));
+    if (!four)
+      continue;
+    // Every covered byte spread over the four bytes of its pixel.
+    mask = _mm_cvtsi32_si128((int) four);
+    mask = _mm_unpacklo_epi8(mask, mask);
+    mask = _mm_unpacklo_epi16(mask, mask);
+    mask = _mm_cmpeq_epi32(_mm_cmpeq_epi32(mask, _mm_setzero_si128()),
+                           _mm_setzero_si128());
+    px = _mm_loadu_si128((const __m128i *) (pixels + i * 4));
+    px = _mm_or_si128(_mm_and_si128(mask, blend4_sse2(px, src, keep)),
+                      _mm_andnot_si128(mask, px));
+    _mm_storeu_si128((__m128i *) (pixels + i * 4), px);
+  }
+  blend_covered_scalar(pixels + i * 4, covered + i, count - i, color);
+}
+
+__attribute__((target("sse2")))
+static inline __m128i div255_sse2(__m128i x) {
+  x = _mm_add_epi16(x, _mm_set1_epi16(128));
+  return _mm_srli_epi16(_mm_add_epi16(x, _mm_srli_epi16(x, 8)), 8);
+}
+
+// Two pixels whose weights are spread over their channels in a.
+__attribute__((target("sse2")))
+static inline __m128i blend_weighted_sse2(__m128i wide, __m128i color, __m128i a) {
+  __m128i keep = _mm_sub_epi16(_mm_set1_epi16(255), a);
+
+  return div255_sse2(_mm_add_epi16(_mm_mullo_epi16(color, a), _mm_mullo_epi16(wide, keep)));
+}
+
+__attribute__((target("sse2")))
+static void blend_coverage_sse2(uint8_t *pixels, const uint8_t *coverage, unsigned int count,
+             const uint8_t color[4]) {
+  __m128i zero = _mm_setzero_si128();
+  __m128i wide_color = _mm_setr_epi16(color[0], color[1], color[2], 255, color[0], color[1],
+                                      color[2], 255);
+  __m128i alpha = _mm_set1_epi16(color[3]);
+  unsigned int i = 0;
+
+  if (color[3] == 0)
+    return;
+  for (; i + 4 <= count; i += 4) {
+    uint32_t four;
+    __m128i spread;
+    __m128i px;
+    __m128i lo;
+    __m128i hi;
+
+    memcpy(&four, coverage + i, sizeof(four));
+    if (!four)
+      continue;
+    spread = _mm_cvtsi32_si128((int) four);
+    spread = _mm_unpacklo_epi8(spread, spread);
+    spread = _mm_unpacklo_epi16(spread, spread);
+    px = _mm_loadu_si128((const __m128i *) (pixels + i * 4));
+    lo = blend_weighted_sse2(_mm_unpacklo_epi8(px, zero), wide_color,
+                             div255_sse2(_mm_mullo_epi16(_mm_unpacklo_epi8(spread, zero), alpha)));
+    hi = blend_weighted_sse2(_mm_unpackhi_epi8(px, zero), wide_color,
+                             div255_sse2(_mm_mullo_epi16(_mm_unpackhi_epi8(spread, zero), alpha)));
+    _mm_storeu_si128((__m128i *) (pixels + i * 4), _mm_packus_epi16(lo, hi));
+  }
+  blend_coverage_scalar(pixels + i * 4, coverage + i, count - i, color);
+}
+
+static const cpu_render_kernels sse2_kernels = {
+  "sse2", blend_span_sse2, blend_covered_sse2, blend_coverage_sse2,
+};
+
+__attribute__((target("avx2")))
+static inline __m256i blend8_avx2(__m256i px, __m256i src, __m256i keep) {
+  __m256i zero = _mm256_setzero_si256();
+  __m256i bias = _mm256_set1_epi16(128);
+  // Unpacking and packing both work within 128-bit lanes, so the pixels come
+  // back in their order.
+  __m256i lo = _mm256_add_epi16(
+      _mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpacklo_epi8(px, zero), keep), src), bias);
+  __m256i hi = _mm256_add_epi16(
+      _mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpackhi_epi8(px, zero), keep), src), bias);
+
+  lo = _mm256_srli_epi16(_mm256_add_epi16(lo, _mm256_srli_epi16(lo, 8)), 8);
+  hi = _mm256_srli_epi16(_mm256_add_epi16(hi, _mm256_srli_epi16(hi, 8)), 8);
+  return _mm256_packus_epi16(lo, hi);
+}
+
+__attribute__((target("avx2")))
+static __m256i premultiplied_avx2(const uint8_t color[4], uint32_t a) {
+  uint64_t pixel = (uint64_t) (color[0] * a) | (uint64_t) (color[1] * a) << 16 |
+                   (uint64_t) (color[2] * a) << 32 | (uint64_t) (255 * a) << 48;
+
+  return _mm256_set1_epi64x((long long) pixel);
+}
+
+__attribute__((target("avx2")))
+static void blend_span_avx2(uint8_t *pixels, unsigned int count, const uint8_t color[4]) {
+  uint32_t a = color[3];
+  __m256i src = premultiplied_avx2(color, a);
+  __m256i keep = _mm256_set1_epi16((short) (255 - a));
+  unsigned int i = 0;
+
+  if (a == 0)
+    return;
+  if (a == 255) {
+    uint32_t opaque;
+    uint8_t bytes[4] = {color[0], color[1], color[2], 255};
+
+    memcpy(&opaque, bytes, sizeof(opaque));
+    for (; i + 8 <= count; i += 8)
+      _mm256_storeu_si256((__m256i *) (pixels + i * 4), _mm256_set1_epi32((int) opaque));
+    for (; i < count; i++)
+      fill_pixel(pixels + i * 4, color);
+    return;
+  }
+  for (; i + 8 <= count; i += 8) {
+    __m256i px = _mm256_loadu_si256((const __m256i *) (pixels + i * 4));
+
+    _mm256_storeu_si256((__m256i *) (pixels + i * 4), blend8_avx2(px, src, keep));
+  }
+  blend_span_sse2(pixels + i * 4, count - i, color);
+}
+
+__attribute__((target("avx2")))
+static void blend_covered_avx2(uint8_t *pixels, const uint8_t *covered, unsigned int count,
+             const uint8_t color[4]) {
+  uint32_t a = color[3];
+  __m256i src = premultiplied_avx2(color, a);
+  __m256i keep = _mm256_set1_epi16((short) (255 - a));
+  unsigned int i = 0;
+
+  if (a == 0)
+    return;
+  for (; i + 8 <= count; i += 8) {
+    uint64_t eight;
+    __m256i mask;
+    __m256i px;
+
+    memcpy(&eight, covered + i, sizeof(eight));
+    if (!eight)
+      continue;
+    mask = _mm256_cvtepu8_epi32(_mm_cvtsi64_si128((long long) eight));
+    mask = _mm256_cmpgt_epi32(mask, _mm256_setzero_si256());
+    px = _mm256_loadu_si256((const __m256i *) (pixels + i * 4));
+    px = _mm256_blendv_epi8(px, blend8_avx2(px, src, keep), mask);
+    _mm256_storeu_si256((__m256i *) (pixels + i * 4), px);
+  }
+  blend_covered_sse2(pixels + i * 4, covered + i, count - i, color);
+}
+
+// Text runs are short, so coverage stays on the SSE2 loop.
+static const cpu_render_kernels avx2_kernels = {
+  "avx2", blend_span_avx2, blend_covered_avx2, blend_coverage_sse2,
+};
+#endif
+
+#ifdef HAVE_NEON_KERNELS
+// Four pixels at once: premultiplied color plus channel * keep, then the
+// same rounded division as div255.
+static inline uint8x16_t blend4_neon(uint8x16_t px, uint16x8_t src, uint8x8_t keep) {
+  uint16x8_t bias = vdupq_n_u16(128);
+  uint16x8_t lo = vaddq_u16(vmlal_u8(src, vget_low_u8(px), keep), bias);
+  uint16x8_t hi = vaddq_u16(vmlal_u8(src, vget_high_u8(px), keep), bias);
+
+  lo = vaddq_u16(lo, vshrq_n_u16(lo, 8));
+  hi = vaddq_u16(hi, vshrq_n_u16(hi, 8));
+  return vcombine_u8(vshrn_n_u16(lo, 8), vshrn_n_u16(hi, 8));
+}
+
+static uint16x8_t premultiplied_neon(const uint8_t color[4], uint32_t a) {
+  const uint16_t pixels[8] = {
+    (uint16_t) (color[0] * a), (uint16_t) (color[1] * a), (uint16_t) (color[2] * a),
+    (uint16_t) (255 * a), (uint16_t) (color[0] * a), (uint16_t) (color[1] * a),
+    (uint16_t) (color[2] * a), (uint16_t) (255 * a),
+  };
+
+  return vld1q_u16(pixels);
+}
+
+static void blend_span_neon(uint8_t *pixels, unsigned int count, const uint8_t color[4]) {
+  uint32_t a = color[3];
+  uint16x8_t src = premultiplied_neon(color, a);
+  uint8x8_t keep = vdup_n_u8((uint8_t) (255 - a));
+  unsigned int i = 0;
+
+  if (a == 0)
+    return;
+  if (a == 255) {
+    const uint8_t bytes[4] = {color[0], color[1], color[2], 255};
+    uint32_t opaque;
+
+    memcpy(&opaque, bytes, sizeof(opaque));
+    for (; i + 4 <= count; i += 4)
+      vst1q_u8(pixels + i * 4, vreinterpretq_u8_u32(vdupq_n_u32(opaque)));
+    for (; i < count; i++)
+      fill_pixel(pixels + i * 4, color);
+    return;
+  }
+  for (; i + 4 <= count; i += 4)
+    vst1q_u8(pixels + i * 4, blend4_neon(vld1q_u8(pixels + i * 4), src, keep));
+  for (; i < count; i++)
+    blend_pixel(pixels + i * 4, color, a);
+}
+
+static void blend_covered_neon(uint8_t *pixels, const uint8_t *covered, unsigned int count,
+             const uint8_t color[4]) {
+  static const uint8_t spread[16] = {0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3};
+  uint32_t a = color[3];
+  uint16x8_t src = premultiplied_neon(color, a);
+  uint8x8_t keep = vdup_n_u8((uint8_t) (255 - a));
+  uint8x16_t index = vld1q_u8(spread);
+  unsigned int i = 0;
+
+  if (a == 0)
+    return;
+  for (; i + 4 <= count; i += 4) {
+    uint32_t four;
+    uint8x16_t mask;
+    uint8x16_t px;
+
+    memcpy(&four, covered + i, sizeof(four));
+    if (!four)
+      continue;
+    // Every covered byte spread over the four bytes of its pixel.
+    mask = vqtbl1q_u8(vreinterpretq_u8_u32(vdupq_n_u32(four)), index);
+    mask = vtstq_u8(mask, mask);
+    px = vld1q_u8(pixels + i * 4);
+    vst1q_u8(pixels + i * 4, vbslq_u8(mask, blend4_neon(px, src, keep), px));
+  }
+  blend_covered_scalar(pixels + i * 4, covered + i, count - i, color);
+}
+
+static inline uint8x8_t div255_neon(uint16x8_t x) {
+  x = vaddq_u16(x, vdupq_n_u16(128));
+  return vshrn_n_u16(vaddq_u16(x, vshrq_n_u16(x, 8)), 8);
+}
+
+// Two pixels whose weights are spread over their channels in a.
+static inline uint8x8_t blend_weighted_neon(uint8x8_t px, uint8x8_t color, uint8x8_t a) {
+  return div255_neon(vmlal_u8(vmull_u8(color, a), px, vmvn_u8(a)));
+}
+
+static void blend_coverage_neon(uint8_t *pixels, const uint8_t *coverage, unsigned int count,
+             const uint8_t color[4]) {
+  static const uint8_t spread_index[16] = {0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3};
+  const uint8_t color_bytes[8] = {color[0], color[1], color[2], 255,
+                                  color[0], color[1], color[2], 255};
+  uint8x8_t wide_color = vld1_u8(color_bytes);
+  uint8x8_t alpha = vdup_n_u8(color[3]);
+  uint8x16_t index = vld1q_u8(spread_index);
+  unsigned int i = 0;
+
+  if (color[3] == 0)
+    return;
+  for (; i + 4 <= count; i += 4) {
+    uint32_t four;
+    uint8x16_t spread;
+    uint8x16_t px;
+
+    memcpy(&four, coverage + i, sizeof(four));
+    if (!four)
+      continue;
+    spread = vqtbl1q_u8(vreinterpretq_u8_u32(vdupq_n_u32(four)), index);
+    px = vld1q_u8(pixels + i * 4);
+    vst1q_u8(pixels + i * 4, vcombine_u8(
+        blend_weighted_neon(vget_low_u8(px), wide_color,
+                            div255_neon(vmull_u8(vget_low_u8(spread), alpha))),
+        blend_weighted_neon(vget_high_u8(px), wide_color,
+                            div255_neon(vmull_u8(vget_high_u8(spread), alpha)))));
+  }
+  blend_coverage_scalar(pixels + i * 4, coverage + i, count - i, color);
+}
+
+static const cpu_render_kernels neon_kernels = {
+  "neon", blend_span_neon, blend_covered_neon, blend_coverage_neon,
+};
+#endif
+
+const cpu_render_kernels *cpu_render_kernels_scalar(void) {
+  return &scalar_kernels;
+}
+
+unsigned int cpu_render_kernels_available(const cpu_render_kernels **out, unsigned int max) {
+  unsigned int n = 0;
+
+  if (n < max)
+    out[n++] = &scalar_kernels;
+#ifdef HAVE_X86_KERNELS
+  __builtin_cpu_init();
+  if (n < max && __builtin_cpu_supports("sse2"))
+    out[n++] = &sse2_kernels;
+  if (n < max && __builtin_cpu_supports("avx2"))
+    out[n++] = &avx2_kernels;
+#endif
+#ifdef HAVE_NEON_KERNELS
+  if (n < max && (getauxval(AT_HWCAP) & HWCAP_ASIMD))
+    out[n++] = &neon_kernels;
+#endif
+  return n;
+}
+
+static const cpu_render_kernels *best;
+static pthread_once_t best_once = PTHREAD_ONCE_INIT;
+
+static void choose_best(void) {
+  const cpu_render_kernels *available[4];
+  unsigned int n = cpu_render_kernels_available(available, 4);
+
+  // Listed from the slowest to the fastest.
+  best = available[n - 1];
+}
+
+const cpu_render_kernels *cpu_render_kernels_best(void) {
+  pthread_once(&best_once, choose_best);
+  return best;
+}
@@ -0,0 +1,34 @@
+// Copyright 2022, Kyota Tashiro, Mengheng Lee, and Latona Inc.
+// License MIT
+#ifndef CPU_RENDER_KERNELS
+#define CPU_RENDER_KERNELS
+#include <stdint.h>
+
+// Pixel loops of the CPU renderer, in a scalar version and in SSE2, AVX2 or
+// NEON versions where the compiler and the CPU have them. Every version does
+// the same integer arithmetic, a channel becoming
+//   (color * a + channel * (255 - a)) / 255, rounded,
+// with 255 for the color of the alpha channel, so they give the same bytes.
+
+typedef struct cpu_render_kernels {
+  const char *name;
+  // Blends color over count RGBA pixels.
+  void (*blend_span)(uint8_t *pixels, unsigned int count, const uint8_t color[4]);
+  // Same, but only for the pixels whose covered byte is not 0.
+  void (*blend_covered)(uint8_t *pixels, const uint8_t *covered, unsigned int count,
+                        const uint8_t color[4]);
+  // Same, with a weight of color[3] * coverage / 255, rounded, for each pixel.
+  void (*blend_coverage)(uint8_t *pixels, const uint8_t *coverage, unsigned int count,
+                         const uint8_t color[4]);
+} cpu_render_kernels;
+
+// The reference every other version must match.
+const cpu_render_kernels *cpu_render_kernels_scalar(void);
+
+// The fastest version this CPU runs, chosen on first use.
+const cpu_render_kernels *cpu_render_kernels_best(void);
+
+// Every version this CPU runs, scalar first; returns how many were stored.
+unsigned int cpu_render_kernels_available(const cpu_render_kernels **out, unsigned int max);
+
+#endif
@@ -0,0 +1,470 @@
+// Copyright 2022, Kyota Tashiro, Mengheng Lee, and Latona Inc.
+// License MIT
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "cpu-render.h"
+
+#define INITIAL_CAPACITY 64
+// Mask pixels tested before they are handed to blend_covered.
+#define MASK_CHUNK 256
+
+static int reserve(cpu_render_list *l, void **array, unsigned int *capacity,
+             unsigned int count, size_t size) {
+  unsigned int grown_capacity = *capacity ? *capacity : INITIAL_CAPACITY;
+  void *grown;
+
+  if (count <= *capacity)
+    return 0;
+  while (grown_capacity < count)
+    grown_capacity *= 2;
+  grown = realloc(*array, (size_t) grown_capacity * size);
+  if (!grown)
+    return -1;
+  *array = grown;
+  *capacity = grown_capacity;
+  l->grows++;
+  return 0;
+}
+
+static inline int max_int(int a, int b) {
+  return a > b ? a : b;
+}
+
+static inline int min_int(int a, int b) {
+  return a < b ? a : b;
+}
+
+static inline void blend_span(const cpu_render_kernels *k, uint8_t *row, int x0, int x1,
+             const uint8_t color[4]) {
+  if (x1 > x0)
+    k->blend_span(row + (size_t) x0 * 4, (unsigned int) (x1 - x0), color);
+}
+
+// Rows y0 up to y1 of the rect, already known to lie inside the target.
+static void draw_rect_rows(const cpu_render_kernels *k, const cpu_render_target *t,
+             const cpu_render_rect *rc, int y0, int y1) {
+  int right = rc->left + rc->width;
+  int bottom = rc->top + rc->height;
+  int border = (int) rc->border_width;
+  // Left band, interior and right band, clipped to the rect and the target.
+  int band_end = min_int(rc->left + border, right);
+  int inner_end = max_int(right - border, band_end);
+  int x0 = max_int(rc->left, 0);
+  int x1 = min_int(right, (int) t->width);
+  int y;
+
+  y0 = max_int(y0, rc->top);
+  y1 = min_int(y1, bottom);
+  for (y = y0; y < y1; y++) {
+    uint8_t *row = t->pixels + (size_t) y * t->pitch;
+
+    if (y < rc->top + border || y >= bottom - border) {
+      blend_span(k, row, x0, x1, rc->border_color);
+      continue;
+    }
+    if (border > 0) {
+      blend_span(k, row, x0, min_int(band_end, x1), rc->border_color);
+      blend_span(k, row, max_int(inner_end, x0), x1, rc->border_color);
+    }
+    if (rc->has_bg_color)
+      blend_span(k, row, max_int(band_end, x0), min_int(inner_end, x1), rc->bg_color);
+  }
+}
+
+// Column x of the mask lands on score (x - left) * mask_width / width; the
+// quotient is stepped along the row instead of divided for every pixel.
+static void draw_mask_rows(const cpu_render_kernels *k, const cpu_render_target *t,
+             const cpu_render_mask *m, int y0, int y1) {
+  unsigned int width = (unsigned int) m->width;
+  unsigned int step = m->mask_width / width;
+  unsigned int step_rem = m->mask_width % width;
+  int x0 = max_int(m->left, 0);
+  int x1 = min_int(m->left + m->width, (int) t->width);
+  uint8_t covered[MASK_CHUNK];
+  int x, y;
+
+  y0 = max_int(y0, m->top);
+  y1 = min_int(y1, m->top + m->height);
+  for (y = y0; y < y1; y++) {
+    uint8_t *row = t->pixels + (size_t) y * t->pitch;
+    unsigned int my = (unsigned int) ((uint64_t) (y - m->top) * m->mask_height /
+                                      (unsigned int) m->height);
+    const float *scores = m->data + (size_t) my * m->mask_width;
+    uint64_t start = (uint64_t) (x0 - m->left) * m->mask_width;
+    unsigned int mx = (unsigned int) (start / width);
+    unsigned int rem = (unsigned int) (start % width);
+
+    for (x = x0; x < x1;) {
+      unsigned int count = (unsigned int) min_int(x1 - x, MASK_CHUNK);
+      unsigned int i;
+
+      for (i = 0; i < count; i++) {
+        covered[i] = scores[mx] > m->threshold;
+        mx += step;
+        rem += step_rem;
+        if (rem >= width) {
+          rem -= width;
+          mx++;
+        }
+      }
+      k->blend_covered(row + (size_t) x * 4, covered, count, m->color);
+      x += (int) count;
+    }
+  }
+}
+
+// Narrows the offsets r in [*lo, *hi) to those where low <= c * r + k < high.
+static void clip_offsets(double c, double k, double low, double high, double *lo, double *hi) {
+  double first, end;
+
+  if (c == 0.0) {
+    if (k < low || k >= high)
+      *hi = *lo;
+    return;
+  }
+  if (c > 0.0) {
+    first = ceil((low - k) / c);
+    end = ceil((high - k) / c);
+  } else {
+    first = floor((high - k) / c) + 1.0;
+    end = floor((low - k) / c) + 1.0;
+  }
+  *lo = fmax(*lo, first);
+  *hi = fmin(*hi, end);
+}
+
+// Rows a line may touch: a corner lies at most width / 2 * sqrt(2) past the
+// end points, the rows in between draw empty spans.
+static void line_rows(const cpu_render_line *ln, int *top, int *height) {
+  *top = min_int(ln->y1, ln->y2) - (int) ln->width;
+  *height = abs(ln->y2 - ln->y1) + 2 * (int) ln->width + 1;
+}
+
+// Rows y0 up to y1 of the line. In every row the rectangle of the line covers
+// one span, whose ends are solved for from its two pairs of edges, across
+//   -width / 2 <= u x r < width / 2
+// and along
+//   -width / 2 <= u . r < length + width / 2
+// with u the direction of the line and r the offset of the pixel from the
+// start. The line is drawn downwards, so its ends are drawn the same either
+// way round.
+static void draw_line_rows(const cpu_render_kernels *k, const cpu_render_target *t,
+             const cpu_render_line *ln, int y0, int y1) {
+  int down = ln->y2 > ln->y1 || (ln->y2 == ln->y1 && ln->x2 >= ln->x1);
+  int x_start = down ? ln->x1 : ln->x2;
+  int y_start = down ? ln->y1 : ln->y2;
+  double dx = down ? ln->x2 - ln->x1 : ln->x1 - ln->x2;
+  double dy = down ? ln->y2 - ln->y1 : ln->y1 - ln->y2;
+  double length = sqrt(dx * dx + dy * dy);
+  double ux = length > 0.0 ? dx / length : 1.0;
+  double uy = length > 0.0 ? dy / length : 0.0;
+  double half = ln->width / 2.0;
+  int top, height, y;
+
+  line_rows(ln, &top, &height);
+  y0 = max_int(y0, top);
+  y1 = min_int(y1, top + height);
+  for (y = y0; y < y1; y++) {
+    double ry = y - y_start;
+    double lo = -x_start;
+    double hi = (double) t->width - x_start;
+
+    clip_offsets(-uy, ux * ry, -half, half, &lo, &hi);
+    clip_offsets(ux, uy * ry, -half, length + half, &lo, &hi);
+    if (hi > lo)
+      blend_span(k, t->pixels + (size_t) y * t->pitch, (int) lo + x_start, (int) hi + x_start,
+                 ln->color);
+  }
+}
+
+static int rect_visible(const cpu_render_target *t, const cpu_render_rect *rc) {
+  return rc->width > 0 && rc->height > 0 && rc->left < (int) t->width &&
+         rc->top < (int) t->height && rc->left + rc->width > 0 &&
+         rc->top + rc->height > 0;
+}
+
+static int mask_visible(const cpu_render_target *t, const cpu_render_mask *m) {
+  return m->data && m->mask_width > 0 && m->mask_height > 0 && m->width > 0 &&
+         m->height > 0 && m->left < (int) t->width && m->top < (int) t->height &&
+         m->left + m->width > 0 && m->top + m->height > 0;
+}
+
+static int line_visible(const cpu_render_target *t, const cpu_render_line *ln) {
+  int top, height;
+
+  line_rows(ln, &top, &height);
+  return ln->width > 0 && top < (int) t->height && top + height > 0 &&
+         min_int(ln->x1, ln->x2) - (int) ln->width < (int) t->width &&
+         max_int(ln->x1, ln->x2) + (int) ln->width >= 0;
+}
+
+// Bands touched by rows top up to top + height, which overlap the target.
+static void span_tiles(const cpu_render_target *t, int top, int height,
+             unsigned int *first, unsigned int *last) {
+  *first = (unsigned int) max_int(top, 0) / CPU_RENDER_TILE_ROWS;
+  *last = (unsigned int) (min_int(top + height, (int) t->height) - 1) /
+          CPU_RENDER_TILE_ROWS;
+}
+
+// Bands touched by item of the bins, 0 when it is not visible at all.
+static int item_tiles(const cpu_render_target *t, const cpu_render_list *l, unsigned int item,
+             unsigned int *first, unsigned int *last) {
+  const cpu_render_mask *m;
+  const cpu_render_line *ln;
+  int top, height;
+
+  if (item < l->num_rects) {
+    if (!rect_visible(t, &l->rects[item]))
+      return 0;
+    span_tiles(t, l->rects[item].top, l->rects[item].height, first, last);
+    return 1;
+  }
+  item -= l->num_rects;
+  if (item < l->num_masks) {
+    m = &l->masks[item];
+    if (!mask_visible(t, m))
+      return 0;
+    span_tiles(t, m->top, m->height, first, last);
+    return 1;
+  }
+  ln = &l->lines[item - l->num_masks];
+  if (!line_visible(t, ln))
+    return 0;
+  line_rows(ln, &top, &height);
+  span_tiles(t, top, height, first, last);
+  return 1;
+}
+
+// Fills the bins, keeping list order within every band. Returns -1 when the
+// bins cannot grow.
+static int bin(const cpu_render_target *t, cpu_render_list *l, unsigned int num_tiles) {
+  unsigned int num_items = l->num_rects + l->num_masks + l->num_lines;
+  unsigned int *offsets;
+  unsigned int first, last, tile, i;
+
+  if (reserve(l, (void **) &l->bin_offsets, &l->bin_offsets_capacity,
+              num_tiles + 1, sizeof(*l->bin_offsets)) < 0)
+    return -1;
+  offsets = l->bin_offsets;
+  memset(offsets, 0, (num_tiles + 1) * sizeof(*offsets));
+
+  // Count into offsets[tile + 1], then turn the counts into starts.
+  for (i = 0; i < num_items; i++) {
+    if (!item_tiles(t, l, i, &first, &last))
+      continue;
+    for (tile = first; tile <= last; tile++)
+      offsets[tile + 1]++;
+  }
+  for (tile = 0; tile < num_tiles; tile++)
+    offsets[tile + 1] += offsets[tile];
+  if (reserve(l, (void **) &l->bin_items, &l->bin_items_capacity,
+              offsets[num_tiles], sizeof(*l->bin_items)) < 0)
+    return -1;
+
+  // offsets[tile] serves as the fill cursor of the band, which leaves every
+  // offset one band ahead until they are shifted back below.
+  for (i = 0; i < num_items; i++) {
+    if (!item_tiles(t, l, i, &first, &last))
+      continue;
+    for (tile = first; tile <= last; tile++)
+      l->bin_items[offsets[tile]++] = i;
+  }
+  for (tile = num_tiles; tile > 0; tile--)
+    offsets[tile] = offsets[tile - 1];
+  offsets[0] = 0;
+  return 0;
+}
+
+static void draw_tile(const cpu_render_kernels *k, const cpu_render_target *t,
+             const cpu_render_list *l, unsigned int tile) {
+  int y0 = (int) (tile * CPU_RENDER_TILE_ROWS);
+  int y1 = min_int(y0 + CPU_RENDER_TILE_ROWS, (int) t->height);
+  unsigned int i;
+
+  for (i = l->bin_offsets[tile]; i < l->bin_offsets[tile + 1]; i++) {
+    unsigned int item = l->bin_items[i];
+
+    if (item < l->num_rects)
+      draw_rect_rows(k, t, &l->rects[item], y0, y1);
+    else if (item < l->num_rects + l->num_masks)
+      draw_mask_rows(k, t, &l->masks[item - l->num_rects], y0, y1);
+    else
+      draw_line_rows(k, t, &l->lines[item - l->num_rects - l->num_masks], y0, y1);
+  }
+}
+
+static void draw_tiles(cpu_renderer *r) {
+  unsigned int tile;
+
+  while ((tile = atomic_fetch_add(&r->next_tile, 1)) < r->num_tiles)
+    draw_tile(r->kernels, r->target, r->list, tile);
+}
+
+// Every primitive whole, in list order.
+static void draw_whole(const cpu_render_kernels *k, const cpu_render_target *t,
+             const cpu_render_list *list) {
+  unsigned int i;
+
+  for (i = 0; i < list->num_rects; i++) {
+    if (rect_visible(t, &list->rects[i]))
+      draw_rect_rows(k, t, &list->rects[i], 0, (int) t->height);
+  }
+  for (i = 0; i < list->num_masks; i++) {
+    if (mask_visible(t, &list->masks[i]))
+      draw_mask_rows(k, t, &list->masks[i], 0, (int) t->height);
+  }
+  for (i = 0; i < list->num_lines; i++) {
+    if (line_visible(t, &list->lines[i]))
+      draw_line_rows(k, t, &list->lines[i], 0, (int) t->height);
+  }
+}
+
+static void *helper(void *arg) {
+  cpu_renderer *r = arg;
+  unsigned long seen = 0;
+
+  pthread_mutex_lock(&r->lock);
+  for (;;) {
+    while (!r->stopping && r->generation == seen)
+      pthread_cond_wait(&r->work, &r->lock);
+    if (r->stopping)
+      break;
+    seen = r->generation;
+    pthread_mutex_unlock(&r->lock);
+    draw_tiles(r);
+    pthread_mutex_lock(&r->lock);
+    if (--r->busy == 0)
+      pthread_cond_signal(&r->done);
+  }
+  pthread_mutex_unlock(&r->lock);
+  return NULL;
+}
+
+void cpu_render_list_init(cpu_render_list *l) {
+  memset(l, 0, sizeof(*l));
+}
+
+void cpu_render_list_free(cpu_render_list *l) {
+  free(l->rects);
+  free(l->masks);
+  free(l->lines);
+  free(l->bin_offsets);
+  free(l->bin_items);
+  cpu_render_list_init(l);
+}
+
+void cpu_render_list_reset(cpu_render_list *l) {
+  l->num_rects = 0;
+  l->num_masks = 0;
+  l->num_lines = 0;
+}
+
+cpu_render_rect *cpu_render_list_add_rect(cpu_render_list *l) {
+  if (reserve(l, (void **) &l->rects, &l->rects_capacity, l->num_rects + 1,
+              sizeof(*l->rects)) < 0) {
+    l->dropped++;
+    return NULL;
+  }
+  return &l->rects[l->num_rects++];
+}
+
+cpu_render_mask *cpu_render_list_add_mask(cpu_render_list *l) {
+  if (reserve(l, (void **) &l->masks, &l->masks_capacity, l->num_masks + 1,
+              sizeof(*l->masks)) < 0) {
+    l->dropped++;
+    return NULL;
+  }
+  return &l->masks[l->num_masks++];
+}
+
+cpu_render_line *cpu_render_list_add_line(cpu_render_list *l) {
+  if (reserve(l, (void **) &l->lines, &l->lines_capacity, l->num_lines + 1,
+              sizeof(*l->lines)) < 0) {
+    l->dropped++;
+    return NULL;
+  }
+  return &l->lines[l->num_lines++];
+}
+
+unsigned int cpu_renderer_init(cpu_renderer *r, unsigned int threads) {
+  unsigned int i;
+
+  memset(r, 0, sizeof(*r));
+  pthread_mutex_init(&r->draw_lock, NULL);
+  pthread_mutex_init(&r->lock, NULL);
+  pthread_cond_init(&r->work, NULL);
+  pthread_cond_init(&r->done, NULL);
+  atomic_init(&r->next_tile, 0);
+  r->kernels = cpu_render_kernels_best();
+  if (threads > CPU_RENDER_MAX_THREADS)
+    threads = CPU_RENDER_MAX_THREADS;
+  for (i = 1; i < threads; i++) {
+    if (pthread_create(&r->threads[r->num_threads], NULL, helper, r) != 0)
+      break;
+    r->num_threads++;
+  }
+  return r->num_threads + 1;
+}
+
+void cpu_renderer_free(cpu_renderer *r) {
+  unsigned int i;
+
+  pthread_mutex_lock(&r->lock);
+  r->stopping = 1;
+  pthread_cond_broadcast(&r->work);
+  pthread_mutex_unlock(&r->lock);
+  for (i = 0; i < r->num_threads; i++)
+    pthread_join(r->threads[i], NULL);
+  r->num_threads = 0;
+  pthread_cond_destroy(&r->done);
+  pthread_cond_destroy(&r->work);
+  pthread_mutex_destroy(&r->lock);
+  pthread_mutex_destroy(&r->draw_lock);
+}
+
+void cpu_renderer_draw(cpu_renderer *r, const cpu_render_target *t, cpu_render_list *list) {
+  unsigned int num_tiles = (t->height + CPU_RENDER_TILE_ROWS - 1) / CPU_RENDER_TILE_ROWS;
+  unsigned int tile;
+
+  if (num_tiles == 0 ||
+      (list->num_rects == 0 && list->num_masks == 0 && list->num_lines == 0))
+    return;
+  if (bin(t, list, num_tiles) < 0) {
+    // Without bins every primitive is drawn whole, which gives the same
+    // pixels on a single thread.
+    draw_whole(r->kernels, t, list);
+    return;
+  }
+
+  pthread_mutex_lock(&r->draw_lock);
+  if (r->num_threads == 0 || num_tiles == 1) {
+    for (tile = 0; tile < num_tiles; tile++)
+      draw_tile(r->kernels, t, list, tile);
+    pthread_mutex_unlock(&r->draw_lock);
+    return;
+  }
+
+  pthread_mutex_lock(&r->lock);
+  r->target = t;
+  r->list = list;
+  r->num_tiles = num_tiles;
+  atomic_store(&r->next_tile, 0);
+  r->busy = r->num_threads;
+  r->generation++;
+  pthread_cond_broadcast(&r->work);
+  pthread_mutex_unlock(&r->lock);
+
+  draw_tiles(r);
+
+  pthread_mutex_lock(&r->lock);
+  while (r->busy)
+    pthread_cond_wait(&r->done, &r->lock);
+  pthread_mutex_unlock(&r->lock);
+  pthread_mutex_unlock(&r->draw_lock);
+}
+
+void cpu_render_draw_serial(const cpu_render_target *t, const cpu_render_list *list) {
+  draw_whole(cpu_render_kernels_scalar(), t, list);
+}
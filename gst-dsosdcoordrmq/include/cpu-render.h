@@ -0,0 +1,145 @@
+// Copyright 2022, Kyota Tashiro, Mengheng Lee, and Latona Inc.
+// License MIT
+#ifndef CPU_RENDER
+#define CPU_RENDER
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include "cpu-render-kernels.h"
+
+// Software renderer for the primitives that dominate dense scenes, boxes,
+// instance masks and lines, on a mapped RGBA frame. The frame is cut into bands of
+// CPU_RENDER_TILE_ROWS rows, every primitive is binned into the bands it
+// touches and the bands are drawn in parallel. A pixel is only ever written by
+// the thread drawing its band, with the primitives covering it in list order,
+// so the output does not depend on the number of threads.
+
+#define CPU_RENDER_TILE_ROWS 32
+#define CPU_RENDER_MAX_THREADS 64
+
+typedef struct cpu_render_target {
+  // 4 bytes per pixel, R, G, B then A.
+  uint8_t *pixels;
+  unsigned int width;
+  unsigned int height;
+  // Bytes from one row to the next.
+  unsigned int pitch;
+} cpu_render_target;
+
+// Colors are R, G, B, A bytes; A is the weight the color is blended with,
+// and the destination alpha moves towards opaque by the same weight.
+typedef struct cpu_render_rect {
+  int left;
+  int top;
+  int width;
+  int height;
+  // Drawn inside the rect, the background fills what is left.
+  unsigned int border_width;
+  uint8_t border_color[4];
+  int has_bg_color;
+  uint8_t bg_color[4];
+} cpu_render_rect;
+
+// mask_width x mask_height scores stretched over the rect; the pixels whose
+// score is above threshold are blended with color.
+typedef struct cpu_render_mask {
+  int left;
+  int top;
+  int width;
+  int height;
+  const float *data;
+  unsigned int mask_width;
+  unsigned int mask_height;
+  float threshold;
+  uint8_t color[4];
+} cpu_render_mask;
+
+// The segment from x1, y1 to x2, y2, end points included, width pixels
+// thick and squared off half of width past either end. A pixel is drawn when
+// its center lies in that rectangle, the end points being pixel centers.
+typedef struct cpu_render_line {
+  int x1;
+  int y1;
+  int x2;
+  int y2;
+  unsigned int width;
+  uint8_t color[4];
+} cpu_render_line;
+
+// Primitives of one frame, drawn rects first, then masks, then lines. Arrays
+// only grow.
+typedef struct cpu_render_list {
+  cpu_render_rect *rects;
+  unsigned int num_rects;
+  unsigned int rects_capacity;
+  cpu_render_mask *masks;
+  unsigned int num_masks;
+  unsigned int masks_capacity;
+  cpu_render_line *lines;
+  unsigned int num_lines;
+  unsigned int lines_capacity;
+  // Primitives of band t are bin_items[bin_offsets[t]] up to
+  // bin_items[bin_offsets[t + 1]], rect i as i, mask i as num_rects + i and
+  // line i as num_rects + num_masks + i.
+  unsigned int *bin_offsets;
+  unsigned int bin_offsets_capacity;
+  unsigned int *bin_items;
+  unsigned int bin_items_capacity;
+  // Primitives that could not be added because an array could not grow.
+  unsigned long dropped;
+  // Number of times an array was grown.
+  unsigned long grows;
+} cpu_render_list;
+
+// Helper threads waiting for frames. The thread calling cpu_renderer_draw
+// draws bands too, so threads - 1 helpers are started.
+typedef struct cpu_renderer {
+  pthread_t threads[CPU_RENDER_MAX_THREADS];
+  unsigned int num_threads;
+  // Pixel loops, the fastest version the CPU runs.
+  const cpu_render_kernels *kernels;
+  // Held for a whole frame, callers on several threads take turns.
+  pthread_mutex_t draw_lock;
+  pthread_mutex_t lock;
+  pthread_cond_t work;
+  pthread_cond_t done;
+  // Frame being drawn; bands are claimed through next_tile.
+  const cpu_render_target *target;
+  const cpu_render_list *list;
+  unsigned int num_tiles;
+  atomic_uint next_tile;
+  // Helpers that have not finished the current frame yet.
+  unsigned int busy;
+  unsigned long generation;
+  int stopping;
+} cpu_renderer;
+
+void cpu_render_list_init(cpu_render_list *l);
+
+void cpu_render_list_free(cpu_render_list *l);
+
+// Empties the list, keeping the arrays.
+void cpu_render_list_reset(cpu_render_list *l);
+
+// The slot for the next primitive, or NULL, counted in dropped, when the
+// array cannot grow.
+cpu_render_rect *cpu_render_list_add_rect(cpu_render_list *l);
+
+cpu_render_mask *cpu_render_list_add_mask(cpu_render_list *l);
+
+cpu_render_line *cpu_render_list_add_line(cpu_render_list *l);
+
+// Starts threads - 1 helpers and returns the number of threads drawing,
+// which is lower than asked when a helper could not be started.
+unsigned int cpu_renderer_init(cpu_renderer *r, unsigned int threads);
+
+void cpu_renderer_free(cpu_renderer *r);
+
+// Draws list onto t and returns once every band is done.
+void cpu_renderer_draw(cpu_renderer *r, const cpu_render_target *t, cpu_render_list *list);
+
+// Draws list onto t primitive after primitive on the calling thread with the
+// scalar kernels, the reference the threaded and vectorized paths must match.
+void cpu_render_draw_serial(const cpu_render_target *t, const cpu_render_list *list);
+
+#endif
@@ -0,0 +1,408 @@
+// Copyright 2022, Kyota Tashiro, Mengheng Lee, and Latona Inc.
+// License MIT
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "dsmeta-binary.h"
+
+static const uint8_t magic[4] = { 'D', 'S', 'M', 'B' };
+
+static int reserve(dsmeta_bin_writer *w, size_t extra) {
+  size_t cap;
+  uint8_t *grown;
+
+  if (w->len + extra <= w->cap)
+    return 0;
+  cap = w->cap ? w->cap : 256;
+  while (cap < w->len + extra)
+    cap *= 2;
+  grown = realloc(w->buf, cap);
+  if (!grown) {
+    w->error = 1;
+    return -1;
+  }
+  w->buf = grown;
+  w->cap = cap;
+  w->grows++;
+  return 0;
+}
+
+static void put_u16(uint8_t *p, uint16_t v) {
+  p[0] = (uint8_t) v;
+  p[1] = (uint8_t) (v >> 8);
+}
+
+static void put_u32(uint8_t *p, uint32_t v) {
+  p[0] = (uint8_t) v;
+  p[1] = (uint8_t) (v >> 8);
+  p[2] = (uint8_t) (v >> 16);
+  p[3] = (uint8_t) (v >> 24);
+}
+
+static void put_u64(uint8_t *p, uint64_t v) {
+  put_u32(p, (uint32_t) v);
+  put_u32(p + 4, (uint32_t) (v >> 32));
+}
+
+static uint16_t get_u16(const uint8_t *p) {
+  return (uint16_t) (p[0] | (p[1] << 8));
+}
+
+static uint32_t get_u32(const uint8_t *p) {
+  return (uint32_t) p[0] | ((uint32_t) p[1] << 8) |
+         ((uint32_t) p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+static uint64_t get_u64(const uint8_t *p) {
+  return (uint64_t) get_u32(p) | ((uint64_t) get_u32(p + 4) << 32);
+}
+
+static int16_t clamp_i16(double v) {
+  if (isnan(v))
+    return 0;
+  if (v < INT16_MIN)
+    return INT16_MIN;
+  if (v > INT16_MAX)
+    return INT16_MAX;
+  return (int16_t) v;
+}
+
+static uint16_t clamp_u16(double v) {
+  if (isnan(v) || v < 0)
+    return 0;
+  if (v > UINT16_MAX)
+    return UINT16_MAX;
+  return (uint16_t) v;
+}
+
+static uint16_t intern_label(dsmeta_bin_writer *w, const char *label) {
+  unsigned int i;
+
+  if (!label)
+    return DSMETA_BIN_NO_LABEL;
+  for (i = 0; i < w->num_labels; i++) {
+    if (strcmp(w->labels[i], label) == 0)
+      return (uint16_t) i;
+  }
+  if (w->num_labels == DSMETA_BIN_MAX_LABELS)
+    return DSMETA_BIN_NO_LABEL;
+  w->labels[w->num_labels] = label;
+  return (uint16_t) w->num_labels++;
+}
+
+void dsmeta_bin_writer_init(dsmeta_bin_writer *w) {
+  memset(w, 0, sizeof(*w));
+}
+
+void dsmeta_bin_writer_free(dsmeta_bin_writer *w) {
+  free(w->buf);
+  dsmeta_bin_writer_init(w);
+}
+
+void dsmeta_bin_writer_reset(dsmeta_bin_writer *w) {
+  w->len = 0;
+  w->frame_start = 0;
+  w->num_objects = 0;
+  w->num_labels = 0;
+  w->batch_start = 0;
+  w->num_frames = 0;
+  w->error = 0;
+}
+
+void dsmeta_bin_begin_frame(dsmeta_bin_writer *w, uint32_t source_id,
+             uint32_t frame_number, uint16_t batch_id, uint64_t pts) {
+  uint8_t *p;
+
+  w->frame_start = w->len;
+  w->num_objects = 0;
+  w->num_labels = 0;
+  w->flags = 0;
+  w->num_object_ids = 0;
+  if (reserve(w, DSMETA_BIN_HEADER_SIZE) < 0)
+    return;
+  p = w->buf + w->len;
+  memcpy(p, magic, 4);
+  p[4] = DSMETA_BIN_VERSION;
+  p[5] = DSMETA_BIN_FRAME;
+  put_u16(p + 6, 0);
+  put_u32(p + 8, frame_number);
+  put_u32(p + 12, source_id);
+  put_u64(p + 16, pts);
+  put_u16(p + 24, batch_id);
+  put_u16(p + 26, 0);
+  w->len += DSMETA_BIN_HEADER_SIZE;
+}
+
+void dsmeta_bin_add_object(dsmeta_bin_writer *w, int class_id, const char *label,
+             double left, double top, double width, double height) {
+  uint8_t *p;
+
+  if (w->num_objects == DSMETA_BIN_MAX_OBJECTS) {
+    w->error = 1;
+    return;
+  }
+  if (reserve(w, DSMETA_BIN_OBJECT_SIZE) < 0)
+    return;
+  p = w->buf + w->len;
+  put_u16(p, (uint16_t) clamp_i16(class_id));
+  put_u16(p + 2, intern_label(w, label));
+  put_u16(p + 4, (uint16_t) clamp_i16(left));
+  put_u16(p + 6, (uint16_t) clamp_i16(top));
+  put_u16(p + 8, clamp_u16(width));
+  put_u16(p + 10, clamp_u16(height));
+  w->len += DSMETA_BIN_OBJECT_SIZE;
+  w->num_objects++;
+}
+
+void dsmeta_bin_set_flags(dsmeta_bin_writer *w, uint16_t flags) {
+  w->flags = flags;
+  if (w->len >= w->frame_start + DSMETA_BIN_HEADER_SIZE)
+    put_u16(w->buf + w->frame_start + 26, flags);
+}
+
+void dsmeta_bin_add_object_id(dsmeta_bin_writer *w, uint64_t object_id) {
+  if (reserve(w, 8) < 0)
+    return;
+  put_u64(w->buf + w->len, object_id);
+  w->len += 8;
+  w->num_object_ids++;
+}
+
+void dsmeta_bin_add_removed(dsmeta_bin_writer *w, const uint64_t *object_ids,
+             size_t count) {
+  size_t i;
+
+  if (count > DSMETA_BIN_MAX_REMOVED) {
+    w->error = 1;
+    return;
+  }
+  if (reserve(w, 2 + count * 8) < 0)
+    return;
+  put_u16(w->buf + w->len, (uint16_t) count);
+  w->len += 2;
+  for (i = 0; i < count; i++) {
+    put_u64(w->buf + w->len, object_ids[i]);
+    w->len += 8;
+  }
+}
+
+void dsmeta_bin_end_frame(dsmeta_bin_writer *w) {
+  unsigned int i;
+
+  if ((w->flags & (DSMETA_BIN_FLAG_KEYFRAME | DSMETA_BIN_FLAG_DELTA)) &&
+      w->num_object_ids != w->num_objects)
+    w->error = 1;
+  if (reserve(w, 1) < 0)
+    return;
+  w->buf[w->len++] = (uint8_t) w->num_labels;
+  for (i = 0; i < w->num_labels; i++) {
+    size_t len = strlen(w->labels[i]);
+
+    if (len > 255)
+      len = 255;
+    if (reserve(w, len + 1) < 0)
+      return;
+    w->buf[w->len++] = (uint8_t) len;
+    memcpy(w->buf + w->len, w->labels[i], len);
+    w->len += len;
+  }
+  if (w->len >= w->frame_start + DSMETA_BIN_HEADER_SIZE)
+    put_u16(w->buf + w->frame_start + 6, (uint16_t) w->num_objects);
+}
+
+void dsmeta_bin_begin_batch(dsmeta_bin_writer *w) {
+  uint8_t *p;
+
+  w->batch_start = w->len;
+  w->num_frames = 0;
+  if (reserve(w, DSMETA_BIN_BATCH_HEADER_SIZE) < 0)
+    return;
+  p = w->buf + w->len;
+  memcpy(p, magic, 4);
+  p[4] = DSMETA_BIN_VERSION;
+  p[5] = DSMETA_BIN_BATCH;
+  put_u16(p + 6, 0);
+  w->len += DSMETA_BIN_BATCH_HEADER_SIZE;
+}
+
+void dsmeta_bin_add_batch_frame(dsmeta_bin_writer *w, const void *frame, size_t len) {
+  if (w->num_frames == DSMETA_BIN_MAX_BATCH_FRAMES) {
+    w->error = 1;
+    return;
+  }
+  if (reserve(w, len + 4) < 0)
+    return;
+  put_u32(w->buf + w->len, (uint32_t) len);
+  memcpy(w->buf + w->len + 4, frame, len);
+  w->len += len + 4;
+  w->num_frames++;
+}
+
+void dsmeta_bin_end_batch(dsmeta_bin_writer *w) {
+  if (w->len >= w->batch_start + DSMETA_BIN_BATCH_HEADER_SIZE)
+    put_u16(w->buf + w->batch_start + 6, (uint16_t) w->num_frames);
+}
+
+void dsmeta_bin_begin_labels(dsmeta_bin_writer *w) {
+  uint8_t *p;
+
+  w->frame_start = w->len;
+  w->num_labels = 0;
+  if (reserve(w, DSMETA_BIN_LABELS_HEADER_SIZE) < 0)
+    return;
+  p = w->buf + w->len;
+  memcpy(p, magic, 4);
+  p[4] = DSMETA_BIN_VERSION;
+  p[5] = DSMETA_BIN_LABELS;
+  put_u16(p + 6, 0);
+  w->len += DSMETA_BIN_LABELS_HEADER_SIZE;
+}
+
+void dsmeta_bin_add_label(dsmeta_bin_writer *w, int class_id, const char *label,
+             size_t len) {
+  if (w->num_labels == UINT16_MAX) {
+    w->error = 1;
+    return;
+  }
+  if (len > 255)
+    len = 255;
+  if (reserve(w, len + 3) < 0)
+    return;
+  put_u16(w->buf + w->len, (uint16_t) clamp_i16(class_id));
+  w->buf[w->len + 2] = (uint8_t) len;
+  memcpy(w->buf + w->len + 3, label, len);
+  w->len += len + 3;
+  w->num_labels++;
+}
+
+void dsmeta_bin_end_labels(dsmeta_bin_writer *w) {
+  if (w->len >= w->frame_start + DSMETA_BIN_LABELS_HEADER_SIZE)
+    put_u16(w->buf + w->frame_start + 6, (uint16_t) w->num_labels);
+}
+
+int dsmeta_bin_decode_frame(const void *data, size_t len, dsmeta_bin_frame *frame) {
+  const uint8_t *p = data;
+  size_t off;
+  unsigned int i;
+
+  if (len < DSMETA_BIN_HEADER_SIZE + 1 || memcmp(p, magic, 4) != 0 ||
+      p[4] != DSMETA_BIN_VERSION || p[5] != DSMETA_BIN_FRAME)
+    return -1;
+
+  frame->num_objects = get_u16(p + 6);
+  frame->frame_number = get_u32(p + 8);
+  frame->source_id = get_u32(p + 12);
+  frame->pts = get_u64(p + 16);
+  frame->batch_id = get_u16(p + 24);
+  frame->flags = get_u16(p + 26);
+  frame->objects = p + DSMETA_BIN_HEADER_SIZE;
+  frame->object_ids = NULL;
+  frame->num_removed = 0;
+  frame->removed = NULL;
+  off = DSMETA_BIN_HEADER_SIZE + (size_t) frame->num_objects * DSMETA_BIN_OBJECT_SIZE;
+  if (frame->flags & (DSMETA_BIN_FLAG_KEYFRAME | DSMETA_BIN_FLAG_DELTA)) {
+    frame->object_ids = p + off;
+    off += (size_t) frame->num_objects * 8;
+  }
+  if (frame->flags & DSMETA_BIN_FLAG_DELTA) {
+    if (off + 2 > len)
+      return -1;
+    frame->num_removed = get_u16(p + off);
+    frame->removed = p + off + 2;
+    off += 2 + (size_t) frame->num_removed * 8;
+  }
+  if (off + 1 > len)
+    return -1;
+
+  frame->num_labels = p[off++];
+  for (i = 0; i < frame->num_labels; i++) {
+    if (off + 1 > len || off + 1 + p[off] > len)
+      return -1;
+    frame->label_lens[i] = p[off];
+    frame->labels[i] = (const char *) p + off + 1;
+    off += 1 + p[off];
+  }
+  frame->size = off;
+  return 0;
+}
+
+void dsmeta_bin_get_object(const dsmeta_bin_frame *frame, unsigned int index,
+             dsmeta_bin_object *object) {
+  const uint8_t *p = frame->objects + (size_t) index * DSMETA_BIN_OBJECT_SIZE;
+
+  object->class_id = (int16_t) get_u16(p);
+  object->label_id = get_u16(p + 2);
+  object->left = (int16_t) get_u16(p + 4);
+  object->top = (int16_t) get_u16(p + 6);
+  object->width = get_u16(p + 8);
+  object->height = get_u16(p + 10);
+}
+
+uint64_t dsmeta_bin_get_object_id(const dsmeta_bin_frame *frame, unsigned int index) {
+  if (!frame->object_ids)
+    return DSMETA_BIN_NO_OBJECT_ID;
+  return get_u64(frame->object_ids + (size_t) index * 8);
+}
+
+uint64_t dsmeta_bin_get_removed(const dsmeta_bin_frame *frame, unsigned int index) {
+  return get_u64(frame->removed + (size_t) index * 8);
+}
+
+int dsmeta_bin_decode_batch(const void *data, size_t len, dsmeta_bin_batch *batch) {
+  const uint8_t *p = data;
+
+  if (len < DSMETA_BIN_BATCH_HEADER_SIZE || memcmp(p, magic, 4) != 0 ||
+      p[4] != DSMETA_BIN_VERSION || p[5] != DSMETA_BIN_BATCH)
+    return -1;
+  batch->num_frames = get_u16(p + 6);
+  batch->remaining = batch->num_frames;
+  batch->next = p + DSMETA_BIN_BATCH_HEADER_SIZE;
+  batch->end = p + len;
+  return 0;
+}
+
+int dsmeta_bin_batch_next(dsmeta_bin_batch *batch, dsmeta_bin_frame *frame) {
+  uint32_t len;
+
+  // A batch cut between two frames is as broken as one cut inside a frame.
+  if (batch->next == batch->end)
+    return batch->remaining ? -1 : 0;
+  if (!batch->remaining || batch->end - batch->next < 4)
+    return -1;
+  len = get_u32(batch->next);
+  if ((size_t) (batch->end - batch->next - 4) < len ||
+      dsmeta_bin_decode_frame(batch->next + 4, len, frame) < 0)
+    return -1;
+  batch->next += 4 + len;
+  batch->remaining--;
+  return 1;
+}
+
+int dsmeta_bin_decode_labels(const void *data, size_t len, dsmeta_bin_labels *labels) {
+  const uint8_t *p = data;
+
+  if (len < DSMETA_BIN_LABELS_HEADER_SIZE || memcmp(p, magic, 4) != 0 ||
+      p[4] != DSMETA_BIN_VERSION || p[5] != DSMETA_BIN_LABELS)
+    return -1;
+  labels->num_labels = get_u16(p + 6);
+  labels->remaining = labels->num_labels;
+  labels->next = p + DSMETA_BIN_LABELS_HEADER_SIZE;
+  labels->end = p + len;
+  return 0;
+}
+
+int dsmeta_bin_labels_next(dsmeta_bin_labels *labels, int *class_id,
+             const char **label, size_t *len) {
+  if (labels->next == labels->end)
+    return labels->remaining ? -1 : 0;
+  if (!labels->remaining || labels->end - labels->next < 3 ||
+      labels->end - labels->next - 3 < labels->next[2])
+    return -1;
+  *class_id = (int16_t) get_u16(labels->next);
+  *len = labels->next[2];
+  *label = (const char *) labels->next + 3;
+  labels->next += 3 + *len;
+  labels->remaining--;
+  return 1;
+}
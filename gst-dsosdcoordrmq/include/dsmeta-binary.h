@@ -0,0 +1,224 @@
+// Copyright 2022, Kyota Tashiro, Mengheng Lee, and Latona Inc.
+// License MIT
+#ifndef DSMETA_BINARY
+#define DSMETA_BINARY
+#include <stddef.h>
+#include <stdint.h>
+
+// Compact alternative to the JSON payload. Every field is little-endian and
+// fixed width; a detection is one rect instead of four corner objects.
+//
+//   header, 28 bytes
+//     0  u8[4] magic "DSMB"
+//     4  u8    version (DSMETA_BIN_VERSION)
+//     5  u8    record type (DSMETA_BIN_FRAME)
+//     6  u16   number of objects
+//     8  u32   frame number
+//    12  u32   source id
+//    16  u64   pts in nanoseconds, DSMETA_BIN_NO_PTS when unknown
+//    24  u16   batch id, the frame's index in the muxed batch
+//    26  u16   flags, DSMETA_BIN_FLAG_*; 0 for a full frame with its labels
+//   objects, 12 bytes each
+//     0  i16   class id
+//     2  u16   label id, index into the label table or DSMETA_BIN_NO_LABEL
+//     4  i16   left
+//     6  i16   top
+//     8  u16   width
+//    10  u16   height
+//   object ids, only when flags has KEYFRAME or DELTA
+//     0  u64   per object, the tracker id or DSMETA_BIN_NO_OBJECT_ID
+//   removed objects, only when flags has DELTA
+//     0  u16   number of ids
+//     2  u64   per removed object, its tracker id
+//   label table
+//     0  u8    number of labels
+//     1  per label: u8 length, then that many bytes (not NUL terminated)
+//
+// The label table is written last so frames can be encoded in one pass.
+// With the CLASS_LABELS flag the table is empty, every label id is
+// DSMETA_BIN_NO_LABEL and the label of an object is the one its class id has
+// in the most recent DSMETA_BIN_LABELS record of the connection.
+//
+// A KEYFRAME carries every object of the frame and replaces what a consumer
+// knows about the source. A DELTA only carries the objects that appeared or
+// moved since the last message of the source, plus the ids of the objects
+// that are gone; objects without a tracker id are sent in every message and
+// only last for it.
+//
+// Several frames can be coalesced into one message:
+//
+//   batch header, 8 bytes
+//     0  u8[4] magic "DSMB"
+//     4  u8    version (DSMETA_BIN_VERSION)
+//     5  u8    record type (DSMETA_BIN_BATCH)
+//     6  u16   number of frames
+//   frames
+//     0  u32   length of the frame that follows
+//     4  one DSMETA_BIN_FRAME record
+//
+// The label dictionary is a message of its own, sent on every connection
+// before the first frame that relies on it and again whenever a class gets a
+// label:
+//
+//   labels header, 8 bytes
+//     0  u8[4] magic "DSMB"
+//     4  u8    version (DSMETA_BIN_VERSION)
+//     5  u8    record type (DSMETA_BIN_LABELS)
+//     6  u16   number of labels
+//   labels
+//     0  i16   class id
+//     2  u8    length, then that many bytes (not NUL terminated)
+
+#define DSMETA_BIN_CONTENT_TYPE "application/x-dsmeta"
+#define DSMETA_BIN_VERSION 2
+#define DSMETA_BIN_FRAME 1
+#define DSMETA_BIN_BATCH 2
+#define DSMETA_BIN_LABELS 3
+#define DSMETA_BIN_HEADER_SIZE 28
+#define DSMETA_BIN_BATCH_HEADER_SIZE 8
+#define DSMETA_BIN_LABELS_HEADER_SIZE 8
+#define DSMETA_BIN_MAX_BATCH_FRAMES 65535
+#define DSMETA_BIN_OBJECT_SIZE 12
+#define DSMETA_BIN_MAX_LABELS 255
+#define DSMETA_BIN_MAX_OBJECTS 65535
+#define DSMETA_BIN_NO_LABEL 0xffff
+#define DSMETA_BIN_NO_PTS UINT64_MAX
+#define DSMETA_BIN_NO_OBJECT_ID UINT64_MAX
+#define DSMETA_BIN_FLAG_KEYFRAME 0x1
+#define DSMETA_BIN_FLAG_DELTA 0x2
+#define DSMETA_BIN_FLAG_CLASS_LABELS 0x4
+#define DSMETA_BIN_MAX_REMOVED 65535
+
+typedef struct dsmeta_bin_object {
+  int16_t class_id;
+  uint16_t label_id;
+  int16_t left;
+  int16_t top;
+  uint16_t width;
+  uint16_t height;
+} dsmeta_bin_object;
+
+// Encoder. Like json_writer, the buffer survives reset.
+typedef struct dsmeta_bin_writer {
+  uint8_t *buf;
+  size_t len;
+  size_t cap;
+  size_t frame_start;
+  unsigned int num_objects;
+  unsigned int num_labels;
+  const char *labels[DSMETA_BIN_MAX_LABELS];
+  uint16_t flags;
+  unsigned int num_object_ids;
+  size_t batch_start;
+  unsigned int num_frames;
+  int error;
+  // Number of times buf was grown, kept across reset.
+  unsigned long grows;
+} dsmeta_bin_writer;
+
+void dsmeta_bin_writer_init(dsmeta_bin_writer *w);
+
+void dsmeta_bin_writer_free(dsmeta_bin_writer *w);
+
+void dsmeta_bin_writer_reset(dsmeta_bin_writer *w);
+
+void dsmeta_bin_begin_frame(dsmeta_bin_writer *w, uint32_t source_id,
+             uint32_t frame_number, uint16_t batch_id, uint64_t pts);
+
+// Label strings must stay valid until dsmeta_bin_end_frame. Coordinates are
+// clamped to the field ranges.
+void dsmeta_bin_add_object(dsmeta_bin_writer *w, int class_id, const char *label,
+             double left, double top, double width, double height);
+
+// Marks the open frame as a keyframe or delta. Once every object is added,
+// the frame then needs one dsmeta_bin_add_object_id per object, in the same
+// order, and a delta also needs dsmeta_bin_add_removed. CLASS_LABELS may be
+// combined with either, and objects are then added without labels.
+void dsmeta_bin_set_flags(dsmeta_bin_writer *w, uint16_t flags);
+
+void dsmeta_bin_add_object_id(dsmeta_bin_writer *w, uint64_t object_id);
+
+void dsmeta_bin_add_removed(dsmeta_bin_writer *w, const uint64_t *object_ids,
+             size_t count);
+
+void dsmeta_bin_end_frame(dsmeta_bin_writer *w);
+
+void dsmeta_bin_begin_batch(dsmeta_bin_writer *w);
+
+// Appends an already encoded DSMETA_BIN_FRAME record.
+void dsmeta_bin_add_batch_frame(dsmeta_bin_writer *w, const void *frame, size_t len);
+
+void dsmeta_bin_end_batch(dsmeta_bin_writer *w);
+
+void dsmeta_bin_begin_labels(dsmeta_bin_writer *w);
+
+// Labels longer than 255 bytes are cut.
+void dsmeta_bin_add_label(dsmeta_bin_writer *w, int class_id, const char *label,
+             size_t len);
+
+void dsmeta_bin_end_labels(dsmeta_bin_writer *w);
+
+// Decoder. A decoded frame points into the message it was decoded from.
+typedef struct dsmeta_bin_frame {
+  uint32_t source_id;
+  uint32_t frame_number;
+  uint16_t batch_id;
+  uint64_t pts;
+  uint16_t flags;
+  unsigned int num_objects;
+  unsigned int num_labels;
+  const uint8_t *objects;
+  // NULL unless flags has KEYFRAME or DELTA.
+  const uint8_t *object_ids;
+  unsigned int num_removed;
+  const uint8_t *removed;
+  const char *labels[DSMETA_BIN_MAX_LABELS];
+  uint8_t label_lens[DSMETA_BIN_MAX_LABELS];
+  size_t size;
+} dsmeta_bin_frame;
+
+// Returns 0 and fills frame when data holds a valid frame, -1 otherwise.
+int dsmeta_bin_decode_frame(const void *data, size_t len, dsmeta_bin_frame *frame);
+
+void dsmeta_bin_get_object(const dsmeta_bin_frame *frame, unsigned int index,
+             dsmeta_bin_object *object);
+
+// DSMETA_BIN_NO_OBJECT_ID for objects without an id and for full frames.
+uint64_t dsmeta_bin_get_object_id(const dsmeta_bin_frame *frame, unsigned int index);
+
+uint64_t dsmeta_bin_get_removed(const dsmeta_bin_frame *frame, unsigned int index);
+
+typedef struct dsmeta_bin_batch {
+  unsigned int num_frames;
+  // Frames of num_frames not decoded yet.
+  unsigned int remaining;
+  const uint8_t *next;
+  const uint8_t *end;
+} dsmeta_bin_batch;
+
+// Returns 0 when data holds a batch, -1 otherwise.
+int dsmeta_bin_decode_batch(const void *data, size_t len, dsmeta_bin_batch *batch);
+
+// Decodes the next frame of a batch. Returns 1 on success, 0 at the end of
+// the batch and -1 when the batch is malformed, which includes ending before
+// or after num_frames frames.
+int dsmeta_bin_batch_next(dsmeta_bin_batch *batch, dsmeta_bin_frame *frame);
+
+typedef struct dsmeta_bin_labels {
+  unsigned int num_labels;
+  // Entries of num_labels not decoded yet.
+  unsigned int remaining;
+  const uint8_t *next;
+  const uint8_t *end;
+} dsmeta_bin_labels;
+
+// Returns 0 when data holds a label dictionary, -1 otherwise.
+int dsmeta_bin_decode_labels(const void *data, size_t len, dsmeta_bin_labels *labels);
+
+// Points label into the message at the next entry. Returns 1 on success, 0
+// at the end of the dictionary and -1 when it is malformed, which includes
+// ending before or after num_labels entries.
+int dsmeta_bin_labels_next(dsmeta_bin_labels *labels, int *class_id,
+             const char **label, size_t *len);
+
+#endif
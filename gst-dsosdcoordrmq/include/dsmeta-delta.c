@@ -0,0 +1,233 @@
+// Copyright 2022, Kyota Tashiro, Mengheng Lee, and Latona Inc.
+// License MIT
+
+#include <math.h>
+#include <stdlib.h>
+#include "dsmeta-delta.h"
+
+static int grow(void **array, size_t *capacity, size_t count, size_t size,
+             unsigned long *grows) {
+  size_t grown_capacity = *capacity ? *capacity : 64;
+  void *grown;
+
+  if (count <= *capacity)
+    return 0;
+  while (grown_capacity < count)
+    grown_capacity *= 2;
+  grown = realloc(*array, grown_capacity * size);
+  if (!grown)
+    return -1;
+  *array = grown;
+  *capacity = grown_capacity;
+  (*grows)++;
+  return 0;
+}
+
+static void sift_down(dsmeta_delta_object *objects, size_t root, size_t count) {
+  dsmeta_delta_object top = objects[root];
+  size_t child;
+
+  while ((child = 2 * root + 1) < count) {
+    if (child + 1 < count && objects[child].object_id < objects[child + 1].object_id)
+      child++;
+    if (objects[child].object_id <= top.object_id)
+      break;
+    objects[root] = objects[child];
+    root = child;
+  }
+  objects[root] = top;
+}
+
+// Heap sort by object id. glibc's qsort mallocs a merge buffer once the array
+// is over 1KB, i.e. every frame from about 32 tracked objects on. The ids are
+// unique, so the sort need not be stable.
+static void sort_by_id(dsmeta_delta_object *objects, size_t count) {
+  dsmeta_delta_object object;
+  size_t i;
+
+  for (i = count / 2; i-- > 0;)
+    sift_down(objects, i, count);
+  for (i = count; i-- > 1;) {
+    object = objects[0];
+    objects[0] = objects[i];
+    objects[i] = object;
+    sift_down(objects, 0, i);
+  }
+}
+
+static dsmeta_delta_object *find_object(dsmeta_delta_source *src, uint64_t id) {
+  size_t lo = 0;
+  size_t hi = src->num_objects;
+
+  while (lo < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+
+    if (src->objects[mid].object_id < id)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  if (lo < src->num_objects && src->objects[lo].object_id == id)
+    return &src->objects[lo];
+  return NULL;
+}
+
+// Streams come and go rarely, so a linear search over sources is enough.
+static dsmeta_delta_source *find_source(dsmeta_delta *d, uint32_t source_id) {
+  dsmeta_delta_source *src;
+  size_t i;
+
+  for (i = 0; i < d->num_sources; i++) {
+    if (d->sources[i].source_id == source_id)
+      return &d->sources[i];
+  }
+  if (grow((void **) &d->sources, &d->sources_capacity, d->num_sources + 1,
+           sizeof(*d->sources), &d->grows) < 0)
+    return NULL;
+  src = &d->sources[d->num_sources++];
+  src->source_id = source_id;
+  src->primed = 0;
+  src->frames_since_keyframe = 0;
+  src->objects = NULL;
+  src->num_objects = 0;
+  src->capacity = 0;
+  return src;
+}
+
+static int moved(const dsmeta_delta_object *was, const dsmeta_object *now,
+             float tolerance) {
+  return fabsf(now->left - was->left) > tolerance ||
+         fabsf(now->top - was->top) > tolerance ||
+         fabsf(now->width - was->width) > tolerance ||
+         fabsf(now->height - was->height) > tolerance;
+}
+
+void dsmeta_delta_init(dsmeta_delta *d, float tolerance,
+             unsigned int keyframe_interval) {
+  d->tolerance = tolerance;
+  d->keyframe_interval = keyframe_interval;
+  d->sources = NULL;
+  d->num_sources = 0;
+  d->sources_capacity = 0;
+  d->scratch = NULL;
+  d->scratch_capacity = 0;
+  d->suppressed = 0;
+  d->grows = 0;
+}
+
+void dsmeta_delta_free(dsmeta_delta *d) {
+  size_t i;
+
+  for (i = 0; i < d->num_sources; i++)
+    free(d->sources[i].objects);
+  free(d->sources);
+  free(d->scratch);
+  dsmeta_delta_init(d, d->tolerance, d->keyframe_interval);
+}
+
+void dsmeta_delta_reset(dsmeta_delta *d) {
+  size_t i;
+
+  for (i = 0; i < d->num_sources; i++) {
+    d->sources[i].primed = 0;
+    d->sources[i].num_objects = 0;
+  }
+}
+
+void dsmeta_delta_force_keyframe(dsmeta_delta *d, uint32_t source_id) {
+  size_t i;
+
+  for (i = 0; i < d->num_sources; i++) {
+    if (d->sources[i].source_id == source_id)
+      d->sources[i].primed = 0;
+  }
+}
+
+int dsmeta_delta_apply(dsmeta_delta *d, dsmeta_frame *f) {
+  dsmeta_delta_source *src = find_source(d, f->source_id);
+  dsmeta_delta_object *swap;
+  size_t swap_capacity;
+  size_t kept = 0;
+  size_t tracked = 0;
+  size_t i;
+  int keyframe;
+
+  f->kind = DSMETA_FRAME_KEYFRAME;
+  f->num_removed = 0;
+  if (!src)
+    return -1;
+  keyframe = !src->primed ||
+             (d->keyframe_interval > 0 &&
+              src->frames_since_keyframe >= d->keyframe_interval);
+
+  // Everything that can fail happens before f is touched. At most every
+  // object of the source can be removed.
+  if (grow((void **) &d->scratch, &d->scratch_capacity, f->num_objects,
+           sizeof(*d->scratch), &d->grows) < 0 ||
+      (!keyframe &&
+       grow((void **) &f->removed, &f->removed_capacity, src->num_objects,
+            sizeof(*f->removed), &f->grows) < 0)) {
+    src->primed = 0;
+    return -1;
+  }
+  for (i = 0; i < src->num_objects; i++)
+    src->objects[i].seen = 0;
+
+  for (i = 0; i < f->num_objects; i++) {
+    const dsmeta_object *o = &f->objects[i];
+    dsmeta_delta_object *was;
+    dsmeta_delta_object *state;
+
+    // Untracked objects cannot be matched across frames and go out every time.
+    if (o->object_id == DSMETA_NO_OBJECT_ID) {
+      f->objects[kept++] = *o;
+      continue;
+    }
+
+    was = keyframe ? NULL : find_object(src, o->object_id);
+    state = &d->scratch[tracked++];
+    state->object_id = o->object_id;
+    state->class_id = o->class_id;
+    state->seen = 0;
+    if (was && !was->seen && was->class_id == o->class_id &&
+        !moved(was, o, d->tolerance)) {
+      // Consumers keep the box they were sent, so it stays the reference.
+      state->left = was->left;
+      state->top = was->top;
+      state->width = was->width;
+      state->height = was->height;
+      was->seen = 1;
+      d->suppressed++;
+      continue;
+    }
+    if (was)
+      was->seen = 1;
+    state->left = o->left;
+    state->top = o->top;
+    state->width = o->width;
+    state->height = o->height;
+    f->objects[kept++] = *o;
+  }
+  f->num_objects = kept;
+
+  if (!keyframe) {
+    f->kind = DSMETA_FRAME_DELTA;
+    for (i = 0; i < src->num_objects; i++) {
+      if (!src->objects[i].seen)
+        f->removed[f->num_removed++] = src->objects[i].object_id;
+    }
+  }
+
+  swap = src->objects;
+  swap_capacity = src->capacity;
+  src->objects = d->scratch;
+  src->capacity = d->scratch_capacity;
+  src->num_objects = tracked;
+  d->scratch = swap;
+  d->scratch_capacity = swap_capacity;
+  sort_by_id(src->objects, src->num_objects);
+
+  src->frames_since_keyframe = keyframe ? 1 : src->frames_since_keyframe + 1;
+  src->primed = 1;
+  return 0;
+}
@@ -0,0 +1,71 @@
+// Copyright 2022, Kyota Tashiro, Mengheng Lee, and Latona Inc.
+// License MIT
+#ifndef DSMETA_DELTA
+#define DSMETA_DELTA
+#include <stddef.h>
+#include <stdint.h>
+#include "dsmeta-frame.h"
+
+// Turns full frames into keyframes and deltas, per source. The state kept for
+// a source is what its consumers were last told about every tracked object,
+// so a box that creeps by less than the tolerance per frame is still sent
+// once it has moved further than that in total.
+
+typedef struct dsmeta_delta_object {
+  uint64_t object_id;
+  int class_id;
+  int seen;
+  float left;
+  float top;
+  float width;
+  float height;
+} dsmeta_delta_object;
+
+typedef struct dsmeta_delta_source {
+  uint32_t source_id;
+  int primed;
+  unsigned int frames_since_keyframe;
+  // Sorted by object_id.
+  dsmeta_delta_object *objects;
+  size_t num_objects;
+  size_t capacity;
+} dsmeta_delta_source;
+
+// Like dsmeta_frame, every array only grows, so a steady scene allocates
+// nothing.
+typedef struct dsmeta_delta {
+  // Largest change of any box edge, in pixels, that still counts as unmoved.
+  float tolerance;
+  // Frames of a source between keyframes, 0 for the first frame only.
+  unsigned int keyframe_interval;
+  dsmeta_delta_source *sources;
+  size_t num_sources;
+  size_t sources_capacity;
+  // State being built for the current frame, swapped with the source's.
+  dsmeta_delta_object *scratch;
+  size_t scratch_capacity;
+  // Objects left out of deltas because they had not moved.
+  unsigned long suppressed;
+  unsigned long grows;
+} dsmeta_delta;
+
+void dsmeta_delta_init(dsmeta_delta *d, float tolerance,
+             unsigned int keyframe_interval);
+
+void dsmeta_delta_free(dsmeta_delta *d);
+
+// Forgets every source, so each one starts over with a keyframe.
+void dsmeta_delta_reset(dsmeta_delta *d);
+
+// Sends the next frame of source_id as a keyframe, for when the message with
+// an earlier frame of it was dropped and its consumers no longer know what a
+// delta would refer to. A source not seen yet starts with one anyway.
+void dsmeta_delta_force_keyframe(dsmeta_delta *d, uint32_t source_id);
+
+// Rewrites f in place into a keyframe or a delta against what was last
+// published for its source, and records f as published. Returns -1 when
+// memory runs out; f is then left as a keyframe and the source will send
+// another one next frame.
+int dsmeta_delta_apply(dsmeta_delta *d, dsmeta_frame *f);
+
+#endif
@@ -0,0 +1,39 @@
+// Copyright 2022, Kyota Tashiro, Mengheng Lee, and Latona Inc.
+// License MIT
+
+#include "dsmeta-extract.h"
+
+int dsmeta_frame_extract(dsmeta_frame *f, const NvDsFrameMeta *frame_meta,
+             label_table *labels) {
+  const NvDsMetaList *l;
+  const NvDsObjectMeta *object_meta;
+  const label_entry *label;
+  dsmeta_object *object;
+
+  dsmeta_frame_begin(f, frame_meta->source_id, frame_meta->frame_num, frame_meta->batch_id,
+                     frame_meta->buf_pts, frame_meta->num_obj_meta);
+  for (l = frame_meta->obj_meta_list; l != NULL; l = l->next) {
+    object_meta = (const NvDsObjectMeta *) l->data;
+    object = dsmeta_frame_add_object(f);
+    if (!object)
+      return -1;
+    object->object_id = object_meta->object_id;
+    object->class_id = object_meta->class_id;
+    // display_text is formatted for the OSD ("Person 0.87"), so it is never
+    // used as the label.
+    label = label_table_intern(labels, object_meta->class_id, object_meta->obj_label);
+    if (label) {
+      object->label = label->name;
+      object->label_json = label->json;
+      object->label_json_len = label->json_len;
+    } else {
+      object->label = object_meta->obj_label[0] ? object_meta->obj_label : NULL;
+      object->label_json = NULL;
+    }
+    object->left = object_meta->rect_params.left;
+    object->top = object_meta->rect_params.top;
+    object->width = object_meta->rect_params.width;
+    object->height = object_meta->rect_params.height;
+  }
+  return 0;
+}
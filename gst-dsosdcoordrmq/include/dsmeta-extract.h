@@ -0,0 +1,20 @@
+// Copyright 2022, Kyota Tashiro, Mengheng Lee, and Latona Inc.
+// License MIT
+#ifndef DSMETA_EXTRACT
+#define DSMETA_EXTRACT
+#include "nvdsmeta.h"
+#include "dsmeta-frame.h"
+#include "label-table.h"
+
+// Copies the detections of one NvDsFrameMeta into a dsmeta_frame. Only the
+// meta structs are read, so this links without GStreamer or CUDA.
+
+// Starts f as the frame of frame_meta and adds every object of it. The label
+// of an object comes from its class id, learnt from obj_label the first time
+// the class shows up unless labels names it already; a class labels cannot
+// hold keeps obj_label, borrowed from frame_meta. Returns -1 when the object
+// array cannot grow, f then holding the objects that fit.
+int dsmeta_frame_extract(dsmeta_frame *f, const NvDsFrameMeta *frame_meta,
+             label_table *labels);
+
+#endif
@@ -0,0 +1,200 @@
+// Copyright 2022, Kyota Tashiro, Mengheng Lee, and Latona Inc.
+// License MIT
+
+#include <stdlib.h>
+#include "dsmeta-frame.h"
+
+static int reserve(dsmeta_frame *f, size_t count) {
+  size_t capacity = f->capacity ? f->capacity : DSMETA_FRAME_DEFAULT_CAPACITY;
+  dsmeta_object *grown;
+
+  if (count <= f->capacity)
+    return 0;
+  while (capacity < count)
+    capacity *= 2;
+  grown = realloc(f->objects, capacity * sizeof(*grown));
+  if (!grown)
+    return -1;
+  f->objects = grown;
+  f->capacity = capacity;
+  f->grows++;
+  return 0;
+}
+
+void dsmeta_frame_init(dsmeta_frame *f, size_t capacity) {
+  f->source_id = 0;
+  f->frame_number = 0;
+  f->batch_id = 0;
+  f->pts = DSMETA_BIN_NO_PTS;
+  f->objects = NULL;
+  f->num_objects = 0;
+  f->capacity = 0;
+  f->class_labels = 0;
+  f->kind = DSMETA_FRAME_FULL;
+  f->removed = NULL;
+  f->num_removed = 0;
+  f->removed_capacity = 0;
+  f->high_water = 0;
+  f->grows = 0;
+  reserve(f, capacity);
+}
+
+void dsmeta_frame_free(dsmeta_frame *f) {
+  free(f->objects);
+  f->objects = NULL;
+  f->num_objects = 0;
+  f->capacity = 0;
+  free(f->removed);
+  f->removed = NULL;
+  f->num_removed = 0;
+  f->removed_capacity = 0;
+}
+
+void dsmeta_frame_begin(dsmeta_frame *f, uint32_t source_id, int32_t frame_number,
+             uint32_t batch_id, uint64_t pts, size_t expected) {
+  f->source_id = source_id;
+  f->frame_number = frame_number;
+  f->batch_id = batch_id;
+  f->pts = pts;
+  f->num_objects = 0;
+  f->kind = DSMETA_FRAME_FULL;
+  f->num_removed = 0;
+  reserve(f, expected);
+}
+
+dsmeta_object *dsmeta_frame_add_object(dsmeta_frame *f) {
+  if (reserve(f, f->num_objects + 1) < 0)
+    return NULL;
+  if (f->num_objects + 1 > f->high_water)
+    f->high_water = f->num_objects + 1;
+  return &f->objects[f->num_objects++];
+}
+
+void dsmeta_frame_sort_by_class(dsmeta_frame *f) {
+  dsmeta_object object;
+  size_t i, j;
+
+  // Insertion sort: stable, in place, and close to linear on the usual frame
+  // where the detector already emits objects grouped by class.
+  for (i = 1; i < f->num_objects; i++) {
+    if (f->objects[i - 1].class_id <= f->objects[i].class_id)
+      continue;
+    object = f->objects[i];
+    for (j = i; j > 0 && f->objects[j - 1].class_id > object.class_id; j--)
+      f->objects[j] = f->objects[j - 1];
+    f->objects[j] = object;
+  }
+}
+
+int dsmeta_frame_next_class(const dsmeta_frame *f, size_t *pos, dsmeta_frame *view) {
+  size_t end = *pos;
+
+  if (*pos >= f->num_objects)
+    return 0;
+  while (end < f->num_objects && f->objects[end].class_id == f->objects[*pos].class_id)
+    end++;
+  *view = *f;
+  view->objects = f->objects + *pos;
+  view->num_objects = end - *pos;
+  view->capacity = view->num_objects;
+  view->kind = DSMETA_FRAME_FULL;
+  view->num_removed = 0;
+  *pos = end;
+  return 1;
+}
+
+static void write_corner(json_writer *w, const char *name, float x, float y) {
+  json_writer_key(w, name);
+  json_writer_begin_object(w);
+  json_writer_key(w, "x");
+  json_writer_int(w, (long long) x);
+  json_writer_key(w, "y");
+  json_writer_int(w, (long long) y);
+  json_writer_end_object(w);
+}
+
+void dsmeta_frame_build_json(const dsmeta_frame *f, json_writer *w) {
+  size_t i;
+
+  json_writer_reset(w);
+  json_writer_begin_object(w);
+  json_writer_key(w, "frameNumber");
+  json_writer_int(w, f->frame_number);
+  json_writer_key(w, "sourceId");
+  json_writer_int(w, f->source_id);
+  json_writer_key(w, "batchId");
+  json_writer_int(w, f->batch_id);
+  if (f->pts != DSMETA_BIN_NO_PTS) {
+    json_writer_key(w, "pts");
+    json_writer_int(w, (long long) f->pts);
+  }
+  if (f->kind != DSMETA_FRAME_FULL) {
+    json_writer_key(w, "keyframe");
+    json_writer_bool(w, f->kind == DSMETA_FRAME_KEYFRAME);
+  }
+  json_writer_key(w, "inferredResult");
+  json_writer_begin_array(w);
+  for (i = 0; i < f->num_objects; i++) {
+    const dsmeta_object *o = &f->objects[i];
+    // Right and bottom edges are summed in float, as NvOSD_RectParams are.
+    float right = o->left + o->width;
+    float bottom = o->top + o->height;
+
+    json_writer_begin_object(w);
+    if (f->kind != DSMETA_FRAME_FULL && o->object_id != DSMETA_NO_OBJECT_ID) {
+      json_writer_key(w, "objectId");
+      json_writer_int(w, (long long) o->object_id);
+    }
+    if (o->label_json) {
+      json_writer_key(w, "label");
+      json_writer_raw(w, o->label_json, o->label_json_len);
+    } else if (o->label) {
+      json_writer_key(w, "label");
+      json_writer_string(w, o->label);
+    }
+    json_writer_key(w, "coordinate");
+    json_writer_begin_object(w);
+    write_corner(w, "topLeft", o->left, o->top);
+    write_corner(w, "topRight", right, o->top);
+    write_corner(w, "bottomLeft", o->left, bottom);
+    write_corner(w, "bottomRight", right, bottom);
+    json_writer_end_object(w);
+    json_writer_end_object(w);
+  }
+  json_writer_end_array(w);
+  if (f->kind == DSMETA_FRAME_DELTA) {
+    json_writer_key(w, "removed");
+    json_writer_begin_array(w);
+    for (i = 0; i < f->num_removed; i++)
+      json_writer_int(w, (long long) f->removed[i]);
+    json_writer_end_array(w);
+  }
+  json_writer_end_object(w);
+}
+
+void dsmeta_frame_build_binary(const dsmeta_frame *f, dsmeta_bin_writer *w) {
+  uint16_t flags = f->class_labels ? DSMETA_BIN_FLAG_CLASS_LABELS : 0;
+  size_t i;
+
+  dsmeta_bin_writer_reset(w);
+  dsmeta_bin_begin_frame(w, f->source_id, (uint32_t) f->frame_number,
+                         (uint16_t) f->batch_id, f->pts);
+  for (i = 0; i < f->num_objects; i++) {
+    const dsmeta_object *o = &f->objects[i];
+
+    dsmeta_bin_add_object(w, o->class_id, f->class_labels ? NULL : o->label,
+                          o->left, o->top, o->width, o->height);
+  }
+  if (f->kind != DSMETA_FRAME_FULL)
+    flags |= f->kind == DSMETA_FRAME_KEYFRAME ?
+             DSMETA_BIN_FLAG_KEYFRAME : DSMETA_BIN_FLAG_DELTA;
+  if (flags)
+    dsmeta_bin_set_flags(w, flags);
+  if (f->kind != DSMETA_FRAME_FULL) {
+    for (i = 0; i < f->num_objects; i++)
+      dsmeta_bin_add_object_id(w, f->objects[i].object_id);
+    if (f->kind == DSMETA_FRAME_DELTA)
+      dsmeta_bin_add_removed(w, f->removed, f->num_removed);
+  }
+  dsmeta_bin_end_frame(w);
+}
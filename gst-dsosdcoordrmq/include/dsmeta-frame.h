@@ -0,0 +1,96 @@
+// Copyright 2022, Kyota Tashiro, Mengheng Lee, and Latona Inc.
+// License MIT
+#ifndef DSMETA_FRAME
+#define DSMETA_FRAME
+#include <stddef.h>
+#include <stdint.h>
+#include "json-writer.h"
+#include "dsmeta-binary.h"
+
+// The detections of one source frame and their JSON and binary encodings.
+// Nothing here depends on GStreamer, DeepStream or CUDA: the element copies
+// what it needs out of NvDsFrameMeta, so frames can just as well be built by
+// hand on a machine without the SDK.
+
+#define DSMETA_FRAME_DEFAULT_CAPACITY 128
+// Same value as DeepStream's UNTRACKED_OBJECT_ID.
+#define DSMETA_NO_OBJECT_ID DSMETA_BIN_NO_OBJECT_ID
+
+// What a serialized frame means to a consumer, see dsmeta-binary.h.
+typedef enum {
+  DSMETA_FRAME_FULL,
+  DSMETA_FRAME_KEYFRAME,
+  DSMETA_FRAME_DELTA,
+} dsmeta_frame_kind;
+
+typedef struct dsmeta_object {
+  // Tracker id, DSMETA_NO_OBJECT_ID when there is no tracker upstream.
+  uint64_t object_id;
+  int class_id;
+  // Borrowed, must stay valid until the frame is serialized.
+  const char *label;
+  // The same label already quoted and escaped for JSON, e.g. from a
+  // label_table; spliced as is when set, label is escaped otherwise.
+  const char *label_json;
+  size_t label_json_len;
+  float left;
+  float top;
+  float width;
+  float height;
+} dsmeta_object;
+
+// The object array is kept across frames and only grows, so once it has
+// reached the busiest frame nothing is allocated.
+typedef struct dsmeta_frame {
+  uint32_t source_id;
+  int32_t frame_number;
+  uint32_t batch_id;
+  // Nanoseconds, DSMETA_BIN_NO_PTS (GST_CLOCK_TIME_NONE) when unknown.
+  uint64_t pts;
+  dsmeta_object *objects;
+  size_t num_objects;
+  size_t capacity;
+  // When set, binary frames leave labels to the dictionary consumers got in
+  // a DSMETA_BIN_LABELS message and carry class ids only.
+  int class_labels;
+  // Set by dsmeta_delta_apply; a FULL frame never carries removed ids.
+  dsmeta_frame_kind kind;
+  uint64_t *removed;
+  size_t num_removed;
+  size_t removed_capacity;
+  // Largest num_objects seen since init.
+  size_t high_water;
+  // Number of times objects or removed was grown.
+  unsigned long grows;
+} dsmeta_frame;
+
+void dsmeta_frame_init(dsmeta_frame *f, size_t capacity);
+
+void dsmeta_frame_free(dsmeta_frame *f);
+
+// Starts a new frame. expected is a hint used to grow the array once up front.
+void dsmeta_frame_begin(dsmeta_frame *f, uint32_t source_id, int32_t frame_number,
+             uint32_t batch_id, uint64_t pts, size_t expected);
+
+// Returns the slot for the next object, or NULL when the array cannot grow.
+dsmeta_object *dsmeta_frame_add_object(dsmeta_frame *f);
+
+// Reorders the objects so those of a class are next to each other, keeping
+// their order within the class.
+void dsmeta_frame_sort_by_class(dsmeta_frame *f);
+
+// Makes view a full frame holding the run of same-class objects that starts
+// at *pos, borrowing f's objects, and moves *pos past it. Returns 0 once
+// every object has been visited. Meant for sorted full frames.
+int dsmeta_frame_next_class(const dsmeta_frame *f, size_t *pos, dsmeta_frame *view);
+
+// Same layout the element has always published: frameNumber, sourceId,
+// batchId, pts when known, then inferredResult with the four corners of each
+// box. Keyframes and deltas add a keyframe flag and an objectId per tracked
+// object, and deltas end with the removed object ids.
+void dsmeta_frame_build_json(const dsmeta_frame *f, json_writer *w);
+
+// One DSMETA_BIN_FRAME record, see dsmeta-binary.h.
+void dsmeta_frame_build_binary(const dsmeta_frame *f, dsmeta_bin_writer *w);
+
+#endif
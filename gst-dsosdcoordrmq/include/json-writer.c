@@ -0,0 +1,191 @@
+// Copyright 2022, Kyota Tashiro, Mengheng Lee, and Latona Inc.
+// License MIT
+
+#include <stdlib.h>
+#include <string.h>
+#include "json-writer.h"
+
+static const char digit_pairs[] =
+  "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+  "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+  "8081828384858687888990919293949596979899";
+
+static int reserve(json_writer *w, size_t extra) {
+  size_t cap;
+  char *grown;
+
+  if (w->len + extra <= w->cap)
+    return 0;
+  cap = w->cap ? w->cap : 256;
+  while (cap < w->len + extra)
+    cap *= 2;
+  grown = realloc(w->buf, cap);
+  if (!grown) {
+    w->error = 1;
+    return -1;
+  }
+  w->buf = grown;
+  w->cap = cap;
+  w->grows++;
+  return 0;
+}
+
+static void append(json_writer *w, const char *data, size_t len) {
+  if (reserve(w, len) < 0)
+    return;
+  memcpy(w->buf + w->len, data, len);
+  w->len += len;
+}
+
+static void begin_value(json_writer *w) {
+  unsigned int bit;
+
+  if (w->after_key) {
+    w->after_key = 0;
+    return;
+  }
+  if (w->depth == 0)
+    return;
+  bit = 1u << (w->depth - 1);
+  if (w->has_items & bit)
+    append(w, ", ", 2);
+  w->has_items |= bit;
+}
+
+static void open_container(json_writer *w, char c) {
+  begin_value(w);
+  append(w, &c, 1);
+  if (w->depth >= JSON_WRITER_MAX_DEPTH) {
+    w->error = 1;
+    return;
+  }
+  w->depth++;
+  w->has_items &= ~(1u << (w->depth - 1));
+}
+
+static void close_container(json_writer *w, char c) {
+  if (w->depth > 0)
+    w->depth--;
+  append(w, &c, 1);
+}
+
+void json_writer_init(json_writer *w) {
+  memset(w, 0, sizeof(*w));
+}
+
+void json_writer_free(json_writer *w) {
+  free(w->buf);
+  json_writer_init(w);
+}
+
+void json_writer_reset(json_writer *w) {
+  w->len = 0;
+  w->depth = 0;
+  w->has_items = 0;
+  w->after_key = 0;
+  w->error = 0;
+}
+
+void json_writer_begin_object(json_writer *w) {
+  open_container(w, '{');
+}
+
+void json_writer_end_object(json_writer *w) {
+  close_container(w, '}');
+}
+
+void json_writer_begin_array(json_writer *w) {
+  open_container(w, '[');
+}
+
+void json_writer_end_array(json_writer *w) {
+  close_container(w, ']');
+}
+
+void json_writer_key(json_writer *w, const char *key) {
+  size_t len = strlen(key);
+
+  begin_value(w);
+  if (reserve(w, len + 4) < 0)
+    return;
+  w->buf[w->len++] = '"';
+  memcpy(w->buf + w->len, key, len);
+  w->len += len;
+  memcpy(w->buf + w->len, "\": ", 3);
+  w->len += 3;
+  w->after_key = 1;
+}
+
+void json_writer_int(json_writer *w, long long value) {
+  char tmp[24];
+  char *p = tmp + sizeof(tmp);
+  unsigned long long u = value < 0 ? 0ULL - (unsigned long long) value
+                                   : (unsigned long long) value;
+
+  while (u >= 100) {
+    unsigned int pair = (unsigned int) (u % 100) * 2;
+    u /= 100;
+    *--p = digit_pairs[pair + 1];
+    *--p = digit_pairs[pair];
+  }
+  if (u >= 10) {
+    *--p = digit_pairs[u * 2 + 1];
+    *--p = digit_pairs[u * 2];
+  } else {
+    *--p = (char) ('0' + u);
+  }
+  if (value < 0)
+    *--p = '-';
+
+  begin_value(w);
+  append(w, p, tmp + sizeof(tmp) - p);
+}
+
+void json_writer_string(json_writer *w, const char *value) {
+  static const char hex[] = "0123456789abcdef";
+  const unsigned char *s = (const unsigned char *) value;
+  const unsigned char *run = s;
+
+  begin_value(w);
+  append(w, "\"", 1);
+  for (; *s; s++) {
+    char esc[6] = { '\\', 0, '0', '0', 0, 0 };
+    size_t esc_len = 2;
+
+    if (*s >= 0x20 && *s != '"' && *s != '\\')
+      continue;
+    append(w, (const char *) run, s - run);
+    switch (*s) {
+      case '"':  esc[1] = '"'; break;
+      case '\\': esc[1] = '\\'; break;
+      case '\b': esc[1] = 'b'; break;
+      case '\f': esc[1] = 'f'; break;
+      case '\n': esc[1] = 'n'; break;
+      case '\r': esc[1] = 'r'; break;
+      case '\t': esc[1] = 't'; break;
+      default:
+        esc[1] = 'u';
+        esc[4] = hex[*s >> 4];
+        esc[5] = hex[*s & 0xf];
+        esc_len = 6;
+        break;
+    }
+    append(w, esc, esc_len);
+    run = s + 1;
+  }
+  append(w, (const char *) run, s - run);
+  append(w, "\"", 1);
+}
+
+void json_writer_bool(json_writer *w, int value) {
+  begin_value(w);
+  if (value)
+    append(w, "true", 4);
+  else
+    append(w, "false", 5);
+}
+
+void json_writer_raw(json_writer *w, const char *data, size_t len) {
+  begin_value(w);
+  append(w, data, len);
+}
@@ -0,0 +1,51 @@
+// Copyright 2022, Kyota Tashiro, Mengheng Lee, and Latona Inc.
+// License MIT
+#ifndef JSON_WRITER
+#define JSON_WRITER
+#include <stddef.h>
+
+#define JSON_WRITER_MAX_DEPTH 32
+
+// Streams JSON text into a buffer that is kept across documents, so once it
+// has grown to the largest document nothing is allocated. Separators follow
+// jansson's json_dumps(root, 0): ", " between items and ": " after keys.
+typedef struct json_writer {
+  char *buf;
+  size_t len;
+  size_t cap;
+  int depth;
+  unsigned int has_items;
+  int after_key;
+  int error;
+  // Number of times buf was grown, kept across reset.
+  unsigned long grows;
+} json_writer;
+
+void json_writer_init(json_writer *w);
+
+void json_writer_free(json_writer *w);
+
+// Starts a new document, keeping the buffer.
+void json_writer_reset(json_writer *w);
+
+void json_writer_begin_object(json_writer *w);
+
+void json_writer_end_object(json_writer *w);
+
+void json_writer_begin_array(json_writer *w);
+
+void json_writer_end_array(json_writer *w);
+
+// Key must not need escaping.
+void json_writer_key(json_writer *w, const char *key);
+
+void json_writer_int(json_writer *w, long long value);
+
+void json_writer_string(json_writer *w, const char *value);
+
+void json_writer_bool(json_writer *w, int value);
+
+// Appends bytes that are already valid JSON for the current position.
+void json_writer_raw(json_writer *w, const char *data, size_t len);
+
+#endif
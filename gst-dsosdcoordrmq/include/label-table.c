@@ -0,0 +1,179 @@
+// Copyright 2022, Kyota Tashiro, Mengheng Lee, and Latona Inc.
+// License MIT
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "json-writer.h"
+#include "label-table.h"
+
+static int reserve(label_table *t, size_t count) {
+  size_t capacity = t->capacity ? t->capacity : 16;
+  label_entry *grown;
+
+  if (count <= t->capacity)
+    return 0;
+  while (capacity < count)
+    capacity *= 2;
+  if (capacity > LABEL_TABLE_MAX_CLASSES)
+    capacity = LABEL_TABLE_MAX_CLASSES;
+  grown = realloc(t->entries, capacity * sizeof(*grown));
+  if (!grown)
+    return -1;
+  memset(grown + t->capacity, 0, (capacity - t->capacity) * sizeof(*grown));
+  t->entries = grown;
+  t->capacity = capacity;
+  t->grows++;
+  return 0;
+}
+
+// Makes room to retire the two strings of a relabeled entry.
+static int reserve_retired(label_table *t) {
+  size_t capacity = t->retired_capacity ? t->retired_capacity * 2 : 16;
+  char **grown;
+
+  if (t->num_retired + 2 <= t->retired_capacity)
+    return 0;
+  grown = realloc(t->retired, capacity * sizeof(*grown));
+  if (!grown)
+    return -1;
+  t->retired = grown;
+  t->retired_capacity = capacity;
+  t->grows++;
+  return 0;
+}
+
+// Keeps whole UTF-8 sequences when a label has to be cut.
+static size_t clip(const char *name, size_t len) {
+  if (len <= LABEL_TABLE_MAX_LABEL)
+    return len;
+  len = LABEL_TABLE_MAX_LABEL;
+  while (len > 0 && ((unsigned char) name[len] & 0xc0) == 0x80)
+    len--;
+  return len;
+}
+
+static int set_label(label_table *t, int class_id, const char *name, size_t len) {
+  label_entry *entry;
+  json_writer w;
+  char *copy;
+
+  if (class_id < 0 || class_id >= LABEL_TABLE_MAX_CLASSES || len == 0 ||
+      reserve(t, (size_t) class_id + 1) < 0)
+    return -1;
+  len = clip(name, len);
+  copy = malloc(len + 1);
+  if (!copy)
+    return -1;
+  memcpy(copy, name, len);
+  copy[len] = '\0';
+
+  json_writer_init(&w);
+  json_writer_string(&w, copy);
+  if (w.error) {
+    json_writer_free(&w);
+    free(copy);
+    return -1;
+  }
+
+  entry = &t->entries[class_id];
+  if (entry->name) {
+    // Frames may still point at the old label.
+    if (reserve_retired(t) < 0) {
+      json_writer_free(&w);
+      free(copy);
+      return -1;
+    }
+    t->retired[t->num_retired++] = entry->name;
+    t->retired[t->num_retired++] = entry->json;
+  } else
+    t->count++;
+  entry->name = copy;
+  entry->name_len = len;
+  // The writer's buffer becomes the entry's, so it is not freed here.
+  entry->json = w.buf;
+  entry->json_len = w.len;
+  t->generation++;
+  t->grows++;
+  return 0;
+}
+
+void label_table_init(label_table *t) {
+  t->entries = NULL;
+  t->capacity = 0;
+  t->retired = NULL;
+  t->num_retired = 0;
+  t->retired_capacity = 0;
+  t->count = 0;
+  t->generation = 0;
+  t->grows = 0;
+}
+
+void label_table_free(label_table *t) {
+  size_t i;
+
+  for (i = 0; i < t->capacity; i++) {
+    free(t->entries[i].name);
+    free(t->entries[i].json);
+  }
+  free(t->entries);
+  for (i = 0; i < t->num_retired; i++)
+    free(t->retired[i]);
+  free(t->retired);
+  label_table_init(t);
+}
+
+int label_table_load(label_table *t, const char *path) {
+  FILE *file = fopen(path, "r");
+  char line[1024];
+  int class_id = 0;
+  int loaded = 0;
+
+  if (!file)
+    return -1;
+  while (fgets(line, sizeof(line), file)) {
+    size_t len = strlen(line);
+    int partial = len > 0 && line[len - 1] != '\n' && !feof(file);
+
+    while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r' ||
+        line[len - 1] == ' ' || line[len - 1] == '\t'))
+      len--;
+    if (len > 0 && set_label(t, class_id, line, len) == 0)
+      loaded++;
+    // The rest of an overlong line is dropped; the label was cut anyway.
+    while (partial && fgets(line, sizeof(line), file))
+      partial = line[strlen(line) - 1] != '\n';
+    class_id++;
+  }
+  fclose(file);
+  return loaded;
+}
+
+const label_entry *label_table_get(const label_table *t, int class_id) {
+  if (class_id < 0 || (size_t) class_id >= t->capacity ||
+      !t->entries[class_id].name)
+    return NULL;
+  return &t->entries[class_id];
+}
+
+const label_entry *label_table_intern(label_table *t, int class_id, const char *name) {
+  const label_entry *entry = label_table_get(t, class_id);
+
+  if (entry)
+    return entry;
+  if (!name || set_label(t, class_id, name, strlen(name)) < 0)
+    return NULL;
+  return &t->entries[class_id];
+}
+
+void label_table_build_binary(const label_table *t, dsmeta_bin_writer *w) {
+  size_t i;
+
+  dsmeta_bin_writer_reset(w);
+  dsmeta_bin_begin_labels(w);
+  for (i = 0; i < t->capacity; i++) {
+    if (t->entries[i].name)
+      dsmeta_bin_add_label(w, (int) i, t->entries[i].name, t->entries[i].name_len);
+  }
+  dsmeta_bin_end_labels(w);
+}
@@ -0,0 +1,62 @@
+// Copyright 2022, Kyota Tashiro, Mengheng Lee, and Latona Inc.
+// License MIT
+#ifndef LABEL_TABLE
+#define LABEL_TABLE
+#include <stddef.h>
+#include "dsmeta-binary.h"
+
+// Label of every class id, interned once and then looked up by index. Each
+// label is also kept as a quoted and escaped JSON string, so serializing a
+// detection splices bytes instead of escaping text per object.
+
+#define LABEL_TABLE_MAX_CLASSES 1024
+// Labels are cut to what a DSMETA_BIN_LABELS entry can carry.
+#define LABEL_TABLE_MAX_LABEL 255
+
+typedef struct label_entry {
+  // NULL while the class has no label.
+  char *name;
+  size_t name_len;
+  char *json;
+  size_t json_len;
+} label_entry;
+
+// Entries are indexed by class id and only grow. Strings are never freed
+// before label_table_free, so pointers into an entry stay valid even when the
+// array itself moves. A class that is labeled again, e.g. by loading a labels
+// file twice, gets new strings and the old ones are retired until then.
+typedef struct label_table {
+  label_entry *entries;
+  size_t capacity;
+  // Superseded name and json strings, freed by label_table_free.
+  char **retired;
+  size_t num_retired;
+  size_t retired_capacity;
+  // Classes with a label.
+  size_t count;
+  // Bumped whenever a label is added, so the dictionary can be resent.
+  unsigned long generation;
+  // Number of times entries was grown or a label was stored.
+  unsigned long grows;
+} label_table;
+
+void label_table_init(label_table *t);
+
+void label_table_free(label_table *t);
+
+// Reads an nvinfer labels file: line n is the label of class n. Empty lines
+// leave their class unlabeled. Returns the number of labels read, -1 when the
+// file cannot be read.
+int label_table_load(label_table *t, const char *path);
+
+// NULL when the class has no label or is out of range.
+const label_entry *label_table_get(const label_table *t, int class_id);
+
+// Returns the label of class_id, first giving it name when it has none. NULL
+// when class_id is out of range, name is empty or memory runs out.
+const label_entry *label_table_intern(label_table *t, int class_id, const char *name);
+
+// One DSMETA_BIN_LABELS record holding every label, see dsmeta-binary.h.
+void label_table_build_binary(const label_table *t, dsmeta_bin_writer *w);
+
+#endif
@@ -0,0 +1,115 @@
+// Copyright 2022, Kyota Tashiro, Mengheng Lee, and Latona Inc.
+// License MIT
+
+#include <time.h>
+#include "latency-histogram.h"
+
+#define SUB_BITS LATENCY_HISTOGRAM_SUB_BITS
+#define SUB_BUCKETS LATENCY_HISTOGRAM_SUB_BUCKETS
+
+static unsigned int bucket_index(uint64_t ns) {
+  unsigned int msb;
+
+  if (ns < SUB_BUCKETS)
+    return (unsigned int) ns;
+  msb = 63 - (unsigned int) __builtin_clzll(ns);
+  return (msb - SUB_BITS + 1) * SUB_BUCKETS +
+         (unsigned int) ((ns >> (msb - SUB_BITS)) & (SUB_BUCKETS - 1));
+}
+
+// Largest value that falls into the bucket, so percentiles err on the high
+// side.
+static uint64_t bucket_upper(unsigned int index) {
+  unsigned int msb;
+  uint64_t sub;
+
+  if (index < SUB_BUCKETS)
+    return index;
+  msb = index / SUB_BUCKETS + SUB_BITS - 1;
+  sub = SUB_BUCKETS + index % SUB_BUCKETS;
+  return ((sub + 1) << (msb - SUB_BITS)) - 1;
+}
+
+uint64_t latency_now_ns(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000000u + (uint64_t) ts.tv_nsec;
+}
+
+void latency_histogram_init(latency_histogram *h) {
+  unsigned int i;
+
+  for (i = 0; i < LATENCY_HISTOGRAM_BUCKETS; i++)
+    atomic_init(&h->buckets[i], 0);
+  atomic_init(&h->count, 0);
+  atomic_init(&h->sum_ns, 0);
+  atomic_init(&h->max_ns, 0);
+}
+
+void latency_histogram_record(latency_histogram *h, uint64_t ns) {
+  unsigned long long max = atomic_load_explicit(&h->max_ns, memory_order_relaxed);
+
+  atomic_fetch_add_explicit(&h->buckets[bucket_index(ns)], 1, memory_order_relaxed);
+  atomic_fetch_add_explicit(&h->sum_ns, ns, memory_order_relaxed);
+  while (ns > max &&
+         !atomic_compare_exchange_weak_explicit(&h->max_ns, &max, ns,
+                                                memory_order_relaxed,
+                                                memory_order_relaxed))
+    ;
+  atomic_fetch_add_explicit(&h->count, 1, memory_order_release);
+}
+
+uint64_t latency_histogram_record_since(latency_histogram *h, uint64_t start_ns) {
+  uint64_t elapsed = latency_now_ns() - start_ns;
+
+  latency_histogram_record(h, elapsed);
+  return elapsed;
+}
+
+void latency_histogram_summarize(latency_histogram *h, latency_summary *s) {
+  unsigned long long seen = 0;
+  unsigned long long total = 0;
+  unsigned long long p50, p90, p99;
+  int found50 = 0, found90 = 0;
+  unsigned int i;
+
+  s->p50_ns = s->p90_ns = s->p99_ns = 0;
+  s->max_ns = atomic_load_explicit(&h->max_ns, memory_order_relaxed);
+  for (i = 0; i < LATENCY_HISTOGRAM_BUCKETS; i++)
+    total += atomic_load_explicit(&h->buckets[i], memory_order_relaxed);
+  s->count = total;
+  s->sum_ns = atomic_load_explicit(&h->sum_ns, memory_order_relaxed);
+  s->mean_ns = total ? s->sum_ns / total : 0;
+  if (total == 0)
+    return;
+
+  // Ranks of the percentiles, rounded up so p99 of 100 samples is the 99th.
+  p50 = (total * 50 + 99) / 100;
+  p90 = (total * 90 + 99) / 100;
+  p99 = (total * 99 + 99) / 100;
+  for (i = 0; i < LATENCY_HISTOGRAM_BUCKETS; i++) {
+    unsigned long long n = atomic_load_explicit(&h->buckets[i], memory_order_relaxed);
+    uint64_t upper;
+
+    if (n == 0)
+      continue;
+    seen += n;
+    upper = bucket_upper(i);
+    if (upper > s->max_ns)
+      upper = s->max_ns;
+    // Flags rather than zero checks, as 0 ns is a valid percentile.
+    if (!found50 && seen >= p50) {
+      s->p50_ns = upper;
+      found50 = 1;
+    }
+    if (!found90 && seen >= p90) {
+      s->p90_ns = upper;
+      found90 = 1;
+    }
+    if (seen >= p99) {
+      s->p99_ns = upper;
+      break;
+    }
+  }
+}
@@ -0,0 +1,50 @@
+// Copyright 2022, Kyota Tashiro, Mengheng Lee, and Latona Inc.
+// License MIT
+#ifndef LATENCY_HISTOGRAM
+#define LATENCY_HISTOGRAM
+#include <stdatomic.h>
+#include <stdint.h>
+
+// Log-linear histogram of durations in nanoseconds, in the spirit of
+// HdrHistogram: every power of two is split into 16 buckets, so a reported
+// percentile is within 1/16 (6.25%) of the true value, from 1 ns up to the
+// full 64-bit range in fixed memory. Recording is a couple of relaxed atomic
+// adds, so one writer and any number of readers need no lock.
+
+#define LATENCY_HISTOGRAM_SUB_BITS 4
+#define LATENCY_HISTOGRAM_SUB_BUCKETS (1 << LATENCY_HISTOGRAM_SUB_BITS)
+#define LATENCY_HISTOGRAM_BUCKETS \
+  ((64 - LATENCY_HISTOGRAM_SUB_BITS + 1) * LATENCY_HISTOGRAM_SUB_BUCKETS)
+
+typedef struct latency_histogram {
+  atomic_ullong buckets[LATENCY_HISTOGRAM_BUCKETS];
+  atomic_ullong count;
+  atomic_ullong sum_ns;
+  atomic_ullong max_ns;
+} latency_histogram;
+
+typedef struct latency_summary {
+  unsigned long long count;
+  uint64_t sum_ns;
+  uint64_t mean_ns;
+  uint64_t p50_ns;
+  uint64_t p90_ns;
+  uint64_t p99_ns;
+  uint64_t max_ns;
+} latency_summary;
+
+// CLOCK_MONOTONIC in nanoseconds.
+uint64_t latency_now_ns(void);
+
+void latency_histogram_init(latency_histogram *h);
+
+void latency_histogram_record(latency_histogram *h, uint64_t ns);
+
+// Records the time elapsed since start_ns and returns it.
+uint64_t latency_histogram_record_since(latency_histogram *h, uint64_t start_ns);
+
+// Safe to call while another thread records; the summary is then a snapshot
+// that may miss the samples recorded meanwhile.
+void latency_histogram_summarize(latency_histogram *h, latency_summary *s);
+
+#endif
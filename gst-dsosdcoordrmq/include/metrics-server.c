@@ -0,0 +1,228 @@
+// Copyright 2022, Kyota Tashiro, Mengheng Lee, and Latona Inc.
+// License MIT
+
+#include <errno.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include "metrics-server.h"
+
+#define REQUEST_MAX 2048
+#define IO_TIMEOUT_MS 1000
+
+static void text_printf(metrics_text *t, const char *fmt, ...) {
+  va_list ap;
+  size_t room, cap;
+  char *buf;
+  int n;
+
+  if (t->error)
+    return;
+  for (;;) {
+    room = t->cap - t->len;
+    va_start(ap, fmt);
+    n = vsnprintf(t->buf ? t->buf + t->len : NULL, room, fmt, ap);
+    va_end(ap);
+    if (n < 0) {
+      t->error = 1;
+      return;
+    }
+    if ((size_t) n < room) {
+      t->len += n;
+      return;
+    }
+
+    cap = t->cap ? t->cap * 2 : 4096;
+    while (cap - t->len <= (size_t) n)
+      cap *= 2;
+    buf = realloc(t->buf, cap);
+    if (!buf) {
+      t->error = 1;
+      return;
+    }
+    t->buf = buf;
+    t->cap = cap;
+  }
+}
+
+void metrics_text_family(metrics_text *t, const char *name, const char *type,
+             const char *help) {
+  text_printf(t, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+void metrics_text_sample(metrics_text *t, const char *name, const char *labels,
+             double value) {
+  if (labels)
+    text_printf(t, "%s{%s} %.17g\n", name, labels, value);
+  else
+    text_printf(t, "%s %.17g\n", name, value);
+}
+
+static int write_all(int fd, const char *data, size_t len) {
+  while (len > 0) {
+    ssize_t n = send(fd, data, len, MSG_NOSIGNAL);
+
+    if (n < 0) {
+      if (errno == EINTR)
+        continue;
+      return -1;
+    }
+    data += n;
+    len -= (size_t) n;
+  }
+  return 0;
+}
+
+// Reads up to the end of the request headers; the body of a GET is empty.
+static ssize_t read_request(int fd, char *req, size_t cap) {
+  size_t len = 0;
+
+  while (len < cap - 1) {
+    ssize_t n = recv(fd, req + len, cap - 1 - len, 0);
+
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      break;
+    len += (size_t) n;
+    req[len] = '\0';
+    if (strstr(req, "\r\n\r\n") || strstr(req, "\n\n"))
+      break;
+  }
+  req[len] = '\0';
+  return (ssize_t) len;
+}
+
+static void serve(metrics_server *srv, int fd) {
+  char req[REQUEST_MAX];
+  char header[256];
+  const char *status = "200 OK";
+  int header_len;
+
+  if (read_request(fd, req, sizeof(req)) <= 0)
+    return;
+
+  srv->text.len = 0;
+  srv->text.error = 0;
+  if (strncmp(req, "GET /metrics ", 13) == 0 || strncmp(req, "GET / ", 6) == 0) {
+    srv->render(&srv->text, srv->user_data);
+    if (srv->text.error) {
+      status = "500 Internal Server Error";
+      srv->text.len = 0;
+    }
+  } else if (strncmp(req, "GET ", 4) == 0) {
+    status = "404 Not Found";
+  } else {
+    status = "405 Method Not Allowed";
+  }
+
+  header_len = snprintf(header, sizeof(header),
+                        "HTTP/1.0 %s\r\n"
+                        "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n"
+                        "Content-Length: %zu\r\n"
+                        "Connection: close\r\n\r\n",
+                        status, srv->text.len);
+  if (write_all(fd, header, header_len) == 0 && srv->text.len > 0)
+    write_all(fd, srv->text.buf, srv->text.len);
+}
+
+static void *server_loop(void *arg) {
+  metrics_server *srv = arg;
+  struct timeval timeout = {IO_TIMEOUT_MS / 1000, (IO_TIMEOUT_MS % 1000) * 1000};
+
+  for (;;) {
+    struct pollfd fds[2] = {
+      {.fd = srv->listen_fd, .events = POLLIN},
+      {.fd = srv->wake_fd[0], .events = POLLIN},
+    };
+    int fd;
+
+    if (poll(fds, 2, -1) < 0) {
+      if (errno == EINTR)
+        continue;
+      break;
+    }
+    if (fds[1].revents)
+      break;
+    if (!(fds[0].revents & POLLIN))
+      continue;
+
+    fd = accept(srv->listen_fd, NULL, NULL);
+    if (fd < 0)
+      continue;
+    // A stalled client must not hold up stop().
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+    serve(srv, fd);
+    close(fd);
+  }
+  return NULL;
+}
+
+int metrics_server_start(metrics_server *srv, int port, metrics_render_fn render,
+             void *user_data) {
+  struct sockaddr_in addr;
+  socklen_t addr_len = sizeof(addr);
+  int one = 1;
+
+  if (srv->started)
+    return 0;
+  srv->render = render;
+  srv->user_data = user_data;
+  memset(&srv->text, 0, sizeof(srv->text));
+
+  srv->listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (srv->listen_fd < 0)
+    return -1;
+  setsockopt(srv->listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  addr.sin_port = htons(port);
+  if (bind(srv->listen_fd, (struct sockaddr *) &addr, sizeof(addr)) < 0 ||
+      listen(srv->listen_fd, 8) < 0) {
+    printf("Error listening for metrics on port %d: %s\n", port, strerror(errno));
+    close(srv->listen_fd);
+    return -1;
+  }
+  if (getsockname(srv->listen_fd, (struct sockaddr *) &addr, &addr_len) < 0) {
+    close(srv->listen_fd);
+    return -1;
+  }
+  srv->port = ntohs(addr.sin_port);
+  if (pipe(srv->wake_fd) < 0) {
+    close(srv->listen_fd);
+    return -1;
+  }
+  if (pthread_create(&srv->thread, NULL, server_loop, srv) != 0) {
+    printf("Error starting metrics thread\n");
+    close(srv->wake_fd[0]);
+    close(srv->wake_fd[1]);
+    close(srv->listen_fd);
+    return -1;
+  }
+  srv->started = 1;
+  return 0;
+}
+
+void metrics_server_stop(metrics_server *srv) {
+  char wake = 0;
+
+  if (!srv->started)
+    return;
+  while (write(srv->wake_fd[1], &wake, 1) < 0 && errno == EINTR)
+    ;
+  pthread_join(srv->thread, NULL);
+  close(srv->wake_fd[0]);
+  close(srv->wake_fd[1]);
+  close(srv->listen_fd);
+  free(srv->text.buf);
+  memset(&srv->text, 0, sizeof(srv->text));
+  srv->started = 0;
+}
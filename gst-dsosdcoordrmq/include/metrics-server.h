@@ -0,0 +1,53 @@
+// Copyright 2022, Kyota Tashiro, Mengheng Lee, and Latona Inc.
+// License MIT
+#ifndef METRICS_SERVER
+#define METRICS_SERVER
+#include <pthread.h>
+#include <stdint.h>
+#include <stddef.h>
+
+// Prometheus text exposition format, built into a buffer that is kept across
+// scrapes.
+typedef struct metrics_text {
+  char *buf;
+  size_t len;
+  size_t cap;
+  int error;
+} metrics_text;
+
+// Writes the # HELP and # TYPE lines of a metric family; type is "counter",
+// "gauge" or "summary".
+void metrics_text_family(metrics_text *t, const char *name, const char *type,
+             const char *help);
+
+// One sample line. labels is the text between the braces, or NULL.
+void metrics_text_sample(metrics_text *t, const char *name, const char *labels,
+             double value);
+
+// Called on the server thread for every scrape. It must only read state that
+// is safe to access from another thread, such as atomics.
+typedef void (*metrics_render_fn)(metrics_text *t, void *user_data);
+
+// Minimal HTTP/1.0 server answering GET /metrics from its own thread, one
+// connection at a time.
+typedef struct metrics_server {
+  // Port listened on, the one the system picked when started with 0.
+  int port;
+  int listen_fd;
+  int wake_fd[2];
+  pthread_t thread;
+  int started;
+  metrics_render_fn render;
+  void *user_data;
+  metrics_text text;
+} metrics_server;
+
+// Listens on every interface, on a free port when port is 0. Returns -1 when
+// the port cannot be bound or the thread cannot be started.
+int metrics_server_start(metrics_server *srv, int port, metrics_render_fn render,
+             void *user_data);
+
+// Joins the server thread; no render call is in progress once this returns.
+void metrics_server_stop(metrics_server *srv);
+
+#endif
@@ -0,0 +1,115 @@
+// Copyright 2022, Kyota Tashiro, Mengheng Lee, and Latona Inc.
+// License MIT
+
+#include <stdlib.h>
+#include <string.h>
+#include "osd-batch.h"
+
+// Doubles *array once count has reached capacity. The capacity is left for
+// the caller to update, so parallel arrays can be grown one after the other.
+static int grow(void **array, unsigned int capacity, unsigned int count,
+             size_t size) {
+  unsigned int grown_capacity;
+  void *grown;
+
+  if (count < capacity)
+    return 0;
+  grown_capacity = capacity ? capacity * 2 : OSD_BATCH_INITIAL_CAPACITY;
+  grown = realloc(*array, (size_t) grown_capacity * size);
+  if (!grown)
+    return -1;
+  *array = grown;
+  return 0;
+}
+
+static int reserve(osd_batch *b, void **array, unsigned int *capacity,
+             unsigned int count, size_t size) {
+  if (count < *capacity)
+    return 0;
+  if (grow(array, *capacity, count, size) < 0) {
+    b->dropped++;
+    return -1;
+  }
+  *capacity = *capacity ? *capacity * 2 : OSD_BATCH_INITIAL_CAPACITY;
+  b->grows++;
+  return 0;
+}
+
+void osd_batch_init(osd_batch *b) {
+  memset(b, 0, sizeof(*b));
+}
+
+void osd_batch_free(osd_batch *b) {
+  free(b->rects);
+  free(b->mask_rects);
+  free(b->masks);
+  free(b->texts);
+  free(b->lines);
+  free(b->arrows);
+  free(b->circles);
+  osd_batch_init(b);
+}
+
+void osd_batch_reset(osd_batch *b) {
+  b->num_rects = 0;
+  b->num_masks = 0;
+  b->num_texts = 0;
+  b->num_lines = 0;
+  b->num_arrows = 0;
+  b->num_circles = 0;
+}
+
+NvOSD_RectParams *osd_batch_add_rect(osd_batch *b) {
+  if (reserve(b, (void **) &b->rects, &b->rects_capacity, b->num_rects,
+              sizeof(*b->rects)) < 0)
+    return NULL;
+  return &b->rects[b->num_rects++];
+}
+
+NvOSD_TextParams *osd_batch_add_text(osd_batch *b) {
+  if (reserve(b, (void **) &b->texts, &b->texts_capacity, b->num_texts,
+              sizeof(*b->texts)) < 0)
+    return NULL;
+  return &b->texts[b->num_texts++];
+}
+
+NvOSD_LineParams *osd_batch_add_line(osd_batch *b) {
+  if (reserve(b, (void **) &b->lines, &b->lines_capacity, b->num_lines,
+              sizeof(*b->lines)) < 0)
+    return NULL;
+  return &b->lines[b->num_lines++];
+}
+
+NvOSD_ArrowParams *osd_batch_add_arrow(osd_batch *b) {
+  if (reserve(b, (void **) &b->arrows, &b->arrows_capacity, b->num_arrows,
+              sizeof(*b->arrows)) < 0)
+    return NULL;
+  return &b->arrows[b->num_arrows++];
+}
+
+NvOSD_CircleParams *osd_batch_add_circle(osd_batch *b) {
+  if (reserve(b, (void **) &b->circles, &b->circles_capacity, b->num_circles,
+              sizeof(*b->circles)) < 0)
+    return NULL;
+  return &b->circles[b->num_circles++];
+}
+
+int osd_batch_add_mask(osd_batch *b, const NvOSD_RectParams *rect,
+             const NvOSD_MaskParams *mask) {
+  if (b->num_masks == b->masks_capacity) {
+    // Both arrays must have grown before the shared capacity changes.
+    if (grow((void **) &b->mask_rects, b->masks_capacity, b->num_masks,
+             sizeof(*b->mask_rects)) < 0 ||
+        grow((void **) &b->masks, b->masks_capacity, b->num_masks,
+             sizeof(*b->masks)) < 0) {
+      b->dropped++;
+      return -1;
+    }
+    b->masks_capacity = b->masks_capacity ? b->masks_capacity * 2
+                                          : OSD_BATCH_INITIAL_CAPACITY;
+    b->grows++;
+  }
+  b->mask_rects[b->num_masks] = *rect;
+  b->masks[b->num_masks++] = *mask;
+  return 0;
+}
@@ -0,0 +1,65 @@
+// Copyright 2022, Kyota Tashiro, Mengheng Lee, and Latona Inc.
+// License MIT
+#ifndef OSD_BATCH
+#define OSD_BATCH
+#include "nvll_osd_api.h"
+
+// Everything one surface gets drawn with, gathered per primitive type so each
+// type takes a single nvll_osd call however crowded the scene is. Only the
+// nvll_osd parameter structs are used; nothing here calls into the library.
+
+#define OSD_BATCH_INITIAL_CAPACITY 64
+
+// The arrays are kept across buffers and only grow, so once they have reached
+// the busiest buffer nothing is allocated.
+typedef struct osd_batch {
+  NvOSD_RectParams *rects;
+  unsigned int num_rects;
+  unsigned int rects_capacity;
+  // Parallel arrays: the box of each mask and the mask itself.
+  NvOSD_RectParams *mask_rects;
+  NvOSD_MaskParams *masks;
+  unsigned int num_masks;
+  unsigned int masks_capacity;
+  NvOSD_TextParams *texts;
+  unsigned int num_texts;
+  unsigned int texts_capacity;
+  NvOSD_LineParams *lines;
+  unsigned int num_lines;
+  unsigned int lines_capacity;
+  NvOSD_ArrowParams *arrows;
+  unsigned int num_arrows;
+  unsigned int arrows_capacity;
+  NvOSD_CircleParams *circles;
+  unsigned int num_circles;
+  unsigned int circles_capacity;
+  // Primitives that could not be added because an array could not grow.
+  unsigned long dropped;
+  // Number of times an array was grown.
+  unsigned long grows;
+} osd_batch;
+
+void osd_batch_init(osd_batch *b);
+
+void osd_batch_free(osd_batch *b);
+
+// Empties the batch, keeping the arrays.
+void osd_batch_reset(osd_batch *b);
+
+// Each returns the slot for the next primitive of its type, or NULL, counted
+// in dropped, when the array cannot grow.
+NvOSD_RectParams *osd_batch_add_rect(osd_batch *b);
+
+NvOSD_TextParams *osd_batch_add_text(osd_batch *b);
+
+NvOSD_LineParams *osd_batch_add_line(osd_batch *b);
+
+NvOSD_ArrowParams *osd_batch_add_arrow(osd_batch *b);
+
+NvOSD_CircleParams *osd_batch_add_circle(osd_batch *b);
+
+// Returns -1, counted in dropped, when the arrays cannot grow.
+int osd_batch_add_mask(osd_batch *b, const NvOSD_RectParams *rect,
+             const NvOSD_MaskParams *mask);
+
+#endif
@@ -0,0 +1,188 @@
+// Copyright 2022, Kyota Tashiro, Mengheng Lee, and Latona Inc.
+// License MIT
+
+#include <string.h>
+#include "latency-histogram.h"
+#include "osd-draw.h"
+
+void osd_draw_collect_frame(osd_batch *b, const NvDsFrameMeta *frame_meta,
+             const osd_draw_options *options, osd_draw_object_func object_func,
+             void *user_data) {
+  NvDsMetaList *l;
+  NvOSD_RectParams *rect;
+  NvOSD_TextParams *text;
+  NvOSD_LineParams *line;
+  NvOSD_ArrowParams *arrow;
+  NvOSD_CircleParams *circle;
+  unsigned int i;
+
+  for (l = frame_meta->obj_meta_list; l; l = l->next) {
+    const NvDsObjectMeta *object = l->data;
+
+    if (options->draw_bbox && (rect = osd_batch_add_rect(b))) {
+      *rect = object->rect_params;
+      if (object_func)
+        object_func(rect, object, user_data);
+    }
+    if (options->draw_mask && object->mask_params.data && object->mask_params.size > 0)
+      osd_batch_add_mask(b, &object->rect_params, &object->mask_params);
+    if (object->text_params.display_text && (text = osd_batch_add_text(b)))
+      *text = object->text_params;
+  }
+
+  for (l = frame_meta->display_meta_list; l; l = l->next) {
+    const NvDsDisplayMeta *display = l->data;
+
+    for (i = 0; i < display->num_rects; i++) {
+      if ((rect = osd_batch_add_rect(b)))
+        *rect = display->rect_params[i];
+    }
+    for (i = 0; i < display->num_labels; i++) {
+      if (display->text_params[i].display_text && (text = osd_batch_add_text(b)))
+        *text = display->text_params[i];
+    }
+    for (i = 0; i < display->num_lines; i++) {
+      if ((line = osd_batch_add_line(b)))
+        *line = display->line_params[i];
+    }
+    for (i = 0; i < display->num_arrows; i++) {
+      if ((arrow = osd_batch_add_arrow(b)))
+        *arrow = display->arrow_params[i];
+    }
+    for (i = 0; i < display->num_circles; i++) {
+      if ((circle = osd_batch_add_circle(b)))
+        *circle = display->circle_params[i];
+    }
+  }
+}
+
+// The one nvll_osd call of type for b.
+static int draw_nvll(const osd_batch *b, osd_draw_type type, void *context,
+             NvBufSurfaceParams *buf_ptr, NvOSD_Mode mode) {
+  switch (type) {
+    case OSD_DRAW_RECTANGLES: {
+      NvOSD_FrameRectParams params = {
+        .buf_ptr = buf_ptr, .mode = mode, .num_rects = (int) b->num_rects,
+        .rect_params_list = b->rects};
+
+      return nvll_osd_draw_rectangles(context, &params);
+    }
+    case OSD_DRAW_SEGMENT_MASKS: {
+      NvOSD_FrameSegmentMaskParams params = {
+        .buf_ptr = buf_ptr, .mode = mode, .num_segments = (int) b->num_masks,
+        .rect_params_list = b->mask_rects, .mask_params_list = b->masks};
+
+      return nvll_osd_draw_segment_masks(context, &params);
+    }
+    case OSD_DRAW_PUT_TEXT: {
+      NvOSD_FrameTextParams params = {
+        .buf_ptr = buf_ptr, .mode = mode, .num_strings = (int) b->num_texts,
+        .text_params_list = b->texts};
+
+      return nvll_osd_put_text(context, &params);
+    }
+    case OSD_DRAW_LINES: {
+      NvOSD_FrameLineParams params = {
+        .buf_ptr = buf_ptr, .mode = mode, .num_lines = (int) b->num_lines,
+        .line_params_list = b->lines};
+
+      return nvll_osd_draw_lines(context, &params);
+    }
+    case OSD_DRAW_ARROWS: {
+      NvOSD_FrameArrowParams params = {
+        .buf_ptr = buf_ptr, .mode = mode, .num_arrows = (int) b->num_arrows,
+        .arrow_params_list = b->arrows};
+
+      return nvll_osd_draw_arrows(context, &params);
+    }
+    case OSD_DRAW_CIRCLES: {
+      NvOSD_FrameCircleParams params = {
+        .buf_ptr = buf_ptr, .mode = mode, .num_circles = (int) b->num_circles,
+        .circle_params_list = b->circles};
+
+      return nvll_osd_draw_circles(context, &params);
+    }
+    default:
+      return -1;
+  }
+}
+
+static int map_surface(NvBufSurface *surface, unsigned int index, cpu_render_target *target) {
+  NvBufSurfaceParams *buf_ptr = &surface->surfaceList[index];
+
+  if (NvBufSurfaceMap(surface, (int) index, 0, NVBUF_MAP_READ_WRITE) != 0)
+    return -1;
+  NvBufSurfaceSyncForCpu(surface, (int) index, 0);
+  target->pixels = buf_ptr->mappedAddr.addr[0];
+  target->width = buf_ptr->width;
+  target->height = buf_ptr->height;
+  target->pitch = buf_ptr->planeParams.pitch[0];
+  return 0;
+}
+
+static void unmap_surface(NvBufSurface *surface, unsigned int index) {
+  NvBufSurfaceSyncForDevice(surface, (int) index, 0);
+  NvBufSurfaceUnMap(surface, (int) index, 0);
+}
+
+void osd_draw_surface(const osd_batch *b, NvBufSurface *surface, unsigned int index,
+             void *context, NvOSD_Mode mode, const osd_draw_options *options,
+             osd_draw_cpu_func cpu_draw, void *user_data, osd_draw_result *result) {
+  const unsigned int counts[OSD_DRAW_NUM_TYPES] = {
+    b->num_rects, b->num_masks, b->num_texts, b->num_lines, b->num_arrows, b->num_circles};
+  int draw[OSD_DRAW_NUM_TYPES];
+  int cpu[OSD_DRAW_NUM_TYPES] = {0};
+  cpu_render_target target;
+  int mapped = 0;
+  unsigned int type;
+
+  memset(result, 0, sizeof(*result));
+  result->failed = OSD_DRAW_NUM_TYPES;
+  for (type = 0; type < OSD_DRAW_NUM_TYPES; type++)
+    draw[type] = counts[type] != 0;
+  draw[OSD_DRAW_RECTANGLES] &= options->draw_bbox != 0;
+  draw[OSD_DRAW_SEGMENT_MASKS] &= options->draw_mask != 0;
+  draw[OSD_DRAW_PUT_TEXT] = (draw[OSD_DRAW_PUT_TEXT] || options->show_clock) &&
+      options->draw_text;
+
+  if (options->cpu_render && cpu_draw) {
+    cpu[OSD_DRAW_RECTANGLES] = draw[OSD_DRAW_RECTANGLES];
+    cpu[OSD_DRAW_SEGMENT_MASKS] = draw[OSD_DRAW_SEGMENT_MASKS];
+    cpu[OSD_DRAW_PUT_TEXT] = draw[OSD_DRAW_PUT_TEXT] && options->text_cache;
+    cpu[OSD_DRAW_LINES] = draw[OSD_DRAW_LINES];
+  }
+
+  for (type = 0; type < OSD_DRAW_NUM_TYPES; type++) {
+    uint64_t start;
+    int ret;
+
+    if (!draw[type])
+      continue;
+    // The surface is mapped for a run of types cpu_draw takes and unmapped
+    // before nvll_osd draws on it. Without a mapping, this type and every
+    // later one go to nvll_osd.
+    if (cpu[type] && !mapped) {
+      if (map_surface(surface, index, &target) == 0)
+        mapped = 1;
+      else
+        memset(cpu, 0, sizeof(cpu));
+    }
+    if (mapped && !cpu[type]) {
+      unmap_surface(surface, index);
+      mapped = 0;
+    }
+    start = latency_now_ns();
+    ret = cpu[type] ? cpu_draw((osd_draw_type) type, b, &target, user_data)
+                    : draw_nvll(b, (osd_draw_type) type, context,
+                                &surface->surfaceList[index], mode);
+    if (ret == -1) {
+      result->failed = (osd_draw_type) type;
+      break;
+    }
+    result->drawn[type] = 1;
+    result->draw_ns[type] = latency_now_ns() - start;
+    result->primitives[type] = counts[type];
+  }
+  if (mapped)
+    unmap_surface(surface, index);
+}
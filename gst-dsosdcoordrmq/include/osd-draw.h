@@ -0,0 +1,77 @@
+// Copyright 2022, Kyota Tashiro, Mengheng Lee, and Latona Inc.
+// License MIT
+#ifndef OSD_DRAW
+#define OSD_DRAW
+#include <stdint.h>
+#include "nvdsmeta.h"
+#include "nvbufsurface.h"
+#include "nvll_osd_api.h"
+#include "cpu-render.h"
+#include "osd-batch.h"
+
+// Gathers what the frame meta asks to be drawn into the osd_batch of its
+// surface, then draws the batch with at most one call per primitive type.
+// Only the meta structs, nvll_osd and NvBufSurface are used, so this links
+// without GStreamer and the calls a buffer takes can be counted.
+
+// In the order a surface is drawn in.
+typedef enum {
+  OSD_DRAW_RECTANGLES,
+  OSD_DRAW_SEGMENT_MASKS,
+  OSD_DRAW_PUT_TEXT,
+  OSD_DRAW_LINES,
+  OSD_DRAW_ARROWS,
+  OSD_DRAW_CIRCLES,
+  OSD_DRAW_NUM_TYPES,
+} osd_draw_type;
+
+typedef struct osd_draw_options {
+  int draw_bbox;
+  int draw_mask;
+  int draw_text;
+  // Text is drawn even without any string, nvll_osd or cpu_draw adding the
+  // clock.
+  int show_clock;
+  // Boxes, masks and lines are drawn by cpu_draw on the mapped surface,
+  // falling back to nvll_osd when it cannot be mapped.
+  int cpu_render;
+  // So is text, when cpu_render is set too.
+  int text_cache;
+} osd_draw_options;
+
+// Called on the box of every object added, e.g. to apply the colors of
+// hardware blending.
+typedef void (*osd_draw_object_func)(NvOSD_RectParams *rect, const NvDsObjectMeta *object,
+             void *user_data);
+
+// Draws the primitives of type in b on target instead of nvll_osd. Returns 0,
+// or -1 like a failed nvll_osd call.
+typedef int (*osd_draw_cpu_func)(osd_draw_type type, const osd_batch *b,
+             const cpu_render_target *target, void *user_data);
+
+// How each call of one surface went.
+typedef struct osd_draw_result {
+  int drawn[OSD_DRAW_NUM_TYPES];
+  // Duration in ns of each call that was issued.
+  uint64_t draw_ns[OSD_DRAW_NUM_TYPES];
+  unsigned int primitives[OSD_DRAW_NUM_TYPES];
+  // Type whose call failed, OSD_DRAW_NUM_TYPES when none did. Nothing is
+  // drawn after it.
+  osd_draw_type failed;
+} osd_draw_result;
+
+// Adds the object and display meta of frame_meta to b. Primitives that are
+// not drawn under options are left out; object_func may be NULL.
+void osd_draw_collect_frame(osd_batch *b, const NvDsFrameMeta *frame_meta,
+             const osd_draw_options *options, osd_draw_object_func object_func,
+             void *user_data);
+
+// Draws b on surfaceList[index] of surface with context, skipping the types
+// it has nothing of. Boxes, masks, text and lines go through cpu_draw as
+// options ask; the surface is mapped for each run of them and unmapped
+// before nvll_osd draws on it again.
+void osd_draw_surface(const osd_batch *b, NvBufSurface *surface, unsigned int index,
+             void *context, NvOSD_Mode mode, const osd_draw_options *options,
+             osd_draw_cpu_func cpu_draw, void *user_data, osd_draw_result *result);
+
+#endif
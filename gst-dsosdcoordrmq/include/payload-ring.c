@@ -0,0 +1,233 @@
+// Copyright 2022, Kyota Tashiro, Mengheng Lee, and Latona Inc.
+// License MIT
+
+#include <errno.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "payload-ring.h"
+
+static void deadline_after(struct timespec *ts, int timeout_ms) {
+  clock_gettime(CLOCK_MONOTONIC, ts);
+  ts->tv_sec += timeout_ms / 1000;
+  ts->tv_nsec += (long) (timeout_ms % 1000) * 1000000L;
+  if (ts->tv_nsec >= 1000000000L) {
+    ts->tv_sec++;
+    ts->tv_nsec -= 1000000000L;
+  }
+}
+
+static void wake(payload_ring *ring, atomic_int *waiting, pthread_cond_t *cond) {
+  atomic_thread_fence(memory_order_seq_cst);
+  if (!atomic_load(waiting))
+    return;
+  pthread_mutex_lock(&ring->lock);
+  pthread_cond_broadcast(cond);
+  pthread_mutex_unlock(&ring->lock);
+}
+
+static int is_empty(payload_ring *ring) {
+  return atomic_load(&ring->head) == atomic_load(&ring->tail);
+}
+
+int payload_ring_init(payload_ring *ring, size_t size, payload_ring_policy policy) {
+  pthread_condattr_t attr;
+  size_t i;
+
+  if (size == 0)
+    return -1;
+  ring->slots = calloc(size, sizeof(payload_slot));
+  if (!ring->slots)
+    return -1;
+  for (i = 0; i < size; i++)
+    atomic_init(&ring->slots[i].seq, i);
+  ring->size = size;
+  ring->policy = policy;
+  atomic_init(&ring->head, 0);
+  atomic_init(&ring->tail, 0);
+  atomic_init(&ring->closed, 0);
+  atomic_init(&ring->interrupted, 0);
+  atomic_init(&ring->consumer_waiting, 0);
+  atomic_init(&ring->producer_waiting, 0);
+  atomic_init(&ring->dropped, 0);
+  atomic_init(&ring->grows, 0);
+  ring->on_discard = NULL;
+  ring->on_discard_arg = NULL;
+
+  pthread_condattr_init(&attr);
+  pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+  pthread_mutex_init(&ring->lock, NULL);
+  pthread_cond_init(&ring->not_empty, &attr);
+  pthread_cond_init(&ring->not_full, &attr);
+  pthread_condattr_destroy(&attr);
+  return 0;
+}
+
+void payload_ring_destroy(payload_ring *ring) {
+  size_t i;
+
+  if (!ring->slots)
+    return;
+  for (i = 0; i < ring->size; i++)
+    free(ring->slots[i].data);
+  free(ring->slots);
+  ring->slots = NULL;
+  pthread_cond_destroy(&ring->not_full);
+  pthread_cond_destroy(&ring->not_empty);
+  pthread_mutex_destroy(&ring->lock);
+}
+
+// Retires the oldest payload on behalf of the producer, but only when it sits
+// in the slot the producer is waiting for. If the consumer has already claimed
+// that slot it is mid-swap and will release it shortly.
+static int discard_oldest(payload_ring *ring, size_t pos) {
+  size_t oldest = pos - ring->size;
+  payload_slot *slot = &ring->slots[oldest % ring->size];
+
+  if (atomic_load_explicit(&slot->seq, memory_order_acquire) != oldest + 1)
+    return 0;
+  if (!atomic_compare_exchange_strong_explicit(&ring->tail, &oldest, oldest + 1,
+          memory_order_acq_rel, memory_order_relaxed))
+    return 0;
+  // The slot is the producer's until it is handed back below.
+  if (ring->on_discard)
+    ring->on_discard(ring->on_discard_arg, slot->source_id);
+  atomic_store_explicit(&slot->seq, pos, memory_order_release);
+  return 1;
+}
+
+static void wait_not_full(payload_ring *ring, payload_slot *slot, size_t pos) {
+  struct timespec deadline;
+
+  pthread_mutex_lock(&ring->lock);
+  atomic_store(&ring->producer_waiting, 1);
+  while (atomic_load(&slot->seq) != pos && !atomic_load(&ring->closed)) {
+    deadline_after(&deadline, 100);
+    pthread_cond_timedwait(&ring->not_full, &ring->lock, &deadline);
+  }
+  atomic_store(&ring->producer_waiting, 0);
+  pthread_mutex_unlock(&ring->lock);
+}
+
+int payload_ring_push(payload_ring *ring, uint32_t source_id, const char *key,
+             const char *data, size_t len) {
+  size_t key_len = key ? strnlen(key, PAYLOAD_RING_MAX_KEY) : 0;
+  size_t pos = atomic_load_explicit(&ring->head, memory_order_relaxed);
+  payload_slot *slot = &ring->slots[pos % ring->size];
+
+  while (atomic_load_explicit(&slot->seq, memory_order_acquire) != pos) {
+    if (atomic_load(&ring->closed))
+      return -1;
+    switch (ring->policy) {
+      case PAYLOAD_RING_DROP_NEWEST:
+        atomic_fetch_add(&ring->dropped, 1);
+        return -1;
+      case PAYLOAD_RING_DROP_OLDEST:
+        if (discard_oldest(ring, pos))
+          atomic_fetch_add(&ring->dropped, 1);
+        else
+          sched_yield();
+        break;
+      case PAYLOAD_RING_BLOCK:
+        wait_not_full(ring, slot, pos);
+        break;
+    }
+  }
+
+  if (slot->cap < len + 1) {
+    char *grown = realloc(slot->data, len + 1);
+    if (!grown) {
+      atomic_fetch_add(&ring->dropped, 1);
+      return -1;
+    }
+    slot->data = grown;
+    slot->cap = len + 1;
+    atomic_fetch_add(&ring->grows, 1);
+  }
+  memcpy(slot->data, data, len);
+  slot->data[len] = '\0';
+  slot->len = len;
+  slot->source_id = source_id;
+  if (key_len)
+    memcpy(slot->key, key, key_len);
+  slot->key[key_len] = '\0';
+
+  atomic_store_explicit(&slot->seq, pos + 1, memory_order_release);
+  atomic_store(&ring->head, pos + 1);
+  wake(ring, &ring->consumer_waiting, &ring->not_empty);
+  return 0;
+}
+
+int payload_ring_pop(payload_ring *ring, char *key, char **buf, size_t *len, size_t *cap) {
+  for (;;) {
+    size_t pos = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    payload_slot *slot = &ring->slots[pos % ring->size];
+    size_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+    char *data;
+    size_t data_cap;
+
+    if (seq < pos + 1)
+      return 0;
+    if (seq > pos + 1)
+      continue;  // the producer retired this one under us
+    if (!atomic_compare_exchange_weak_explicit(&ring->tail, &pos, pos + 1,
+            memory_order_acq_rel, memory_order_relaxed))
+      continue;
+
+    data = slot->data;
+    data_cap = slot->cap;
+    slot->data = *buf;
+    slot->cap = *cap;
+    *buf = data;
+    *cap = data_cap;
+    *len = slot->len;
+    strcpy(key, slot->key);
+
+    atomic_store_explicit(&slot->seq, pos + ring->size, memory_order_release);
+    wake(ring, &ring->producer_waiting, &ring->not_full);
+    return 1;
+  }
+}
+
+int payload_ring_wait(payload_ring *ring, int timeout_ms) {
+  struct timespec deadline;
+
+  if (!is_empty(ring))
+    return 1;
+
+  deadline_after(&deadline, timeout_ms);
+  pthread_mutex_lock(&ring->lock);
+  atomic_store(&ring->consumer_waiting, 1);
+  while (is_empty(ring) && !atomic_load(&ring->closed) &&
+      !atomic_load(&ring->interrupted)) {
+    if (pthread_cond_timedwait(&ring->not_empty, &ring->lock, &deadline) == ETIMEDOUT)
+      break;
+  }
+  atomic_store(&ring->interrupted, 0);
+  atomic_store(&ring->consumer_waiting, 0);
+  pthread_mutex_unlock(&ring->lock);
+  return !is_empty(ring);
+}
+
+void payload_ring_interrupt(payload_ring *ring) {
+  atomic_store(&ring->interrupted, 1);
+  pthread_mutex_lock(&ring->lock);
+  pthread_cond_broadcast(&ring->not_empty);
+  pthread_mutex_unlock(&ring->lock);
+}
+
+void payload_ring_close(payload_ring *ring) {
+  atomic_store(&ring->closed, 1);
+  pthread_mutex_lock(&ring->lock);
+  pthread_cond_broadcast(&ring->not_empty);
+  pthread_cond_broadcast(&ring->not_full);
+  pthread_mutex_unlock(&ring->lock);
+}
+
+size_t payload_ring_depth(payload_ring *ring) {
+  size_t tail = atomic_load(&ring->tail);
+  size_t head = atomic_load(&ring->head);
+
+  return head > tail ? head - tail : 0;
+}
@@ -0,0 +1,84 @@
+// Copyright 2022, Kyota Tashiro, Mengheng Lee, and Latona Inc.
+// License MIT
+#ifndef PAYLOAD_RING
+#define PAYLOAD_RING
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// What the producer does when every slot is occupied.
+typedef enum {
+  PAYLOAD_RING_DROP_OLDEST,
+  PAYLOAD_RING_DROP_NEWEST,
+  PAYLOAD_RING_BLOCK,
+} payload_ring_policy;
+
+// Longest routing key a payload can carry; the AMQP short string limit.
+#define PAYLOAD_RING_MAX_KEY 255
+
+// A slot owns its buffer. Buffers are swapped with the consumer on pop, so
+// once every buffer has grown to the working payload size nothing allocates.
+typedef struct payload_slot {
+  atomic_size_t seq;
+  char *data;
+  size_t len;
+  size_t cap;
+  // Routing key of the payload, fixed size so pushing it never allocates.
+  char key[PAYLOAD_RING_MAX_KEY + 1];
+  uint32_t source_id;
+} payload_slot;
+
+// Bounded single-producer / single-consumer ring of serialized payloads.
+// The data path is lock-free; the mutex is only taken to sleep and wake.
+typedef struct payload_ring {
+  payload_slot *slots;
+  size_t size;
+  payload_ring_policy policy;
+  atomic_size_t head;
+  atomic_size_t tail;
+  atomic_int closed;
+  atomic_int interrupted;
+  atomic_int consumer_waiting;
+  atomic_int producer_waiting;
+  atomic_ulong dropped;
+  // Slot buffers grown by push, i.e. allocations on the producer's thread.
+  atomic_ulong grows;
+  // Called on the producer's thread with the source of every payload that
+  // drop-oldest discards, so it can be told apart from the ones that went
+  // out. May be NULL.
+  void (*on_discard)(void *arg, uint32_t source_id);
+  void *on_discard_arg;
+  pthread_mutex_t lock;
+  pthread_cond_t not_empty;
+  pthread_cond_t not_full;
+} payload_ring;
+
+int payload_ring_init(payload_ring *ring, size_t size, payload_ring_policy policy);
+
+void payload_ring_destroy(payload_ring *ring);
+
+// Copies the payload and its routing key (NULL for none, truncated past
+// PAYLOAD_RING_MAX_KEY) into the next slot. Returns 0 when queued, -1 when
+// the payload was dropped (ring full with drop-newest, or ring closed).
+int payload_ring_push(payload_ring *ring, uint32_t source_id, const char *key,
+             const char *data, size_t len);
+
+// Moves the oldest payload into *buf, handing the previous *buf back to the
+// ring, and copies its routing key into key (PAYLOAD_RING_MAX_KEY + 1 bytes).
+// Returns 1 when a payload was taken, 0 when the ring is empty.
+int payload_ring_pop(payload_ring *ring, char *key, char **buf, size_t *len, size_t *cap);
+
+// Sleeps until a payload is available, the ring is closed or interrupted, or
+// timeout_ms elapses. Returns 1 when the ring is not empty.
+int payload_ring_wait(payload_ring *ring, int timeout_ms);
+
+// Makes a pending or the next payload_ring_wait return early.
+void payload_ring_interrupt(payload_ring *ring);
+
+// Wakes both sides; pushes fail from now on, pending payloads stay poppable.
+void payload_ring_close(payload_ring *ring);
+
+size_t payload_ring_depth(payload_ring *ring);
+
+#endif
@@ -0,0 +1,116 @@
+// Copyright 2022, Kyota Tashiro, Mengheng Lee, and Latona Inc.
+// License MIT
+
+#include <stdlib.h>
+#include "publish-throttle.h"
+
+static publish_throttle_source *find_source(publish_throttle *t, uint32_t source_id) {
+  publish_throttle_source *src;
+  size_t i;
+
+  for (i = 0; i < t->num_sources; i++) {
+    if (t->sources[i].source_id == source_id)
+      return &t->sources[i];
+  }
+  if (t->num_sources == t->capacity) {
+    size_t capacity = t->capacity ? t->capacity * 2 : 16;
+    publish_throttle_source *grown = realloc(t->sources, capacity * sizeof(*grown));
+
+    if (!grown)
+      return NULL;
+    t->sources = grown;
+    t->capacity = capacity;
+  }
+  src = &t->sources[t->num_sources++];
+  src->source_id = source_id;
+  src->frames = 0;
+  src->next_ns = 0;
+  return src;
+}
+
+void publish_throttle_init(publish_throttle *t) {
+  t->sources = NULL;
+  t->num_sources = 0;
+  t->capacity = 0;
+  atomic_init(&t->factor, 1);
+  atomic_init(&t->skipped_interval, 0);
+  atomic_init(&t->skipped_rate, 0);
+  atomic_init(&t->skipped_backpressure, 0);
+  publish_throttle_configure(t, 1, 0, 0, 0);
+}
+
+void publish_throttle_free(publish_throttle *t) {
+  free(t->sources);
+  t->sources = NULL;
+  t->num_sources = 0;
+  t->capacity = 0;
+}
+
+void publish_throttle_configure(publish_throttle *t, unsigned int interval,
+             double max_rate, int adaptive, size_t queue_depth) {
+  t->interval = interval ? interval : 1;
+  t->max_rate = max_rate;
+  // Without a queue both watermarks are 0, which would read as always full.
+  t->adaptive = adaptive && queue_depth > 0;
+  t->high_water = queue_depth - queue_depth / 4;
+  t->low_water = queue_depth / 4;
+  t->adjust_after_ns = 0;
+  t->num_sources = 0;
+  atomic_store(&t->factor, 1);
+}
+
+void publish_throttle_update(publish_throttle *t, size_t depth, uint64_t now_ns) {
+  unsigned int factor;
+
+  if (!t->adaptive)
+    return;
+  factor = atomic_load_explicit(&t->factor, memory_order_relaxed);
+  if ((depth < t->high_water || factor == PUBLISH_THROTTLE_MAX_FACTOR) &&
+      (depth > t->low_water || factor == 1)) {
+    t->adjust_after_ns = 0;
+    return;
+  }
+  // Past a watermark: change the factor once it has stayed there a while,
+  // then wait as long again before the next step.
+  if (t->adjust_after_ns == 0) {
+    t->adjust_after_ns = now_ns + PUBLISH_THROTTLE_ADJUST_NS;
+    return;
+  }
+  if (now_ns < t->adjust_after_ns)
+    return;
+  factor = depth >= t->high_water ? factor * 2 : factor / 2;
+  atomic_store_explicit(&t->factor, factor, memory_order_relaxed);
+  t->adjust_after_ns = now_ns + PUBLISH_THROTTLE_ADJUST_NS;
+}
+
+int publish_throttle_admit(publish_throttle *t, uint32_t source_id, uint64_t now_ns) {
+  publish_throttle_source *src = find_source(t, source_id);
+  unsigned int factor = atomic_load_explicit(&t->factor, memory_order_relaxed);
+  unsigned long long frame;
+  uint64_t period;
+
+  // Without room to track the source, publishing everything is the safe side.
+  if (!src)
+    return 1;
+  frame = src->frames++;
+  if (frame % t->interval != 0) {
+    atomic_fetch_add_explicit(&t->skipped_interval, 1, memory_order_relaxed);
+    return 0;
+  }
+  if (frame % ((unsigned long long) t->interval * factor) != 0) {
+    atomic_fetch_add_explicit(&t->skipped_backpressure, 1, memory_order_relaxed);
+    return 0;
+  }
+  if (t->max_rate > 0) {
+    if (now_ns < src->next_ns) {
+      atomic_fetch_add_explicit(&t->skipped_rate, 1, memory_order_relaxed);
+      return 0;
+    }
+    // Keep to the schedule rather than to the last frame, so arrival jitter
+    // does not push the rate below max_rate.
+    period = (uint64_t) (1e9 / t->max_rate);
+    src->next_ns = now_ns - src->next_ns < period ? src->next_ns + period
+                                                  : now_ns + period;
+  }
+  return 1;
+}
@@ -0,0 +1,60 @@
+// Copyright 2022, Kyota Tashiro, Mengheng Lee, and Latona Inc.
+// License MIT
+#ifndef PUBLISH_THROTTLE
+#define PUBLISH_THROTTLE
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Decides which source frames get published. Three limits apply, per source:
+//   - every interval-th frame only,
+//   - at most max_rate frames per second,
+//   - when adaptive, interval is multiplied by a factor that doubles while
+//     the publish queue stays above high water and halves again once it has
+//     drained below low water.
+// Only the metadata is thinned out; buffers always go downstream.
+
+#define PUBLISH_THROTTLE_MAX_FACTOR 16
+// Time the queue has to stay past a watermark before the factor changes.
+#define PUBLISH_THROTTLE_ADJUST_NS 500000000ull
+
+typedef struct publish_throttle_source {
+  uint32_t source_id;
+  unsigned long long frames;
+  uint64_t next_ns;
+} publish_throttle_source;
+
+typedef struct publish_throttle {
+  unsigned int interval;
+  double max_rate;
+  int adaptive;
+  size_t high_water;
+  size_t low_water;
+  uint64_t adjust_after_ns;
+  publish_throttle_source *sources;
+  size_t num_sources;
+  size_t capacity;
+  // Read by the metrics thread.
+  atomic_uint factor;
+  atomic_ulong skipped_interval;
+  atomic_ulong skipped_rate;
+  atomic_ulong skipped_backpressure;
+} publish_throttle;
+
+void publish_throttle_init(publish_throttle *t);
+
+void publish_throttle_free(publish_throttle *t);
+
+// Applies new limits and forgets every source. queue_depth is the capacity
+// of the publish queue the watermarks are derived from; 0 turns adaptive off.
+void publish_throttle_configure(publish_throttle *t, unsigned int interval,
+             double max_rate, int adaptive, size_t queue_depth);
+
+// Adapts the factor to the current depth of the publish queue; call once per
+// buffer.
+void publish_throttle_update(publish_throttle *t, size_t depth, uint64_t now_ns);
+
+// Returns 1 when the frame should be published, 0 when it is skipped.
+int publish_throttle_admit(publish_throttle *t, uint32_t source_id, uint64_t now_ns);
+
+#endif
@@ -0,0 +1,179 @@
+// Copyright 2022, Kyota Tashiro, Mengheng Lee, and Latona Inc.
+// License MIT
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <time.h>
+#include "publisher-pool.h"
+
+static long long now_ms(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (long long) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+typedef struct shard_start {
+  rabbitmq_publisher *shard;
+  const rabbitmq_publisher_config *config;
+  pthread_t thread;
+  int threaded;
+  int ret;
+} shard_start;
+
+static void *start_shard(void *arg) {
+  shard_start *s = arg;
+
+  s->ret = rabbitmq_publisher_start(s->shard, s->config);
+  return NULL;
+}
+
+int publisher_pool_start(publisher_pool *pool, size_t num_shards,
+             const rabbitmq_publisher_config *config) {
+  shard_start starts[PUBLISHER_POOL_MAX_SHARDS];
+  rabbitmq_publisher *shards;
+  int ret = 0;
+  size_t i;
+
+  if (pool->num_shards)
+    return 0;
+  if (num_shards == 0 || num_shards > PUBLISHER_POOL_MAX_SHARDS)
+    return -1;
+  shards = calloc(num_shards, sizeof(*shards));
+  if (!shards)
+    return -1;
+  // Each shard pays for its first connection attempt when it starts, up to
+  // the connect timeout against an unreachable broker, so start them all at
+  // once rather than one after the other. A shard whose helper thread cannot
+  // be created starts on this thread instead.
+  for (i = 0; i < num_shards; i++) {
+    starts[i] = (shard_start) { .shard = &shards[i], .config = config };
+    starts[i].threaded = i > 0 &&
+        pthread_create(&starts[i].thread, NULL, start_shard, &starts[i]) == 0;
+  }
+  for (i = 0; i < num_shards; i++) {
+    if (!starts[i].threaded)
+      start_shard(&starts[i]);
+  }
+  for (i = 0; i < num_shards; i++) {
+    if (starts[i].threaded)
+      pthread_join(starts[i].thread, NULL);
+    if (starts[i].ret < 0)
+      ret = -1;
+  }
+  if (ret < 0) {
+    for (i = 0; i < num_shards; i++)
+      rabbitmq_publisher_stop(&shards[i]);
+    free(shards);
+    return -1;
+  }
+  pool->shards = shards;
+  pool->num_shards = num_shards;
+  return 0;
+}
+
+int publisher_pool_enqueue(publisher_pool *pool, uint32_t source_id,
+             const char *routing_key, const char *payload, size_t len) {
+  if (!pool->num_shards)
+    return -1;
+  return rabbitmq_publisher_enqueue(&pool->shards[source_id % pool->num_shards],
+                                    source_id, routing_key, payload, len);
+}
+
+int publisher_pool_take_dropped(publisher_pool *pool, uint32_t source_id) {
+  if (!pool->num_shards)
+    return 0;
+  return rabbitmq_publisher_take_dropped(&pool->shards[source_id % pool->num_shards],
+                                         source_id);
+}
+
+int publisher_pool_set_preamble(publisher_pool *pool, const char *routing_key,
+             const void *data, size_t len) {
+  int ret = 0;
+  size_t i;
+
+  for (i = 0; i < pool->num_shards; i++) {
+    if (rabbitmq_publisher_set_preamble(&pool->shards[i], routing_key, data, len) < 0)
+      ret = -1;
+  }
+  return ret;
+}
+
+int publisher_pool_flush(publisher_pool *pool, int timeout_ms) {
+  long long deadline = now_ms() + timeout_ms;
+  long long left;
+  int ret = 0;
+  size_t i;
+
+  // The shards drain concurrently, so by the time the first one has caught
+  // up the others usually have too.
+  for (i = 0; i < pool->num_shards; i++) {
+    left = deadline - now_ms();
+    if (rabbitmq_publisher_flush(&pool->shards[i], left > 0 ? (int) left : 0) < 0)
+      ret = -1;
+  }
+  return ret;
+}
+
+void publisher_pool_get_stats(publisher_pool *pool, rabbitmq_publisher_stats *stats) {
+  rabbitmq_publisher_stats shard;
+  size_t i;
+
+  *stats = (rabbitmq_publisher_stats) {0};
+  for (i = 0; i < pool->num_shards; i++) {
+    rabbitmq_publisher_get_stats(&pool->shards[i], &shard);
+    stats->published += shard.published;
+    stats->messages += shard.messages;
+    stats->bytes += shard.bytes;
+    stats->failed += shard.failed;
+    stats->dropped += shard.dropped;
+    stats->connects += shard.connects;
+    stats->disconnects += shard.disconnects;
+    stats->confirmed += shard.confirmed;
+    stats->retried += shard.retried;
+    stats->inflight += shard.inflight;
+    stats->queue_depth += shard.queue_depth;
+    stats->enqueue_allocations += shard.enqueue_allocations;
+  }
+}
+
+double publisher_pool_round_trips_per_message(publisher_pool *pool) {
+  unsigned long messages = 0;
+  unsigned long round_trips = 0;
+  size_t i;
+
+  for (i = 0; i < pool->num_shards; i++) {
+    messages += atomic_load(&pool->shards[i].messages);
+    round_trips += atomic_load(&pool->shards[i].round_trips);
+  }
+  if (messages == 0)
+    return 0.0;
+  return (double) round_trips / messages;
+}
+
+size_t publisher_pool_max_queue_depth(publisher_pool *pool) {
+  size_t depth;
+  size_t max = 0;
+  size_t i;
+
+  for (i = 0; i < pool->num_shards; i++) {
+    depth = rabbitmq_publisher_queue_depth(&pool->shards[i]);
+    if (depth > max)
+      max = depth;
+  }
+  return max;
+}
+
+void publisher_pool_stop(publisher_pool *pool) {
+  rabbitmq_publisher *shards = pool->shards;
+  size_t num_shards = pool->num_shards;
+  size_t i;
+
+  if (!num_shards)
+    return;
+  pool->num_shards = 0;
+  pool->shards = NULL;
+  for (i = 0; i < num_shards; i++)
+    rabbitmq_publisher_stop(&shards[i]);
+  free(shards);
+}
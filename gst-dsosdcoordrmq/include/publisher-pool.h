@@ -0,0 +1,53 @@
+// Copyright 2022, Kyota Tashiro, Mengheng Lee, and Latona Inc.
+// License MIT
+#ifndef PUBLISHER_POOL
+#define PUBLISHER_POOL
+#include <stdint.h>
+#include "rabbitmq-publisher.h"
+
+#define PUBLISHER_POOL_MAX_SHARDS 64
+
+// Several publishers, each with its own connection, ring and thread. A
+// payload goes to the shard picked by its source id, so the frames of one
+// camera are always published in order over the same connection while
+// different cameras spread over the shards.
+typedef struct publisher_pool {
+  rabbitmq_publisher *shards;
+  size_t num_shards;
+} publisher_pool;
+
+// Starts num_shards publishers with the same config; config->depth is the
+// depth of each shard's ring. The shards make their first connection attempts
+// concurrently. Fails, with nothing left running, when any of them cannot be
+// started.
+int publisher_pool_start(publisher_pool *pool, size_t num_shards,
+             const rabbitmq_publisher_config *config);
+
+// Never touches the network. Returns -1 when the payload was dropped.
+int publisher_pool_enqueue(publisher_pool *pool, uint32_t source_id,
+             const char *routing_key, const char *payload, size_t len);
+
+// See rabbitmq_publisher_take_dropped; asks the shard of source_id.
+int publisher_pool_take_dropped(publisher_pool *pool, uint32_t source_id);
+
+// Every connection sends the preamble first, see
+// rabbitmq_publisher_set_preamble.
+int publisher_pool_set_preamble(publisher_pool *pool, const char *routing_key,
+             const void *data, size_t len);
+
+// Flushes every shard, waiting at most timeout_ms in total.
+int publisher_pool_flush(publisher_pool *pool, int timeout_ms);
+
+// Counters summed over the shards; safe to call from any thread.
+void publisher_pool_get_stats(publisher_pool *pool, rabbitmq_publisher_stats *stats);
+
+// Round-trips over messages summed across the shards.
+double publisher_pool_round_trips_per_message(publisher_pool *pool);
+
+// Depth of the fullest shard's ring, which is the one a busy camera stalls
+// on first.
+size_t publisher_pool_max_queue_depth(publisher_pool *pool);
+
+void publisher_pool_stop(publisher_pool *pool);
+
+#endif
@@ -4,55 +4,651 @@
 #include <rabbitmq-c/amqp.h>
 #include <rabbitmq-c/tcp_socket.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
 #include "rabbitmq-client.h"
 
-rabbitmq_cli new_rabbitmq_client(char *hostname, int port, 
-             char *vhost, char *user, char *pass) {
-  int status;
+static long long now_ms(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (long long) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static char *dup_or_null(const char *s) {
+  return s ? strdup(s) : NULL;
+}
+
+static int copy_into(char **data, size_t *cap, const void *message, size_t len) {
+  if (*cap < len) {
+    char *grown = realloc(*data, len);
+
+    if (!grown)
+      return -1;
+    *data = grown;
+    *cap = len;
+  }
+  memcpy(*data, message, len);
+  return 0;
+}
+
+static void copy_key(char *dst, const char *routing_key) {
+  size_t len = routing_key ? strnlen(routing_key, RABBITMQ_CLI_MAX_ROUTING_KEY) : 0;
+
+  if (len)
+    memcpy(dst, routing_key, len);
+  dst[len] = '\0';
+}
+
+static void set_content_type(rabbitmq_cli *cli, const char *content_type) {
+  if (!cli->content_type || strcmp(cli->content_type, content_type) != 0) {
+    free(cli->content_type);
+    cli->content_type = strdup(content_type);
+  }
+}
+
+// Keeps a copy of the message, discarding the oldest one when the replay ring
+// is full. Returns -1 when the message itself could not be kept.
+static int replay_push(rabbitmq_cli *cli, const char *routing_key,
+             const void *message, size_t len, unsigned int count) {
+  rabbitmq_replay_entry *entry;
+
+  if (cli->replay_size == 0) {
+    cli->dropped++;
+    return -1;
+  }
+  if (cli->replay_count == cli->replay_size) {
+    cli->replay_head = (cli->replay_head + 1) % cli->replay_size;
+    cli->replay_count--;
+    cli->dropped++;
+  }
+  entry = &cli->replay[(cli->replay_head + cli->replay_count) % cli->replay_size];
+  if (copy_into(&entry->data, &entry->cap, message, len) < 0) {
+    cli->dropped++;
+    return -1;
+  }
+  entry->len = len;
+  entry->count = count;
+  copy_key(entry->routing_key, routing_key);
+  cli->replay_count++;
+  return 0;
+}
+
+// Puts a message in front of everything buffered. Used for messages that are
+// older than the buffered ones, so a full ring drops the message itself.
+static void replay_unshift(rabbitmq_cli *cli, const char *routing_key,
+             const void *message, size_t len, unsigned int count) {
+  size_t head;
+  rabbitmq_replay_entry *entry;
+
+  if (cli->replay_count == cli->replay_size) {
+    cli->dropped++;
+    return;
+  }
+  head = (cli->replay_head + cli->replay_size - 1) % cli->replay_size;
+  entry = &cli->replay[head];
+  if (copy_into(&entry->data, &entry->cap, message, len) < 0) {
+    cli->dropped++;
+    return;
+  }
+  entry->len = len;
+  entry->count = count;
+  copy_key(entry->routing_key, routing_key);
+  cli->replay_head = head;
+  cli->replay_count++;
+}
+
+static rabbitmq_inflight_entry *inflight_at(rabbitmq_cli *cli, size_t i) {
+  return &cli->inflight[(cli->inflight_head + i) % cli->inflight_size];
+}
+
+// Hands every unsettled message back to the replay ring, oldest first.
+static void requeue_inflight(rabbitmq_cli *cli) {
+  size_t i;
+
+  for (i = cli->inflight_count; i > 0; i--) {
+    rabbitmq_inflight_entry *entry = inflight_at(cli, i - 1);
+
+    if (!entry->settled) {
+      replay_unshift(cli, entry->routing_key, entry->data, entry->len, entry->count);
+      cli->retried++;
+    }
+  }
+  cli->inflight_head = 0;
+  cli->inflight_count = 0;
+}
+
+static void connection_lost(rabbitmq_cli *cli) {
+  if (cli->state != RABBITMQ_CLI_CONNECTED)
+    return;
+  // The socket is gone or the broker closed the channel; there is nobody to
+  // exchange close handshakes with.
+  amqp_destroy_connection(cli->connection);
+  cli->connection = NULL;
+  cli->state = RABBITMQ_CLI_DISCONNECTED;
+  cli->disconnects++;
+  cli->next_attempt_ms = now_ms();
+  if (cli->confirm)
+    requeue_inflight(cli);
+  printf("Connection to %s lost\n", cli->hostname);
+}
+
+static void set_declared_name(rabbitmq_cli *cli, const char *queuename) {
+  char *name;
+
+  if (cli->declared_name && strcmp(cli->declared_name, queuename) == 0)
+    return;
+  name = strdup(queuename);
+  free(cli->declared_name);
+  cli->declared_name = name;
+}
+
+static int declare_queue(rabbitmq_cli *cli, const char *queuename) {
+  amqp_queue_declare_ok_t *queue_ok;
+
+  queue_ok = amqp_queue_declare(cli->connection, 1, amqp_cstring_bytes(queuename),
+                     0, 0, 0, 1, amqp_empty_table);
+  cli->round_trips++;
+  if (!queue_ok) {
+    printf("Error declaring queue %s\n", queuename);
+    return -1;
+  }
+
+  if (cli->declared_queue.bytes)
+    amqp_bytes_free(cli->declared_queue);
+  cli->declared_queue = amqp_bytes_malloc_dup(queue_ok->queue);
+  return 0;
+}
+
+static int declare_exchange(rabbitmq_cli *cli) {
+  amqp_rpc_reply_t reply;
+
+  amqp_exchange_declare(cli->connection, 1, amqp_cstring_bytes(cli->exchange),
+                        amqp_cstring_bytes(cli->exchange_type), 0, 1, 0, 0,
+                        amqp_empty_table);
+  reply = amqp_get_rpc_reply(cli->connection);
+  cli->round_trips++;
+  if (reply.reply_type != AMQP_RESPONSE_NORMAL) {
+    printf("Error declaring %s exchange %s\n", cli->exchange_type, cli->exchange);
+    return -1;
+  }
+  return 0;
+}
+
+static int select_confirms(rabbitmq_cli *cli) {
+  amqp_rpc_reply_t reply;
+
+  amqp_confirm_select(cli->connection, 1);
+  reply = amqp_get_rpc_reply(cli->connection);
+  cli->round_trips++;
+  if (reply.reply_type != AMQP_RESPONSE_NORMAL)
+    return -1;
+  // Delivery tags restart at 1 on every channel.
+  cli->next_tag = 1;
+  return 0;
+}
+
+static int connect_broker(rabbitmq_cli *cli) {
   amqp_rpc_reply_t reply;
   amqp_socket_t *socket = NULL;
-  rabbitmq_cli cli;
-  amqp_connection_state_t conn;
-
-  cli.connection = amqp_new_connection();
-  socket = amqp_tcp_socket_new(cli.connection);
-  status = amqp_socket_open(socket, hostname, port);
-
-  if (status){printf("Error opening TCP socket\n");};
-  reply = amqp_login(cli.connection, vhost, 0, 131072, 0, 
-        AMQP_SASL_METHOD_PLAIN, user, pass);  amqp_channel_open(cli.connection, 1);
-  reply = amqp_get_rpc_reply(cli.connection);
-  // handle reply error
-  printf("Connection established at %s\n", hostname);
+  struct timeval timeout = {
+    RABBITMQ_CLI_CONNECT_TIMEOUT_MS / 1000,
+    (RABBITMQ_CLI_CONNECT_TIMEOUT_MS % 1000) * 1000,
+  };
+
+  cli->connection = amqp_new_connection();
+  socket = amqp_tcp_socket_new(cli->connection);
+  if (!socket || amqp_socket_open_noblock(socket, cli->hostname, cli->port, &timeout)) {
+    printf("Error opening TCP socket\n");
+    goto fail;
+  }
+  reply = amqp_login(cli->connection, cli->vhost, 0, 131072, cli->heartbeat,
+        AMQP_SASL_METHOD_PLAIN, cli->user, cli->pass);
+  if (reply.reply_type != AMQP_RESPONSE_NORMAL) {
+    printf("Error logging in to %s\n", cli->hostname);
+    goto fail;
+  }
+  amqp_channel_open(cli->connection, 1);
+  reply = amqp_get_rpc_reply(cli->connection);
+  cli->round_trips += 2; /* login, channel.open */
+  if (reply.reply_type != AMQP_RESPONSE_NORMAL) {
+    printf("Error opening channel\n");
+    goto fail;
+  }
+
+  if (cli->confirm && select_confirms(cli) < 0) {
+    printf("Error enabling publisher confirms\n");
+    goto fail;
+  }
+  if (cli->exchange && declare_exchange(cli) < 0)
+    goto fail;
+  if (!cli->exchange && cli->declared_name &&
+      declare_queue(cli, cli->declared_name) < 0)
+    goto fail;
+  cli->state = RABBITMQ_CLI_CONNECTED;
+  cli->connects++;
+  cli->preamble_pending = cli->preamble_len > 0;
+  cli->backoff_ms = RABBITMQ_CLI_BACKOFF_MIN_MS;
+  printf("Connection established at %s\n", cli->hostname);
+  return 0;
+
+fail:
+  amqp_destroy_connection(cli->connection);
+  cli->connection = NULL;
+  cli->next_attempt_ms = now_ms() + cli->backoff_ms;
+  cli->backoff_ms *= 2;
+  if (cli->backoff_ms > RABBITMQ_CLI_BACKOFF_MAX_MS)
+    cli->backoff_ms = RABBITMQ_CLI_BACKOFF_MAX_MS;
+  return -1;
+}
+
+rabbitmq_cli new_rabbitmq_client(char *hostname, int port,
+             char *vhost, char *user, char *pass, int heartbeat,
+             size_t replay_depth) {
+  rabbitmq_cli cli = {0};
+
+  cli.hostname = dup_or_null(hostname);
+  cli.port = port;
+  cli.vhost = dup_or_null(vhost);
+  cli.user = dup_or_null(user);
+  cli.pass = dup_or_null(pass);
+  cli.heartbeat = heartbeat;
+  cli.state = RABBITMQ_CLI_DISCONNECTED;
+  cli.backoff_ms = RABBITMQ_CLI_BACKOFF_MIN_MS;
+  if (replay_depth > 0) {
+    cli.replay = calloc(replay_depth, sizeof(*cli.replay));
+    if (cli.replay)
+      cli.replay_size = replay_depth;
+  }
+  connect_broker(&cli);
   return cli;
 }
 
-// TO-DO implement error handler for amqp_rpc_reply_t
+// Declares the queue once per connection and keeps the broker-assigned name,
+// so publishing never waits on the broker. The queue is declared again on
+// every reconnect.
+int rabbitmq_cli_declare_queue(rabbitmq_cli *cli, char *queuename) {
+  set_declared_name(cli, queuename);
+  if (cli->state != RABBITMQ_CLI_CONNECTED)
+    return -1;
+  if (declare_queue(cli, queuename) < 0) {
+    // A failed declare closes the channel, so start over with a new connection.
+    connection_lost(cli);
+    return -1;
+  }
+  return 0;
+}
+
+int rabbitmq_cli_declare_exchange(rabbitmq_cli *cli, const char *exchange,
+             const char *type) {
+  char *name = strdup(exchange);
+  char *kind = strdup(type);
 
-// TO-DO implement message content_type
-int rabbitmq_cli_publish(rabbitmq_cli cli, char *queuename, char *message) {
+  if (!name || !kind) {
+    free(name);
+    free(kind);
+    return -1;
+  }
+  free(cli->exchange);
+  free(cli->exchange_type);
+  cli->exchange = name;
+  cli->exchange_type = kind;
+  if (cli->state != RABBITMQ_CLI_CONNECTED)
+    return -1;
+  if (declare_exchange(cli) < 0) {
+    // Like a failed queue declare, this closes the channel.
+    connection_lost(cli);
+    return -1;
+  }
+  return 0;
+}
+
+int rabbitmq_cli_enable_confirms(rabbitmq_cli *cli, size_t window,
+             unsigned int timeout_ms) {
+  if (cli->confirm || window == 0)
+    return -1;
+  cli->inflight = calloc(window, sizeof(*cli->inflight));
+  if (!cli->inflight)
+    return -1;
+  cli->inflight_size = window;
+  cli->confirm_timeout_ms = timeout_ms;
+  cli->confirm = 1;
+  // On failure the channel is gone; the next connection selects confirms.
+  if (cli->state == RABBITMQ_CLI_CONNECTED && select_confirms(cli) < 0)
+    connection_lost(cli);
+  return 0;
+}
+
+// The preamble goes out with a count of 0 and is not counted.
+static void deliver(rabbitmq_cli *cli, size_t len, unsigned int count) {
+  if (count == 0)
+    return;
+  cli->delivered += count;
+  cli->delivered_messages++;
+  cli->delivered_bytes += len;
+}
+
+// Settles the unsettled messages covered by an ack or nack. Nacked messages
+// are queued for another attempt.
+static void settle(rabbitmq_cli *cli, uint64_t tag, int multiple, int ack) {
+  size_t i;
+
+  for (i = 0; i < cli->inflight_count; i++) {
+    rabbitmq_inflight_entry *entry = inflight_at(cli, i);
+
+    if (entry->tag > tag)
+      break;
+    if (entry->settled || (!multiple && entry->tag != tag))
+      continue;
+    entry->settled = 1;
+    if (ack) {
+      cli->confirmed++;
+      deliver(cli, entry->len, entry->count);
+    } else {
+      cli->nacked++;
+      cli->retried++;
+      replay_push(cli, entry->routing_key, entry->data, entry->len, entry->count);
+    }
+  }
+  while (cli->inflight_count > 0 && inflight_at(cli, 0)->settled) {
+    cli->inflight_head = (cli->inflight_head + 1) % cli->inflight_size;
+    cli->inflight_count--;
+  }
+}
+
+static int handle_frame(rabbitmq_cli *cli, amqp_frame_t *frame) {
+  if (frame->frame_type != AMQP_FRAME_METHOD)
+    return 0;
+  switch (frame->payload.method.id) {
+    case AMQP_BASIC_ACK_METHOD: {
+      amqp_basic_ack_t *ack = frame->payload.method.decoded;
+
+      if (cli->confirm)
+        settle(cli, ack->delivery_tag, ack->multiple, 1);
+      return 0;
+    }
+    case AMQP_BASIC_NACK_METHOD: {
+      amqp_basic_nack_t *nack = frame->payload.method.decoded;
+
+      if (cli->confirm)
+        settle(cli, nack->delivery_tag, nack->multiple, 0);
+      return 0;
+    }
+    case AMQP_CHANNEL_CLOSE_METHOD:
+    case AMQP_CONNECTION_CLOSE_METHOD:
+      connection_lost(cli);
+      return -1;
+    default:
+      return 0;
+  }
+}
+
+// Waits up to timeout_ms for the first frame, then handles whatever else has
+// already arrived. Reading also lets rabbitmq-c send heartbeats that are due
+// and notice missed ones from the broker.
+static int read_frames(rabbitmq_cli *cli, int timeout_ms) {
+  amqp_frame_t frame;
+  struct timeval timeout = { timeout_ms / 1000, (timeout_ms % 1000) * 1000 };
+  int status;
+
+  for (;;) {
+    status = amqp_simple_wait_frame_noblock(cli->connection, &frame, &timeout);
+    if (status == AMQP_STATUS_TIMEOUT)
+      break;
+    if (status != AMQP_STATUS_OK) {
+      connection_lost(cli);
+      return -1;
+    }
+    if (handle_frame(cli, &frame) < 0)
+      return -1;
+    timeout.tv_sec = 0;
+    timeout.tv_usec = 0;
+  }
+  amqp_maybe_release_buffers(cli->connection);
+
+  if (cli->confirm && cli->inflight_count > 0 &&
+      now_ms() - inflight_at(cli, 0)->sent_ms >= cli->confirm_timeout_ms) {
+    printf("Publisher confirm timed out\n");
+    connection_lost(cli);
+    return -1;
+  }
+  return 0;
+}
+
+// Blocks until the confirm window has room for one more message.
+static int wait_for_window(rabbitmq_cli *cli) {
+  while (cli->state == RABBITMQ_CLI_CONNECTED &&
+      cli->inflight_count == cli->inflight_size) {
+    long long left = inflight_at(cli, 0)->sent_ms + cli->confirm_timeout_ms - now_ms();
+
+    if (read_frames(cli, left > 0 ? (int) left : 0) < 0)
+      return -1;
+  }
+  return cli->state == RABBITMQ_CLI_CONNECTED ? 0 : -1;
+}
+
+// Copies the message into the next free window slot, ahead of publishing it,
+// so a message that could not be copied is never sent untracked. The slot
+// only counts as in flight once inflight_commit is called.
+static rabbitmq_inflight_entry *inflight_reserve(rabbitmq_cli *cli, const char *routing_key,
+             const void *message, size_t len, unsigned int count) {
+  rabbitmq_inflight_entry *entry = inflight_at(cli, cli->inflight_count);
+
+  if (copy_into(&entry->data, &entry->cap, message, len) < 0)
+    return NULL;
+  entry->len = len;
+  entry->count = count;
+  copy_key(entry->routing_key, routing_key);
+  return entry;
+}
+
+static void inflight_commit(rabbitmq_cli *cli, rabbitmq_inflight_entry *entry) {
+  entry->tag = cli->next_tag++;
+  entry->sent_ms = now_ms();
+  entry->settled = 0;
+  cli->inflight_count++;
+}
+
+// Returns AMQP_STATUS_NO_MEMORY without sending when confirms are on and the
+// message cannot be kept for a retry.
+static int send_message(rabbitmq_cli *cli, const char *routing_key,
+             const void *message, size_t len, unsigned int count) {
   int reply;
   amqp_basic_properties_t props;
-  amqp_queue_declare_ok_t *queue_ok;
+  amqp_bytes_t body;
+  amqp_bytes_t exchange = amqp_cstring_bytes(cli->exchange ? cli->exchange : "");
+  amqp_bytes_t key;
+  rabbitmq_inflight_entry *entry = NULL;
   props._flags = AMQP_BASIC_CONTENT_TYPE_FLAG | AMQP_BASIC_DELIVERY_MODE_FLAG;
-  props.content_type = amqp_cstring_bytes("text/json");
+  props.content_type = amqp_cstring_bytes(cli->content_type);
   props.delivery_mode = 2; /* persistent delivery mode */
 
-
-  queue_ok = amqp_queue_declare(cli.connection, 1, amqp_cstring_bytes(queuename),
-                     0, 0, 0, 1, amqp_empty_table);
-  reply = amqp_basic_publish(cli.connection, 1, amqp_cstring_bytes(""),
-                              queue_ok->queue, 0, 0, &props,
-                              amqp_cstring_bytes(message));
+  if (cli->confirm) {
+    if (wait_for_window(cli) < 0)
+      return -1;
+    entry = inflight_reserve(cli, routing_key, message, len, count);
+    if (!entry)
+      return AMQP_STATUS_NO_MEMORY;
+  }
+  body.len = len;
+  body.bytes = (void *) message;
+  if (routing_key && routing_key[0])
+    key = amqp_cstring_bytes(routing_key);
+  else if (cli->exchange)
+    key = amqp_empty_bytes;
+  else
+    key = cli->declared_queue;
+  reply = amqp_basic_publish(cli->connection, 1, exchange, key, 0, 0, &props, body);
+  if (reply != AMQP_STATUS_OK) {
+    connection_lost(cli);
+    return reply;
+  }
+  // With confirms on, the message is delivered once it is acked.
+  if (entry)
+    inflight_commit(cli, entry);
+  else
+    deliver(cli, len, count);
+  cli->published++;
   return reply;
 }
 
-char *rabbitmq_cli_receive(rabbitmq_cli cli, char *queuename) {
+// Sends the preamble when due, then buffered messages in order until the ring
+// is empty or the connection drops again.
+static int replay_flush(rabbitmq_cli *cli) {
+  if (cli->preamble_pending && cli->state == RABBITMQ_CLI_CONNECTED) {
+    if (send_message(cli, cli->preamble_key, cli->preamble,
+                     cli->preamble_len, 0) != AMQP_STATUS_OK)
+      return -1;
+    cli->preamble_pending = 0;
+  }
+  while (cli->replay_count > 0 && cli->state == RABBITMQ_CLI_CONNECTED) {
+    rabbitmq_replay_entry *entry;
+
+    // Settling confirms can push nacked messages, so make room before
+    // picking the entry to send.
+    if (cli->confirm && wait_for_window(cli) < 0)
+      return -1;
+    entry = &cli->replay[cli->replay_head];
+
+    if (send_message(cli, entry->routing_key, entry->data, entry->len,
+                     entry->count) != AMQP_STATUS_OK)
+      return -1;
+    cli->replay_head = (cli->replay_head + 1) % cli->replay_size;
+    cli->replay_count--;
+  }
+  return cli->state == RABBITMQ_CLI_CONNECTED ? 0 : -1;
+}
+
+// Flushes the replay ring and, with confirms on, waits for room in the window.
+// Waiting settles confirms, which can queue nacked messages for another
+// attempt; those are flushed too, so a new message never overtakes them.
+static int drain_replay(rabbitmq_cli *cli) {
+  for (;;) {
+    if (replay_flush(cli) < 0)
+      return -1;
+    if (!cli->confirm)
+      return 0;
+    if (wait_for_window(cli) < 0)
+      return -1;
+    if (cli->replay_count == 0)
+      return 0;
+  }
+}
+
+int rabbitmq_cli_poll(rabbitmq_cli *cli) {
+  if (cli->state != RABBITMQ_CLI_CONNECTED) {
+    if (now_ms() < cli->next_attempt_ms || connect_broker(cli) < 0)
+      return -1;
+  }
+  if (read_frames(cli, 0) < 0)
+    return -1;
+  return replay_flush(cli);
+}
+
+int rabbitmq_cli_publish(rabbitmq_cli *cli, char *queuename, char *content_type,
+             const char *routing_key, const void *message, size_t len,
+             unsigned int count) {
+  set_content_type(cli, content_type);
+
+  if (cli->state != RABBITMQ_CLI_CONNECTED)
+    rabbitmq_cli_poll(cli);
+  else
+    replay_flush(cli);
+
+  if (cli->state == RABBITMQ_CLI_CONNECTED && !cli->exchange &&
+      (!cli->declared_name || strcmp(cli->declared_name, queuename) != 0))
+    rabbitmq_cli_declare_queue(cli, queuename);
+
+  if (cli->state == RABBITMQ_CLI_CONNECTED && drain_replay(cli) == 0 &&
+      send_message(cli, routing_key, message, len, count) == AMQP_STATUS_OK)
+    return AMQP_STATUS_OK;
+
+  if (!cli->exchange && !cli->declared_name)
+    set_declared_name(cli, queuename);
+  return replay_push(cli, routing_key, message, len, count) < 0 ? -1 :
+                                                                  RABBITMQ_CLI_BUFFERED;
+}
+
+int rabbitmq_cli_set_preamble(rabbitmq_cli *cli, char *content_type,
+             const char *routing_key, const void *message, size_t len) {
+  if (len > 0 && copy_into(&cli->preamble, &cli->preamble_cap, message, len) < 0)
+    return -1;
+  set_content_type(cli, content_type);
+  copy_key(cli->preamble_key, routing_key);
+  cli->preamble_len = len;
+  // Sent by the next replay_flush, which runs before any other message.
+  cli->preamble_pending = len > 0;
+  return 0;
+}
+
+double rabbitmq_cli_round_trips_per_message(rabbitmq_cli *cli) {
+  if (cli->published == 0)
+    return 0.0;
+  return (double) cli->round_trips / cli->published;
+}
+
+void rabbitmq_cli_close(rabbitmq_cli *cli) {
+  size_t i;
+
+  if (cli->state == RABBITMQ_CLI_CONNECTED) {
+    replay_flush(cli);
+    // Give outstanding confirms a chance to arrive; read_frames gives up on
+    // the connection once the oldest one times out.
+    while (cli->confirm && cli->state == RABBITMQ_CLI_CONNECTED &&
+        cli->inflight_count > 0)
+      read_frames(cli, 100);
+  }
+  if (cli->state == RABBITMQ_CLI_CONNECTED) {
+    amqp_channel_close(cli->connection, 1, AMQP_REPLY_SUCCESS);
+    amqp_connection_close(cli->connection, AMQP_REPLY_SUCCESS);
+    amqp_destroy_connection(cli->connection);
+  }
+  cli->connection = NULL;
+  cli->state = RABBITMQ_CLI_DISCONNECTED;
+  if (cli->replay_count > 0)
+    printf("Discarding %zu unsent messages\n", cli->replay_count);
+
+  free(cli->declared_name);
+  cli->declared_name = NULL;
+  if (cli->declared_queue.bytes)
+    amqp_bytes_free(cli->declared_queue);
+  cli->declared_queue = amqp_empty_bytes;
+
+  for (i = 0; i < cli->replay_size; i++)
+    free(cli->replay[i].data);
+  free(cli->replay);
+  cli->replay = NULL;
+  for (i = 0; i < cli->inflight_size; i++)
+    free(cli->inflight[i].data);
+  free(cli->inflight);
+  cli->inflight = NULL;
+  free(cli->preamble);
+  cli->preamble = NULL;
+  cli->preamble_len = cli->preamble_cap = 0;
+  cli->preamble_pending = 0;
+  cli->inflight_size = cli->inflight_head = cli->inflight_count = 0;
+  cli->confirm = 0;
+  cli->replay_size = cli->replay_head = cli->replay_count = 0;
+  free(cli->hostname);
+  free(cli->vhost);
+  free(cli->user);
+  free(cli->pass);
+  free(cli->content_type);
+  free(cli->exchange);
+  free(cli->exchange_type);
+  cli->hostname = cli->vhost = cli->user = cli->pass = cli->content_type = NULL;
+  cli->exchange = cli->exchange_type = NULL;
+}
+
+char *rabbitmq_cli_receive(rabbitmq_cli *cli, char *queuename) {
   amqp_rpc_reply_t res;
   amqp_envelope_t envelope;
-  amqp_basic_consume(cli.connection, 1, amqp_cstring_bytes(queuename), amqp_empty_bytes,
+  amqp_basic_consume(cli->connection, 1, amqp_cstring_bytes(queuename), amqp_empty_bytes,
                     0, 0, 0, amqp_empty_table);
-  amqp_get_rpc_reply(cli.connection);
-  res = amqp_consume_message(cli.connection, &envelope, NULL, 0);
+  amqp_get_rpc_reply(cli->connection);
+  res = amqp_consume_message(cli->connection, &envelope, NULL, 0);
+  if (res.reply_type != AMQP_RESPONSE_NORMAL)
+    return NULL;
   return (char *) envelope.message.body.bytes;
 }
@@ -1,9 +1,50 @@
 // Copyright 2022, Kyota Tashiro, Mengheng Lee, and Latona Inc.
 // License MIT
-#ifndef MQ_CLIENT 
+#ifndef MQ_CLIENT
 #define MQ_CLIENT
+#include <stddef.h>
+#include <stdint.h>
 #include <rabbitmq-c/amqp.h>
 
+#define RABBITMQ_CLI_DEFAULT_HEARTBEAT 10
+#define RABBITMQ_CLI_DEFAULT_REPLAY_DEPTH 256
+#define RABBITMQ_CLI_CONNECT_TIMEOUT_MS 2000
+#define RABBITMQ_CLI_BACKOFF_MIN_MS 100
+#define RABBITMQ_CLI_BACKOFF_MAX_MS 30000
+#define RABBITMQ_CLI_DEFAULT_CONFIRM_WINDOW 256
+#define RABBITMQ_CLI_DEFAULT_CONFIRM_TIMEOUT_MS 5000
+// Longest routing key AMQP allows (a short string).
+#define RABBITMQ_CLI_MAX_ROUTING_KEY 255
+
+// rabbitmq_cli_publish result when the broker is unreachable and the message
+// was kept for replay instead of being sent.
+#define RABBITMQ_CLI_BUFFERED 1
+
+typedef enum {
+  RABBITMQ_CLI_DISCONNECTED,
+  RABBITMQ_CLI_CONNECTED,
+} rabbitmq_cli_state;
+
+typedef struct rabbitmq_replay_entry {
+  char routing_key[RABBITMQ_CLI_MAX_ROUTING_KEY + 1];
+  char *data;
+  size_t len;
+  size_t cap;
+  unsigned int count;
+} rabbitmq_replay_entry;
+
+// A message published in confirm mode that the broker has not settled yet.
+typedef struct rabbitmq_inflight_entry {
+  uint64_t tag;
+  long long sent_ms;
+  int settled;
+  char routing_key[RABBITMQ_CLI_MAX_ROUTING_KEY + 1];
+  char *data;
+  size_t len;
+  size_t cap;
+  unsigned int count;
+} rabbitmq_inflight_entry;
+
 typedef struct rabbitmq_cli {
   amqp_connection_state_t connection;
   amqp_channel_t *channel;
@@ -13,14 +54,115 @@ typedef struct rabbitmq_cli {
   int counter;
   char *tag;
   int is_closed;
+  char *declared_name;
+  amqp_bytes_t declared_queue;
+  // Exchange messages are published to, NULL for the default exchange.
+  char *exchange;
+  char *exchange_type;
+  unsigned long round_trips;
+  unsigned long published;
+
+  // Kept so the connection can be re-established after it drops.
+  char *hostname;
+  int port;
+  char *vhost;
+  char *user;
+  char *pass;
+  int heartbeat;
+  char *content_type;
+  rabbitmq_cli_state state;
+  unsigned int backoff_ms;
+  long long next_attempt_ms;
+
+  // Sent ahead of every other message on each connection.
+  char preamble_key[RABBITMQ_CLI_MAX_ROUTING_KEY + 1];
+  char *preamble;
+  size_t preamble_len;
+  size_t preamble_cap;
+  int preamble_pending;
+
+  // Messages that could not be sent, oldest first, replayed after reconnect.
+  rabbitmq_replay_entry *replay;
+  size_t replay_size;
+  size_t replay_head;
+  size_t replay_count;
+
+  // Publisher confirms. Unsettled messages are kept in tag order; nacked ones
+  // and everything in flight when the connection drops go back to the replay
+  // ring.
+  int confirm;
+  unsigned int confirm_timeout_ms;
+  uint64_t next_tag;
+  rabbitmq_inflight_entry *inflight;
+  size_t inflight_size;
+  size_t inflight_head;
+  size_t inflight_count;
+
+  unsigned long connects;
+  unsigned long disconnects;
+  unsigned long dropped;
+  unsigned long confirmed;
+  unsigned long nacked;
+  unsigned long retried;
+  // Sum of the counts of the messages delivered, and their number and bytes.
+  // A message is delivered once sent or, with confirms on, once acked; one
+  // only kept for replay is not.
+  unsigned long delivered;
+  unsigned long delivered_messages;
+  unsigned long delivered_bytes;
 } rabbitmq_cli;
 
-rabbitmq_cli new_rabbitmq_client(char *hostname, int port, 
-             char *vhost, char *user, char *pass);
-// TO-DO implement message content type
-int rabbitmq_cli_publish(rabbitmq_cli cli, char *queuename, char *message);
+// Copies the connection parameters and makes a first connection attempt. A
+// failed attempt is retried with exponential backoff by rabbitmq_cli_poll and
+// rabbitmq_cli_publish. heartbeat is in seconds, 0 disables it; replay_depth
+// bounds the number of unsent messages kept while disconnected.
+rabbitmq_cli new_rabbitmq_client(char *hostname, int port,
+             char *vhost, char *user, char *pass, int heartbeat,
+             size_t replay_depth);
+int rabbitmq_cli_declare_queue(rabbitmq_cli *cli, char *queuename);
 
-char *rabbitmq_cli_receive(rabbitmq_cli cli, char *queuename);
+// Publishes to a durable exchange of the given type (direct, fanout, topic or
+// headers) instead of the default exchange, declaring it now and after every
+// reconnect. Queues are left to the consumers, which bind what they need.
+int rabbitmq_cli_declare_exchange(rabbitmq_cli *cli, const char *exchange,
+             const char *type);
 
-#endif
+// Puts the channel in confirm mode, now and after every reconnect. At most
+// window messages are unconfirmed at a time; publishing waits for acks once
+// the window is full. A message not confirmed within timeout_ms is treated as
+// a dead connection and retried after reconnecting.
+int rabbitmq_cli_enable_confirms(rabbitmq_cli *cli, size_t window,
+             unsigned int timeout_ms);
+
+// Returns AMQP_STATUS_OK when sent, RABBITMQ_CLI_BUFFERED when kept for
+// replay and -1 when the message was dropped. routing_key may be NULL or
+// empty; on the default exchange the message then goes to queuename, which
+// is declared first. Replayed messages keep their routing key and go out
+// with the most recent content type. count is what the message stands for,
+// e.g. the frames of a batch, and goes into delivered once it is delivered.
+int rabbitmq_cli_publish(rabbitmq_cli *cli, char *queuename, char *content_type,
+             const char *routing_key, const void *message, size_t len,
+             unsigned int count);
+
+// Keeps a copy of message and sends it before anything else on every
+// connection, including replayed messages, e.g. a dictionary later messages
+// refer to. Setting it again sends the new one ahead of the next message; a
+// len of 0 clears it. Returns -1 when the copy cannot be made.
+int rabbitmq_cli_set_preamble(rabbitmq_cli *cli, char *content_type,
+             const char *routing_key, const void *message, size_t len);
+
+// Services heartbeats, processes publisher confirms and notices a closed
+// connection while idle. Reconnects once the backoff has elapsed and replays
+// buffered messages. Returns 0 while connected, -1 otherwise. Must be called
+// from the thread that publishes.
+int rabbitmq_cli_poll(rabbitmq_cli *cli);
 
+// Synchronous broker round-trips (login, channel.open, queue.declare) divided
+// by the number of messages published on this connection.
+double rabbitmq_cli_round_trips_per_message(rabbitmq_cli *cli);
+
+void rabbitmq_cli_close(rabbitmq_cli *cli);
+
+char *rabbitmq_cli_receive(rabbitmq_cli *cli, char *queuename);
+
+#endif
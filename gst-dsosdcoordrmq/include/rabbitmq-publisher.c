@@ -0,0 +1,445 @@
+// Copyright 2022, Kyota Tashiro, Mengheng Lee, and Latona Inc.
+// License MIT
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "rabbitmq-publisher.h"
+
+static long long now_ms(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (long long) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static void mirror_counters(rabbitmq_publisher *pub) {
+  if (pub->cli.dropped != atomic_load(&pub->replay_dropped))
+    atomic_fetch_add(&pub->losses, 1);
+  atomic_store(&pub->round_trips, pub->cli.round_trips);
+  atomic_store(&pub->connects, pub->cli.connects);
+  atomic_store(&pub->disconnects, pub->cli.disconnects);
+  atomic_store(&pub->replay_dropped, pub->cli.dropped);
+  atomic_store(&pub->confirmed, pub->cli.confirmed);
+  atomic_store(&pub->retried, pub->cli.retried);
+  atomic_store(&pub->inflight, pub->cli.inflight_count);
+  atomic_store(&pub->published, pub->cli.delivered);
+  atomic_store(&pub->messages, pub->cli.delivered_messages);
+  atomic_store(&pub->bytes, pub->cli.delivered_bytes);
+}
+
+static void lose(rabbitmq_publisher *pub, unsigned int frames) {
+  atomic_fetch_add(&pub->failed, frames);
+  atomic_fetch_add(&pub->losses, 1);
+}
+
+// Messages kept for replay only count as published once the client has sent
+// them, or once the broker has acked them with confirms on.
+static void publish(rabbitmq_publisher *pub, const char *routing_key,
+             const void *message, size_t len, unsigned int frames) {
+  if (rabbitmq_cli_publish(&pub->cli, pub->config.queuename, pub->config.content_type,
+                           routing_key, message, len, frames) < 0)
+    lose(pub, frames);
+  mirror_counters(pub);
+}
+
+static size_t batch_len(rabbitmq_publisher *pub) {
+  if (pub->config.batch_format == RABBITMQ_BATCH_DSMETA_BIN)
+    return pub->bin_batch.len;
+  return pub->json_batch.len + 1;
+}
+
+static void flush_batch(rabbitmq_publisher *pub) {
+  if (pub->batch_frames == 0)
+    return;
+  if (pub->config.batch_format == RABBITMQ_BATCH_DSMETA_BIN) {
+    dsmeta_bin_end_batch(&pub->bin_batch);
+    if (!pub->bin_batch.error)
+      publish(pub, pub->batch_key, pub->bin_batch.buf, pub->bin_batch.len,
+              pub->batch_frames);
+    else
+      lose(pub, pub->batch_frames);
+  } else {
+    json_writer_end_array(&pub->json_batch);
+    if (!pub->json_batch.error)
+      publish(pub, pub->batch_key, pub->json_batch.buf, pub->json_batch.len,
+              pub->batch_frames);
+    else
+      lose(pub, pub->batch_frames);
+  }
+  pub->batch_frames = 0;
+}
+
+// Appends one queued payload to the open batch, publishing the batch first
+// when the payload would push it past batch_max_bytes or is routed elsewhere.
+static void add_to_batch(rabbitmq_publisher *pub, const char *routing_key,
+             const char *payload, size_t len) {
+  size_t framing = pub->config.batch_format == RABBITMQ_BATCH_DSMETA_BIN ? 4 : 2;
+
+  if (pub->batch_frames > 0 && pub->config.batch_max_bytes > 0 &&
+      batch_len(pub) + len + framing > pub->config.batch_max_bytes)
+    flush_batch(pub);
+  if (pub->batch_frames > 0 && strcmp(pub->batch_key, routing_key) != 0)
+    flush_batch(pub);
+
+  if (pub->batch_frames == 0) {
+    if (pub->config.batch_format == RABBITMQ_BATCH_DSMETA_BIN) {
+      dsmeta_bin_writer_reset(&pub->bin_batch);
+      dsmeta_bin_begin_batch(&pub->bin_batch);
+    } else {
+      json_writer_reset(&pub->json_batch);
+      json_writer_begin_array(&pub->json_batch);
+    }
+    pub->batch_deadline_ms = now_ms() + pub->config.linger_ms;
+    strcpy(pub->batch_key, routing_key);
+  }
+
+  if (pub->config.batch_format == RABBITMQ_BATCH_DSMETA_BIN)
+    dsmeta_bin_add_batch_frame(&pub->bin_batch, payload, len);
+  else
+    json_writer_raw(&pub->json_batch, payload, len);
+  pub->batch_frames++;
+
+  if (pub->batch_frames >= pub->config.batch_max_frames)
+    flush_batch(pub);
+}
+
+// Runs on the publisher thread before any payload it pops is published, so a
+// preamble set before a payload was enqueued always goes out ahead of it.
+static void apply_preamble(rabbitmq_publisher *pub) {
+  unsigned long generation = atomic_load(&pub->preamble_generation);
+
+  if (generation == pub->preamble_applied)
+    return;
+  pthread_mutex_lock(&pub->preamble_lock);
+  generation = atomic_load(&pub->preamble_generation);
+  rabbitmq_cli_set_preamble(&pub->cli, pub->config.content_type,
+                            pub->preamble_key, pub->preamble, pub->preamble_len);
+  pthread_mutex_unlock(&pub->preamble_lock);
+  pub->preamble_applied = generation;
+}
+
+static int next_timeout(rabbitmq_publisher *pub) {
+  long long left;
+
+  if (pub->batch_frames == 0)
+    return 100;
+  left = pub->batch_deadline_ms - now_ms();
+  if (left <= 0)
+    return 0;
+  return left < 100 ? (int) left : 100;
+}
+
+static void finish_flush(rabbitmq_publisher *pub) {
+  pthread_mutex_lock(&pub->flush_lock);
+  atomic_store(&pub->flush_requested, 0);
+  pthread_cond_broadcast(&pub->flushed);
+  pthread_mutex_unlock(&pub->flush_lock);
+}
+
+static void *publisher_loop(void *arg) {
+  rabbitmq_publisher *pub = arg;
+  int batching = pub->config.batch_max_frames > 1;
+  char key[PAYLOAD_RING_MAX_KEY + 1];
+  char *buf = NULL;
+  size_t len = 0;
+  size_t cap = 0;
+
+  for (;;) {
+    // Read the request before draining so that everything enqueued ahead of
+    // the flush call is part of what gets published.
+    int flush = atomic_load(&pub->flush_requested);
+
+    if (!flush)
+      payload_ring_wait(&pub->ring, next_timeout(pub));
+    apply_preamble(pub);
+    rabbitmq_cli_poll(&pub->cli);
+    mirror_counters(pub);
+    while (payload_ring_pop(&pub->ring, key, &buf, &len, &cap)) {
+      apply_preamble(pub);
+      if (batching)
+        add_to_batch(pub, key, buf, len);
+      else
+        publish(pub, key, buf, len, 1);
+    }
+
+    if (pub->batch_frames > 0 && now_ms() >= pub->batch_deadline_ms)
+      flush_batch(pub);
+    if (flush) {
+      flush_batch(pub);
+      finish_flush(pub);
+    }
+    if (atomic_load(&pub->ring.closed) && payload_ring_depth(&pub->ring) == 0)
+      break;
+  }
+
+  flush_batch(pub);
+  finish_flush(pub);
+  rabbitmq_cli_close(&pub->cli);
+  free(buf);
+  return NULL;
+}
+
+// Sources come and go rarely, so a linear search is enough. A new source has
+// lost nothing yet.
+static rabbitmq_publisher_source *find_source(rabbitmq_publisher *pub, uint32_t source_id) {
+  rabbitmq_publisher_source *src;
+  size_t i;
+
+  for (i = 0; i < pub->num_sources; i++) {
+    if (pub->sources[i].source_id == source_id)
+      return &pub->sources[i];
+  }
+  if (pub->num_sources == pub->sources_capacity) {
+    size_t capacity = pub->sources_capacity ? pub->sources_capacity * 2 : 16;
+    rabbitmq_publisher_source *grown = realloc(pub->sources, capacity * sizeof(*grown));
+
+    if (!grown)
+      return NULL;
+    pub->sources = grown;
+    pub->sources_capacity = capacity;
+  }
+  src = &pub->sources[pub->num_sources++];
+  src->source_id = source_id;
+  src->dropped = 0;
+  src->losses = atomic_load(&pub->losses);
+  return src;
+}
+
+// Runs inside enqueue, on the producer's thread.
+static void note_discard(void *arg, uint32_t source_id) {
+  rabbitmq_publisher *pub = arg;
+  rabbitmq_publisher_source *src = find_source(pub, source_id);
+
+  if (src)
+    src->dropped = 1;
+  else
+    atomic_fetch_add(&pub->losses, 1);
+}
+
+static void free_config(rabbitmq_publisher_config *config) {
+  free(config->hostname);
+  free(config->vhost);
+  free(config->user);
+  free(config->pass);
+  free(config->queuename);
+  free(config->exchange);
+  free(config->exchange_type);
+  free(config->content_type);
+}
+
+int rabbitmq_publisher_start(rabbitmq_publisher *pub,
+             const rabbitmq_publisher_config *config) {
+  if (pub->started)
+    return 0;
+  if (payload_ring_init(&pub->ring, config->depth, config->policy) < 0)
+    return -1;
+
+  pub->config = *config;
+  pub->config.hostname = strdup(config->hostname);
+  pub->config.vhost = strdup(config->vhost);
+  pub->config.user = strdup(config->user);
+  pub->config.pass = strdup(config->pass);
+  pub->config.queuename = strdup(config->queuename);
+  pub->config.exchange = config->exchange && config->exchange[0]
+      ? strdup(config->exchange) : NULL;
+  pub->config.exchange_type = !pub->config.exchange ? NULL
+      : strdup(config->exchange_type ? config->exchange_type : "topic");
+  pub->config.content_type = strdup(config->content_type);
+  json_writer_init(&pub->json_batch);
+  dsmeta_bin_writer_init(&pub->bin_batch);
+  pub->batch_frames = 0;
+  pub->batch_deadline_ms = 0;
+  pthread_mutex_init(&pub->preamble_lock, NULL);
+  pub->preamble = NULL;
+  pub->preamble_len = 0;
+  pub->preamble_cap = 0;
+  pub->preamble_key[0] = '\0';
+  atomic_init(&pub->preamble_generation, 0);
+  pub->preamble_applied = 0;
+  atomic_init(&pub->flush_requested, 0);
+  pthread_mutex_init(&pub->flush_lock, NULL);
+  pthread_cond_init(&pub->flushed, NULL);
+  atomic_init(&pub->published, 0);
+  atomic_init(&pub->messages, 0);
+  atomic_init(&pub->bytes, 0);
+  atomic_init(&pub->failed, 0);
+  atomic_init(&pub->round_trips, 0);
+  atomic_init(&pub->connects, 0);
+  atomic_init(&pub->disconnects, 0);
+  atomic_init(&pub->replay_dropped, 0);
+  atomic_init(&pub->confirmed, 0);
+  atomic_init(&pub->retried, 0);
+  atomic_init(&pub->inflight, 0);
+  pub->sources = NULL;
+  pub->num_sources = 0;
+  pub->sources_capacity = 0;
+  atomic_init(&pub->losses, 0);
+  pub->ring.on_discard = note_discard;
+  pub->ring.on_discard_arg = pub;
+
+  // Connect on the caller's thread so the handshake is paid before the first
+  // payload arrives. The connection is handed over to the publisher thread.
+  pub->cli = new_rabbitmq_client(pub->config.hostname, pub->config.port,
+                                 pub->config.vhost, pub->config.user,
+                                 pub->config.pass, pub->config.heartbeat,
+                                 pub->config.replay_depth);
+  if (pub->config.confirm &&
+      rabbitmq_cli_enable_confirms(&pub->cli, pub->config.confirm_window,
+                                   pub->config.confirm_timeout_ms) < 0)
+    printf("Error enabling publisher confirms, publishing without them\n");
+  if (pub->config.exchange)
+    rabbitmq_cli_declare_exchange(&pub->cli, pub->config.exchange,
+                                  pub->config.exchange_type);
+  else
+    rabbitmq_cli_declare_queue(&pub->cli, pub->config.queuename);
+  mirror_counters(pub);
+
+  if (pthread_create(&pub->thread, NULL, publisher_loop, pub) != 0) {
+    printf("Error starting publisher thread\n");
+    rabbitmq_cli_close(&pub->cli);
+    pthread_cond_destroy(&pub->flushed);
+    pthread_mutex_destroy(&pub->flush_lock);
+    pthread_mutex_destroy(&pub->preamble_lock);
+    free_config(&pub->config);
+    payload_ring_destroy(&pub->ring);
+    return -1;
+  }
+  pub->started = 1;
+  return 0;
+}
+
+int rabbitmq_publisher_enqueue(rabbitmq_publisher *pub, uint32_t source_id,
+             const char *routing_key, const char *payload, size_t len) {
+  if (!pub->started)
+    return -1;
+  return payload_ring_push(&pub->ring, source_id, routing_key, payload, len);
+}
+
+int rabbitmq_publisher_take_dropped(rabbitmq_publisher *pub, uint32_t source_id) {
+  unsigned long losses = atomic_load(&pub->losses);
+  rabbitmq_publisher_source *src = find_source(pub, source_id);
+  int dropped;
+
+  // Without a record of the source, assume the worst.
+  if (!src)
+    return 1;
+  dropped = src->dropped || src->losses != losses;
+  src->dropped = 0;
+  src->losses = losses;
+  return dropped;
+}
+
+int rabbitmq_publisher_set_preamble(rabbitmq_publisher *pub, const char *routing_key,
+             const void *data, size_t len) {
+  size_t key_len = routing_key ? strnlen(routing_key, PAYLOAD_RING_MAX_KEY) : 0;
+
+  if (!pub->started)
+    return -1;
+  pthread_mutex_lock(&pub->preamble_lock);
+  if (len > pub->preamble_cap) {
+    char *grown = realloc(pub->preamble, len);
+
+    if (!grown) {
+      pthread_mutex_unlock(&pub->preamble_lock);
+      return -1;
+    }
+    pub->preamble = grown;
+    pub->preamble_cap = len;
+  }
+  if (len)
+    memcpy(pub->preamble, data, len);
+  pub->preamble_len = len;
+  if (key_len)
+    memcpy(pub->preamble_key, routing_key, key_len);
+  pub->preamble_key[key_len] = '\0';
+  atomic_fetch_add(&pub->preamble_generation, 1);
+  pthread_mutex_unlock(&pub->preamble_lock);
+  payload_ring_interrupt(&pub->ring);
+  return 0;
+}
+
+int rabbitmq_publisher_flush(rabbitmq_publisher *pub, int timeout_ms) {
+  struct timespec deadline;
+  int ret = 0;
+
+  if (!pub->started)
+    return 0;
+
+  clock_gettime(CLOCK_REALTIME, &deadline);
+  deadline.tv_sec += timeout_ms / 1000;
+  deadline.tv_nsec += (long) (timeout_ms % 1000) * 1000000;
+  if (deadline.tv_nsec >= 1000000000) {
+    deadline.tv_sec++;
+    deadline.tv_nsec -= 1000000000;
+  }
+
+  pthread_mutex_lock(&pub->flush_lock);
+  atomic_store(&pub->flush_requested, 1);
+  payload_ring_interrupt(&pub->ring);
+  while (atomic_load(&pub->flush_requested)) {
+    if (pthread_cond_timedwait(&pub->flushed, &pub->flush_lock, &deadline) == ETIMEDOUT) {
+      ret = -1;
+      break;
+    }
+  }
+  pthread_mutex_unlock(&pub->flush_lock);
+  return ret;
+}
+
+void rabbitmq_publisher_get_stats(rabbitmq_publisher *pub, rabbitmq_publisher_stats *stats) {
+  stats->published = atomic_load(&pub->published);
+  stats->messages = atomic_load(&pub->messages);
+  stats->bytes = atomic_load(&pub->bytes);
+  stats->failed = atomic_load(&pub->failed);
+  stats->dropped = atomic_load(&pub->replay_dropped);
+  stats->enqueue_allocations = 0;
+  if (pub->started) {
+    stats->dropped += atomic_load(&pub->ring.dropped);
+    stats->enqueue_allocations = atomic_load(&pub->ring.grows);
+  }
+  stats->queue_depth = rabbitmq_publisher_queue_depth(pub);
+  stats->connects = atomic_load(&pub->connects);
+  stats->disconnects = atomic_load(&pub->disconnects);
+  stats->confirmed = atomic_load(&pub->confirmed);
+  stats->retried = atomic_load(&pub->retried);
+  stats->inflight = atomic_load(&pub->inflight);
+}
+
+size_t rabbitmq_publisher_queue_depth(rabbitmq_publisher *pub) {
+  if (!pub->started)
+    return 0;
+  return payload_ring_depth(&pub->ring);
+}
+
+double rabbitmq_publisher_round_trips_per_message(rabbitmq_publisher *pub) {
+  unsigned long messages = atomic_load(&pub->messages);
+
+  if (messages == 0)
+    return 0.0;
+  return (double) atomic_load(&pub->round_trips) / messages;
+}
+
+void rabbitmq_publisher_stop(rabbitmq_publisher *pub) {
+  if (!pub->started)
+    return;
+  payload_ring_close(&pub->ring);
+  pthread_join(pub->thread, NULL);
+  payload_ring_destroy(&pub->ring);
+
+  json_writer_free(&pub->json_batch);
+  dsmeta_bin_writer_free(&pub->bin_batch);
+  pthread_cond_destroy(&pub->flushed);
+  pthread_mutex_destroy(&pub->flush_lock);
+  pthread_mutex_destroy(&pub->preamble_lock);
+  free(pub->preamble);
+  pub->preamble = NULL;
+  free(pub->sources);
+  pub->sources = NULL;
+  pub->num_sources = 0;
+  pub->sources_capacity = 0;
+  free_config(&pub->config);
+  pub->started = 0;
+}
@@ -0,0 +1,166 @@
+// Copyright 2022, Kyota Tashiro, Mengheng Lee, and Latona Inc.
+// License MIT
+#ifndef MQ_PUBLISHER
+#define MQ_PUBLISHER
+#include <pthread.h>
+#include <stdatomic.h>
+#include "payload-ring.h"
+#include "rabbitmq-client.h"
+#include "json-writer.h"
+#include "dsmeta-binary.h"
+
+// Envelope used when several queued payloads are coalesced into one message.
+typedef enum {
+  RABBITMQ_BATCH_JSON_ARRAY,
+  RABBITMQ_BATCH_DSMETA_BIN,
+} rabbitmq_batch_format;
+
+typedef struct rabbitmq_publisher_config {
+  char *hostname;
+  int port;
+  char *vhost;
+  char *user;
+  char *pass;
+  char *queuename;
+  // Publish to this exchange instead of queuename when set and not empty;
+  // exchange_type is one of direct, fanout, topic or headers.
+  char *exchange;
+  char *exchange_type;
+  char *content_type;
+  int heartbeat;
+  size_t replay_depth;
+  // Publisher confirms; confirm_window and confirm_timeout_ms are ignored
+  // when confirm is 0.
+  int confirm;
+  size_t confirm_window;
+  unsigned int confirm_timeout_ms;
+  size_t depth;
+  payload_ring_policy policy;
+  // A batch is published once it holds batch_max_frames payloads, would grow
+  // past batch_max_bytes (0 for no limit), or its first payload has waited
+  // linger_ms. batch_max_frames <= 1 publishes every payload on its own.
+  unsigned int batch_max_frames;
+  size_t batch_max_bytes;
+  unsigned int linger_ms;
+  rabbitmq_batch_format batch_format;
+} rabbitmq_publisher_config;
+
+// Whether a payload of a source was dropped since the producer last asked.
+typedef struct rabbitmq_publisher_source {
+  uint32_t source_id;
+  int dropped;
+  // Value of losses when the producer last asked.
+  unsigned long losses;
+} rabbitmq_publisher_source;
+
+// Owns a RabbitMQ connection and the thread that publishes to it, so the
+// caller only ever copies a payload into the ring.
+typedef struct rabbitmq_publisher {
+  rabbitmq_cli cli;
+  payload_ring ring;
+  pthread_t thread;
+  int started;
+  rabbitmq_publisher_config config;
+  json_writer json_batch;
+  dsmeta_bin_writer bin_batch;
+  unsigned int batch_frames;
+  long long batch_deadline_ms;
+  // Routing key shared by every payload of the open batch.
+  char batch_key[PAYLOAD_RING_MAX_KEY + 1];
+  // Preamble handed over by rabbitmq_publisher_set_preamble; the thread
+  // passes it on to the client once it sees a new generation.
+  pthread_mutex_t preamble_lock;
+  char preamble_key[PAYLOAD_RING_MAX_KEY + 1];
+  char *preamble;
+  size_t preamble_len;
+  size_t preamble_cap;
+  atomic_ulong preamble_generation;
+  unsigned long preamble_applied;
+  atomic_int flush_requested;
+  pthread_mutex_t flush_lock;
+  pthread_cond_t flushed;
+  atomic_ulong published;
+  atomic_ulong messages;
+  atomic_ulong bytes;
+  atomic_ulong failed;
+  atomic_ulong round_trips;
+  atomic_ulong connects;
+  atomic_ulong disconnects;
+  atomic_ulong replay_dropped;
+  atomic_ulong confirmed;
+  atomic_ulong retried;
+  atomic_ulong inflight;
+  // Sources the producer has enqueued for, only touched on its thread.
+  rabbitmq_publisher_source *sources;
+  size_t num_sources;
+  size_t sources_capacity;
+  // Messages lost after leaving the ring. A batch can hold frames of any
+  // source, so each of these counts against every source.
+  atomic_ulong losses;
+} rabbitmq_publisher;
+
+typedef struct rabbitmq_publisher_stats {
+  // Frames sent to the broker, or acked by it with confirms on, and the
+  // messages and bytes they took; frames outnumber messages when batching.
+  // Frames kept for replay while disconnected are not counted until sent.
+  unsigned long published;
+  unsigned long messages;
+  unsigned long bytes;
+  unsigned long failed;
+  // Payloads discarded because the publish queue or the replay ring was full.
+  unsigned long dropped;
+  unsigned long connects;
+  unsigned long disconnects;
+  // Messages acked by the broker, and messages sent again after a nack, a
+  // confirm timeout or a lost connection.
+  unsigned long confirmed;
+  unsigned long retried;
+  // Messages waiting for a confirm, and payloads waiting in the publish queue.
+  unsigned long inflight;
+  unsigned long queue_depth;
+  // Publish queue buffers grown by enqueue, on the caller's thread.
+  unsigned long enqueue_allocations;
+} rabbitmq_publisher_stats;
+
+// Makes the first connection attempt and starts the publisher thread. A broker
+// that cannot be reached yet is retried in the background, so this only fails
+// when the thread cannot be started. The config strings are copied.
+int rabbitmq_publisher_start(rabbitmq_publisher *pub,
+             const rabbitmq_publisher_config *config);
+
+// Never touches the network. routing_key may be NULL to publish to the queue.
+// Returns -1 when the payload was dropped.
+int rabbitmq_publisher_enqueue(rabbitmq_publisher *pub, uint32_t source_id,
+             const char *routing_key, const char *payload, size_t len);
+
+// Returns 1 when a payload of source_id that enqueue had accepted was dropped
+// since the last call for it, so its next payload should not depend on the
+// ones before, e.g. be a keyframe. A source is followed from its first call
+// on, which returns 0. Must be called from the thread that enqueues.
+int rabbitmq_publisher_take_dropped(rabbitmq_publisher *pub, uint32_t source_id);
+
+// Has the publisher thread send a copy of data ahead of everything else on
+// every connection, see rabbitmq_cli_set_preamble. Payloads enqueued after
+// this call are published after the new preamble. routing_key may be NULL.
+int rabbitmq_publisher_set_preamble(rabbitmq_publisher *pub, const char *routing_key,
+             const void *data, size_t len);
+
+// Publishes everything queued or batched so far, waiting at most timeout_ms.
+// Returns 0 when the publisher caught up in time.
+int rabbitmq_publisher_flush(rabbitmq_publisher *pub, int timeout_ms);
+
+// Snapshot of the counters; safe to call from any thread.
+void rabbitmq_publisher_get_stats(rabbitmq_publisher *pub, rabbitmq_publisher_stats *stats);
+
+// Payloads waiting in the publish queue; cheap enough to poll per buffer.
+size_t rabbitmq_publisher_queue_depth(rabbitmq_publisher *pub);
+
+// Mirrors rabbitmq_cli_round_trips_per_message, dividing by messages rather
+// than frames so batching does not hide round-trips; safe to call from any
+// thread.
+double rabbitmq_publisher_round_trips_per_message(rabbitmq_publisher *pub);
+
+// Publishes whatever is still queued, then closes the connection.
+void rabbitmq_publisher_stop(rabbitmq_publisher *pub);
+
+#endif
@@ -0,0 +1,125 @@
+// Copyright 2022, Kyota Tashiro, Mengheng Lee, and Latona Inc.
+// License MIT
+
+#include <string.h>
+#include "routing-key.h"
+
+static const struct {
+  const char *name;
+  routing_key_field field;
+} placeholders[] = {
+  {"{source_id}", ROUTING_KEY_SOURCE_ID},
+  {"{class_id}", ROUTING_KEY_CLASS_ID},
+  {"{label}", ROUTING_KEY_LABEL},
+};
+
+static int add_part(routing_key_template *t, routing_key_field field,
+             size_t offset, size_t len) {
+  if (t->num_parts == ROUTING_KEY_MAX_PARTS)
+    return -1;
+  t->parts[t->num_parts].field = field;
+  t->parts[t->num_parts].offset = offset;
+  t->parts[t->num_parts].len = len;
+  t->num_parts++;
+  return 0;
+}
+
+int routing_key_parse(routing_key_template *t, const char *text) {
+  size_t len = text ? strlen(text) : 0;
+  size_t literal = 0;
+  size_t pos = 0;
+  size_t i;
+
+  t->text[0] = '\0';
+  t->num_parts = 0;
+  t->per_class = 0;
+  if (len > ROUTING_KEY_MAX)
+    return -1;
+  if (len)
+    memcpy(t->text, text, len + 1);
+
+  while (pos < len) {
+    if (t->text[pos] != '{') {
+      pos++;
+      continue;
+    }
+    for (i = 0; i < sizeof(placeholders) / sizeof(placeholders[0]); i++) {
+      if (strncmp(t->text + pos, placeholders[i].name, strlen(placeholders[i].name)) == 0)
+        break;
+    }
+    if (i == sizeof(placeholders) / sizeof(placeholders[0]))
+      return -1;
+    if (pos > literal && add_part(t, ROUTING_KEY_LITERAL, literal, pos - literal) < 0)
+      return -1;
+    if (add_part(t, placeholders[i].field, 0, 0) < 0)
+      return -1;
+    if (placeholders[i].field != ROUTING_KEY_SOURCE_ID)
+      t->per_class = 1;
+    pos += strlen(placeholders[i].name);
+    literal = pos;
+  }
+  if (pos > literal && add_part(t, ROUTING_KEY_LITERAL, literal, pos - literal) < 0)
+    return -1;
+  return 0;
+}
+
+// Appends up to len bytes, keeping room for the terminator.
+static size_t append(char *out, size_t at, const char *s, size_t len) {
+  if (len > ROUTING_KEY_MAX - at)
+    len = ROUTING_KEY_MAX - at;
+  memcpy(out + at, s, len);
+  return at + len;
+}
+
+static size_t append_int(char *out, size_t at, long long value) {
+  char digits[24];
+  size_t n = sizeof(digits);
+  unsigned long long v = value < 0 ? 0ull - (unsigned long long) value
+                                   : (unsigned long long) value;
+
+  do {
+    digits[--n] = (char) ('0' + v % 10);
+    v /= 10;
+  } while (v);
+  if (value < 0)
+    digits[--n] = '-';
+  return append(out, at, digits + n, sizeof(digits) - n);
+}
+
+static size_t append_label(char *out, size_t at, const char *label) {
+  if (!label || !*label)
+    return append(out, at, "unknown", 7);
+  for (; *label && at < ROUTING_KEY_MAX; label++) {
+    char c = *label;
+
+    out[at++] = c == '.' || c == '*' || c == '#' || c == ' ' ? '_' : c;
+  }
+  return at;
+}
+
+size_t routing_key_render(const routing_key_template *t, char *out,
+             uint32_t source_id, int class_id, const char *label) {
+  size_t at = 0;
+  size_t i;
+
+  for (i = 0; i < t->num_parts; i++) {
+    const routing_key_part *part = &t->parts[i];
+
+    switch (part->field) {
+      case ROUTING_KEY_LITERAL:
+        at = append(out, at, t->text + part->offset, part->len);
+        break;
+      case ROUTING_KEY_SOURCE_ID:
+        at = append_int(out, at, source_id);
+        break;
+      case ROUTING_KEY_CLASS_ID:
+        at = append_int(out, at, class_id);
+        break;
+      case ROUTING_KEY_LABEL:
+        at = append_label(out, at, label);
+        break;
+    }
+  }
+  out[at] = '\0';
+  return at;
+}
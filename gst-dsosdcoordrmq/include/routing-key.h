@@ -0,0 +1,53 @@
+// Copyright 2022, Kyota Tashiro, Mengheng Lee, and Latona Inc.
+// License MIT
+#ifndef ROUTING_KEY
+#define ROUTING_KEY
+#include <stddef.h>
+#include <stdint.h>
+
+// Routing key templates such as "cam.{source_id}.{label}". The template is
+// parsed once; rendering only copies into a caller-provided buffer, so it
+// can run for every published frame.
+//
+// Placeholders: {source_id}, {class_id} and {label}. Characters that have a
+// meaning in topic bindings ('.', '*', '#') and spaces are replaced by '_'
+// in labels, so a label is always exactly one word of the key.
+
+// Longest key AMQP allows (a short string).
+#define ROUTING_KEY_MAX 255
+#define ROUTING_KEY_MAX_PARTS 32
+
+typedef enum {
+  ROUTING_KEY_LITERAL,
+  ROUTING_KEY_SOURCE_ID,
+  ROUTING_KEY_CLASS_ID,
+  ROUTING_KEY_LABEL,
+} routing_key_field;
+
+typedef struct routing_key_part {
+  routing_key_field field;
+  // Literal text, as an offset into the template's copy of the text.
+  size_t offset;
+  size_t len;
+} routing_key_part;
+
+typedef struct routing_key_template {
+  char text[ROUTING_KEY_MAX + 1];
+  routing_key_part parts[ROUTING_KEY_MAX_PARTS];
+  size_t num_parts;
+  // Set when the key depends on the class, i.e. every class of a frame needs
+  // a message of its own.
+  int per_class;
+} routing_key_template;
+
+// Returns -1 on an unknown or unterminated placeholder, or when the template
+// is longer than ROUTING_KEY_MAX or has too many parts. An empty template
+// renders as an empty key.
+int routing_key_parse(routing_key_template *t, const char *text);
+
+// Renders into out, which must hold ROUTING_KEY_MAX + 1 bytes; keys that
+// would be longer are truncated. label may be NULL. Returns the key length.
+size_t routing_key_render(const routing_key_template *t, char *out,
+             uint32_t source_id, int class_id, const char *label);
+
+#endif
@@ -0,0 +1,226 @@
+// Copyright 2022, Kyota Tashiro, Mengheng Lee, and Latona Inc.
+// License MIT
+
+#include <stdlib.h>
+#include <string.h>
+#include "text-atlas.h"
+
+#define INITIAL_BUCKETS 64
+// Bitmaps start on this boundary inside their entry.
+#define COVERAGE_ALIGN 16
+
+static uint32_t hash_bytes(uint32_t h, const void *bytes, size_t len) {
+  const unsigned char *p = bytes;
+  size_t i;
+
+  for (i = 0; i < len; i++) {
+    h ^= p[i];
+    h *= 16777619u;
+  }
+  return h;
+}
+
+// FNV-1a over the font with its terminator, the size and the text.
+static uint32_t hash_key(const char *font, unsigned int size, const char *text) {
+  uint32_t h = 2166136261u;
+
+  h = hash_bytes(h, font, strlen(font) + 1);
+  h = hash_bytes(h, &size, sizeof(size));
+  return hash_bytes(h, text, strlen(text));
+}
+
+static void lru_unlink(text_atlas *a, text_atlas_entry *e) {
+  if (e->lru_prev)
+    e->lru_prev->lru_next = e->lru_next;
+  else
+    a->lru_first = e->lru_next;
+  if (e->lru_next)
+    e->lru_next->lru_prev = e->lru_prev;
+  else
+    a->lru_last = e->lru_prev;
+}
+
+static void lru_push_front(text_atlas *a, text_atlas_entry *e) {
+  e->lru_prev = NULL;
+  e->lru_next = a->lru_first;
+  if (a->lru_first)
+    a->lru_first->lru_prev = e;
+  else
+    a->lru_last = e;
+  a->lru_first = e;
+}
+
+// A held run is only taken out of the atlas; the last release frees it.
+static void remove_entry(text_atlas *a, text_atlas_entry *e) {
+  text_atlas_entry **link = &a->buckets[e->hash & (a->num_buckets - 1)];
+
+  while (*link != e)
+    link = &(*link)->hash_next;
+  *link = e->hash_next;
+  lru_unlink(a, e);
+  a->bytes -= e->bytes;
+  a->count--;
+  if (e->refs)
+    e->evicted = 1;
+  else
+    free(e);
+}
+
+// Keeps the chains short by doubling the buckets once there are more entries
+// than buckets. Failing to grow only makes the chains longer.
+static void grow_buckets(text_atlas *a) {
+  unsigned int num_buckets = a->num_buckets ? a->num_buckets * 2 : INITIAL_BUCKETS;
+  text_atlas_entry **buckets;
+  text_atlas_entry *e;
+  unsigned int i;
+
+  if (a->count < a->num_buckets)
+    return;
+  buckets = calloc(num_buckets, sizeof(*buckets));
+  if (!buckets)
+    return;
+  for (i = 0; i < a->num_buckets; i++) {
+    while ((e = a->buckets[i])) {
+      a->buckets[i] = e->hash_next;
+      e->hash_next = buckets[e->hash & (num_buckets - 1)];
+      buckets[e->hash & (num_buckets - 1)] = e;
+    }
+  }
+  free(a->buckets);
+  a->buckets = buckets;
+  a->num_buckets = num_buckets;
+  a->grows++;
+}
+
+void text_atlas_init(text_atlas *a, size_t max_bytes) {
+  memset(a, 0, sizeof(*a));
+  a->max_bytes = max_bytes;
+}
+
+void text_atlas_free(text_atlas *a) {
+  text_atlas_entry *e = a->lru_first;
+  text_atlas_entry *next;
+
+  while (e) {
+    next = e->lru_next;
+    free(e);
+    e = next;
+  }
+  free(a->buckets);
+  text_atlas_init(a, a->max_bytes);
+}
+
+const text_atlas_entry *text_atlas_find(text_atlas *a, const char *font, unsigned int size,
+                                        const char *text) {
+  uint32_t hash = hash_key(font, size, text);
+  text_atlas_entry *e;
+
+  if (a->num_buckets) {
+    for (e = a->buckets[hash & (a->num_buckets - 1)]; e; e = e->hash_next) {
+      if (e->hash == hash && e->size == size && strcmp(e->font, font) == 0 &&
+          strcmp(e->text, text) == 0) {
+        lru_unlink(a, e);
+        lru_push_front(a, e);
+        e->refs++;
+        a->hits++;
+        return e;
+      }
+    }
+  }
+  a->misses++;
+  return NULL;
+}
+
+text_atlas_entry *text_atlas_add(text_atlas *a, const char *font, unsigned int size,
+                                 const char *text, unsigned int width, unsigned int height,
+                                 unsigned int stride) {
+  size_t font_len = strlen(font) + 1;
+  size_t text_len = strlen(text) + 1;
+  size_t coverage_offset = (sizeof(text_atlas_entry) + font_len + text_len +
+                            COVERAGE_ALIGN - 1) / COVERAGE_ALIGN * COVERAGE_ALIGN;
+  size_t bytes;
+  text_atlas_entry *e;
+  char *key;
+
+  if (stride < width || (height && stride > (SIZE_MAX - coverage_offset) / height)) {
+    a->dropped++;
+    return NULL;
+  }
+  bytes = coverage_offset + (size_t) stride * height;
+  if (bytes > a->max_bytes) {
+    a->dropped++;
+    return NULL;
+  }
+  while (a->bytes + bytes > a->max_bytes) {
+    remove_entry(a, a->lru_last);
+    a->evictions++;
+  }
+  e = calloc(1, bytes);
+  if (!e) {
+    a->dropped++;
+    return NULL;
+  }
+  grow_buckets(a);
+  if (!a->num_buckets) {
+    free(e);
+    a->dropped++;
+    return NULL;
+  }
+
+  key = (char *) (e + 1);
+  memcpy(key, font, font_len);
+  memcpy(key + font_len, text, text_len);
+  e->hash = hash_key(font, size, text);
+  e->font = key;
+  e->size = size;
+  e->text = key + font_len;
+  e->coverage = (uint8_t *) e + coverage_offset;
+  e->width = width;
+  e->height = height;
+  e->stride = stride;
+  e->bytes = bytes;
+  e->refs = 1;
+  e->hash_next = a->buckets[e->hash & (a->num_buckets - 1)];
+  a->buckets[e->hash & (a->num_buckets - 1)] = e;
+  lru_push_front(a, e);
+  a->bytes += bytes;
+  a->count++;
+  return e;
+}
+
+void text_atlas_release(text_atlas *a, const text_atlas_entry *e) {
+  text_atlas_entry *held = (text_atlas_entry *) e;
+
+  (void) a;
+  if (--held->refs == 0 && held->evicted)
+    free(held);
+}
+
+static inline int max_int(int a, int b) {
+  return a > b ? a : b;
+}
+
+static inline int min_int(int a, int b) {
+  return a < b ? a : b;
+}
+
+void text_atlas_blit(const cpu_render_kernels *k, const cpu_render_target *t,
+                     const text_atlas_entry *e, int x, int y, const uint8_t color[4],
+                     const uint8_t *bg_color) {
+  int x0 = max_int(x, 0);
+  int y0 = max_int(y, 0);
+  int x1 = min_int(x + (int) e->width, (int) t->width);
+  int y1 = min_int(y + (int) e->height, (int) t->height);
+  int row;
+
+  if (x0 >= x1 || y0 >= y1)
+    return;
+  for (row = y0; row < y1; row++) {
+    uint8_t *pixels = t->pixels + (size_t) row * t->pitch + (size_t) x0 * 4;
+
+    if (bg_color)
+      k->blend_span(pixels, (unsigned int) (x1 - x0), bg_color);
+    k->blend_coverage(pixels, e->coverage + (size_t) (row - y) * e->stride + (x0 - x),
+                      (unsigned int) (x1 - x0), color);
+  }
+}
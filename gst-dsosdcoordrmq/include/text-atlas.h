@@ -0,0 +1,83 @@
+// Copyright 2022, Kyota Tashiro, Mengheng Lee, and Latona Inc.
+// License MIT
+#ifndef TEXT_ATLAS
+#define TEXT_ATLAS
+#include <stddef.h>
+#include <stdint.h>
+#include "cpu-render.h"
+#include "cpu-render-kernels.h"
+
+// Rasterized text runs keyed by font, size and text. A run is kept as a
+// coverage bitmap and takes its color when it is blitted, so one entry serves
+// a label in every color. The least recently used runs are evicted to stay
+// under a byte budget. The atlas is not thread-safe, but a run handed out by
+// it is held until released, so it can be blitted while other threads use the
+// atlas.
+
+typedef struct text_atlas_entry {
+  struct text_atlas_entry *hash_next;
+  // Most recently used first.
+  struct text_atlas_entry *lru_prev;
+  struct text_atlas_entry *lru_next;
+  uint32_t hash;
+  const char *font;
+  unsigned int size;
+  const char *text;
+  // Rows of stride bytes, 0 leaving the pixel alone and 255 covering it.
+  uint8_t *coverage;
+  unsigned int width;
+  unsigned int height;
+  unsigned int stride;
+  // Counted against the budget, the key and the bitmap included.
+  size_t bytes;
+  // Holders of the run. An evicted run leaves the atlas and its budget at
+  // once but is only freed when the last holder releases it.
+  unsigned int refs;
+  int evicted;
+} text_atlas_entry;
+
+typedef struct text_atlas {
+  text_atlas_entry **buckets;
+  unsigned int num_buckets;
+  unsigned int count;
+  text_atlas_entry *lru_first;
+  text_atlas_entry *lru_last;
+  size_t bytes;
+  size_t max_bytes;
+  unsigned long hits;
+  unsigned long misses;
+  unsigned long evictions;
+  // Runs that could not be added, being over the budget on their own or
+  // memory running out.
+  unsigned long dropped;
+  // Number of times the buckets were grown.
+  unsigned long grows;
+} text_atlas;
+
+void text_atlas_init(text_atlas *a, size_t max_bytes);
+
+// Every run must have been released.
+void text_atlas_free(text_atlas *a);
+
+// The cached run, which becomes the most recently used, or NULL. Counted as a
+// hit or a miss. The caller holds the run until text_atlas_release.
+const text_atlas_entry *text_atlas_find(text_atlas *a, const char *font, unsigned int size,
+                                        const char *text);
+
+// Adds a run with a zeroed bitmap for the caller to rasterize into, evicting
+// runs as needed. stride is at least width. NULL when the run cannot be added.
+// The caller holds the run until text_atlas_release.
+text_atlas_entry *text_atlas_add(text_atlas *a, const char *font, unsigned int size,
+                                 const char *text, unsigned int width, unsigned int height,
+                                 unsigned int stride);
+
+// Lets go of a run returned by text_atlas_find or text_atlas_add.
+void text_atlas_release(text_atlas *a, const text_atlas_entry *e);
+
+// Blends the run in color onto t with its top left corner at x, y, over a box
+// of its size filled with bg_color first unless bg_color is NULL.
+void text_atlas_blit(const cpu_render_kernels *k, const cpu_render_target *t,
+                     const text_atlas_entry *e, int x, int y, const uint8_t color[4],
+                     const uint8_t *bg_color);
+
+#endif
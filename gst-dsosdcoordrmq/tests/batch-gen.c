@@ -0,0 +1,211 @@
+// Copyright 2022, Kyota Tashiro, Mengheng Lee, and Latona Inc.
+// License MIT
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "batch-gen.h"
+
+#define FRAME_DURATION_NS 33333333ull
+
+const char *const batch_gen_labels[4] = {"Car", "Bicycle", "Person", "Roadsign"};
+
+static uint32_t next_random(batch_gen *g) {
+  // xorshift32
+  g->rng ^= g->rng << 13;
+  g->rng ^= g->rng >> 17;
+  g->rng ^= g->rng << 5;
+  return g->rng;
+}
+
+// Uniform in [low, high).
+static float random_between(batch_gen *g, float low, float high) {
+  return low + (high - low) * (float) (next_random(g) >> 8) / (float) (1u << 24);
+}
+
+static void link(GList *l, gpointer data, GList *prev, GList *next) {
+  l->data = data;
+  l->prev = prev;
+  l->next = next;
+}
+
+// Gives the object at index a new identity, box and course.
+static void spawn(batch_gen *g, size_t index) {
+  NvDsObjectMeta *o = &g->objects[index];
+  unsigned int i = (unsigned int) (index % g->config.objects_per_frame);
+  int class_id = (int) (i % g->config.num_classes);
+  float width = random_between(g, 16.0f, g->config.width / 4.0f);
+  float height = random_between(g, 16.0f, g->config.height / 4.0f);
+
+  o->class_id = class_id;
+  o->object_id = g->config.tracked ? g->next_object_id++ : UNTRACKED_OBJECT_ID;
+  o->confidence = random_between(g, 0.3f, 1.0f);
+  snprintf(o->obj_label, sizeof(o->obj_label), "%s", batch_gen_labels[class_id % 4]);
+  o->rect_params.left = random_between(g, 0.0f, g->config.width - width);
+  o->rect_params.top = random_between(g, 0.0f, g->config.height - height);
+  o->rect_params.width = width;
+  o->rect_params.height = height;
+  o->rect_params.border_width = 3;
+  o->rect_params.border_color = (NvOSD_ColorParams) {1.0, 0.0, 0.0, 1.0};
+  g->velocity[index * 2] = random_between(g, -4.0f, 4.0f);
+  g->velocity[index * 2 + 1] = random_between(g, -4.0f, 4.0f);
+  snprintf(g->texts[index], BATCH_GEN_MAX_TEXT, "%.24s %.2f", o->obj_label, o->confidence);
+}
+
+static void move(batch_gen *g, size_t index) {
+  NvOSD_RectParams *r = &g->objects[index].rect_params;
+  float *v = &g->velocity[index * 2];
+
+  r->left += v[0];
+  r->top += v[1];
+  if (r->left < 0.0f || r->left + r->width > g->config.width) {
+    v[0] = -v[0];
+    r->left += 2.0f * v[0];
+  }
+  if (r->top < 0.0f || r->top + r->height > g->config.height) {
+    v[1] = -v[1];
+    r->top += 2.0f * v[1];
+  }
+}
+
+static void fill_display(batch_gen *g, NvDsDisplayMeta *d, unsigned int source) {
+  unsigned int n = g->config.display_elements;
+  unsigned int i;
+
+  d->base_meta.meta_type = NVDS_DISPLAY_META;
+  d->num_rects = d->num_labels = d->num_lines = d->num_arrows = d->num_circles = n;
+  for (i = 0; i < n; i++) {
+    unsigned int x = 10 + 20 * i;
+    unsigned int y = 10 + 10 * source;
+
+    d->rect_params[i] = (NvOSD_RectParams) {
+      .left = (float) x, .top = (float) y, .width = 16, .height = 16, .border_width = 2,
+      .border_color = {0.0, 1.0, 0.0, 1.0}};
+    d->text_params[i] = (NvOSD_TextParams) {
+      .display_text = "zone", .x_offset = x, .y_offset = y,
+      .font_params = {.font_name = "Serif", .font_size = 10, .font_color = {1, 1, 1, 1}}};
+    d->line_params[i] = (NvOSD_LineParams) {x, y, x + 16, y + 16, 2, {0, 0, 1, 1}};
+    d->arrow_params[i] = (NvOSD_ArrowParams) {x, y + 16, x + 16, y, 2, END_HEAD, {1, 1, 0, 1}, 0};
+    d->circle_params[i] = (NvOSD_CircleParams) {x + 8, y + 8, 6, {0, 1, 1, 1}, 0, {0, 0, 0, 0}, 0};
+  }
+}
+
+int batch_gen_init(batch_gen *g, const batch_gen_config *config) {
+  size_t sources = config->num_sources;
+  size_t objects = sources * config->objects_per_frame;
+  size_t mask_len = (size_t) config->mask_size * config->mask_size;
+  size_t num_links = sources * 2 + objects;
+  GList *l;
+  size_t s, i;
+
+  memset(g, 0, sizeof(*g));
+  g->config = *config;
+  if (!g->config.num_classes)
+    g->config.num_classes = 4;
+  if (g->config.display_elements > MAX_ELEMENTS_IN_DISPLAY_META)
+    g->config.display_elements = MAX_ELEMENTS_IN_DISPLAY_META;
+  g->rng = config->seed ? config->seed : 1;
+  g->next_object_id = 1;
+  g->frame_num = -1;
+  g->frames = calloc(sources ? sources : 1, sizeof(*g->frames));
+  g->objects = calloc(objects ? objects : 1, sizeof(*g->objects));
+  g->display = calloc(sources ? sources : 1, sizeof(*g->display));
+  g->velocity = calloc(objects ? objects * 2 : 1, sizeof(*g->velocity));
+  g->texts = calloc(objects ? objects : 1, sizeof(*g->texts));
+  g->mask = calloc(mask_len ? mask_len : 1, sizeof(*g->mask));
+  g->links = calloc(num_links ? num_links : 1, sizeof(*g->links));
+  if (!g->frames || !g->objects || !g->display || !g->velocity || !g->texts || !g->mask ||
+      !g->links) {
+    batch_gen_free(g);
+    return -1;
+  }
+  for (i = 0; i < mask_len; i++)
+    g->mask[i] = (float) (i % 7) / 6.0f;
+
+  g->batch.base_meta.meta_type = NVDS_BATCH_META;
+  g->batch.max_frames_in_batch = config->num_sources;
+  g->batch.num_frames_in_batch = config->num_sources;
+  l = g->links;
+  g->batch.frame_meta_list = sources ? l : NULL;
+  for (s = 0; s < sources; s++)
+    link(&l[s], &g->frames[s], s ? &l[s - 1] : NULL, s + 1 < sources ? &l[s + 1] : NULL);
+  l += sources;
+  for (s = 0; s < sources; s++) {
+    NvDsFrameMeta *f = &g->frames[s];
+    NvDsObjectMeta *o = &g->objects[s * config->objects_per_frame];
+    size_t n = config->objects_per_frame;
+
+    f->base_meta.meta_type = NVDS_FRAME_META;
+    f->pad_index = (guint) s;
+    f->batch_id = (guint) s;
+    f->source_id = (guint) s;
+    f->source_frame_width = config->width;
+    f->source_frame_height = config->height;
+    f->num_obj_meta = (guint) n;
+    f->obj_meta_list = n ? l : NULL;
+    for (i = 0; i < n; i++) {
+      o[i].base_meta.meta_type = NVDS_OBJ_META;
+      o[i].unique_component_id = 1;
+      link(&l[i], &o[i], i ? &l[i - 1] : NULL, i + 1 < n ? &l[i + 1] : NULL);
+    }
+    l += n;
+    if (g->config.display_elements) {
+      link(l, &g->display[s], NULL, NULL);
+      f->display_meta_list = l;
+      fill_display(g, &g->display[s], (unsigned int) s);
+      l++;
+    }
+  }
+  for (i = 0; i < objects; i++) {
+    NvDsObjectMeta *o = &g->objects[i];
+
+    spawn(g, i);
+    o->text_params.display_text = g->texts[i];
+    o->text_params.x_offset = 0;
+    o->text_params.font_params.font_name = "Serif";
+    o->text_params.font_params.font_size = 10;
+    o->text_params.font_params.font_color = (NvOSD_ColorParams) {1.0, 1.0, 1.0, 1.0};
+    o->text_params.set_bg_clr = 1;
+    o->text_params.text_bg_clr = (NvOSD_ColorParams) {0.0, 0.0, 0.0, 1.0};
+    if (mask_len) {
+      o->mask_params.data = g->mask;
+      o->mask_params.size = (unsigned int) (mask_len * sizeof(float));
+      o->mask_params.threshold = 0.5f;
+      o->mask_params.width = config->mask_size;
+      o->mask_params.height = config->mask_size;
+    }
+  }
+  return 0;
+}
+
+void batch_gen_free(batch_gen *g) {
+  free(g->frames);
+  free(g->objects);
+  free(g->display);
+  free(g->velocity);
+  free(g->texts);
+  free(g->mask);
+  free(g->links);
+  memset(g, 0, sizeof(*g));
+}
+
+NvDsBatchMeta *batch_gen_next(batch_gen *g) {
+  size_t per_frame = g->config.objects_per_frame;
+  size_t s, i;
+
+  g->frame_num++;
+  for (s = 0; s < g->config.num_sources; s++) {
+    NvDsFrameMeta *f = &g->frames[s];
+
+    f->frame_num = g->frame_num;
+    f->buf_pts = (guint64) g->frame_num * FRAME_DURATION_NS;
+    f->ntp_timestamp = f->buf_pts;
+    if (g->frame_num == 0)
+      continue;
+    for (i = 0; i < per_frame; i++)
+      move(g, s * per_frame + i);
+    if (per_frame && g->config.churn_interval && g->frame_num % g->config.churn_interval == 0)
+      spawn(g, s * per_frame + (g->frame_num / g->config.churn_interval) % per_frame);
+  }
+  return &g->batch;
+}
@@ -0,0 +1,63 @@
+// Copyright 2022, Kyota Tashiro, Mengheng Lee, and Latona Inc.
+// License MIT
+#ifndef BATCH_GEN
+#define BATCH_GEN
+#include <stdint.h>
+#include "nvdsmeta.h"
+
+// Synthetic NvDsBatchMeta as nvstreammux and nvinfer would attach it: one
+// frame per source, each with the same number of detections moving around a
+// pipeline-sized picture. The same config and seed always give the same
+// sequence of batches, so tests can compare runs.
+
+#define BATCH_GEN_MAX_TEXT 32
+
+typedef struct batch_gen_config {
+  unsigned int num_sources;
+  unsigned int objects_per_frame;
+  // Classes cycle through the four of DeepStream's primary detector.
+  unsigned int num_classes;
+  unsigned int width;
+  unsigned int height;
+  // Objects get tracker ids, UNTRACKED_OBJECT_ID otherwise.
+  int tracked;
+  // Every churn_interval frames one object of each source leaves the scene
+  // and a new one takes its place, 0 for a fixed set of objects.
+  unsigned int churn_interval;
+  // Objects also carry an instance mask of mask_size x mask_size.
+  unsigned int mask_size;
+  // Each frame also carries a display meta with this many of every primitive,
+  // at most MAX_ELEMENTS_IN_DISPLAY_META.
+  unsigned int display_elements;
+  uint32_t seed;
+} batch_gen_config;
+
+typedef struct batch_gen {
+  batch_gen_config config;
+  NvDsBatchMeta batch;
+  NvDsFrameMeta *frames;
+  NvDsObjectMeta *objects;
+  NvDsDisplayMeta *display;
+  // Velocity of each object in pixels per frame, x then y.
+  float *velocity;
+  char (*texts)[BATCH_GEN_MAX_TEXT];
+  float *mask;
+  // Storage of the frame, object and display meta lists.
+  GList *links;
+  uint64_t next_object_id;
+  uint32_t rng;
+  int frame_num;
+} batch_gen;
+
+extern const char *const batch_gen_labels[4];
+
+// Returns -1 when memory runs out.
+int batch_gen_init(batch_gen *g, const batch_gen_config *config);
+
+void batch_gen_free(batch_gen *g);
+
+// Moves every object one frame on and returns the batch, valid until the
+// next call. The first call returns frame 0.
+NvDsBatchMeta *batch_gen_next(batch_gen *g);
+
+#endif
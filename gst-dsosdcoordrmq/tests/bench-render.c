@@ -0,0 +1,158 @@
+// Copyright 2022, Kyota Tashiro, Mengheng Lee, and Latona Inc.
+// License MIT
+
+// Time the tiled CPU renderer takes per 1920x1080 frame with 1 up to N
+// threads, for scenes of boxes with masks, and the speedup over 1 thread.
+//
+//   bench-render [--json] [--max-threads N] [--max-objects N] [--frames N]
+//
+// Prints CSV by default, one row per object count and thread count. Each
+// frame is checked against the serial reference once, so a faster run is
+// never a wrong one.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "cpu-render.h"
+#include "latency-histogram.h"
+
+#define WIDTH 1920
+#define HEIGHT 1080
+#define PITCH (WIDTH * 4)
+#define MASK_SIZE 28
+#define MAX_OBJECTS 4096
+#define DEFAULT_FRAMES 50
+
+static float scores[MASK_SIZE * MASK_SIZE];
+
+static uint32_t next_random(uint32_t *state) {
+  *state = *state * 1664525u + 1013904223u;
+  return *state >> 8;
+}
+
+// A box with a border, a translucent background and an instance mask for
+// every object, spread over the frame.
+static void fill_list(cpu_render_list *l, unsigned int objects) {
+  uint32_t state = objects + 1;
+  unsigned int i;
+
+  cpu_render_list_reset(l);
+  for (i = 0; i < objects; i++) {
+    cpu_render_rect *rc = cpu_render_list_add_rect(l);
+    cpu_render_mask *m = cpu_render_list_add_mask(l);
+
+    if (!rc || !m)
+      break;
+    *rc = (cpu_render_rect) {
+      .left = (int) (next_random(&state) % (WIDTH - 100)),
+      .top = (int) (next_random(&state) % (HEIGHT - 100)),
+      .width = 40 + (int) (next_random(&state) % 60),
+      .height = 40 + (int) (next_random(&state) % 60), .border_width = 3,
+      .border_color = {255, 0, 0, 255}, .has_bg_color = 1, .bg_color = {0, 0, 255, 64}};
+    *m = (cpu_render_mask) {
+      .left = rc->left, .top = rc->top, .width = rc->width, .height = rc->height,
+      .data = scores, .mask_width = MASK_SIZE, .mask_height = MASK_SIZE,
+      .threshold = 0.5f, .color = {0, 255, 0, 96}};
+  }
+}
+
+static void usage(const char *name) {
+  fprintf(stderr, "usage: %s [--json] [--max-threads N] [--max-objects N] [--frames N]\n",
+          name);
+}
+
+int main(int argc, char **argv) {
+  long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+  unsigned int max_threads = cpus > 1 ? (unsigned int) cpus : 1;
+  unsigned int max_objects = 1024;
+  unsigned int frames = DEFAULT_FRAMES;
+  uint8_t *pixels = malloc((size_t) PITCH * HEIGHT);
+  uint8_t *reference = malloc((size_t) PITCH * HEIGHT);
+  cpu_render_target target = {pixels, WIDTH, HEIGHT, PITCH};
+  cpu_render_target reference_target = {reference, WIDTH, HEIGHT, PITCH};
+  cpu_render_list list;
+  int json = 0;
+  int first = 1;
+  unsigned int objects, threads, f;
+  int i;
+
+  for (i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--json") == 0) {
+      json = 1;
+    } else if (i + 1 < argc && strcmp(argv[i], "--max-threads") == 0) {
+      max_threads = (unsigned int) strtoul(argv[++i], NULL, 10);
+    } else if (i + 1 < argc && strcmp(argv[i], "--max-objects") == 0) {
+      max_objects = (unsigned int) strtoul(argv[++i], NULL, 10);
+    } else if (i + 1 < argc && strcmp(argv[i], "--frames") == 0) {
+      frames = (unsigned int) strtoul(argv[++i], NULL, 10);
+    } else {
+      usage(argv[0]);
+      return 2;
+    }
+  }
+  if (max_threads < 1 || max_threads > CPU_RENDER_MAX_THREADS || max_objects > MAX_OBJECTS ||
+      frames < 1) {
+    usage(argv[0]);
+    return 2;
+  }
+  if (!pixels || !reference) {
+    fprintf(stderr, "out of memory\n");
+    return 1;
+  }
+  for (i = 0; i < MASK_SIZE * MASK_SIZE; i++)
+    scores[i] = (float) (i * 7 % 11) / 10.0f;
+  cpu_render_list_init(&list);
+
+  if (json)
+    printf("[");
+  else
+    printf("objects,threads,kernels,frames,ns_per_frame,speedup\n");
+  for (objects = 16; objects <= max_objects; objects *= 4) {
+    double single = 0.0;
+
+    fill_list(&list, objects);
+    memset(reference, 0, (size_t) PITCH * HEIGHT);
+    cpu_render_draw_serial(&reference_target, &list);
+    for (threads = 1; threads <= max_threads; threads++) {
+      cpu_renderer r;
+      uint64_t start;
+      double ns;
+
+      if (cpu_renderer_init(&r, threads) != threads) {
+        fprintf(stderr, "cannot start %u threads\n", threads);
+        return 1;
+      }
+      memset(pixels, 0, (size_t) PITCH * HEIGHT);
+      cpu_renderer_draw(&r, &target, &list);
+      if (memcmp(pixels, reference, (size_t) PITCH * HEIGHT) != 0) {
+        fprintf(stderr, "%u threads differ from the serial reference at %u objects\n",
+                threads, objects);
+        return 1;
+      }
+      start = latency_now_ns();
+      for (f = 0; f < frames; f++)
+        cpu_renderer_draw(&r, &target, &list);
+      ns = (double) (latency_now_ns() - start) / frames;
+      if (threads == 1)
+        single = ns;
+      if (json)
+        printf("%s\n  {\"objects\": %u, \"threads\": %u, \"kernels\": \"%s\", "
+               "\"frames\": %u, \"nsPerFrame\": %.1f, \"speedup\": %.2f}",
+               first ? "" : ",", objects, threads, r.kernels->name, frames, ns, single / ns);
+      else
+        printf("%u,%u,%s,%u,%.1f,%.2f\n", objects, threads, r.kernels->name, frames, ns,
+               single / ns);
+      first = 0;
+      fflush(stdout);
+      cpu_renderer_free(&r);
+    }
+  }
+  if (json)
+    printf("\n]\n");
+
+  cpu_render_list_free(&list);
+  free(pixels);
+  free(reference);
+  return 0;
+}
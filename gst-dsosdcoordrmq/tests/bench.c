@@ -0,0 +1,467 @@
+// Copyright 2022, Kyota Tashiro, Mengheng Lee, and Latona Inc.
+// License MIT
+
+// Cost of each stage dsmetarmq runs per frame, in ns and allocations per
+// frame, over object counts and batch sizes. Batches come from batch-gen and
+// are published to the fake broker, so nothing but the code under test runs.
+//
+//   bench [--json] [--max-objects N] [--max-batch N] [--frames N]
+//   bench --batching [--json] [--objects N] [--frames N]
+//
+// Prints CSV by default, one row per stage, object count and batch size.
+// Allocations are the growth counters the element sums into its
+// allocation-count property, taken once every buffer has grown to the
+// configuration, so a steady stream should show 0.
+//
+// --batching instead publishes pre-encoded JSON and binary frames through a
+// rabbitmq_publisher over batch_max_frames, batch_max_bytes and linger_ms,
+// and prints the messages, frames and bytes per second the broker received.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "batch-gen.h"
+#include "dsmeta-extract.h"
+#include "dsmeta-delta.h"
+#include "publisher-pool.h"
+#include "latency-histogram.h"
+#include "fake-amqp.h"
+
+#define MAX_BATCH 32
+#define MAX_OBJECTS 1024
+#define DEFAULT_FRAMES 4096
+#define QUEUE_DEPTH 256
+// Frames encoded up front for --batching, enqueued round robin.
+#define BATCHING_PAYLOADS 256
+#define BATCHING_SOURCES 8
+#define DEFAULT_BATCHING_OBJECTS 16
+
+typedef enum {
+  STAGE_EXTRACT,
+  STAGE_DELTA,
+  STAGE_JSON,
+  STAGE_BINARY,
+  STAGE_ENQUEUE,
+  NUM_STAGES,
+} stage;
+
+static const char *const stage_names[NUM_STAGES] = {
+  "extract", "delta", "json", "binary", "enqueue",
+};
+
+typedef struct result {
+  uint64_t ns;
+  unsigned long allocations;
+} result;
+
+typedef struct bench {
+  publisher_pool pool;
+  label_table labels;
+  dsmeta_delta delta;
+  // One frame and encoding per source, as the element keeps one per buffer.
+  dsmeta_frame frames[MAX_BATCH];
+  dsmeta_frame deltas[MAX_BATCH];
+  json_writer json[MAX_BATCH];
+  dsmeta_bin_writer bin;
+} bench;
+
+// Growths of the buffers stage st works in, as counted by the element.
+static unsigned long allocations(bench *b, stage st) {
+  rabbitmq_publisher_stats stats;
+  unsigned long n = 0;
+  unsigned int i;
+
+  switch (st) {
+  case STAGE_EXTRACT:
+    n = b->labels.grows;
+    for (i = 0; i < MAX_BATCH; i++)
+      n += b->frames[i].grows;
+    break;
+  case STAGE_DELTA:
+    n = b->delta.grows;
+    break;
+  case STAGE_JSON:
+    for (i = 0; i < MAX_BATCH; i++)
+      n += b->json[i].grows;
+    break;
+  case STAGE_BINARY:
+    n = b->bin.grows;
+    break;
+  case STAGE_ENQUEUE:
+    publisher_pool_get_stats(&b->pool, &stats);
+    n = stats.enqueue_allocations;
+    break;
+  default:
+    break;
+  }
+  return n;
+}
+
+static void begin(bench *b, stage st, result *r, uint64_t *start) {
+  r->allocations -= allocations(b, st);
+  *start = latency_now_ns();
+}
+
+static void end(bench *b, stage st, result *r, uint64_t start) {
+  r->ns += latency_now_ns() - start;
+  r->allocations += allocations(b, st);
+}
+
+// Runs every stage over one batch. Each stage goes through the whole batch
+// before the next one starts, as its timer covers the batch.
+static void run_batch(bench *b, NvDsBatchMeta *batch, result *results) {
+  NvDsMetaList *l;
+  unsigned int n = 0;
+  unsigned int i;
+  uint64_t start;
+
+  begin(b, STAGE_EXTRACT, &results[STAGE_EXTRACT], &start);
+  for (l = batch->frame_meta_list; l; l = l->next)
+    dsmeta_frame_extract(&b->frames[n++], l->data, &b->labels);
+  end(b, STAGE_EXTRACT, &results[STAGE_EXTRACT], start);
+
+  // Deltas work on copies so the other stages see full frames.
+  for (i = 0; i < n; i++) {
+    dsmeta_frame_begin(&b->deltas[i], b->frames[i].source_id, b->frames[i].frame_number,
+                       b->frames[i].batch_id, b->frames[i].pts, b->frames[i].num_objects);
+    b->deltas[i].num_objects = b->frames[i].num_objects;
+    memcpy(b->deltas[i].objects, b->frames[i].objects,
+           b->frames[i].num_objects * sizeof(*b->frames[i].objects));
+  }
+  begin(b, STAGE_DELTA, &results[STAGE_DELTA], &start);
+  for (i = 0; i < n; i++)
+    dsmeta_delta_apply(&b->delta, &b->deltas[i]);
+  end(b, STAGE_DELTA, &results[STAGE_DELTA], start);
+
+  begin(b, STAGE_JSON, &results[STAGE_JSON], &start);
+  for (i = 0; i < n; i++)
+    dsmeta_frame_build_json(&b->frames[i], &b->json[i]);
+  end(b, STAGE_JSON, &results[STAGE_JSON], start);
+
+  begin(b, STAGE_BINARY, &results[STAGE_BINARY], &start);
+  for (i = 0; i < n; i++)
+    dsmeta_frame_build_binary(&b->frames[i], &b->bin);
+  end(b, STAGE_BINARY, &results[STAGE_BINARY], start);
+
+  begin(b, STAGE_ENQUEUE, &results[STAGE_ENQUEUE], &start);
+  for (i = 0; i < n; i++)
+    publisher_pool_enqueue(&b->pool, b->frames[i].source_id, NULL, b->json[i].buf,
+                           b->json[i].len);
+  end(b, STAGE_ENQUEUE, &results[STAGE_ENQUEUE], start);
+}
+
+static int measure(bench *b, unsigned int objects, unsigned int batch_size,
+                   unsigned int target_frames, result *results) {
+  batch_gen_config config = {
+    .num_sources = batch_size, .objects_per_frame = objects, .width = 1920,
+    .height = 1080, .tracked = 1, .churn_interval = 10, .seed = 1};
+  // Enough batches to cover every slot of the publish queue.
+  unsigned int warmup = QUEUE_DEPTH / batch_size + 2;
+  unsigned int batches = (target_frames + batch_size - 1) / batch_size;
+  result ignored[NUM_STAGES];
+  batch_gen g;
+  unsigned int i;
+
+  if (batch_gen_init(&g, &config) < 0)
+    return -1;
+  dsmeta_delta_reset(&b->delta);
+  memset(results, 0, NUM_STAGES * sizeof(*results));
+  for (i = 0; i < warmup; i++)
+    run_batch(b, batch_gen_next(&g), ignored);
+  for (i = 0; i < batches; i++)
+    run_batch(b, batch_gen_next(&g), results);
+  batch_gen_free(&g);
+  return (int) (batches * batch_size);
+}
+
+// One encoding of every frame --batching enqueues.
+typedef struct payload_set {
+  char *bufs[BATCHING_PAYLOADS];
+  size_t lens[BATCHING_PAYLOADS];
+} payload_set;
+
+typedef struct batching_config {
+  unsigned int max_frames;
+  size_t max_bytes;
+  unsigned int linger_ms;
+} batching_config;
+
+// batch_max_frames 1 ignores the other two, so it is only run once.
+static const batching_config batching_configs[] = {
+  {1, 0, 0},
+  {8, 0, 0}, {8, 0, 5}, {8, 16384, 0}, {8, 16384, 5}, {8, 131072, 0}, {8, 131072, 5},
+  {32, 0, 0}, {32, 0, 5}, {32, 16384, 0}, {32, 16384, 5}, {32, 131072, 0}, {32, 131072, 5},
+};
+
+static char *copy_payload(const void *buf, size_t len) {
+  char *copy = malloc(len);
+
+  if (copy)
+    memcpy(copy, buf, len);
+  return copy;
+}
+
+// Extracts BATCHING_PAYLOADS frames of objects objects from batch-gen and
+// keeps their JSON and binary encodings.
+static int encode_payloads(unsigned int objects, payload_set *json, payload_set *binary) {
+  batch_gen_config config = {
+    .num_sources = BATCHING_SOURCES, .objects_per_frame = objects, .width = 1920,
+    .height = 1080, .tracked = 1, .churn_interval = 10, .seed = 1};
+  label_table labels;
+  dsmeta_frame frame;
+  json_writer w;
+  dsmeta_bin_writer bin;
+  batch_gen g;
+  NvDsMetaList *l;
+  unsigned int n = 0;
+  int ret = 0;
+
+  if (batch_gen_init(&g, &config) < 0)
+    return -1;
+  label_table_init(&labels);
+  dsmeta_frame_init(&frame, DSMETA_FRAME_DEFAULT_CAPACITY);
+  json_writer_init(&w);
+  dsmeta_bin_writer_init(&bin);
+  while (n < BATCHING_PAYLOADS && ret == 0) {
+    for (l = batch_gen_next(&g)->frame_meta_list; l && n < BATCHING_PAYLOADS; l = l->next) {
+      dsmeta_frame_extract(&frame, l->data, &labels);
+      dsmeta_frame_build_json(&frame, &w);
+      dsmeta_frame_build_binary(&frame, &bin);
+      json->lens[n] = w.len;
+      json->bufs[n] = copy_payload(w.buf, w.len);
+      binary->lens[n] = bin.len;
+      binary->bufs[n] = copy_payload(bin.buf, bin.len);
+      if (w.error || bin.error || !json->bufs[n] || !binary->bufs[n]) {
+        ret = -1;
+        break;
+      }
+      n++;
+    }
+  }
+  dsmeta_bin_writer_free(&bin);
+  json_writer_free(&w);
+  dsmeta_frame_free(&frame);
+  label_table_free(&labels);
+  batch_gen_free(&g);
+  return ret;
+}
+
+static void free_payloads(payload_set *set) {
+  unsigned int i;
+
+  for (i = 0; i < BATCHING_PAYLOADS; i++)
+    free(set->bufs[i]);
+}
+
+// Publishes frames payloads of set with one batching configuration and
+// fills stats. Returns the seconds from the first enqueue until the last
+// batch reached the broker, or a negative value on failure.
+static double publish_payloads(const payload_set *set, rabbitmq_batch_format format,
+                               const batching_config *batching, unsigned int frames,
+                               rabbitmq_publisher_stats *stats) {
+  rabbitmq_publisher_config config = {
+    .hostname = "localhost", .port = 5672, .vhost = "/", .user = "guest", .pass = "guest",
+    .queuename = "bench", .replay_depth = 256, .depth = QUEUE_DEPTH,
+    .policy = PAYLOAD_RING_BLOCK, .batch_format = format};
+  static rabbitmq_publisher pub;
+  uint64_t start;
+  double seconds;
+  unsigned int i;
+
+  config.content_type = format == RABBITMQ_BATCH_DSMETA_BIN ? "application/x-dsmeta" :
+                                                                "application/json";
+  config.batch_max_frames = batching->max_frames;
+  config.batch_max_bytes = batching->max_bytes;
+  config.linger_ms = batching->linger_ms;
+  memset(&pub, 0, sizeof(pub));
+  if (rabbitmq_publisher_start(&pub, &config) < 0)
+    return -1.0;
+  start = latency_now_ns();
+  for (i = 0; i < frames; i++)
+    rabbitmq_publisher_enqueue(&pub, i % BATCHING_SOURCES, NULL,
+                               set->bufs[i % BATCHING_PAYLOADS],
+                               set->lens[i % BATCHING_PAYLOADS]);
+  if (rabbitmq_publisher_flush(&pub, 60000) < 0) {
+    rabbitmq_publisher_stop(&pub);
+    return -1.0;
+  }
+  seconds = (double) (latency_now_ns() - start) / 1e9;
+  rabbitmq_publisher_get_stats(&pub, stats);
+  rabbitmq_publisher_stop(&pub);
+  return seconds;
+}
+
+#define NUM_BATCHING_CONFIGS (sizeof(batching_configs) / sizeof(batching_configs[0]))
+
+static int run_batching(unsigned int objects, unsigned int frames, int json) {
+  static payload_set payloads[2];
+  static const char *const format_names[2] = {"json", "binary"};
+  static const rabbitmq_batch_format formats[2] = {
+    RABBITMQ_BATCH_JSON_ARRAY, RABBITMQ_BATCH_DSMETA_BIN,
+  };
+  // Every run is done before anything is printed, as the client reports each
+  // connection on stdout.
+  rabbitmq_publisher_stats stats[2][NUM_BATCHING_CONFIGS];
+  double seconds[2][NUM_BATCHING_CONFIGS];
+  unsigned int f, c;
+  int first = 1;
+  int ret = 0;
+
+  if (encode_payloads(objects, &payloads[0], &payloads[1]) < 0) {
+    fprintf(stderr, "cannot encode %u objects per frame\n", objects);
+    ret = 1;
+  }
+  fake_amqp.record = 0;
+  for (f = 0; f < 2 && ret == 0; f++) {
+    for (c = 0; c < NUM_BATCHING_CONFIGS && ret == 0; c++) {
+      seconds[f][c] = publish_payloads(&payloads[f], formats[f], &batching_configs[c],
+                                       frames, &stats[f][c]);
+      if (seconds[f][c] <= 0.0) {
+        fprintf(stderr, "cannot publish %s batches of %u frames\n", format_names[f],
+                batching_configs[c].max_frames);
+        ret = 1;
+      }
+    }
+  }
+  free_payloads(&payloads[0]);
+  free_payloads(&payloads[1]);
+  if (ret)
+    return ret;
+
+  if (json)
+    printf("[");
+  else
+    printf("format,objects,batch_max_frames,batch_max_bytes,linger_ms,frames,messages,"
+           "messages_per_s,frames_per_s,bytes_per_s\n");
+  for (f = 0; f < 2; f++) {
+    for (c = 0; c < NUM_BATCHING_CONFIGS; c++) {
+      const batching_config *batching = &batching_configs[c];
+      const rabbitmq_publisher_stats *st = &stats[f][c];
+      double secs = seconds[f][c];
+
+      if (json)
+        printf("%s\n  {\"format\": \"%s\", \"objects\": %u, \"batchMaxFrames\": %u, "
+               "\"batchMaxBytes\": %zu, \"lingerMs\": %u, \"frames\": %lu, "
+               "\"messages\": %lu, \"messagesPerSecond\": %.0f, "
+               "\"framesPerSecond\": %.0f, \"bytesPerSecond\": %.0f}",
+               first ? "" : ",", format_names[f], objects, batching->max_frames,
+               batching->max_bytes, batching->linger_ms, st->published, st->messages,
+               st->messages / secs, st->published / secs, st->bytes / secs);
+      else
+        printf("%s,%u,%u,%zu,%u,%lu,%lu,%.0f,%.0f,%.0f\n", format_names[f], objects,
+               batching->max_frames, batching->max_bytes, batching->linger_ms,
+               st->published, st->messages, st->messages / secs, st->published / secs,
+               st->bytes / secs);
+      first = 0;
+    }
+  }
+  if (json)
+    printf("\n]\n");
+  return 0;
+}
+
+static void usage(const char *name) {
+  fprintf(stderr, "usage: %s [--json] [--max-objects N] [--max-batch N] [--frames N]\n"
+          "       %s --batching [--json] [--objects N] [--frames N]\n", name, name);
+}
+
+int main(int argc, char **argv) {
+  rabbitmq_publisher_config config = {
+    .hostname = "localhost", .port = 5672, .vhost = "/", .user = "guest", .pass = "guest",
+    .queuename = "bench", .content_type = "application/json", .replay_depth = 256,
+    .depth = QUEUE_DEPTH, .policy = PAYLOAD_RING_DROP_OLDEST, .batch_max_frames = 1};
+  static bench b;
+  unsigned int max_objects = MAX_OBJECTS;
+  unsigned int max_batch = MAX_BATCH;
+  unsigned int target_frames = DEFAULT_FRAMES;
+  unsigned int batching_objects = DEFAULT_BATCHING_OBJECTS;
+  int batching = 0;
+  int json = 0;
+  int first = 1;
+  unsigned int objects, batch_size, s;
+  int i;
+
+  for (i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--json") == 0) {
+      json = 1;
+    } else if (strcmp(argv[i], "--batching") == 0) {
+      batching = 1;
+    } else if (i + 1 < argc && strcmp(argv[i], "--objects") == 0) {
+      batching_objects = (unsigned int) strtoul(argv[++i], NULL, 10);
+    } else if (i + 1 < argc && strcmp(argv[i], "--max-objects") == 0) {
+      max_objects = (unsigned int) strtoul(argv[++i], NULL, 10);
+    } else if (i + 1 < argc && strcmp(argv[i], "--max-batch") == 0) {
+      max_batch = (unsigned int) strtoul(argv[++i], NULL, 10);
+    } else if (i + 1 < argc && strcmp(argv[i], "--frames") == 0) {
+      target_frames = (unsigned int) strtoul(argv[++i], NULL, 10);
+    } else {
+      usage(argv[0]);
+      return 2;
+    }
+  }
+  if (max_batch < 1 || max_batch > MAX_BATCH || max_objects > MAX_OBJECTS ||
+      batching_objects > MAX_OBJECTS || target_frames < 1) {
+    usage(argv[0]);
+    return 2;
+  }
+  if (batching)
+    return run_batching(batching_objects, target_frames, json);
+
+  // Only the counters are kept, the broker would otherwise hold every message.
+  fake_amqp.record = 0;
+  if (publisher_pool_start(&b.pool, 1, &config) < 0) {
+    fprintf(stderr, "cannot start the publisher\n");
+    return 1;
+  }
+  label_table_init(&b.labels);
+  dsmeta_delta_init(&b.delta, 0.0f, 30);
+  for (s = 0; s < MAX_BATCH; s++) {
+    dsmeta_frame_init(&b.frames[s], DSMETA_FRAME_DEFAULT_CAPACITY);
+    dsmeta_frame_init(&b.deltas[s], DSMETA_FRAME_DEFAULT_CAPACITY);
+    json_writer_init(&b.json[s]);
+  }
+  dsmeta_bin_writer_init(&b.bin);
+
+  if (json)
+    printf("[");
+  else
+    printf("stage,objects,batch_size,frames,ns_per_frame,allocs_per_frame\n");
+  for (objects = 0; objects <= max_objects; objects = objects ? objects * 2 : 1) {
+    for (batch_size = 1; batch_size <= max_batch; batch_size *= 2) {
+      result results[NUM_STAGES];
+      int frames = measure(&b, objects, batch_size, target_frames, results);
+
+      if (frames < 0) {
+        fprintf(stderr, "out of memory at %u objects x %u sources\n", objects, batch_size);
+        return 1;
+      }
+      for (s = 0; s < NUM_STAGES; s++) {
+        double ns = (double) results[s].ns / frames;
+        double allocs = (double) results[s].allocations / frames;
+
+        if (json)
+          printf("%s\n  {\"stage\": \"%s\", \"objects\": %u, \"batchSize\": %u, "
+                 "\"frames\": %d, \"nsPerFrame\": %.1f, \"allocsPerFrame\": %.3f}",
+                 first ? "" : ",", stage_names[s], objects, batch_size, frames, ns, allocs);
+        else
+          printf("%s,%u,%u,%d,%.1f,%.3f\n", stage_names[s], objects, batch_size, frames, ns,
+                 allocs);
+        first = 0;
+      }
+      fflush(stdout);
+    }
+  }
+  if (json)
+    printf("\n]\n");
+
+  publisher_pool_stop(&b.pool);
+  for (s = 0; s < MAX_BATCH; s++) {
+    dsmeta_frame_free(&b.frames[s]);
+    dsmeta_frame_free(&b.deltas[s]);
+    json_writer_free(&b.json[s]);
+  }
+  dsmeta_bin_writer_free(&b.bin);
+  dsmeta_delta_free(&b.delta);
+  label_table_free(&b.labels);
+  return 0;
+}
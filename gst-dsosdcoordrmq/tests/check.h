@@ -0,0 +1,75 @@
+// Copyright 2022, Kyota Tashiro, Mengheng Lee, and Latona Inc.
+// License MIT
+#ifndef CHECK_HARNESS
+#define CHECK_HARNESS
+#include <stdio.h>
+#include <string.h>
+
+// Assertions of the make check tests. A failed check is reported and counted
+// and the test goes on, so one run shows every broken expectation; main
+// returns check_done() to fail the run when any did.
+
+static int check_count;
+static int check_failures;
+
+#define CHECK(cond)                                                           \
+  do {                                                                        \
+    check_count++;                                                            \
+    if (!(cond)) {                                                            \
+      check_failures++;                                                       \
+      fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+    }                                                                         \
+  } while (0)
+
+#define CHECK_INT(actual, expected)                                           \
+  do {                                                                        \
+    long long check_a = (long long) (actual);                                 \
+    long long check_e = (long long) (expected);                               \
+    check_count++;                                                            \
+    if (check_a != check_e) {                                                 \
+      check_failures++;                                                       \
+      fprintf(stderr, "%s:%d: %s is %lld, expected %lld\n", __FILE__, __LINE__, \
+              #actual, check_a, check_e);                                     \
+    }                                                                         \
+  } while (0)
+
+#define CHECK_STR(actual, expected)                                           \
+  do {                                                                        \
+    const char *check_a = (actual);                                           \
+    const char *check_e = (expected);                                         \
+    check_count++;                                                            \
+    if (!check_a || strcmp(check_a, check_e) != 0) {                          \
+      check_failures++;                                                       \
+      fprintf(stderr, "%s:%d: %s is\n  %s\nexpected\n  %s\n", __FILE__, __LINE__, \
+              #actual, check_a ? check_a : "(null)", check_e);                \
+    }                                                                         \
+  } while (0)
+
+#define CHECK_MEM(actual, expected, len)                                      \
+  do {                                                                        \
+    check_count++;                                                            \
+    if (memcmp((actual), (expected), (len)) != 0) {                           \
+      check_failures++;                                                       \
+      fprintf(stderr, "%s:%d: %s differs from %s\n", __FILE__, __LINE__,      \
+              #actual, #expected);                                            \
+    }                                                                         \
+  } while (0)
+
+// The len bytes at buf as a string, for writers that do not terminate their
+// output. NULL when they do not fit; valid until the next call.
+static inline const char *check_text(const void *buf, size_t len) {
+  static char out[1 << 16];
+
+  if (len >= sizeof(out))
+    return NULL;
+  memcpy(out, buf, len);
+  out[len] = '\0';
+  return out;
+}
+
+static inline int check_done(const char *name) {
+  printf("%s: %d checks, %d failed\n", name, check_count, check_failures);
+  return check_failures ? 1 : 0;
+}
+
+#endif
@@ -0,0 +1,496 @@
+// Copyright 2022, Kyota Tashiro, Mengheng Lee, and Latona Inc.
+// License MIT
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <rabbitmq-c/tcp_socket.h>
+#include "fake-amqp.h"
+
+// Longest a wait for a frame sleeps, so callers looping on timeouts still
+// notice a broker taken down promptly.
+#define MAX_WAIT_MS 10
+
+fake_amqp_broker fake_amqp = {.up = 1, .fail_after = -1, .record = 1};
+pthread_mutex_t fake_amqp_lock = PTHREAD_MUTEX_INITIALIZER;
+
+const amqp_table_t amqp_empty_table = {0, NULL};
+const amqp_bytes_t amqp_empty_bytes = {0, NULL};
+
+struct amqp_connection_state_t_ {
+  unsigned long id;
+  unsigned long epoch;
+  int open;
+  int confirm;
+  uint64_t next_tag;
+  uint64_t settled_tag;
+  amqp_basic_ack_t ack;
+  amqp_basic_nack_t nack;
+  amqp_queue_declare_ok_t queue_ok;
+  char queue[FAKE_AMQP_MAX_NAME];
+};
+
+static void sleep_ms(int ms) {
+  struct timespec ts = {ms / 1000, (ms % 1000) * 1000000L};
+
+  nanosleep(&ts, NULL);
+}
+
+static void copy_name(char *dst, const void *src, size_t len) {
+  if (len >= FAKE_AMQP_MAX_NAME)
+    len = FAKE_AMQP_MAX_NAME - 1;
+  if (len)
+    memcpy(dst, src, len);
+  dst[len] = '\0';
+}
+
+// Whether the connection still reaches the broker; called under the lock.
+static int alive(amqp_connection_state_t state) {
+  return state && state->open && fake_amqp.up && state->epoch == fake_amqp.epoch;
+}
+
+static amqp_rpc_reply_t reply(int ok) {
+  amqp_rpc_reply_t r = {0};
+
+  r.reply_type = ok ? AMQP_RESPONSE_NORMAL : AMQP_RESPONSE_LIBRARY_EXCEPTION;
+  r.library_error = ok ? 0 : AMQP_STATUS_SOCKET_ERROR;
+  return r;
+}
+
+void fake_amqp_reset(void) {
+  size_t i;
+
+  pthread_mutex_lock(&fake_amqp_lock);
+  for (i = 0; i < fake_amqp.num_messages; i++)
+    free(fake_amqp.messages[i].body);
+  free(fake_amqp.messages);
+  memset(&fake_amqp, 0, sizeof(fake_amqp));
+  fake_amqp.up = 1;
+  fake_amqp.fail_after = -1;
+  fake_amqp.record = 1;
+  pthread_mutex_unlock(&fake_amqp_lock);
+}
+
+void fake_amqp_set_up(int up) {
+  pthread_mutex_lock(&fake_amqp_lock);
+  if (fake_amqp.up && !up)
+    fake_amqp.epoch++;
+  fake_amqp.up = up;
+  pthread_mutex_unlock(&fake_amqp_lock);
+}
+
+size_t fake_amqp_count(void) {
+  size_t count;
+
+  pthread_mutex_lock(&fake_amqp_lock);
+  count = fake_amqp.num_messages;
+  pthread_mutex_unlock(&fake_amqp_lock);
+  return count;
+}
+
+int fake_amqp_get(size_t i, fake_amqp_message *message) {
+  int found;
+
+  pthread_mutex_lock(&fake_amqp_lock);
+  found = i < fake_amqp.num_messages;
+  if (found)
+    *message = fake_amqp.messages[i];
+  pthread_mutex_unlock(&fake_amqp_lock);
+  return found ? 0 : -1;
+}
+
+int fake_amqp_wait_for(size_t count, int timeout_ms) {
+  int waited;
+
+  for (waited = 0; fake_amqp_count() < count; waited++) {
+    if (waited >= timeout_ms)
+      return -1;
+    sleep_ms(1);
+  }
+  return 0;
+}
+
+void amqp_default_connection_info(struct amqp_connection_info *parsed) {
+  parsed->user = "guest";
+  parsed->password = "guest";
+  parsed->host = "localhost";
+  parsed->vhost = "/";
+  parsed->port = 5672;
+  parsed->ssl = 0;
+}
+
+// Decodes the %XX escapes of s in place, -1 for a malformed one.
+static int percent_decode(char *s) {
+  char *out = s;
+  unsigned int c;
+
+  for (; *s; s++) {
+    if (*s != '%') {
+      *out++ = *s;
+      continue;
+    }
+    if (sscanf(s + 1, "%2x", &c) != 1 || !s[1] || !s[2])
+      return -1;
+    *out++ = (char) c;
+    s += 2;
+  }
+  *out = '\0';
+  return 0;
+}
+
+// amqp[s]://[user[:password]@][host][:port][/vhost], parsed in place over the
+// defaults the way rabbitmq-c does.
+int amqp_parse_url(char *url, struct amqp_connection_info *parsed) {
+  char *host, *at, *colon, *slash, *end;
+  long port;
+
+  amqp_default_connection_info(parsed);
+  if (strncmp(url, "amqp://", 7) == 0) {
+    host = url + 7;
+  } else if (strncmp(url, "amqps://", 8) == 0) {
+    host = url + 8;
+    parsed->port = 5671;
+    parsed->ssl = 1;
+  } else {
+    return AMQP_STATUS_BAD_URL;
+  }
+  slash = strchr(host, '/');
+  if (slash) {
+    *slash = '\0';
+    parsed->vhost = slash + 1;
+    if (percent_decode(parsed->vhost) < 0)
+      return AMQP_STATUS_BAD_URL;
+  }
+  at = strrchr(host, '@');
+  if (at) {
+    *at = '\0';
+    parsed->user = host;
+    colon = strchr(host, ':');
+    if (colon) {
+      *colon = '\0';
+      parsed->password = colon + 1;
+    }
+    host = at + 1;
+  }
+  colon = strchr(host, ':');
+  if (colon) {
+    *colon = '\0';
+    port = strtol(colon + 1, &end, 10);
+    if (end == colon + 1 || *end || port <= 0 || port > 65535)
+      return AMQP_STATUS_BAD_URL;
+    parsed->port = (int) port;
+  }
+  if (*host)
+    parsed->host = host;
+  return AMQP_STATUS_OK;
+}
+
+amqp_connection_state_t amqp_new_connection(void) {
+  return calloc(1, sizeof(struct amqp_connection_state_t_));
+}
+
+int amqp_destroy_connection(amqp_connection_state_t state) {
+  free(state);
+  return AMQP_STATUS_OK;
+}
+
+amqp_socket_t *amqp_tcp_socket_new(amqp_connection_state_t state) {
+  return (amqp_socket_t *) state;
+}
+
+int amqp_socket_open_noblock(amqp_socket_t *self, const char *host, int port,
+                             const struct timeval *timeout) {
+  amqp_connection_state_t state = (amqp_connection_state_t) self;
+  int status = AMQP_STATUS_SOCKET_ERROR;
+
+  (void) timeout;
+  pthread_mutex_lock(&fake_amqp_lock);
+  copy_name(fake_amqp.host, host, strlen(host));
+  fake_amqp.port = port;
+  if (fake_amqp.up) {
+    state->id = ++fake_amqp.connections;
+    state->epoch = fake_amqp.epoch;
+    state->open = 1;
+    status = AMQP_STATUS_OK;
+  }
+  pthread_mutex_unlock(&fake_amqp_lock);
+  return status;
+}
+
+amqp_rpc_reply_t amqp_login(amqp_connection_state_t state, char const *vhost, int channel_max,
+                            int frame_max, int heartbeat, amqp_sasl_method_enum sasl_method,
+                            ...) {
+  const char *user;
+  va_list args;
+  int ok;
+
+  (void) channel_max;
+  (void) frame_max;
+  (void) heartbeat;
+  (void) sasl_method;
+  va_start(args, sasl_method);
+  user = va_arg(args, const char *);
+  va_end(args);
+  pthread_mutex_lock(&fake_amqp_lock);
+  ok = alive(state);
+  if (ok) {
+    fake_amqp.logins++;
+    copy_name(fake_amqp.vhost, vhost, strlen(vhost));
+    copy_name(fake_amqp.user, user, strlen(user));
+  }
+  pthread_mutex_unlock(&fake_amqp_lock);
+  return reply(ok);
+}
+
+amqp_channel_open_ok_t *amqp_channel_open(amqp_connection_state_t state,
+                                          amqp_channel_t channel) {
+  static amqp_channel_open_ok_t open_ok;
+
+  (void) channel;
+  return state ? &open_ok : NULL;
+}
+
+amqp_rpc_reply_t amqp_get_rpc_reply(amqp_connection_state_t state) {
+  int ok;
+
+  pthread_mutex_lock(&fake_amqp_lock);
+  ok = alive(state);
+  pthread_mutex_unlock(&fake_amqp_lock);
+  return reply(ok);
+}
+
+amqp_rpc_reply_t amqp_channel_close(amqp_connection_state_t state, amqp_channel_t channel,
+                                    int code) {
+  (void) channel;
+  (void) code;
+  return amqp_get_rpc_reply(state);
+}
+
+amqp_rpc_reply_t amqp_connection_close(amqp_connection_state_t state, int code) {
+  amqp_rpc_reply_t r = amqp_get_rpc_reply(state);
+
+  (void) code;
+  state->open = 0;
+  return r;
+}
+
+amqp_bytes_t amqp_cstring_bytes(char const *cstr) {
+  amqp_bytes_t bytes = {strlen(cstr), (void *) cstr};
+
+  return bytes;
+}
+
+amqp_bytes_t amqp_bytes_malloc_dup(amqp_bytes_t src) {
+  amqp_bytes_t bytes = {src.len, malloc(src.len ? src.len : 1)};
+
+  if (!bytes.bytes)
+    bytes.len = 0;
+  else if (src.len)
+    memcpy(bytes.bytes, src.bytes, src.len);
+  return bytes;
+}
+
+void amqp_bytes_free(amqp_bytes_t bytes) {
+  free(bytes.bytes);
+}
+
+amqp_queue_declare_ok_t *amqp_queue_declare(amqp_connection_state_t state,
+                                            amqp_channel_t channel, amqp_bytes_t queue,
+                                            amqp_boolean_t passive, amqp_boolean_t durable,
+                                            amqp_boolean_t exclusive,
+                                            amqp_boolean_t auto_delete,
+                                            amqp_table_t arguments) {
+  amqp_queue_declare_ok_t *ok = NULL;
+
+  (void) channel;
+  (void) passive;
+  (void) durable;
+  (void) exclusive;
+  (void) auto_delete;
+  (void) arguments;
+  pthread_mutex_lock(&fake_amqp_lock);
+  if (alive(state)) {
+    fake_amqp.queue_declares++;
+    copy_name(fake_amqp.queue, queue.bytes, queue.len);
+    copy_name(state->queue, queue.bytes, queue.len);
+    state->queue_ok.queue = amqp_cstring_bytes(state->queue);
+    ok = &state->queue_ok;
+  }
+  pthread_mutex_unlock(&fake_amqp_lock);
+  return ok;
+}
+
+amqp_exchange_declare_ok_t *amqp_exchange_declare(amqp_connection_state_t state,
+                                                  amqp_channel_t channel,
+                                                  amqp_bytes_t exchange, amqp_bytes_t type,
+                                                  amqp_boolean_t passive,
+                                                  amqp_boolean_t durable,
+                                                  amqp_boolean_t auto_delete,
+                                                  amqp_boolean_t internal,
+                                                  amqp_table_t arguments) {
+  static amqp_exchange_declare_ok_t declare_ok;
+  amqp_exchange_declare_ok_t *ok = NULL;
+
+  (void) channel;
+  (void) passive;
+  (void) durable;
+  (void) auto_delete;
+  (void) internal;
+  (void) arguments;
+  pthread_mutex_lock(&fake_amqp_lock);
+  if (alive(state)) {
+    fake_amqp.exchange_declares++;
+    copy_name(fake_amqp.exchange, exchange.bytes, exchange.len);
+    copy_name(fake_amqp.exchange_type, type.bytes, type.len);
+    ok = &declare_ok;
+  }
+  pthread_mutex_unlock(&fake_amqp_lock);
+  return ok;
+}
+
+amqp_confirm_select_ok_t *amqp_confirm_select(amqp_connection_state_t state,
+                                              amqp_channel_t channel) {
+  static amqp_confirm_select_ok_t select_ok;
+
+  (void) channel;
+  state->confirm = 1;
+  state->next_tag = 1;
+  state->settled_tag = 0;
+  return &select_ok;
+}
+
+static int record(amqp_connection_state_t state, uint64_t tag, amqp_bytes_t exchange,
+                  amqp_bytes_t routing_key, const amqp_basic_properties_t *properties,
+                  amqp_bytes_t body) {
+  fake_amqp_message *message;
+
+  if (fake_amqp.num_messages == fake_amqp.capacity) {
+    size_t capacity = fake_amqp.capacity ? fake_amqp.capacity * 2 : 64;
+    fake_amqp_message *grown = realloc(fake_amqp.messages, capacity * sizeof(*grown));
+
+    if (!grown)
+      return -1;
+    fake_amqp.messages = grown;
+    fake_amqp.capacity = capacity;
+  }
+  message = &fake_amqp.messages[fake_amqp.num_messages];
+  message->body = malloc(body.len ? body.len : 1);
+  if (!message->body)
+    return -1;
+  if (body.len)
+    memcpy(message->body, body.bytes, body.len);
+  message->len = body.len;
+  message->connection = state->id;
+  message->tag = tag;
+  copy_name(message->exchange, exchange.bytes, exchange.len);
+  copy_name(message->routing_key, routing_key.bytes, routing_key.len);
+  if (properties && (properties->_flags & AMQP_BASIC_CONTENT_TYPE_FLAG))
+    copy_name(message->content_type, properties->content_type.bytes,
+              properties->content_type.len);
+  else
+    message->content_type[0] = '\0';
+  fake_amqp.num_messages++;
+  return 0;
+}
+
+int amqp_basic_publish(amqp_connection_state_t state, amqp_channel_t channel,
+                       amqp_bytes_t exchange, amqp_bytes_t routing_key,
+                       amqp_boolean_t mandatory, amqp_boolean_t immediate,
+                       struct amqp_basic_properties_t_ const *properties, amqp_bytes_t body) {
+  int status = AMQP_STATUS_OK;
+  uint64_t tag = 0;
+
+  (void) channel;
+  (void) mandatory;
+  (void) immediate;
+  pthread_mutex_lock(&fake_amqp_lock);
+  if (alive(state) && fake_amqp.fail_after == 0) {
+    // The connection breaks under this publish, which never arrives.
+    state->open = 0;
+    fake_amqp.fail_after = -1;
+  }
+  if (!alive(state)) {
+    status = AMQP_STATUS_SOCKET_ERROR;
+  } else {
+    if (fake_amqp.fail_after > 0)
+      fake_amqp.fail_after--;
+    if (state->confirm)
+      tag = state->next_tag++;
+    fake_amqp.published++;
+    fake_amqp.bytes += body.len;
+    if (fake_amqp.record && record(state, tag, exchange, routing_key, properties, body) < 0)
+      status = AMQP_STATUS_NO_MEMORY;
+  }
+  pthread_mutex_unlock(&fake_amqp_lock);
+  return status;
+}
+
+// Answers the oldest unsettled publish, one confirm per frame.
+int amqp_simple_wait_frame_noblock(amqp_connection_state_t state, amqp_frame_t *decoded_frame,
+                                   const struct timeval *tv) {
+  int wait_ms = tv ? (int) (tv->tv_sec * 1000 + tv->tv_usec / 1000) : MAX_WAIT_MS;
+  int status = AMQP_STATUS_TIMEOUT;
+
+  pthread_mutex_lock(&fake_amqp_lock);
+  if (!alive(state)) {
+    status = AMQP_STATUS_CONNECTION_CLOSED;
+  } else if (state->confirm && !fake_amqp.hold_confirms &&
+      state->settled_tag + 1 < state->next_tag) {
+    uint64_t tag = ++state->settled_tag;
+
+    decoded_frame->frame_type = AMQP_FRAME_METHOD;
+    decoded_frame->channel = 1;
+    if (fake_amqp.nack_next > 0) {
+      fake_amqp.nack_next--;
+      fake_amqp.nacks++;
+      state->nack.delivery_tag = tag;
+      state->nack.multiple = 0;
+      state->nack.requeue = 0;
+      decoded_frame->payload.method.id = AMQP_BASIC_NACK_METHOD;
+      decoded_frame->payload.method.decoded = &state->nack;
+    } else {
+      fake_amqp.acks++;
+      state->ack.delivery_tag = tag;
+      state->ack.multiple = 0;
+      decoded_frame->payload.method.id = AMQP_BASIC_ACK_METHOD;
+      decoded_frame->payload.method.decoded = &state->ack;
+    }
+    status = AMQP_STATUS_OK;
+  }
+  pthread_mutex_unlock(&fake_amqp_lock);
+  if (status == AMQP_STATUS_TIMEOUT && wait_ms > 0)
+    sleep_ms(wait_ms < MAX_WAIT_MS ? wait_ms : MAX_WAIT_MS);
+  return status;
+}
+
+void amqp_maybe_release_buffers(amqp_connection_state_t state) {
+  (void) state;
+}
+
+amqp_basic_consume_ok_t *amqp_basic_consume(amqp_connection_state_t state,
+                                            amqp_channel_t channel, amqp_bytes_t queue,
+                                            amqp_bytes_t consumer_tag, amqp_boolean_t no_local,
+                                            amqp_boolean_t no_ack, amqp_boolean_t exclusive,
+                                            amqp_table_t arguments) {
+  (void) state;
+  (void) channel;
+  (void) queue;
+  (void) consumer_tag;
+  (void) no_local;
+  (void) no_ack;
+  (void) exclusive;
+  (void) arguments;
+  return NULL;
+}
+
+// Nothing is ever delivered to consumers.
+amqp_rpc_reply_t amqp_consume_message(amqp_connection_state_t state, amqp_envelope_t *envelope,
+                                      const struct timeval *timeout, int flags) {
+  (void) state;
+  (void) timeout;
+  (void) flags;
+  memset(envelope, 0, sizeof(*envelope));
+  return reply(0);
+}
@@ -0,0 +1,84 @@
+// Copyright 2022, Kyota Tashiro, Mengheng Lee, and Latona Inc.
+// License MIT
+#ifndef FAKE_AMQP
+#define FAKE_AMQP
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <rabbitmq-c/amqp.h>
+
+// An in-process broker behind the rabbitmq-c calls rabbitmq-client.c makes.
+// It keeps what was published, acks or nacks messages in confirm mode, and
+// can be taken down and brought back to exercise reconnects. The publisher
+// threads call into it, so tests read it under fake_amqp_lock or through
+// the helpers below.
+
+#define FAKE_AMQP_MAX_NAME 256
+
+typedef struct fake_amqp_message {
+  // Connection it arrived on, counting from 1.
+  unsigned long connection;
+  // Delivery tag on that connection's channel, 0 without confirms.
+  uint64_t tag;
+  char exchange[FAKE_AMQP_MAX_NAME];
+  char routing_key[FAKE_AMQP_MAX_NAME];
+  char content_type[FAKE_AMQP_MAX_NAME];
+  char *body;
+  size_t len;
+} fake_amqp_message;
+
+typedef struct fake_amqp_broker {
+  // Refuses connections while 0; taking the broker down also breaks every
+  // open connection.
+  int up;
+  // Publishes that go through before the connection breaks by itself, -1 for
+  // never.
+  long fail_after;
+  // Keep the messages; with 0 only the counters are kept.
+  int record;
+  // Leave confirms unanswered while set.
+  int hold_confirms;
+  // Nack the next this many confirms instead of acking them.
+  unsigned long nack_next;
+  unsigned long connections;
+  unsigned long logins;
+  // Where the last connection went and what it logged in to, and as whom.
+  char host[FAKE_AMQP_MAX_NAME];
+  int port;
+  char vhost[FAKE_AMQP_MAX_NAME];
+  char user[FAKE_AMQP_MAX_NAME];
+  unsigned long queue_declares;
+  unsigned long exchange_declares;
+  char exchange[FAKE_AMQP_MAX_NAME];
+  char exchange_type[FAKE_AMQP_MAX_NAME];
+  char queue[FAKE_AMQP_MAX_NAME];
+  unsigned long published;
+  unsigned long bytes;
+  unsigned long acks;
+  unsigned long nacks;
+  fake_amqp_message *messages;
+  size_t num_messages;
+  size_t capacity;
+  // Bumped when the broker goes down, which breaks older connections.
+  unsigned long epoch;
+} fake_amqp_broker;
+
+extern fake_amqp_broker fake_amqp;
+extern pthread_mutex_t fake_amqp_lock;
+
+// Forgets everything and brings the broker up, recording messages.
+void fake_amqp_reset(void);
+
+void fake_amqp_set_up(int up);
+
+// Messages received so far, under the lock.
+size_t fake_amqp_count(void);
+
+// Copies message i, returning -1 past the end. Its body is the broker's, which
+// stays valid until fake_amqp_reset.
+int fake_amqp_get(size_t i, fake_amqp_message *message);
+
+// Waits up to timeout_ms for at least count messages. Returns 0 once there.
+int fake_amqp_wait_for(size_t count, int timeout_ms);
+
+#endif
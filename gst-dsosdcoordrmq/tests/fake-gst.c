@@ -0,0 +1,1086 @@
+// Copyright 2022, Kyota Tashiro, Mengheng Lee, and Latona Inc.
+// License MIT
+
+#include <pthread.h>
+#include "fake-gst.h"
+
+#define MAX_TYPES 64
+#define MAX_PROPERTIES 64
+#define MAX_FACTORIES 8
+#define MAX_QUARKS 64
+
+typedef struct type_node {
+  const gchar *name;
+  GType parent;
+  guint class_size;
+  GClassInitFunc class_init;
+  guint instance_size;
+  GInstanceInitFunc instance_init;
+  // Created on first use, and kept for good like GObject's.
+  gpointer klass;
+  const GEnumValue *enum_values;
+  GParamSpec *properties[MAX_PROPERTIES];
+  guint num_properties;
+} type_node;
+
+typedef struct factory {
+  const gchar *name;
+  GType type;
+} factory;
+
+struct _GstPlugin {
+  const GstPluginDesc *desc;
+};
+
+struct _GstBuffer {
+  NvDsBatchMeta *batch_meta;
+  NvBufSurface *surface;
+  // Attached when the buffer holds a surface and batch_meta.
+  NvDsMeta meta;
+};
+
+typedef struct structure_field {
+  gchar *name;
+  GType type;
+  union {
+    gint v_int;
+    guint v_uint;
+    guint64 v_uint64;
+    gdouble v_double;
+    gchar *v_string;
+  } value;
+} structure_field;
+
+struct _GstStructure {
+  gchar *name;
+  structure_field *fields;
+  size_t num_fields;
+};
+
+struct _GstCaps {
+  GstStructure *structure;
+};
+
+struct _GThreadPool {
+  GFunc func;
+  gpointer user_data;
+  pthread_t *threads;
+  gint num_threads;
+  pthread_mutex_t lock;
+  pthread_cond_t pushed;
+  // Data pushed and not yet picked up, oldest first from head.
+  gpointer *queue;
+  size_t head;
+  size_t len;
+  size_t capacity;
+  gboolean stopping;
+};
+
+static void g_object_real_finalize(GObject *object) {
+  (void) object;
+}
+
+static void g_object_class_init(gpointer klass) {
+  G_OBJECT_CLASS(klass)->finalize = g_object_real_finalize;
+}
+
+static type_node types[MAX_TYPES] = {
+    [G_TYPE_BOOLEAN] = {.name = "gboolean"},
+    [G_TYPE_INT] = {.name = "gint"},
+    [G_TYPE_UINT] = {.name = "guint"},
+    [G_TYPE_UINT64] = {.name = "guint64"},
+    [G_TYPE_FLOAT] = {.name = "gfloat"},
+    [G_TYPE_DOUBLE] = {.name = "gdouble"},
+    [G_TYPE_STRING] = {.name = "gchararray"},
+    [G_TYPE_ENUM] = {.name = "GEnum"},
+    [G_TYPE_BOXED] = {.name = "GBoxed"},
+    [G_TYPE_OBJECT] = {.name = "GObject",
+                       .class_size = sizeof(GObjectClass),
+                       .class_init = g_object_class_init,
+                       .instance_size = sizeof(GObject)},
+};
+static GType num_types = G_TYPE_FUNDAMENTAL_MAX;
+static factory factories[MAX_FACTORIES];
+static size_t num_factories;
+static guint elements_made;
+static GstDebugCategory debug_category;
+static const gchar *quarks[MAX_QUARKS];
+static guint num_quarks;
+static pthread_mutex_t quark_lock = PTHREAD_MUTEX_INITIALIZER;
+
+fake_gst_bus fake_gst;
+static pthread_mutex_t bus_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static type_node *lookup(GType type) {
+  if (type == G_TYPE_INVALID || type >= num_types || !types[type].name) {
+    fprintf(stderr, "fake-gst: unknown type %zu\n", type);
+    abort();
+  }
+  return &types[type];
+}
+
+GType g_type_register_static_simple(GType parent_type, const gchar *type_name,
+                                    guint class_size, GClassInitFunc class_init,
+                                    guint instance_size, GInstanceInitFunc instance_init,
+                                    guint flags) {
+  type_node *node;
+
+  (void) flags;
+  if (num_types == MAX_TYPES) {
+    fprintf(stderr, "fake-gst: more than %d types\n", MAX_TYPES);
+    abort();
+  }
+  lookup(parent_type);
+  node = &types[num_types];
+  node->name = type_name;
+  node->parent = parent_type;
+  node->class_size = class_size;
+  node->class_init = class_init;
+  node->instance_size = instance_size;
+  node->instance_init = instance_init;
+  return num_types++;
+}
+
+GType g_type_parent(GType type) {
+  return lookup(type)->parent;
+}
+
+GType g_type_fundamental(GType type) {
+  while (type >= G_TYPE_FUNDAMENTAL_MAX)
+    type = g_type_parent(type);
+  return type;
+}
+
+const gchar *g_type_name(GType type) {
+  return lookup(type)->name;
+}
+
+gboolean g_type_is_a(GType type, GType is_a_type) {
+  for (; type != G_TYPE_INVALID; type = lookup(type)->parent)
+    if (type == is_a_type)
+      return TRUE;
+  return FALSE;
+}
+
+// The class of type, created along with those of its ancestors on first use.
+static gpointer class_ref(GType type) {
+  type_node *node = lookup(type);
+  gpointer parent_class;
+
+  if (node->klass)
+    return node->klass;
+  node->klass = calloc(1, node->class_size);
+  if (!node->klass)
+    abort();
+  if (node->parent != G_TYPE_INVALID) {
+    parent_class = class_ref(node->parent);
+    memcpy(node->klass, parent_class, lookup(node->parent)->class_size);
+  }
+  ((GTypeClass *) node->klass)->g_type = type;
+  if (node->class_init)
+    node->class_init(node->klass);
+  return node->klass;
+}
+
+gpointer g_type_class_peek_parent(gpointer g_class) {
+  GType parent = g_type_parent(G_TYPE_FROM_CLASS(g_class));
+
+  return parent == G_TYPE_INVALID ? NULL : class_ref(parent);
+}
+
+static void set_type(GValue *value, GType type) {
+  if (value->g_type == G_TYPE_INVALID)
+    value->g_type = type;
+}
+
+void g_value_set_boolean(GValue *value, gboolean v_boolean) {
+  set_type(value, G_TYPE_BOOLEAN);
+  value->data.v_int = v_boolean;
+}
+
+gboolean g_value_get_boolean(const GValue *value) {
+  return value->data.v_int;
+}
+
+void g_value_set_uint(GValue *value, guint v_uint) {
+  set_type(value, G_TYPE_UINT);
+  value->data.v_uint = v_uint;
+}
+
+guint g_value_get_uint(const GValue *value) {
+  return value->data.v_uint;
+}
+
+void g_value_set_uint64(GValue *value, guint64 v_uint64) {
+  set_type(value, G_TYPE_UINT64);
+  value->data.v_uint64 = v_uint64;
+}
+
+guint64 g_value_get_uint64(const GValue *value) {
+  return value->data.v_uint64;
+}
+
+void g_value_set_enum(GValue *value, gint v_enum) {
+  set_type(value, G_TYPE_ENUM);
+  value->data.v_int = v_enum;
+}
+
+gint g_value_get_enum(const GValue *value) {
+  return value->data.v_int;
+}
+
+void g_value_set_float(GValue *value, gfloat v_float) {
+  set_type(value, G_TYPE_FLOAT);
+  value->data.v_float = v_float;
+}
+
+gfloat g_value_get_float(const GValue *value) {
+  return value->data.v_float;
+}
+
+void g_value_set_double(GValue *value, gdouble v_double) {
+  set_type(value, G_TYPE_DOUBLE);
+  value->data.v_double = v_double;
+}
+
+gdouble g_value_get_double(const GValue *value) {
+  return value->data.v_double;
+}
+
+void g_value_set_string(GValue *value, const gchar *v_string) {
+  set_type(value, G_TYPE_STRING);
+  g_free(value->data.v_pointer);
+  value->data.v_pointer = g_strdup(v_string);
+}
+
+const gchar *g_value_get_string(const GValue *value) {
+  return value->data.v_pointer;
+}
+
+gchar *g_value_dup_string(const GValue *value) {
+  return g_strdup(value->data.v_pointer);
+}
+
+void g_value_take_boxed(GValue *value, gconstpointer v_boxed) {
+  set_type(value, G_TYPE_BOXED);
+  value->data.v_pointer = (gpointer) v_boxed;
+}
+
+gpointer g_value_get_boxed(const GValue *value) {
+  return value->data.v_pointer;
+}
+
+void g_value_unset(GValue *value) {
+  if (g_type_fundamental(value->g_type) == G_TYPE_STRING)
+    g_free(value->data.v_pointer);
+  else if (value->g_type == GST_TYPE_STRUCTURE && value->data.v_pointer)
+    gst_structure_free(value->data.v_pointer);
+  memset(value, 0, sizeof(*value));
+}
+
+GType g_enum_register_static(const gchar *name, const GEnumValue *values) {
+  GType type = g_type_register_static_simple(G_TYPE_ENUM, name, 0, NULL, 0, NULL, 0);
+
+  types[type].enum_values = values;
+  return type;
+}
+
+const GEnumValue *g_enum_get_value_by_nick(GType enum_type, const gchar *nick) {
+  const GEnumValue *v;
+
+  for (v = lookup(enum_type)->enum_values; v && v->value_nick; v++)
+    if (strcmp(v->value_nick, nick) == 0)
+      return v;
+  return NULL;
+}
+
+static const GEnumValue *enum_get_value(GType enum_type, gint value) {
+  const GEnumValue *v;
+
+  for (v = lookup(enum_type)->enum_values; v && v->value_nick; v++)
+    if (v->value == value)
+      return v;
+  return NULL;
+}
+
+static GParamSpec *param_spec_new(const gchar *name, GType value_type, gdouble minimum,
+                                  gdouble maximum, GParamFlags flags) {
+  GParamSpec *pspec = calloc(1, sizeof(*pspec));
+
+  if (!pspec)
+    abort();
+  pspec->name = name;
+  pspec->flags = flags;
+  pspec->value_type = value_type;
+  pspec->minimum = minimum;
+  pspec->maximum = maximum;
+  return pspec;
+}
+
+GParamSpec *g_param_spec_boolean(const gchar *name, const gchar *nick, const gchar *blurb,
+                                 gboolean default_value, GParamFlags flags) {
+  (void) nick, (void) blurb, (void) default_value;
+  return param_spec_new(name, G_TYPE_BOOLEAN, 0, 1, flags);
+}
+
+GParamSpec *g_param_spec_uint(const gchar *name, const gchar *nick, const gchar *blurb,
+                              guint minimum, guint maximum, guint default_value,
+                              GParamFlags flags) {
+  (void) nick, (void) blurb, (void) default_value;
+  return param_spec_new(name, G_TYPE_UINT, minimum, maximum, flags);
+}
+
+GParamSpec *g_param_spec_uint64(const gchar *name, const gchar *nick, const gchar *blurb,
+                                guint64 minimum, guint64 maximum, guint64 default_value,
+                                GParamFlags flags) {
+  (void) nick, (void) blurb, (void) default_value;
+  return param_spec_new(name, G_TYPE_UINT64, minimum, maximum, flags);
+}
+
+GParamSpec *g_param_spec_enum(const gchar *name, const gchar *nick, const gchar *blurb,
+                              GType enum_type, gint default_value, GParamFlags flags) {
+  (void) nick, (void) blurb, (void) default_value;
+  return param_spec_new(name, enum_type, 0, 0, flags);
+}
+
+GParamSpec *g_param_spec_float(const gchar *name, const gchar *nick, const gchar *blurb,
+                               gfloat minimum, gfloat maximum, gfloat default_value,
+                               GParamFlags flags) {
+  (void) nick, (void) blurb, (void) default_value;
+  return param_spec_new(name, G_TYPE_FLOAT, minimum, maximum, flags);
+}
+
+GParamSpec *g_param_spec_double(const gchar *name, const gchar *nick, const gchar *blurb,
+                                gdouble minimum, gdouble maximum, gdouble default_value,
+                                GParamFlags flags) {
+  (void) nick, (void) blurb, (void) default_value;
+  return param_spec_new(name, G_TYPE_DOUBLE, minimum, maximum, flags);
+}
+
+GParamSpec *g_param_spec_string(const gchar *name, const gchar *nick, const gchar *blurb,
+                                const gchar *default_value, GParamFlags flags) {
+  (void) nick, (void) blurb, (void) default_value;
+  return param_spec_new(name, G_TYPE_STRING, 0, 0, flags);
+}
+
+GParamSpec *g_param_spec_boxed(const gchar *name, const gchar *nick, const gchar *blurb,
+                               GType boxed_type, GParamFlags flags) {
+  (void) nick, (void) blurb;
+  return param_spec_new(name, boxed_type, 0, 0, flags);
+}
+
+void g_object_class_install_property(GObjectClass *oclass, guint property_id,
+                                     GParamSpec *pspec) {
+  type_node *node = lookup(G_TYPE_FROM_CLASS(oclass));
+
+  if (node->num_properties == MAX_PROPERTIES) {
+    fprintf(stderr, "fake-gst: more than %d properties on %s\n", MAX_PROPERTIES, node->name);
+    abort();
+  }
+  pspec->param_id = property_id;
+  node->properties[node->num_properties++] = pspec;
+}
+
+// The property named name and the class that installed it, whose accessors
+// handle it.
+static GParamSpec *find_property(GType type, const gchar *name, GObjectClass **owner) {
+  guint i;
+
+  for (; type != G_TYPE_INVALID; type = lookup(type)->parent) {
+    type_node *node = lookup(type);
+
+    for (i = 0; i < node->num_properties; i++)
+      if (strcmp(node->properties[i]->name, name) == 0) {
+        if (owner)
+          *owner = class_ref(type);
+        return node->properties[i];
+      }
+  }
+  return NULL;
+}
+
+GParamSpec *g_object_class_find_property(GObjectClass *oclass, const gchar *property_name) {
+  return find_property(G_TYPE_FROM_CLASS(oclass), property_name, NULL);
+}
+
+static int check_range(const GParamSpec *pspec, gdouble v) {
+  if (v >= pspec->minimum && v <= pspec->maximum)
+    return 0;
+  fprintf(stderr, "fake-gst: value %g of property \"%s\" is outside [%g, %g]\n", v,
+          pspec->name, pspec->minimum, pspec->maximum);
+  return -1;
+}
+
+// Reads one property value off args into value, -1 when the property would
+// reject it.
+static int collect_value(const GParamSpec *pspec, GValue *value, va_list *args) {
+  GType fundamental = g_type_fundamental(pspec->value_type);
+
+  value->g_type = pspec->value_type;
+  switch (fundamental) {
+    case G_TYPE_BOOLEAN:
+      value->data.v_int = va_arg(*args, gboolean) != 0;
+      return 0;
+    case G_TYPE_UINT:
+      value->data.v_uint = va_arg(*args, guint);
+      return check_range(pspec, value->data.v_uint);
+    case G_TYPE_UINT64:
+      value->data.v_uint64 = va_arg(*args, guint64);
+      return check_range(pspec, value->data.v_uint64);
+    case G_TYPE_FLOAT:
+      value->data.v_float = va_arg(*args, gdouble);
+      return check_range(pspec, value->data.v_float);
+    case G_TYPE_DOUBLE:
+      value->data.v_double = va_arg(*args, gdouble);
+      return check_range(pspec, value->data.v_double);
+    case G_TYPE_STRING:
+      value->data.v_pointer = g_strdup(va_arg(*args, const gchar *));
+      return 0;
+    case G_TYPE_ENUM:
+      value->data.v_int = va_arg(*args, gint);
+      if (enum_get_value(pspec->value_type, value->data.v_int))
+        return 0;
+      fprintf(stderr, "fake-gst: %d is not a value of %s\n", value->data.v_int,
+              g_type_name(pspec->value_type));
+      return -1;
+    default:
+      value->data.v_pointer = va_arg(*args, gpointer);
+      return 0;
+  }
+}
+
+// Stores value in the location args points to next, handing strings and boxed
+// values over to the caller.
+static void lcopy_value(const GParamSpec *pspec, GValue *value, va_list *args) {
+  switch (g_type_fundamental(pspec->value_type)) {
+    case G_TYPE_BOOLEAN:
+      *va_arg(*args, gboolean *) = value->data.v_int;
+      break;
+    case G_TYPE_UINT:
+      *va_arg(*args, guint *) = value->data.v_uint;
+      break;
+    case G_TYPE_UINT64:
+      *va_arg(*args, guint64 *) = value->data.v_uint64;
+      break;
+    case G_TYPE_FLOAT:
+      *va_arg(*args, gfloat *) = value->data.v_float;
+      break;
+    case G_TYPE_DOUBLE:
+      *va_arg(*args, gdouble *) = value->data.v_double;
+      break;
+    case G_TYPE_ENUM:
+      *va_arg(*args, gint *) = value->data.v_int;
+      break;
+    default:
+      *va_arg(*args, gpointer *) = value->data.v_pointer;
+      value->data.v_pointer = NULL;
+      break;
+  }
+}
+
+static void set_valist(GObject *object, const gchar *name, va_list *args) {
+  GObjectClass *owner;
+  GParamSpec *pspec;
+
+  for (; name; name = va_arg(*args, const gchar *)) {
+    GValue value = G_VALUE_INIT;
+
+    pspec = find_property(G_TYPE_FROM_INSTANCE(object), name, &owner);
+    if (!pspec) {
+      // The type of the value that follows is unknown, so stop here.
+      fprintf(stderr, "fake-gst: %s has no property \"%s\"\n",
+              g_type_name(G_TYPE_FROM_INSTANCE(object)), name);
+      return;
+    }
+    if (collect_value(pspec, &value, args) == 0) {
+      if (pspec->flags & G_PARAM_WRITABLE)
+        owner->set_property(object, pspec->param_id, &value, pspec);
+      else
+        fprintf(stderr, "fake-gst: property \"%s\" is not writable\n", name);
+    }
+    g_value_unset(&value);
+  }
+}
+
+gpointer g_object_new(GType object_type, const gchar *first_property_name, ...) {
+  GType chain[MAX_TYPES];
+  GTypeInstance *instance;
+  size_t depth = 0;
+  va_list args;
+
+  instance = calloc(1, lookup(object_type)->instance_size);
+  if (!instance)
+    abort();
+  instance->g_class = class_ref(object_type);
+  // Instance init functions run from the root type down.
+  for (GType t = object_type; t != G_TYPE_INVALID; t = lookup(t)->parent)
+    chain[depth++] = t;
+  while (depth--)
+    if (types[chain[depth]].instance_init)
+      types[chain[depth]].instance_init(instance);
+  va_start(args, first_property_name);
+  set_valist((GObject *) instance, first_property_name, &args);
+  va_end(args);
+  return instance;
+}
+
+void g_object_set(gpointer object, const gchar *first_property_name, ...) {
+  va_list args;
+
+  va_start(args, first_property_name);
+  set_valist(object, first_property_name, &args);
+  va_end(args);
+}
+
+void g_object_get(gpointer object, const gchar *first_property_name, ...) {
+  const gchar *name;
+  GObjectClass *owner;
+  GParamSpec *pspec;
+  va_list args;
+
+  va_start(args, first_property_name);
+  for (name = first_property_name; name; name = va_arg(args, const gchar *)) {
+    GValue value = G_VALUE_INIT;
+
+    pspec = find_property(G_TYPE_FROM_INSTANCE(object), name, &owner);
+    if (!pspec || !(pspec->flags & G_PARAM_READABLE)) {
+      fprintf(stderr, "fake-gst: %s has no readable property \"%s\"\n",
+              g_type_name(G_TYPE_FROM_INSTANCE(object)), name);
+      break;
+    }
+    value.g_type = pspec->value_type;
+    owner->get_property(object, pspec->param_id, &value, pspec);
+    lcopy_value(pspec, &value, &args);
+    g_value_unset(&value);
+  }
+  va_end(args);
+}
+
+void g_object_unref(gpointer object) {
+  G_OBJECT_GET_CLASS(object)->finalize(object);
+  free(object);
+}
+
+GQuark g_quark_from_static_string(const gchar *string) {
+  GQuark quark = 0;
+  guint i;
+
+  pthread_mutex_lock(&quark_lock);
+  for (i = 0; i < num_quarks && !quark; i++)
+    if (strcmp(quarks[i], string) == 0)
+      quark = i + 1;
+  if (!quark) {
+    if (num_quarks == MAX_QUARKS) {
+      fprintf(stderr, "fake-gst: more than %d quarks\n", MAX_QUARKS);
+      abort();
+    }
+    quarks[num_quarks] = string;
+    quark = ++num_quarks;
+  }
+  pthread_mutex_unlock(&quark_lock);
+  return quark;
+}
+
+static void *thread_pool_worker(void *arg) {
+  GThreadPool *pool = arg;
+  gpointer data;
+
+  pthread_mutex_lock(&pool->lock);
+  for (;;) {
+    while (!pool->len && !pool->stopping)
+      pthread_cond_wait(&pool->pushed, &pool->lock);
+    if (!pool->len)
+      break;
+    data = pool->queue[pool->head];
+    pool->head = (pool->head + 1) % pool->capacity;
+    pool->len--;
+    pthread_mutex_unlock(&pool->lock);
+    pool->func(data, pool->user_data);
+    pthread_mutex_lock(&pool->lock);
+  }
+  pthread_mutex_unlock(&pool->lock);
+  return NULL;
+}
+
+GThreadPool *g_thread_pool_new(GFunc func, gpointer user_data, gint max_threads,
+                               gboolean exclusive, GError **error) {
+  GThreadPool *pool = calloc(1, sizeof(*pool));
+
+  (void) exclusive;
+  if (!pool || max_threads < 1)
+    abort();
+  pool->func = func;
+  pool->user_data = user_data;
+  pool->threads = calloc((size_t) max_threads, sizeof(*pool->threads));
+  if (!pool->threads)
+    abort();
+  pthread_mutex_init(&pool->lock, NULL);
+  pthread_cond_init(&pool->pushed, NULL);
+  for (; pool->num_threads < max_threads; pool->num_threads++)
+    if (pthread_create(&pool->threads[pool->num_threads], NULL, thread_pool_worker, pool) != 0)
+      break;
+  if (pool->num_threads)
+    return pool;
+  if (error) {
+    *error = calloc(1, sizeof(**error));
+    if (!*error)
+      abort();
+    (*error)->message = g_strdup("Creating a thread failed");
+  }
+  g_thread_pool_free(pool, TRUE, FALSE);
+  return NULL;
+}
+
+gboolean g_thread_pool_push(GThreadPool *pool, gpointer data, GError **error) {
+  gpointer *queue;
+  size_t i;
+
+  (void) error;
+  pthread_mutex_lock(&pool->lock);
+  if (pool->len == pool->capacity) {
+    queue = calloc(pool->capacity ? pool->capacity * 2 : 8, sizeof(*queue));
+    if (!queue)
+      abort();
+    for (i = 0; i < pool->len; i++)
+      queue[i] = pool->queue[(pool->head + i) % pool->capacity];
+    free(pool->queue);
+    pool->queue = queue;
+    pool->head = 0;
+    pool->capacity = pool->capacity ? pool->capacity * 2 : 8;
+  }
+  pool->queue[(pool->head + pool->len) % pool->capacity] = data;
+  pool->len++;
+  pthread_cond_signal(&pool->pushed);
+  pthread_mutex_unlock(&pool->lock);
+  return TRUE;
+}
+
+// Always joins the threads, which only stop once they are idle.
+void g_thread_pool_free(GThreadPool *pool, gboolean immediate, gboolean wait_) {
+  gint i;
+
+  (void) wait_;
+  pthread_mutex_lock(&pool->lock);
+  pool->stopping = TRUE;
+  if (immediate)
+    pool->len = 0;
+  pthread_cond_broadcast(&pool->pushed);
+  pthread_mutex_unlock(&pool->lock);
+  for (i = 0; i < pool->num_threads; i++)
+    pthread_join(pool->threads[i], NULL);
+  pthread_cond_destroy(&pool->pushed);
+  pthread_mutex_destroy(&pool->lock);
+  free(pool->threads);
+  free(pool->queue);
+  free(pool);
+}
+
+G_DEFINE_TYPE(GstElement, gst_element, G_TYPE_OBJECT)
+
+static void gst_element_finalize(GObject *object) {
+  g_free(GST_OBJECT_NAME(object));
+  g_mutex_clear(&GST_OBJECT(object)->lock);
+  G_OBJECT_CLASS(gst_element_parent_class)->finalize(object);
+}
+
+static void gst_element_class_init(GstElementClass *klass) {
+  G_OBJECT_CLASS(klass)->finalize = gst_element_finalize;
+}
+
+static void gst_element_init(GstElement *element) {
+  g_mutex_init(&GST_OBJECT(element)->lock);
+  GST_OBJECT_NAME(element) = NULL;
+}
+
+void gst_element_class_set_details_simple(GstElementClass *klass, const gchar *longname,
+                                          const gchar *classification,
+                                          const gchar *description, const gchar *author) {
+  (void) klass, (void) longname, (void) classification, (void) description, (void) author;
+}
+
+gboolean gst_element_register(GstPlugin *plugin, const gchar *name, guint rank,
+                              GType type) {
+  (void) plugin, (void) rank;
+  if (num_factories == MAX_FACTORIES)
+    return FALSE;
+  factories[num_factories].name = name;
+  factories[num_factories].type = type;
+  num_factories++;
+  return TRUE;
+}
+
+GstElement *gst_element_factory_make(const gchar *factoryname, const gchar *name) {
+  GstElement *element;
+  gchar default_name[64];
+  size_t i;
+
+  for (i = 0; i < num_factories; i++)
+    if (strcmp(factories[i].name, factoryname) == 0) {
+      element = g_object_new(factories[i].type, NULL);
+      snprintf(default_name, sizeof(default_name), "%s%u", factoryname, elements_made++);
+      GST_OBJECT_NAME(element) = g_strdup(name ? name : default_name);
+      return element;
+    }
+  return NULL;
+}
+
+GstPadTemplate *gst_static_pad_template_get(GstStaticPadTemplate *pad_template) {
+  return (GstPadTemplate *) pad_template;
+}
+
+void gst_element_class_add_pad_template(GstElementClass *klass, GstPadTemplate *templ) {
+  (void) klass, (void) templ;
+}
+
+G_DEFINE_TYPE(GstBaseTransform, gst_base_transform, GST_TYPE_ELEMENT)
+
+// A pipeline would send the event on downstream.
+static gboolean gst_base_transform_real_sink_event(GstBaseTransform *trans, GstEvent *event) {
+  (void) trans;
+  gst_event_unref(event);
+  return TRUE;
+}
+
+static void gst_base_transform_class_init(GstBaseTransformClass *klass) {
+  klass->sink_event = gst_base_transform_real_sink_event;
+}
+
+static void gst_base_transform_init(GstBaseTransform *trans) {
+  (void) trans;
+}
+
+void gst_base_transform_set_passthrough(GstBaseTransform *trans, gboolean passthrough) {
+  trans->passthrough = passthrough;
+}
+
+GstEvent *gst_event_new_eos(void) {
+  GstEvent *event = calloc(1, sizeof(*event));
+
+  if (!event)
+    abort();
+  event->type = GST_EVENT_EOS;
+  return event;
+}
+
+void gst_event_unref(GstEvent *event) {
+  free(event);
+}
+
+GType nvds_meta_api_get_type(void) {
+  static GType type = 0;
+
+  if (!type)
+    type = g_type_register_static_simple(G_TYPE_BOXED, "NvDsMetaAPI", 0, NULL, 0, NULL, 0);
+  return type;
+}
+
+GstBuffer *fake_gst_buffer_new(NvDsBatchMeta *batch_meta) {
+  GstBuffer *buffer = calloc(1, sizeof(*buffer));
+
+  if (!buffer)
+    abort();
+  buffer->batch_meta = batch_meta;
+  return buffer;
+}
+
+GstBuffer *fake_gst_buffer_new_video(NvBufSurface *surface, NvDsBatchMeta *batch_meta) {
+  static GstMetaInfo nvds_meta_info;
+  GstBuffer *buffer = fake_gst_buffer_new(batch_meta);
+
+  nvds_meta_info.api = NVDS_META_API_TYPE;
+  buffer->surface = surface;
+  buffer->meta.meta.info = &nvds_meta_info;
+  buffer->meta.meta_data = batch_meta;
+  buffer->meta.meta_type = NVDS_BATCH_GST_META;
+  return buffer;
+}
+
+gboolean gst_buffer_map(GstBuffer *buffer, GstMapInfo *info, GstMapFlags flags) {
+  if (!buffer->surface)
+    return FALSE;
+  info->flags = flags;
+  info->data = (guint8 *) buffer->surface;
+  info->size = sizeof(*buffer->surface);
+  return TRUE;
+}
+
+void gst_buffer_unmap(GstBuffer *buffer, GstMapInfo *info) {
+  (void) buffer;
+  info->data = NULL;
+  info->size = 0;
+}
+
+GstMeta *gst_buffer_iterate_meta(GstBuffer *buffer, gpointer *state) {
+  if (*state || !buffer->surface || !buffer->batch_meta)
+    return NULL;
+  *state = &buffer->meta;
+  return &buffer->meta.meta;
+}
+
+gboolean gst_meta_api_type_has_tag(GType api, GQuark tag) {
+  return api == NVDS_META_API_TYPE && tag == g_quark_from_static_string(NVDS_META_STRING);
+}
+
+gboolean nvds_set_input_system_timestamp(GstBuffer *buffer, gchar *element_name) {
+  (void) buffer, (void) element_name;
+  return TRUE;
+}
+
+gboolean nvds_set_output_system_timestamp(GstBuffer *buffer, gchar *element_name) {
+  (void) buffer, (void) element_name;
+  return TRUE;
+}
+
+void gst_buffer_unref(GstBuffer *buffer) {
+  free(buffer);
+}
+
+NvDsBatchMeta *gst_buffer_get_nvds_batch_meta(GstBuffer *buffer) {
+  return buffer->batch_meta;
+}
+
+GType gst_structure_get_type(void) {
+  static GType type = 0;
+
+  if (!type)
+    type = g_type_register_static_simple(G_TYPE_BOXED, "GstStructure", 0, NULL, 0, NULL, 0);
+  return type;
+}
+
+static structure_field *structure_field_get(GstStructure *structure, const gchar *fieldname) {
+  structure_field *fields;
+  size_t i;
+
+  for (i = 0; i < structure->num_fields; i++)
+    if (strcmp(structure->fields[i].name, fieldname) == 0)
+      return &structure->fields[i];
+  fields = realloc(structure->fields, (structure->num_fields + 1) * sizeof(*fields));
+  if (!fields)
+    abort();
+  structure->fields = fields;
+  fields[structure->num_fields].name = g_strdup(fieldname);
+  fields[structure->num_fields].type = G_TYPE_INVALID;
+  return &fields[structure->num_fields++];
+}
+
+static void structure_field_clear(structure_field *field) {
+  if (field->type == G_TYPE_STRING)
+    g_free(field->value.v_string);
+}
+
+static void structure_set_valist(GstStructure *structure, const gchar *fieldname,
+                                 va_list *args) {
+  for (; fieldname; fieldname = va_arg(*args, const gchar *)) {
+    structure_field *field = structure_field_get(structure, fieldname);
+
+    structure_field_clear(field);
+    field->type = va_arg(*args, GType);
+    switch (field->type) {
+      case G_TYPE_INT:
+        field->value.v_int = va_arg(*args, gint);
+        break;
+      case G_TYPE_UINT:
+        field->value.v_uint = va_arg(*args, guint);
+        break;
+      case G_TYPE_UINT64:
+        field->value.v_uint64 = va_arg(*args, guint64);
+        break;
+      case G_TYPE_DOUBLE:
+        field->value.v_double = va_arg(*args, gdouble);
+        break;
+      case G_TYPE_STRING:
+        field->value.v_string = g_strdup(va_arg(*args, const gchar *));
+        break;
+      default:
+        fprintf(stderr, "fake-gst: field \"%s\" has unsupported type %s\n", fieldname,
+                g_type_name(field->type));
+        abort();
+    }
+  }
+}
+
+GstStructure *gst_structure_new(const gchar *name, const gchar *firstfield, ...) {
+  GstStructure *structure = calloc(1, sizeof(*structure));
+  va_list args;
+
+  if (!structure)
+    abort();
+  structure->name = g_strdup(name);
+  va_start(args, firstfield);
+  structure_set_valist(structure, firstfield, &args);
+  va_end(args);
+  return structure;
+}
+
+void gst_structure_set(GstStructure *structure, const gchar *fieldname, ...) {
+  va_list args;
+
+  va_start(args, fieldname);
+  structure_set_valist(structure, fieldname, &args);
+  va_end(args);
+}
+
+const gchar *gst_structure_get_name(const GstStructure *structure) {
+  return structure->name;
+}
+
+static const structure_field *structure_find(const GstStructure *structure,
+                                             const gchar *fieldname, GType type) {
+  size_t i;
+
+  for (i = 0; i < structure->num_fields; i++)
+    if (strcmp(structure->fields[i].name, fieldname) == 0)
+      return structure->fields[i].type == type ? &structure->fields[i] : NULL;
+  return NULL;
+}
+
+gboolean gst_structure_get_int(const GstStructure *structure, const gchar *fieldname,
+                               gint *value) {
+  const structure_field *field = structure_find(structure, fieldname, G_TYPE_INT);
+
+  if (!field)
+    return FALSE;
+  *value = field->value.v_int;
+  return TRUE;
+}
+
+gboolean gst_structure_get_uint(const GstStructure *structure, const gchar *fieldname,
+                                guint *value) {
+  const structure_field *field = structure_find(structure, fieldname, G_TYPE_UINT);
+
+  if (!field)
+    return FALSE;
+  *value = field->value.v_uint;
+  return TRUE;
+}
+
+gboolean gst_structure_get_uint64(const GstStructure *structure, const gchar *fieldname,
+                                  guint64 *value) {
+  const structure_field *field = structure_find(structure, fieldname, G_TYPE_UINT64);
+
+  if (!field)
+    return FALSE;
+  *value = field->value.v_uint64;
+  return TRUE;
+}
+
+const gchar *gst_structure_get_string(const GstStructure *structure, const gchar *fieldname) {
+  const structure_field *field = structure_find(structure, fieldname, G_TYPE_STRING);
+
+  return field ? field->value.v_string : NULL;
+}
+
+void gst_structure_free(GstStructure *structure) {
+  size_t i;
+
+  for (i = 0; i < structure->num_fields; i++) {
+    structure_field_clear(&structure->fields[i]);
+    g_free(structure->fields[i].name);
+  }
+  free(structure->fields);
+  g_free(structure->name);
+  free(structure);
+}
+
+GstStructure *gst_caps_get_structure(const GstCaps *caps, guint index) {
+  return index == 0 ? caps->structure : NULL;
+}
+
+GstDebugCategory *_gst_debug_category_new(const gchar *name, guint color,
+                                          const gchar *description) {
+  (void) color, (void) description;
+  debug_category.name = name;
+  return &debug_category;
+}
+
+gchar *_gst_element_error_printf(const gchar *format, ...) {
+  gchar *text;
+  va_list args;
+  int len;
+
+  if (!format)
+    return NULL;
+  va_start(args, format);
+  len = vsnprintf(NULL, 0, format, args);
+  va_end(args);
+  text = len < 0 ? NULL : malloc((size_t) len + 1);
+  if (!text)
+    return NULL;
+  va_start(args, format);
+  vsnprintf(text, (size_t) len + 1, format, args);
+  va_end(args);
+  return text;
+}
+
+static void copy_text(char *dst, size_t size, const char *src) {
+  snprintf(dst, size, "%s", src ? src : "");
+}
+
+void gst_element_message_full(GstElement *element, GstMessageType type, const gchar *domain,
+                              const gchar *code, gchar *text, gchar *debug) {
+  fake_gst_message *message;
+
+  (void) element;
+  pthread_mutex_lock(&bus_lock);
+  if (type == GST_MESSAGE_ERROR) {
+    fake_gst.errors++;
+    message = &fake_gst.error;
+  } else {
+    fake_gst.warnings++;
+    message = &fake_gst.warning;
+  }
+  copy_text(message->domain, sizeof(message->domain), domain);
+  copy_text(message->code, sizeof(message->code), code);
+  copy_text(message->text, sizeof(message->text), text);
+  copy_text(message->debug, sizeof(message->debug), debug);
+  pthread_mutex_unlock(&bus_lock);
+  g_free(text);
+  g_free(debug);
+}
+
+void fake_gst_reset(void) {
+  pthread_mutex_lock(&bus_lock);
+  memset(&fake_gst, 0, sizeof(fake_gst));
+  pthread_mutex_unlock(&bus_lock);
+}
+
+gboolean fake_gst_load_plugin(const GstPluginDesc *desc) {
+  GstPlugin plugin = {desc};
+
+  return desc->plugin_init(&plugin);
+}
+
+gboolean fake_gst_start(GstElement *element) {
+  GstBaseTransformClass *klass = GST_BASE_TRANSFORM_GET_CLASS(element);
+
+  return klass->start ? klass->start(GST_BASE_TRANSFORM(element)) : TRUE;
+}
+
+gboolean fake_gst_stop(GstElement *element) {
+  GstBaseTransformClass *klass = GST_BASE_TRANSFORM_GET_CLASS(element);
+
+  return klass->stop ? klass->stop(GST_BASE_TRANSFORM(element)) : TRUE;
+}
+
+gboolean fake_gst_set_caps(GstElement *element, gint width, gint height) {
+  GstBaseTransformClass *klass = GST_BASE_TRANSFORM_GET_CLASS(element);
+  GstCaps caps = {gst_structure_new("video/x-raw", "width", G_TYPE_INT, width, "height",
+                                    G_TYPE_INT, height, NULL)};
+  gboolean ret;
+
+  ret = klass->set_caps ? klass->set_caps(GST_BASE_TRANSFORM(element), &caps, &caps) : TRUE;
+  gst_structure_free(caps.structure);
+  return ret;
+}
+
+GstFlowReturn fake_gst_push(GstElement *element, GstBuffer *buffer) {
+  GstBaseTransformClass *klass = GST_BASE_TRANSFORM_GET_CLASS(element);
+
+  return klass->transform_ip(GST_BASE_TRANSFORM(element), buffer);
+}
+
+gboolean fake_gst_send_event(GstElement *element, GstEvent *event) {
+  GstBaseTransformClass *klass = GST_BASE_TRANSFORM_GET_CLASS(element);
+
+  return klass->sink_event(GST_BASE_TRANSFORM(element), event);
+}
@@ -0,0 +1,56 @@
+// Copyright 2022, Kyota Tashiro, Mengheng Lee, and Latona Inc.
+// License MIT
+#ifndef FAKE_GST
+#define FAKE_GST
+#include <gst/gst.h>
+#include <gst/base/gstbasetransform.h>
+#include "gstnvdsmeta.h"
+#include "nvbufsurface.h"
+
+// Drives an element built against the stand-in GStreamer headers in stubs/
+// the way a pipeline would: loads its plugin, starts and stops it, and hands
+// it buffers and events. The error and warning messages it posts are kept
+// here instead of going to a bus.
+
+#define FAKE_GST_MAX_TEXT 256
+
+typedef struct fake_gst_message {
+  char domain[32];
+  char code[32];
+  char text[FAKE_GST_MAX_TEXT];
+  char debug[FAKE_GST_MAX_TEXT];
+} fake_gst_message;
+
+typedef struct fake_gst_bus {
+  unsigned long errors;
+  unsigned long warnings;
+  // The latest of each.
+  fake_gst_message error;
+  fake_gst_message warning;
+} fake_gst_bus;
+
+extern fake_gst_bus fake_gst;
+
+// Forgets the messages posted so far.
+void fake_gst_reset(void);
+
+// Runs the plugin's init function, which registers its elements.
+gboolean fake_gst_load_plugin(const GstPluginDesc *desc);
+
+// A buffer carrying batch_meta, which stays the caller's.
+GstBuffer *fake_gst_buffer_new(NvDsBatchMeta *batch_meta);
+// A buffer of NVMM memory holding surface, with batch_meta attached as an
+// NvDsMeta when it is not NULL. Both stay the caller's.
+GstBuffer *fake_gst_buffer_new_video(NvBufSurface *surface, NvDsBatchMeta *batch_meta);
+
+// Calls into the GstBaseTransform virtual methods of element.
+gboolean fake_gst_start(GstElement *element);
+gboolean fake_gst_stop(GstElement *element);
+// Negotiates video caps of width x height on both pads.
+gboolean fake_gst_set_caps(GstElement *element, gint width, gint height);
+// Leaves buffer to the caller, as a passthrough transform does.
+GstFlowReturn fake_gst_push(GstElement *element, GstBuffer *buffer);
+// Takes event.
+gboolean fake_gst_send_event(GstElement *element, GstEvent *event);
+
+#endif
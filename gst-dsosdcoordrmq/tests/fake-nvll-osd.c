@@ -0,0 +1,150 @@
+// Copyright 2022, Kyota Tashiro, Mengheng Lee, and Latona Inc.
+// License MIT
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include "fake-nvll-osd.h"
+
+fake_nvll_osd_log fake_nvll_osd = {.fail_op = FAKE_NVLL_OSD_NUM_OPS};
+static pthread_mutex_t log_lock = PTHREAD_MUTEX_INITIALIZER;
+
+void fake_nvll_osd_reset(void) {
+  pthread_mutex_lock(&log_lock);
+  memset(&fake_nvll_osd, 0, sizeof(fake_nvll_osd));
+  fake_nvll_osd.fail_op = FAKE_NVLL_OSD_NUM_OPS;
+  pthread_mutex_unlock(&log_lock);
+}
+
+unsigned int fake_nvll_osd_calls_on(fake_nvll_osd_op op, const NvBufSurfaceParams *buf_ptr) {
+  unsigned int calls = 0;
+  unsigned int i;
+
+  for (i = 0; i < fake_nvll_osd.num_calls && i < FAKE_NVLL_OSD_MAX_CALLS; i++) {
+    if (fake_nvll_osd.calls[i].op == op && fake_nvll_osd.calls[i].buf_ptr == buf_ptr)
+      calls++;
+  }
+  return calls;
+}
+
+static int record(fake_nvll_osd_op op, const void *context, const NvBufSurfaceParams *buf_ptr,
+                  NvOSD_Mode mode, int primitives) {
+  fake_nvll_osd_call *call;
+  int ret;
+
+  pthread_mutex_lock(&log_lock);
+  if (fake_nvll_osd.num_calls < FAKE_NVLL_OSD_MAX_CALLS) {
+    call = &fake_nvll_osd.calls[fake_nvll_osd.num_calls];
+    call->op = op;
+    call->context = context;
+    call->buf_ptr = buf_ptr;
+    call->mode = mode;
+    call->primitives = primitives;
+  }
+  fake_nvll_osd.num_calls++;
+  fake_nvll_osd.calls_per_op[op]++;
+  fake_nvll_osd.primitives_per_op[op] += (unsigned long) primitives;
+  ret = op == fake_nvll_osd.fail_op ? -1 : 0;
+  pthread_mutex_unlock(&log_lock);
+  return ret;
+}
+
+NvOSDCtxHandle nvll_osd_create_context(void) {
+  pthread_mutex_lock(&log_lock);
+  fake_nvll_osd.contexts++;
+  pthread_mutex_unlock(&log_lock);
+  return malloc(1);
+}
+
+void nvll_osd_destroy_context(NvOSDCtxHandle nvosd_ctx) {
+  free(nvosd_ctx);
+}
+
+void *nvll_osd_set_params(NvOSDCtxHandle nvosd_ctx, int width, int height) {
+  (void) nvosd_ctx;
+  pthread_mutex_lock(&log_lock);
+  fake_nvll_osd.set_params++;
+  fake_nvll_osd.width = width;
+  fake_nvll_osd.height = height;
+  pthread_mutex_unlock(&log_lock);
+  return NULL;
+}
+
+void nvll_osd_set_clock_params(NvOSDCtxHandle nvosd_ctx, NvOSD_TextParams *clk_params) {
+  (void) nvosd_ctx;
+  pthread_mutex_lock(&log_lock);
+  fake_nvll_osd.clock_params++;
+  fake_nvll_osd.clock = *clk_params;
+  pthread_mutex_unlock(&log_lock);
+}
+
+void nvll_osd_init_colors_for_hw_blend(NvOSDCtxHandle nvosd_ctx, NvOSD_Color_info *color_info,
+                                       int num_classes) {
+  (void) nvosd_ctx;
+  (void) color_info;
+  (void) num_classes;
+}
+
+int nvll_osd_put_text(NvOSDCtxHandle nvosd_ctx, NvOSD_FrameTextParams *p) {
+  return record(FAKE_NVLL_OSD_PUT_TEXT, nvosd_ctx, p->buf_ptr, p->mode, p->num_strings);
+}
+
+int nvll_osd_draw_rectangles(NvOSDCtxHandle nvosd_ctx, NvOSD_FrameRectParams *p) {
+  return record(FAKE_NVLL_OSD_RECTANGLES, nvosd_ctx, p->buf_ptr, p->mode, p->num_rects);
+}
+
+int nvll_osd_draw_segment_masks(NvOSDCtxHandle nvosd_ctx, NvOSD_FrameSegmentMaskParams *p) {
+  return record(FAKE_NVLL_OSD_SEGMENT_MASKS, nvosd_ctx, p->buf_ptr, p->mode, p->num_segments);
+}
+
+int nvll_osd_draw_lines(NvOSDCtxHandle nvosd_ctx, NvOSD_FrameLineParams *p) {
+  return record(FAKE_NVLL_OSD_LINES, nvosd_ctx, p->buf_ptr, p->mode, p->num_lines);
+}
+
+int nvll_osd_draw_arrows(NvOSDCtxHandle nvosd_ctx, NvOSD_FrameArrowParams *p) {
+  return record(FAKE_NVLL_OSD_ARROWS, nvosd_ctx, p->buf_ptr, p->mode, p->num_arrows);
+}
+
+int nvll_osd_draw_circles(NvOSDCtxHandle nvosd_ctx, NvOSD_FrameCircleParams *p) {
+  return record(FAKE_NVLL_OSD_CIRCLES, nvosd_ctx, p->buf_ptr, p->mode, p->num_circles);
+}
+
+// Surfaces are host memory already, so mapping only hands out dataPtr.
+int NvBufSurfaceMap(NvBufSurface *surf, int index, int plane, NvBufSurfaceMemMapFlags type) {
+  int ret = 0;
+
+  (void) plane;
+  (void) type;
+  pthread_mutex_lock(&log_lock);
+  if (fake_nvll_osd.fail_maps)
+    ret = -1;
+  else
+    fake_nvll_osd.maps++;
+  pthread_mutex_unlock(&log_lock);
+  if (ret == 0)
+    surf->surfaceList[index].mappedAddr.addr[0] = surf->surfaceList[index].dataPtr;
+  return ret;
+}
+
+int NvBufSurfaceUnMap(NvBufSurface *surf, int index, int plane) {
+  (void) plane;
+  surf->surfaceList[index].mappedAddr.addr[0] = NULL;
+  pthread_mutex_lock(&log_lock);
+  fake_nvll_osd.unmaps++;
+  pthread_mutex_unlock(&log_lock);
+  return 0;
+}
+
+int NvBufSurfaceSyncForCpu(NvBufSurface *surf, int index, int plane) {
+  (void) surf;
+  (void) index;
+  (void) plane;
+  return 0;
+}
+
+int NvBufSurfaceSyncForDevice(NvBufSurface *surf, int index, int plane) {
+  (void) surf;
+  (void) index;
+  (void) plane;
+  return 0;
+}
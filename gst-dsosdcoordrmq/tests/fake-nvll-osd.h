@@ -0,0 +1,61 @@
+// Copyright 2022, Kyota Tashiro, Mengheng Lee, and Latona Inc.
+// License MIT
+#ifndef FAKE_NVLL_OSD
+#define FAKE_NVLL_OSD
+#include "nvll_osd_api.h"
+
+// nvll_osd and NvBufSurface calls that draw nothing but log what they were
+// handed, so a test can tell how many calls each surface took. Calls may
+// come from several threads at once.
+
+typedef enum {
+  FAKE_NVLL_OSD_RECTANGLES,
+  FAKE_NVLL_OSD_SEGMENT_MASKS,
+  FAKE_NVLL_OSD_PUT_TEXT,
+  FAKE_NVLL_OSD_LINES,
+  FAKE_NVLL_OSD_ARROWS,
+  FAKE_NVLL_OSD_CIRCLES,
+  FAKE_NVLL_OSD_NUM_OPS,
+} fake_nvll_osd_op;
+
+#define FAKE_NVLL_OSD_MAX_CALLS 4096
+
+typedef struct fake_nvll_osd_call {
+  fake_nvll_osd_op op;
+  const void *context;
+  const NvBufSurfaceParams *buf_ptr;
+  NvOSD_Mode mode;
+  int primitives;
+} fake_nvll_osd_call;
+
+typedef struct fake_nvll_osd_log {
+  // The first FAKE_NVLL_OSD_MAX_CALLS calls since the last reset.
+  fake_nvll_osd_call calls[FAKE_NVLL_OSD_MAX_CALLS];
+  unsigned int num_calls;
+  unsigned long calls_per_op[FAKE_NVLL_OSD_NUM_OPS];
+  unsigned long primitives_per_op[FAKE_NVLL_OSD_NUM_OPS];
+  unsigned long maps;
+  unsigned long unmaps;
+  unsigned long contexts;
+  // Contexts given clock params by nvll_osd_set_clock_params, and the
+  // latest of them.
+  unsigned long clock_params;
+  NvOSD_TextParams clock;
+  // nvll_osd_set_params calls, and the latest size.
+  unsigned long set_params;
+  int width;
+  int height;
+  // The call of this op fails, FAKE_NVLL_OSD_NUM_OPS for none.
+  fake_nvll_osd_op fail_op;
+  // NvBufSurfaceMap fails.
+  int fail_maps;
+} fake_nvll_osd_log;
+
+extern fake_nvll_osd_log fake_nvll_osd;
+
+void fake_nvll_osd_reset(void);
+
+// Calls of op on buf_ptr since the last reset.
+unsigned int fake_nvll_osd_calls_on(fake_nvll_osd_op op, const NvBufSurfaceParams *buf_ptr);
+
+#endif
@@ -0,0 +1,26 @@
+// Copyright 2022, Kyota Tashiro, Mengheng Lee, and Latona Inc.
+// License MIT
+#ifndef FAKE_PANGO
+#define FAKE_PANGO
+#include <pango/pangocairo.h>
+
+// Pango and cairo calls that lay text out in a fake font and count what they
+// rasterize. A glyph of font size size is fake_pango_glyph_width wide and
+// size high, and covers all of that but its last column, which is left
+// blank as the space between glyphs.
+
+typedef struct fake_pango_log {
+  // pango_cairo_show_layout calls and the glyphs they drew.
+  unsigned long shown;
+  unsigned long glyphs;
+} fake_pango_log;
+
+extern fake_pango_log fake_pango;
+
+void fake_pango_reset(void);
+
+// ':' is a quarter of size, '1' a third and every other character a half,
+// at least 2 pixels.
+unsigned int fake_pango_glyph_width(char c, unsigned int size);
+
+#endif
@@ -0,0 +1,30 @@
+// Copyright 2022, Kyota Tashiro, Mengheng Lee, and Latona Inc.
+// License MIT
+#ifndef CHECK_STUB_CAIRO
+#define CHECK_STUB_CAIRO
+
+// The image surfaces of cairo the text cache rasterizes into: A8 only, drawn
+// on by pango_cairo_show_layout alone. fake-pango.c implements the calls.
+
+typedef enum _cairo_format {
+  CAIRO_FORMAT_INVALID = -1,
+  CAIRO_FORMAT_ARGB32 = 0,
+  CAIRO_FORMAT_A8 = 2,
+} cairo_format_t;
+
+typedef struct _cairo_surface cairo_surface_t;
+typedef struct _cairo cairo_t;
+
+// -1 for formats other than A8.
+int cairo_format_stride_for_width(cairo_format_t format, int width);
+// data stays the caller's and must outlive the surface.
+cairo_surface_t *cairo_image_surface_create_for_data(unsigned char *data, cairo_format_t format,
+                                                     int width, int height, int stride);
+void cairo_surface_finish(cairo_surface_t *surface);
+void cairo_surface_destroy(cairo_surface_t *surface);
+
+cairo_t *cairo_create(cairo_surface_t *target);
+void cairo_move_to(cairo_t *cr, double x, double y);
+void cairo_destroy(cairo_t *cr);
+
+#endif
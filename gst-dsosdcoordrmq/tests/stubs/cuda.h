@@ -0,0 +1,9 @@
+// Copyright 2022, Kyota Tashiro, Mengheng Lee, and Latona Inc.
+// License MIT
+#ifndef CHECK_STUB_CUDA
+#define CHECK_STUB_CUDA
+
+// Stand-in for the CUDA driver API header, of which the OSD element uses
+// nothing but through cuda_runtime.h.
+
+#endif
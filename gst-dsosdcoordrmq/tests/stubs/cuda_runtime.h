@@ -0,0 +1,33 @@
+// Copyright 2022, Kyota Tashiro, Mengheng Lee, and Latona Inc.
+// License MIT
+#ifndef CHECK_STUB_CUDA_RUNTIME
+#define CHECK_STUB_CUDA_RUNTIME
+
+// Stand-in for the CUDA runtime calls the OSD element makes, on a machine
+// with a single discrete GPU, device 0.
+
+typedef enum cudaError {
+  cudaSuccess = 0,
+  cudaErrorInvalidValue = 1,
+  cudaErrorInvalidDevice = 101,
+} cudaError_t;
+
+enum cudaDeviceAttr {
+  cudaDevAttrIntegrated = 18,
+};
+
+static inline cudaError_t cudaSetDevice(int device) {
+  return device == 0 ? cudaSuccess : cudaErrorInvalidDevice;
+}
+
+static inline cudaError_t cudaDeviceGetAttribute(int *value, enum cudaDeviceAttr attr,
+                                                 int device) {
+  if (device != 0)
+    return cudaErrorInvalidDevice;
+  if (attr != cudaDevAttrIntegrated)
+    return cudaErrorInvalidValue;
+  *value = 0;
+  return cudaSuccess;
+}
+
+#endif
@@ -0,0 +1,194 @@
+// Copyright 2022, Kyota Tashiro, Mengheng Lee, and Latona Inc.
+// License MIT
+#ifndef CHECK_STUB_GLIB_OBJECT
+#define CHECK_STUB_GLIB_OBJECT
+#include "glib.h"
+
+// Just enough of GObject for the plugins to define their element types,
+// install properties and have them set and read by name. Classes are single
+// inheritance only; fake-gst.c implements the calls.
+
+typedef gsize GType;
+
+// Fundamental types; registered types are numbered after them.
+#define G_TYPE_INVALID ((GType) 0)
+#define G_TYPE_BOOLEAN ((GType) 1)
+#define G_TYPE_INT ((GType) 2)
+#define G_TYPE_UINT ((GType) 3)
+#define G_TYPE_UINT64 ((GType) 4)
+#define G_TYPE_FLOAT ((GType) 5)
+#define G_TYPE_DOUBLE ((GType) 6)
+#define G_TYPE_STRING ((GType) 7)
+#define G_TYPE_ENUM ((GType) 8)
+#define G_TYPE_BOXED ((GType) 9)
+#define G_TYPE_OBJECT ((GType) 10)
+#define G_TYPE_FUNDAMENTAL_MAX ((GType) 16)
+
+typedef struct _GTypeClass {
+  GType g_type;
+} GTypeClass;
+
+typedef struct _GTypeInstance {
+  GTypeClass *g_class;
+} GTypeInstance;
+
+typedef void (*GClassInitFunc)(gpointer g_class);
+typedef void (*GInstanceInitFunc)(GTypeInstance *instance);
+
+GType g_type_register_static_simple(GType parent_type, const gchar *type_name,
+                                    guint class_size, GClassInitFunc class_init,
+                                    guint instance_size, GInstanceInitFunc instance_init,
+                                    guint flags);
+GType g_type_parent(GType type);
+// The fundamental type type derives from, e.g. G_TYPE_ENUM for an enum.
+GType g_type_fundamental(GType type);
+const gchar *g_type_name(GType type);
+gboolean g_type_is_a(GType type, GType is_a_type);
+gpointer g_type_class_peek_parent(gpointer g_class);
+
+#define G_TYPE_FROM_INSTANCE(instance) (((GTypeInstance *) (instance))->g_class->g_type)
+#define G_TYPE_FROM_CLASS(g_class) (((GTypeClass *) (g_class))->g_type)
+#define G_TYPE_CHECK_INSTANCE_CAST(instance, g_type, c_type) ((c_type *) (instance))
+#define G_TYPE_CHECK_CLASS_CAST(g_class, g_type, c_type) ((c_type *) (g_class))
+#define G_TYPE_CHECK_INSTANCE_TYPE(instance, g_type) \
+  ((instance) && g_type_is_a(G_TYPE_FROM_INSTANCE(instance), (g_type)))
+#define G_TYPE_CHECK_CLASS_TYPE(g_class, g_type) \
+  ((g_class) && g_type_is_a(G_TYPE_FROM_CLASS(g_class), (g_type)))
+
+typedef struct _GValue {
+  GType g_type;
+  union {
+    gint v_int;
+    guint v_uint;
+    guint64 v_uint64;
+    gfloat v_float;
+    gdouble v_double;
+    gpointer v_pointer;
+  } data;
+} GValue;
+
+#define G_VALUE_INIT {0, {0}}
+
+void g_value_set_boolean(GValue *value, gboolean v_boolean);
+gboolean g_value_get_boolean(const GValue *value);
+void g_value_set_uint(GValue *value, guint v_uint);
+guint g_value_get_uint(const GValue *value);
+void g_value_set_uint64(GValue *value, guint64 v_uint64);
+guint64 g_value_get_uint64(const GValue *value);
+void g_value_set_enum(GValue *value, gint v_enum);
+gint g_value_get_enum(const GValue *value);
+void g_value_set_float(GValue *value, gfloat v_float);
+gfloat g_value_get_float(const GValue *value);
+void g_value_set_double(GValue *value, gdouble v_double);
+gdouble g_value_get_double(const GValue *value);
+// The value keeps a copy of v_string.
+void g_value_set_string(GValue *value, const gchar *v_string);
+const gchar *g_value_get_string(const GValue *value);
+gchar *g_value_dup_string(const GValue *value);
+// The value takes ownership of v_boxed.
+void g_value_take_boxed(GValue *value, gconstpointer v_boxed);
+gpointer g_value_get_boxed(const GValue *value);
+// Frees what the value owns.
+void g_value_unset(GValue *value);
+
+typedef struct _GEnumValue {
+  gint value;
+  const gchar *value_name;
+  const gchar *value_nick;
+} GEnumValue;
+
+// values must outlive the type, as it does in GObject.
+GType g_enum_register_static(const gchar *name, const GEnumValue *values);
+// The value of type named nick, NULL if it has none.
+const GEnumValue *g_enum_get_value_by_nick(GType enum_type, const gchar *nick);
+
+typedef enum {
+  G_PARAM_READABLE = 1 << 0,
+  G_PARAM_WRITABLE = 1 << 1,
+  G_PARAM_READWRITE = G_PARAM_READABLE | G_PARAM_WRITABLE,
+  G_PARAM_STATIC_STRINGS = 7 << 5,
+} GParamFlags;
+
+typedef struct _GParamSpec {
+  const gchar *name;
+  guint flags;
+  GType value_type;
+  guint param_id;
+  // Range of numeric properties, checked when they are set.
+  gdouble minimum;
+  gdouble maximum;
+} GParamSpec;
+
+GParamSpec *g_param_spec_boolean(const gchar *name, const gchar *nick, const gchar *blurb,
+                                 gboolean default_value, GParamFlags flags);
+GParamSpec *g_param_spec_uint(const gchar *name, const gchar *nick, const gchar *blurb,
+                              guint minimum, guint maximum, guint default_value,
+                              GParamFlags flags);
+GParamSpec *g_param_spec_uint64(const gchar *name, const gchar *nick, const gchar *blurb,
+                                guint64 minimum, guint64 maximum, guint64 default_value,
+                                GParamFlags flags);
+GParamSpec *g_param_spec_enum(const gchar *name, const gchar *nick, const gchar *blurb,
+                              GType enum_type, gint default_value, GParamFlags flags);
+GParamSpec *g_param_spec_float(const gchar *name, const gchar *nick, const gchar *blurb,
+                               gfloat minimum, gfloat maximum, gfloat default_value,
+                               GParamFlags flags);
+GParamSpec *g_param_spec_double(const gchar *name, const gchar *nick, const gchar *blurb,
+                                gdouble minimum, gdouble maximum, gdouble default_value,
+                                GParamFlags flags);
+GParamSpec *g_param_spec_string(const gchar *name, const gchar *nick, const gchar *blurb,
+                                const gchar *default_value, GParamFlags flags);
+GParamSpec *g_param_spec_boxed(const gchar *name, const gchar *nick, const gchar *blurb,
+                               GType boxed_type, GParamFlags flags);
+
+typedef struct _GObject {
+  GTypeInstance g_type_instance;
+} GObject;
+
+typedef struct _GObjectClass {
+  GTypeClass g_type_class;
+  void (*set_property)(GObject *object, guint property_id, const GValue *value,
+                       GParamSpec *pspec);
+  void (*get_property)(GObject *object, guint property_id, GValue *value,
+                       GParamSpec *pspec);
+  void (*finalize)(GObject *object);
+} GObjectClass;
+
+#define G_OBJECT(object) ((GObject *) (object))
+#define G_OBJECT_CLASS(g_class) ((GObjectClass *) (g_class))
+#define G_OBJECT_GET_CLASS(object) ((GObjectClass *) ((GTypeInstance *) (object))->g_class)
+
+void g_object_class_install_property(GObjectClass *oclass, guint property_id,
+                                     GParamSpec *pspec);
+GParamSpec *g_object_class_find_property(GObjectClass *oclass, const gchar *property_name);
+
+// Properties are set and read as name, value pairs ending with NULL; values
+// are passed as the C type of the property, enums as gint, and read into
+// pointers to it. Strings and boxed values read are the caller's to free.
+gpointer g_object_new(GType object_type, const gchar *first_property_name, ...);
+void g_object_set(gpointer object, const gchar *first_property_name, ...);
+void g_object_get(gpointer object, const gchar *first_property_name, ...);
+// Finalizes and frees the object; there is no reference counting.
+void g_object_unref(gpointer object);
+
+#define G_OBJECT_WARN_INVALID_PROPERTY_ID(object, property_id, pspec) \
+  fprintf(stderr, "%s:%d: invalid property id %u for \"%s\"\n", __FILE__, __LINE__, \
+          (guint) (property_id), (pspec)->name)
+
+#define G_DEFINE_TYPE(TypeName, type_name, TYPE_PARENT) \
+  static void type_name##_init(TypeName *self); \
+  static void type_name##_class_init(TypeName##Class *klass); \
+  static gpointer type_name##_parent_class = NULL; \
+  static void type_name##_class_intern_init(gpointer klass) { \
+    type_name##_parent_class = g_type_class_peek_parent(klass); \
+    type_name##_class_init((TypeName##Class *) klass); \
+  } \
+  GType type_name##_get_type(void) { \
+    static GType g_define_type_id = 0; \
+    if (!g_define_type_id) \
+      g_define_type_id = g_type_register_static_simple( \
+          TYPE_PARENT, #TypeName, sizeof(TypeName##Class), type_name##_class_intern_init, \
+          sizeof(TypeName), (GInstanceInitFunc) (void (*)(void)) type_name##_init, 0); \
+    return g_define_type_id; \
+  }
+
+#endif
@@ -0,0 +1,168 @@
+// Copyright 2022, Kyota Tashiro, Mengheng Lee, and Latona Inc.
+// License MIT
+#ifndef CHECK_STUB_GLIB
+#define CHECK_STUB_GLIB
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <float.h>
+#include <limits.h>
+
+// The few glib types and helpers the DeepStream meta headers and the plugins
+// are written in, so the tests build without glib.
+
+typedef char gchar;
+typedef uint8_t guint8;
+typedef int gint;
+typedef unsigned int guint;
+typedef int gboolean;
+typedef float gfloat;
+typedef double gdouble;
+typedef int32_t gint32;
+typedef uint32_t guint32;
+typedef int64_t gint64;
+typedef uint64_t guint64;
+typedef long glong;
+typedef unsigned long gulong;
+typedef size_t gsize;
+typedef void *gpointer;
+typedef const void *gconstpointer;
+typedef guint32 GQuark;
+
+#ifndef FALSE
+#define FALSE 0
+#endif
+#ifndef TRUE
+#define TRUE 1
+#endif
+
+#define G_BEGIN_DECLS
+#define G_END_DECLS
+#define G_N_ELEMENTS(arr) (sizeof(arr) / sizeof((arr)[0]))
+#define G_MAXUINT UINT_MAX
+#define G_MAXUINT64 UINT64_MAX
+#define G_MAXDOUBLE DBL_MAX
+#define G_GNUC_PRINTF(format_idx, arg_idx) \
+  __attribute__((__format__(__printf__, format_idx, arg_idx)))
+
+#ifndef MIN
+#define MIN(a, b) (((a) < (b)) ? (a) : (b))
+#endif
+#ifndef MAX
+#define MAX(a, b) (((a) > (b)) ? (a) : (b))
+#endif
+#define CLAMP(x, low, high) (((x) > (high)) ? (high) : (((x) < (low)) ? (low) : (x)))
+#define GPOINTER_TO_UINT(p) ((guint) (uintptr_t) (p))
+#define GUINT_TO_POINTER(u) ((gpointer) (uintptr_t) (u))
+#define g_ascii_isdigit(c) ((c) >= '0' && (c) <= '9')
+
+static inline void g_free(gpointer mem) {
+  free(mem);
+}
+
+static inline gchar *g_strdup(const gchar *str) {
+  return str ? strdup(str) : NULL;
+}
+
+// Aborts when memory runs out, like glib.
+static inline gpointer g_realloc_n(gpointer mem, gsize n_blocks, gsize n_block_bytes) {
+  gpointer grown = realloc(mem, n_blocks * n_block_bytes);
+
+  if (!grown && n_blocks && n_block_bytes)
+    abort();
+  return grown;
+}
+
+#define g_renew(struct_type, mem, n_structs) \
+  ((struct_type *) g_realloc_n((mem), (n_structs), sizeof(struct_type)))
+
+static inline gchar *g_strstr_len(const gchar *haystack, gsize haystack_len,
+                                  const gchar *needle) {
+  (void) haystack_len;
+  return strstr(haystack, needle);
+}
+
+#define g_snprintf snprintf
+#define g_print printf
+
+// Returns the value before the addition, like glib since 2.30.
+#define g_atomic_int_add(atomic, val) __atomic_fetch_add((atomic), (val), __ATOMIC_SEQ_CST)
+#define g_atomic_int_set(atomic, newval) __atomic_store_n((atomic), (newval), __ATOMIC_SEQ_CST)
+
+typedef struct _GMutex {
+  pthread_mutex_t mutex;
+} GMutex;
+
+static inline void g_mutex_init(GMutex *mutex) {
+  pthread_mutex_init(&mutex->mutex, NULL);
+}
+
+static inline void g_mutex_clear(GMutex *mutex) {
+  pthread_mutex_destroy(&mutex->mutex);
+}
+
+static inline void g_mutex_lock(GMutex *mutex) {
+  pthread_mutex_lock(&mutex->mutex);
+}
+
+static inline void g_mutex_unlock(GMutex *mutex) {
+  pthread_mutex_unlock(&mutex->mutex);
+}
+
+typedef struct _GCond {
+  pthread_cond_t cond;
+} GCond;
+
+static inline void g_cond_init(GCond *cond) {
+  pthread_cond_init(&cond->cond, NULL);
+}
+
+static inline void g_cond_clear(GCond *cond) {
+  pthread_cond_destroy(&cond->cond);
+}
+
+static inline void g_cond_wait(GCond *cond, GMutex *mutex) {
+  pthread_cond_wait(&cond->cond, &mutex->mutex);
+}
+
+static inline void g_cond_signal(GCond *cond) {
+  pthread_cond_signal(&cond->cond);
+}
+
+typedef struct _GError {
+  GQuark domain;
+  gint code;
+  gchar *message;
+} GError;
+
+static inline void g_error_free(GError *error) {
+  free(error->message);
+  free(error);
+}
+
+// Interned strings; fake-gst.c implements them.
+GQuark g_quark_from_static_string(const gchar *string);
+
+typedef void (*GFunc)(gpointer data, gpointer user_data);
+typedef struct _GThreadPool GThreadPool;
+
+// max_threads threads run func on the data pushed, in the order it was
+// pushed; fake-gst.c implements the pool on pthreads.
+GThreadPool *g_thread_pool_new(GFunc func, gpointer user_data, gint max_threads,
+                               gboolean exclusive, GError **error);
+gboolean g_thread_pool_push(GThreadPool *pool, gpointer data, GError **error);
+// Waits for the data pushed to be done unless immediate is set.
+void g_thread_pool_free(GThreadPool *pool, gboolean immediate, gboolean wait_);
+
+typedef struct _GList GList;
+struct _GList {
+  gpointer data;
+  GList *next;
+  GList *prev;
+};
+
+#endif
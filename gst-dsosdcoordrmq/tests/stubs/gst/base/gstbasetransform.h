@@ -0,0 +1,35 @@
+// Copyright 2022, Kyota Tashiro, Mengheng Lee, and Latona Inc.
+// License MIT
+#ifndef CHECK_STUB_GST_BASE_TRANSFORM
+#define CHECK_STUB_GST_BASE_TRANSFORM
+#include <gst/gst.h>
+
+// The in-place half of GstBaseTransform. Nothing calls the virtual methods
+// but the tests, through fake-gst.h.
+
+typedef struct _GstBaseTransform {
+  GstElement element;
+  gboolean passthrough;
+} GstBaseTransform;
+
+typedef struct _GstBaseTransformClass {
+  GstElementClass parent_class;
+  gboolean passthrough_on_same_caps;
+  gboolean transform_ip_on_passthrough;
+  gboolean (*start)(GstBaseTransform *trans);
+  gboolean (*stop)(GstBaseTransform *trans);
+  gboolean (*set_caps)(GstBaseTransform *trans, GstCaps *incaps, GstCaps *outcaps);
+  gboolean (*sink_event)(GstBaseTransform *trans, GstEvent *event);
+  GstFlowReturn (*transform_ip)(GstBaseTransform *trans, GstBuffer *buf);
+} GstBaseTransformClass;
+
+GType gst_base_transform_get_type(void);
+#define GST_TYPE_BASE_TRANSFORM (gst_base_transform_get_type())
+#define GST_BASE_TRANSFORM(obj) ((GstBaseTransform *) (obj))
+#define GST_BASE_TRANSFORM_CLASS(klass) ((GstBaseTransformClass *) (klass))
+#define GST_BASE_TRANSFORM_GET_CLASS(obj) \
+  ((GstBaseTransformClass *) ((GTypeInstance *) (obj))->g_class)
+
+void gst_base_transform_set_passthrough(GstBaseTransform *trans, gboolean passthrough);
+
+#endif
@@ -0,0 +1,246 @@
+// Copyright 2022, Kyota Tashiro, Mengheng Lee, and Latona Inc.
+// License MIT
+#ifndef CHECK_STUB_GST
+#define CHECK_STUB_GST
+#include <glib-object.h>
+
+// The parts of GStreamer an element uses to register itself, read buffers and
+// report errors, so the plugins build and run in tests without GStreamer.
+// There are no pads or pipelines: tests drive an element through
+// fake-gst.h. fake-gst.c implements the calls.
+
+#define GST_VERSION_MAJOR 1
+#define GST_VERSION_MINOR 16
+
+#define GST_SECOND ((guint64) 1000000000)
+#define GST_PTR_FORMAT "p"
+
+typedef struct _GstPlugin GstPlugin;
+typedef struct _GstBuffer GstBuffer;
+typedef struct _GstStructure GstStructure;
+typedef struct _GstCaps GstCaps;
+typedef struct _GstPadTemplate GstPadTemplate;
+
+typedef enum {
+  GST_FLOW_OK = 0,
+  GST_FLOW_ERROR = -5,
+} GstFlowReturn;
+
+typedef enum {
+  GST_RANK_NONE = 0,
+  GST_RANK_MARGINAL = 64,
+  GST_RANK_SECONDARY = 128,
+  GST_RANK_PRIMARY = 256,
+} GstRank;
+
+#define GST_PARAM_MUTABLE_READY (1 << 10)
+
+// The object lock is a plain mutex; the name is set by
+// gst_element_factory_make.
+typedef struct _GstObject {
+  GObject object;
+  GMutex lock;
+  gchar *name;
+} GstObject;
+
+#define GST_OBJECT(obj) ((GstObject *) (obj))
+#define GST_OBJECT_NAME(obj) (GST_OBJECT(obj)->name)
+#define GST_OBJECT_LOCK(obj) g_mutex_lock(&GST_OBJECT(obj)->lock)
+#define GST_OBJECT_UNLOCK(obj) g_mutex_unlock(&GST_OBJECT(obj)->lock)
+
+typedef struct _GstElement {
+  GstObject object;
+} GstElement;
+
+typedef struct _GstElementClass {
+  GObjectClass parent_class;
+} GstElementClass;
+
+GType gst_element_get_type(void);
+#define GST_TYPE_ELEMENT (gst_element_get_type())
+#define GST_ELEMENT(obj) ((GstElement *) (obj))
+#define GST_ELEMENT_CLASS(klass) ((GstElementClass *) (klass))
+#define GST_ELEMENT_NAME(elem) GST_OBJECT_NAME(elem)
+
+void gst_element_class_set_details_simple(GstElementClass *klass, const gchar *longname,
+                                          const gchar *classification,
+                                          const gchar *description, const gchar *author);
+gboolean gst_element_register(GstPlugin *plugin, const gchar *name, guint rank,
+                              GType type);
+// An instance of the element registered as factoryname, NULL if none is.
+// Without a name it is named after the factory and a counter, e.g.
+// "dsosdcoordrmq0".
+GstElement *gst_element_factory_make(const gchar *factoryname, const gchar *name);
+
+typedef enum {
+  GST_PAD_UNKNOWN,
+  GST_PAD_SRC,
+  GST_PAD_SINK,
+} GstPadDirection;
+
+typedef enum {
+  GST_PAD_ALWAYS,
+  GST_PAD_SOMETIMES,
+  GST_PAD_REQUEST,
+} GstPadPresence;
+
+typedef struct _GstStaticCaps {
+  const gchar *string;
+} GstStaticCaps;
+
+#define GST_STATIC_CAPS(string) {string}
+#define GST_STATIC_CAPS_ANY GST_STATIC_CAPS("ANY")
+
+typedef struct _GstStaticPadTemplate {
+  const gchar *name_template;
+  GstPadDirection direction;
+  GstPadPresence presence;
+  GstStaticCaps static_caps;
+} GstStaticPadTemplate;
+
+#define GST_STATIC_PAD_TEMPLATE(padname, dir, pres, caps) {padname, dir, pres, caps}
+
+GstPadTemplate *gst_static_pad_template_get(GstStaticPadTemplate *pad_template);
+void gst_element_class_add_pad_template(GstElementClass *klass, GstPadTemplate *templ);
+
+typedef enum {
+  GST_EVENT_UNKNOWN,
+  GST_EVENT_FLUSH_STOP,
+  GST_EVENT_EOS,
+} GstEventType;
+
+typedef struct _GstEvent {
+  GstEventType type;
+} GstEvent;
+
+#define GST_EVENT_TYPE(event) ((event)->type)
+
+GstEvent *gst_event_new_eos(void);
+void gst_event_unref(GstEvent *event);
+
+void gst_buffer_unref(GstBuffer *buffer);
+
+typedef enum {
+  GST_MAP_READ = 1 << 0,
+  GST_MAP_WRITE = 1 << 1,
+} GstMapFlags;
+
+typedef struct _GstMapInfo {
+  GstMapFlags flags;
+  guint8 *data;
+  gsize size;
+} GstMapInfo;
+
+#define GST_MAP_INFO_INIT {0, NULL, 0}
+
+// A buffer made by fake_gst_buffer_new_video maps to its NvBufSurface, as
+// NVMM memory does; any other fails to map.
+gboolean gst_buffer_map(GstBuffer *buffer, GstMapInfo *info, GstMapFlags flags);
+void gst_buffer_unmap(GstBuffer *buffer, GstMapInfo *info);
+
+typedef struct _GstMetaInfo {
+  GType api;
+} GstMetaInfo;
+
+typedef struct _GstMeta {
+  guint flags;
+  const GstMetaInfo *info;
+} GstMeta;
+
+#define GST_META_CAST(meta) ((GstMeta *) (meta))
+
+// The metas of buffer one by one, NULL after the last; *state starts NULL.
+GstMeta *gst_buffer_iterate_meta(GstBuffer *buffer, gpointer *state);
+gboolean gst_meta_api_type_has_tag(GType api, GQuark tag);
+
+// Fields are set as name, GType, value triples ending with NULL; G_TYPE_INT,
+// G_TYPE_UINT, G_TYPE_UINT64, G_TYPE_DOUBLE and G_TYPE_STRING are supported.
+GType gst_structure_get_type(void);
+#define GST_TYPE_STRUCTURE (gst_structure_get_type())
+GstStructure *gst_structure_new(const gchar *name, const gchar *firstfield, ...);
+void gst_structure_set(GstStructure *structure, const gchar *fieldname, ...);
+const gchar *gst_structure_get_name(const GstStructure *structure);
+gboolean gst_structure_get_int(const GstStructure *structure, const gchar *fieldname,
+                               gint *value);
+gboolean gst_structure_get_uint(const GstStructure *structure, const gchar *fieldname,
+                                guint *value);
+gboolean gst_structure_get_uint64(const GstStructure *structure, const gchar *fieldname,
+                                  guint64 *value);
+// The string stays the structure's.
+const gchar *gst_structure_get_string(const GstStructure *structure, const gchar *fieldname);
+void gst_structure_free(GstStructure *structure);
+
+// The structures of caps; fake_gst_set_caps makes caps of one.
+GstStructure *gst_caps_get_structure(const GstCaps *caps, guint index);
+
+typedef gboolean (*GstPluginInitFunc)(GstPlugin *plugin);
+
+typedef struct _GstPluginDesc {
+  gint major_version;
+  gint minor_version;
+  const gchar *name;
+  const gchar *description;
+  GstPluginInitFunc plugin_init;
+  const gchar *version;
+  const gchar *license;
+  const gchar *source;
+  const gchar *package;
+  const gchar *origin;
+} GstPluginDesc;
+
+// Defines gst_plugin_<name>_desc, which tests load with fake_gst_load_plugin.
+#define GST_PLUGIN_DEFINE(major, minor, name, description, init, version, license, package, \
+                          origin) \
+  const GstPluginDesc gst_plugin_##name##_desc = { \
+      major, minor, #name, description, init, version, license, PACKAGE, package, origin};
+
+// Debug output is dropped, but its format is still checked.
+typedef struct _GstDebugCategory {
+  const gchar *name;
+} GstDebugCategory;
+
+#define GST_DEBUG_CATEGORY_STATIC(cat) static GstDebugCategory *cat
+#define GST_DEBUG_CATEGORY_INIT(cat, name, color, description) \
+  ((cat) = _gst_debug_category_new((name), (color), (description)))
+#define GST_DEBUG_FUNCPTR(ptr) (ptr)
+
+GstDebugCategory *_gst_debug_category_new(const gchar *name, guint color,
+                                          const gchar *description);
+
+static inline void G_GNUC_PRINTF(2, 3) _gst_debug_log(gconstpointer object,
+                                                    const gchar *format, ...) {
+  (void) object;
+  (void) format;
+}
+
+#define GST_ERROR_OBJECT(obj, ...) _gst_debug_log((obj), __VA_ARGS__)
+#define GST_WARNING_OBJECT(obj, ...) _gst_debug_log((obj), __VA_ARGS__)
+#define GST_INFO_OBJECT(obj, ...) _gst_debug_log((obj), __VA_ARGS__)
+#define GST_DEBUG_OBJECT(obj, ...) _gst_debug_log((obj), __VA_ARGS__)
+#define GST_LOG_OBJECT(obj, ...) _gst_debug_log((obj), __VA_ARGS__)
+
+// Error and warning messages of an element, recorded by fake-gst.c instead of
+// being posted on a bus.
+typedef enum {
+  GST_MESSAGE_ERROR,
+  GST_MESSAGE_WARNING,
+} GstMessageType;
+
+gchar *_gst_element_error_printf(const gchar *format, ...) G_GNUC_PRINTF(1, 2);
+// Takes ownership of text and debug.
+void gst_element_message_full(GstElement *element, GstMessageType type, const gchar *domain,
+                              const gchar *code, gchar *text, gchar *debug);
+
+// text and debug are parenthesized printf arguments, or NULL.
+#define GST_ELEMENT_MESSAGE(el, type, domain, code, text, debug) \
+  do { \
+    gchar *__txt = _gst_element_error_printf text; \
+    gchar *__dbg = _gst_element_error_printf debug; \
+    gst_element_message_full(GST_ELEMENT(el), (type), #domain, #code, __txt, __dbg); \
+  } while (0)
+#define GST_ELEMENT_ERROR(el, domain, code, text, debug) \
+  GST_ELEMENT_MESSAGE(el, GST_MESSAGE_ERROR, domain, code, text, debug)
+#define GST_ELEMENT_WARNING(el, domain, code, text, debug) \
+  GST_ELEMENT_MESSAGE(el, GST_MESSAGE_WARNING, domain, code, text, debug)
+
+#endif
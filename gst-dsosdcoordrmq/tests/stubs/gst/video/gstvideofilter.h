@@ -0,0 +1,11 @@
+// Copyright 2022, Kyota Tashiro, Mengheng Lee, and Latona Inc.
+// License MIT
+#ifndef CHECK_STUB_GST_VIDEO_FILTER
+#define CHECK_STUB_GST_VIDEO_FILTER
+#include <gst/video/video.h>
+#include <gst/base/gstbasetransform.h>
+
+// Included by the OSD element, which derives from GstBaseTransform and uses
+// none of GstVideoFilter.
+
+#endif
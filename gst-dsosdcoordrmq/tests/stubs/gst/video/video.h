@@ -0,0 +1,17 @@
+// Copyright 2022, Kyota Tashiro, Mengheng Lee, and Latona Inc.
+// License MIT
+#ifndef CHECK_STUB_GST_VIDEO
+#define CHECK_STUB_GST_VIDEO
+#include <gst/gst.h>
+
+// The caps string macro of gst-video, for the pad templates of the OSD
+// element.
+
+#define GST_VIDEO_SIZE_RANGE "(int) [ 1, max ]"
+#define GST_VIDEO_FPS_RANGE "(fraction) [ 0, max ]"
+
+#define GST_VIDEO_CAPS_MAKE_WITH_FEATURES(features, format) \
+  "video/x-raw(" features "), format = (string) " format ", width = " GST_VIDEO_SIZE_RANGE \
+  ", height = " GST_VIDEO_SIZE_RANGE ", framerate = " GST_VIDEO_FPS_RANGE
+
+#endif
@@ -0,0 +1,35 @@
+// Copyright 2022, Kyota Tashiro, Mengheng Lee, and Latona Inc.
+// License MIT
+#ifndef CHECK_STUB_GSTNVDSMETA
+#define CHECK_STUB_GSTNVDSMETA
+#include <gst/gst.h>
+#include "nvdsmeta.h"
+
+// Tag of the API type of NvDsMeta.
+#define NVDS_META_STRING "nvdsmeta"
+
+typedef enum {
+  NVDS_GST_INVALID_META = -1,
+  NVDS_GST_CUSTOM_META = 4096,
+  NVDS_BATCH_GST_META,
+} GstNvDsMetaType;
+
+// The GstMeta through which DeepStream elements find the batch meta.
+typedef struct _NvDsMeta {
+  GstMeta meta;
+  gpointer meta_data;
+  gpointer user_data;
+  gint meta_type;
+} NvDsMeta;
+
+GType nvds_meta_api_get_type(void);
+#define NVDS_META_API_TYPE (nvds_meta_api_get_type())
+
+// Batch meta attached to a buffer; fake_gst_buffer_new attaches it.
+NvDsBatchMeta *gst_buffer_get_nvds_batch_meta(GstBuffer *buffer);
+
+// Latency measurement hooks, which do nothing here.
+gboolean nvds_set_input_system_timestamp(GstBuffer *buffer, gchar *element_name);
+gboolean nvds_set_output_system_timestamp(GstBuffer *buffer, gchar *element_name);
+
+#endif
@@ -0,0 +1,77 @@
+// Copyright 2022, Kyota Tashiro, Mengheng Lee, and Latona Inc.
+// License MIT
+#ifndef CHECK_STUB_NVBUFSURFACE
+#define CHECK_STUB_NVBUFSURFACE
+#include <stdint.h>
+
+// Stand-in for DeepStream's nvbufsurface.h: batched surfaces described in
+// the SDK's terms, backed by plain host memory in the tests.
+
+#define NVBUF_MAX_PLANES 4
+
+typedef enum {
+  NVBUF_MEM_DEFAULT,
+  NVBUF_MEM_CUDA_PINNED,
+  NVBUF_MEM_CUDA_DEVICE,
+  NVBUF_MEM_CUDA_UNIFIED,
+  NVBUF_MEM_SURFACE_ARRAY,
+  NVBUF_MEM_HANDLE,
+  NVBUF_MEM_SYSTEM,
+} NvBufSurfaceMemType;
+
+typedef enum {
+  NVBUF_MAP_READ,
+  NVBUF_MAP_WRITE,
+  NVBUF_MAP_READ_WRITE,
+} NvBufSurfaceMemMapFlags;
+
+typedef enum {
+  NVBUF_COLOR_FORMAT_INVALID,
+  NVBUF_COLOR_FORMAT_RGBA = 19,
+} NvBufSurfaceColorFormat;
+
+typedef struct NvBufSurfacePlaneParams {
+  uint32_t num_planes;
+  uint32_t width[NVBUF_MAX_PLANES];
+  uint32_t height[NVBUF_MAX_PLANES];
+  uint32_t pitch[NVBUF_MAX_PLANES];
+  uint32_t offset[NVBUF_MAX_PLANES];
+  uint32_t psize[NVBUF_MAX_PLANES];
+  uint32_t bytesPerPix[NVBUF_MAX_PLANES];
+} NvBufSurfacePlaneParams;
+
+typedef struct NvBufSurfaceMappedAddr {
+  void *addr[NVBUF_MAX_PLANES];
+  void *eglImage;
+} NvBufSurfaceMappedAddr;
+
+typedef struct NvBufSurfaceParams {
+  uint32_t width;
+  uint32_t height;
+  uint32_t pitch;
+  NvBufSurfaceColorFormat colorFormat;
+  uint64_t bufferDesc;
+  uint32_t dataSize;
+  void *dataPtr;
+  NvBufSurfacePlaneParams planeParams;
+  NvBufSurfaceMappedAddr mappedAddr;
+} NvBufSurfaceParams;
+
+typedef struct NvBufSurface {
+  uint32_t gpuId;
+  uint32_t batchSize;
+  uint32_t numFilled;
+  int isContiguous;
+  NvBufSurfaceMemType memType;
+  NvBufSurfaceParams *surfaceList;
+} NvBufSurface;
+
+int NvBufSurfaceMap(NvBufSurface *surf, int index, int plane, NvBufSurfaceMemMapFlags type);
+
+int NvBufSurfaceUnMap(NvBufSurface *surf, int index, int plane);
+
+int NvBufSurfaceSyncForCpu(NvBufSurface *surf, int index, int plane);
+
+int NvBufSurfaceSyncForDevice(NvBufSurface *surf, int index, int plane);
+
+#endif
@@ -0,0 +1,81 @@
+// Copyright 2022, Kyota Tashiro, Mengheng Lee, and Latona Inc.
+// License MIT
+#ifndef CHECK_STUB_NVDSMETA
+#define CHECK_STUB_NVDSMETA
+#include <glib.h>
+#include "nvll_osd_struct.h"
+
+// Stand-in for DeepStream's nvdsmeta.h: the meta structs with the fields the
+// plugins read, in the SDK's order. Everything else is left out, so the
+// layout is not the SDK's and nothing built here may be linked with it.
+
+#define MAX_LABEL_SIZE 128
+#define MAX_ELEMENTS_IN_DISPLAY_META 16
+#define UNTRACKED_OBJECT_ID 0xFFFFFFFFFFFFFFFF
+
+typedef GList NvDsMetaList;
+typedef NvDsMetaList NvDsFrameMetaList;
+typedef NvDsMetaList NvDsObjectMetaList;
+typedef NvDsMetaList NvDsDisplayMetaList;
+
+typedef enum {
+  NVDS_INVALID_META = -1,
+  NVDS_BATCH_META = 1,
+  NVDS_FRAME_META,
+  NVDS_OBJ_META,
+  NVDS_DISPLAY_META,
+} NvDsMetaType;
+
+typedef struct _NvDsBaseMeta {
+  NvDsMetaType meta_type;
+} NvDsBaseMeta;
+
+typedef struct _NvDsObjectMeta {
+  NvDsBaseMeta base_meta;
+  gint unique_component_id;
+  gint class_id;
+  guint64 object_id;
+  gfloat confidence;
+  NvOSD_RectParams rect_params;
+  NvOSD_MaskParams mask_params;
+  NvOSD_TextParams text_params;
+  gchar obj_label[MAX_LABEL_SIZE];
+} NvDsObjectMeta;
+
+typedef struct NvDsDisplayMeta {
+  NvDsBaseMeta base_meta;
+  guint num_rects;
+  guint num_labels;
+  guint num_lines;
+  guint num_arrows;
+  guint num_circles;
+  NvOSD_RectParams rect_params[MAX_ELEMENTS_IN_DISPLAY_META];
+  NvOSD_TextParams text_params[MAX_ELEMENTS_IN_DISPLAY_META];
+  NvOSD_LineParams line_params[MAX_ELEMENTS_IN_DISPLAY_META];
+  NvOSD_ArrowParams arrow_params[MAX_ELEMENTS_IN_DISPLAY_META];
+  NvOSD_CircleParams circle_params[MAX_ELEMENTS_IN_DISPLAY_META];
+} NvDsDisplayMeta;
+
+typedef struct _NvDsFrameMeta {
+  NvDsBaseMeta base_meta;
+  guint pad_index;
+  guint batch_id;
+  gint frame_num;
+  guint64 buf_pts;
+  guint64 ntp_timestamp;
+  guint source_id;
+  guint source_frame_width;
+  guint source_frame_height;
+  guint num_obj_meta;
+  NvDsObjectMetaList *obj_meta_list;
+  NvDsDisplayMetaList *display_meta_list;
+} NvDsFrameMeta;
+
+typedef struct _NvDsBatchMeta {
+  NvDsBaseMeta base_meta;
+  guint max_frames_in_batch;
+  guint num_frames_in_batch;
+  NvDsFrameMetaList *frame_meta_list;
+} NvDsBatchMeta;
+
+#endif
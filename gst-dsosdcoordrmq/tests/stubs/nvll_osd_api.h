@@ -0,0 +1,81 @@
+// Copyright 2022, Kyota Tashiro, Mengheng Lee, and Latona Inc.
+// License MIT
+#ifndef CHECK_STUB_NVLL_OSD_API
+#define CHECK_STUB_NVLL_OSD_API
+#include "nvll_osd_struct.h"
+#include "nvbufsurface.h"
+
+// Stand-in for DeepStream's nvll_osd_api.h. The calls are provided by the
+// counting fake the OSD tests link with.
+
+typedef void *NvOSDCtxHandle;
+
+typedef struct _NvOSD_FrameTextParams {
+  NvBufSurfaceParams *buf_ptr;
+  NvOSD_Mode mode;
+  int num_strings;
+  NvOSD_TextParams *text_params_list;
+} NvOSD_FrameTextParams;
+
+typedef struct _NvOSD_FrameRectParams {
+  NvBufSurfaceParams *buf_ptr;
+  NvOSD_Mode mode;
+  int num_rects;
+  NvOSD_RectParams *rect_params_list;
+} NvOSD_FrameRectParams;
+
+typedef struct _NvOSD_FrameSegmentMaskParams {
+  NvBufSurfaceParams *buf_ptr;
+  NvOSD_Mode mode;
+  int num_segments;
+  NvOSD_RectParams *rect_params_list;
+  NvOSD_MaskParams *mask_params_list;
+} NvOSD_FrameSegmentMaskParams;
+
+typedef struct _NvOSD_FrameLineParams {
+  NvBufSurfaceParams *buf_ptr;
+  NvOSD_Mode mode;
+  int num_lines;
+  NvOSD_LineParams *line_params_list;
+} NvOSD_FrameLineParams;
+
+typedef struct _NvOSD_FrameArrowParams {
+  NvBufSurfaceParams *buf_ptr;
+  NvOSD_Mode mode;
+  int num_arrows;
+  NvOSD_ArrowParams *arrow_params_list;
+} NvOSD_FrameArrowParams;
+
+typedef struct _NvOSD_FrameCircleParams {
+  NvBufSurfaceParams *buf_ptr;
+  NvOSD_Mode mode;
+  int num_circles;
+  NvOSD_CircleParams *circle_params_list;
+} NvOSD_FrameCircleParams;
+
+NvOSDCtxHandle nvll_osd_create_context(void);
+
+void nvll_osd_destroy_context(NvOSDCtxHandle nvosd_ctx);
+
+// Returns the buffer nvll_osd converts frames in, if any.
+void *nvll_osd_set_params(NvOSDCtxHandle nvosd_ctx, int width, int height);
+
+void nvll_osd_set_clock_params(NvOSDCtxHandle nvosd_ctx, NvOSD_TextParams *clk_params);
+
+void nvll_osd_init_colors_for_hw_blend(NvOSDCtxHandle nvosd_ctx, NvOSD_Color_info *color_info,
+                                       int num_classes);
+
+int nvll_osd_put_text(NvOSDCtxHandle nvosd_ctx, NvOSD_FrameTextParams *frame_text_params);
+
+int nvll_osd_draw_rectangles(NvOSDCtxHandle nvosd_ctx, NvOSD_FrameRectParams *frame_rect_params);
+
+int nvll_osd_draw_segment_masks(NvOSDCtxHandle nvosd_ctx,
+                                NvOSD_FrameSegmentMaskParams *frame_mask_params);
+
+int nvll_osd_draw_lines(NvOSDCtxHandle nvosd_ctx, NvOSD_FrameLineParams *frame_line_params);
+
+int nvll_osd_draw_arrows(NvOSDCtxHandle nvosd_ctx, NvOSD_FrameArrowParams *frame_arrow_params);
+
+int nvll_osd_draw_circles(NvOSDCtxHandle nvosd_ctx, NvOSD_FrameCircleParams *frame_circle_params);
+
+#endif
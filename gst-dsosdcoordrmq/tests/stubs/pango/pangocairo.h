@@ -0,0 +1,48 @@
+// Copyright 2022, Kyota Tashiro, Mengheng Lee, and Latona Inc.
+// License MIT
+#ifndef CHECK_STUB_PANGOCAIRO
+#define CHECK_STUB_PANGOCAIRO
+#include <cairo.h>
+#include <glib-object.h>
+
+// Just enough of Pango for the text cache to lay text out and rasterize it.
+// Fonts are fake: every glyph is a box of the font size in height, with a
+// width that depends on the character, so tests can tell where each glyph
+// went. fake-pango.c implements the calls; fake-pango.h says how glyphs
+// look.
+
+#define PANGO_SCALE 1024
+
+typedef struct _PangoRectangle {
+  int x;
+  int y;
+  int width;
+  int height;
+} PangoRectangle;
+
+// Font maps, contexts and layouts are objects, freed with g_object_unref.
+typedef struct _PangoFontMap PangoFontMap;
+typedef struct _PangoContext PangoContext;
+typedef struct _PangoLayout PangoLayout;
+typedef struct _PangoFontDescription PangoFontDescription;
+
+PangoFontMap *pango_cairo_font_map_new(void);
+PangoContext *pango_font_map_create_context(PangoFontMap *fontmap);
+
+PangoFontDescription *pango_font_description_from_string(const char *str);
+// size is in points times PANGO_SCALE; a point is a pixel here.
+void pango_font_description_set_size(PangoFontDescription *desc, gint size);
+void pango_font_description_free(PangoFontDescription *desc);
+
+PangoLayout *pango_layout_new(PangoContext *context);
+// The layout keeps a copy of desc.
+void pango_layout_set_font_description(PangoLayout *layout, const PangoFontDescription *desc);
+// length -1 takes text up to its terminator.
+void pango_layout_set_text(PangoLayout *layout, const char *text, int length);
+void pango_layout_get_pixel_extents(PangoLayout *layout, PangoRectangle *ink_rect,
+                                    PangoRectangle *logical_rect);
+
+// Draws layout with its top left corner at the current point of cr.
+void pango_cairo_show_layout(cairo_t *cr, PangoLayout *layout);
+
+#endif
@@ -0,0 +1,207 @@
+// Copyright 2022, Kyota Tashiro, Mengheng Lee, and Latona Inc.
+// License MIT
+#ifndef CHECK_STUB_AMQP
+#define CHECK_STUB_AMQP
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/time.h>
+
+// Stand-in for rabbitmq-c's amqp.h: the part of the API rabbitmq-client.c
+// calls, with the library's constants. The calls are provided by the fake
+// broker in fake-amqp.c.
+
+typedef int amqp_boolean_t;
+typedef uint32_t amqp_method_number_t;
+typedef uint16_t amqp_channel_t;
+typedef uint32_t amqp_flags_t;
+
+typedef struct amqp_bytes_t_ {
+  size_t len;
+  void *bytes;
+} amqp_bytes_t;
+
+typedef struct amqp_table_t_ {
+  int num_entries;
+  void *entries;
+} amqp_table_t;
+
+typedef struct amqp_method_t_ {
+  amqp_method_number_t id;
+  void *decoded;
+} amqp_method_t;
+
+typedef struct amqp_frame_t_ {
+  uint8_t frame_type;
+  amqp_channel_t channel;
+  union {
+    amqp_method_t method;
+  } payload;
+} amqp_frame_t;
+
+typedef enum amqp_response_type_enum_ {
+  AMQP_RESPONSE_NONE = 0,
+  AMQP_RESPONSE_NORMAL,
+  AMQP_RESPONSE_LIBRARY_EXCEPTION,
+  AMQP_RESPONSE_SERVER_EXCEPTION,
+} amqp_response_type_enum;
+
+typedef struct amqp_rpc_reply_t_ {
+  amqp_response_type_enum reply_type;
+  amqp_method_t reply;
+  int library_error;
+} amqp_rpc_reply_t;
+
+typedef enum amqp_sasl_method_enum_ {
+  AMQP_SASL_METHOD_PLAIN = 0,
+} amqp_sasl_method_enum;
+
+typedef struct amqp_connection_state_t_ *amqp_connection_state_t;
+typedef struct amqp_socket_t_ amqp_socket_t;
+
+typedef struct amqp_basic_properties_t_ {
+  amqp_flags_t _flags;
+  amqp_bytes_t content_type;
+  uint8_t delivery_mode;
+} amqp_basic_properties_t;
+
+typedef struct amqp_message_t_ {
+  amqp_basic_properties_t properties;
+  amqp_bytes_t body;
+} amqp_message_t;
+
+typedef struct amqp_envelope_t_ {
+  amqp_channel_t channel;
+  amqp_message_t message;
+} amqp_envelope_t;
+
+typedef struct amqp_queue_declare_ok_t_ {
+  amqp_bytes_t queue;
+  uint32_t message_count;
+  uint32_t consumer_count;
+} amqp_queue_declare_ok_t;
+
+typedef struct amqp_exchange_declare_ok_t_ {
+  char dummy;
+} amqp_exchange_declare_ok_t;
+
+typedef struct amqp_channel_open_ok_t_ {
+  amqp_bytes_t channel_id;
+} amqp_channel_open_ok_t;
+
+typedef struct amqp_confirm_select_ok_t_ {
+  char dummy;
+} amqp_confirm_select_ok_t;
+
+typedef struct amqp_basic_consume_ok_t_ {
+  amqp_bytes_t consumer_tag;
+} amqp_basic_consume_ok_t;
+
+typedef struct amqp_basic_ack_t_ {
+  uint64_t delivery_tag;
+  amqp_boolean_t multiple;
+} amqp_basic_ack_t;
+
+typedef struct amqp_basic_nack_t_ {
+  uint64_t delivery_tag;
+  amqp_boolean_t multiple;
+  amqp_boolean_t requeue;
+} amqp_basic_nack_t;
+
+#define AMQP_STATUS_OK 0x0
+#define AMQP_STATUS_NO_MEMORY -0x0001
+#define AMQP_STATUS_BAD_URL -0x0008
+#define AMQP_STATUS_SOCKET_ERROR -0x0009
+#define AMQP_STATUS_CONNECTION_CLOSED -0x000B
+#define AMQP_STATUS_TIMEOUT -0x000D
+
+#define AMQP_FRAME_METHOD 1
+#define AMQP_REPLY_SUCCESS 200
+#define AMQP_BASIC_CONTENT_TYPE_FLAG (1 << 15)
+#define AMQP_BASIC_DELIVERY_MODE_FLAG (1 << 12)
+#define AMQP_BASIC_ACK_METHOD ((amqp_method_number_t) 0x003C0050)
+#define AMQP_BASIC_NACK_METHOD ((amqp_method_number_t) 0x003C0078)
+#define AMQP_CHANNEL_CLOSE_METHOD ((amqp_method_number_t) 0x00140028)
+#define AMQP_CONNECTION_CLOSE_METHOD ((amqp_method_number_t) 0x000A0032)
+
+struct amqp_connection_info {
+  char *user;
+  char *password;
+  char *host;
+  char *vhost;
+  int port;
+  amqp_boolean_t ssl;
+};
+
+extern const amqp_table_t amqp_empty_table;
+extern const amqp_bytes_t amqp_empty_bytes;
+
+void amqp_default_connection_info(struct amqp_connection_info *parsed);
+
+int amqp_parse_url(char *url, struct amqp_connection_info *parsed);
+
+amqp_connection_state_t amqp_new_connection(void);
+
+int amqp_destroy_connection(amqp_connection_state_t state);
+
+int amqp_socket_open_noblock(amqp_socket_t *self, const char *host, int port,
+                             const struct timeval *timeout);
+
+amqp_rpc_reply_t amqp_login(amqp_connection_state_t state, char const *vhost, int channel_max,
+                            int frame_max, int heartbeat, amqp_sasl_method_enum sasl_method,
+                            ...);
+
+amqp_channel_open_ok_t *amqp_channel_open(amqp_connection_state_t state,
+                                          amqp_channel_t channel);
+
+amqp_rpc_reply_t amqp_get_rpc_reply(amqp_connection_state_t state);
+
+amqp_rpc_reply_t amqp_channel_close(amqp_connection_state_t state, amqp_channel_t channel,
+                                    int code);
+
+amqp_rpc_reply_t amqp_connection_close(amqp_connection_state_t state, int code);
+
+amqp_bytes_t amqp_cstring_bytes(char const *cstr);
+
+amqp_bytes_t amqp_bytes_malloc_dup(amqp_bytes_t src);
+
+void amqp_bytes_free(amqp_bytes_t bytes);
+
+amqp_queue_declare_ok_t *amqp_queue_declare(amqp_connection_state_t state,
+                                            amqp_channel_t channel, amqp_bytes_t queue,
+                                            amqp_boolean_t passive, amqp_boolean_t durable,
+                                            amqp_boolean_t exclusive,
+                                            amqp_boolean_t auto_delete,
+                                            amqp_table_t arguments);
+
+amqp_exchange_declare_ok_t *amqp_exchange_declare(amqp_connection_state_t state,
+                                                  amqp_channel_t channel,
+                                                  amqp_bytes_t exchange, amqp_bytes_t type,
+                                                  amqp_boolean_t passive,
+                                                  amqp_boolean_t durable,
+                                                  amqp_boolean_t auto_delete,
+                                                  amqp_boolean_t internal,
+                                                  amqp_table_t arguments);
+
+amqp_confirm_select_ok_t *amqp_confirm_select(amqp_connection_state_t state,
+                                              amqp_channel_t channel);
+
+int amqp_basic_publish(amqp_connection_state_t state, amqp_channel_t channel,
+                       amqp_bytes_t exchange, amqp_bytes_t routing_key,
+                       amqp_boolean_t mandatory, amqp_boolean_t immediate,
+                       struct amqp_basic_properties_t_ const *properties, amqp_bytes_t body);
+
+int amqp_simple_wait_frame_noblock(amqp_connection_state_t state, amqp_frame_t *decoded_frame,
+                                   const struct timeval *tv);
+
+void amqp_maybe_release_buffers(amqp_connection_state_t state);
+
+amqp_basic_consume_ok_t *amqp_basic_consume(amqp_connection_state_t state,
+                                            amqp_channel_t channel, amqp_bytes_t queue,
+                                            amqp_bytes_t consumer_tag, amqp_boolean_t no_local,
+                                            amqp_boolean_t no_ack, amqp_boolean_t exclusive,
+                                            amqp_table_t arguments);
+
+amqp_rpc_reply_t amqp_consume_message(amqp_connection_state_t state, amqp_envelope_t *envelope,
+                                      const struct timeval *timeout, int flags);
+
+#endif
@@ -0,0 +1,11 @@
+// Copyright 2022, Kyota Tashiro, Mengheng Lee, and Latona Inc.
+// License MIT
+#ifndef CHECK_STUB_AMQP_TCP_SOCKET
+#define CHECK_STUB_AMQP_TCP_SOCKET
+#include <rabbitmq-c/amqp.h>
+
+// Stand-in for rabbitmq-c's tcp_socket.h.
+
+amqp_socket_t *amqp_tcp_socket_new(amqp_connection_state_t state);
+
+#endif
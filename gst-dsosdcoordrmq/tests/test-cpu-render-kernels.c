@@ -0,0 +1,168 @@
+// Copyright 2022, Kyota Tashiro, Mengheng Lee, and Latona Inc.
+// License MIT
+
+#include <stdio.h>
+#include "check.h"
+#include "cpu-render-kernels.h"
+
+#define MAX_KERNELS 8
+// Pixels of a span, enough for every vector width and its tail.
+#define MAX_SPAN 67
+// Untouched pixels around every span.
+#define GUARD 8
+
+static const cpu_render_kernels *kernels[MAX_KERNELS];
+static unsigned int num_kernels;
+
+static uint32_t next_random(uint32_t *state) {
+  *state = *state * 1664525u + 1013904223u;
+  return *state >> 8;
+}
+
+// x / 255 rounded to nearest, as exact rational arithmetic gives it.
+static uint8_t rounded(uint32_t x) {
+  return (uint8_t) ((2 * x + 255) / 510);
+}
+
+static void blend_reference(uint8_t *p, const uint8_t color[4], uint32_t a) {
+  int c;
+
+  for (c = 0; c < 3; c++)
+    p[c] = rounded(color[c] * a + p[c] * (255 - a));
+  p[3] = rounded(255 * a + p[3] * (255 - a));
+}
+
+// The scalar kernels do the arithmetic the header documents, for every
+// alpha, weight and destination byte.
+static void test_scalar(void) {
+  const cpu_render_kernels *k = cpu_render_kernels_scalar();
+  uint8_t pixels[256 * 4];
+  uint8_t expected[256 * 4];
+  uint8_t ones[256];
+  uint8_t coverage[256];
+  uint32_t a, i;
+  int failures = 0;
+
+  CHECK_STR(k->name, "scalar");
+  memset(ones, 1, sizeof(ones));
+  for (i = 0; i < 256; i++)
+    coverage[i] = (uint8_t) i;
+  for (a = 0; a < 256 && !failures; a++) {
+    const uint8_t color[4] = {(uint8_t) a, (uint8_t) (255 - a), 200, (uint8_t) a};
+
+    // Pixel i holds i in every channel.
+    for (i = 0; i < 256 * 4; i++)
+      pixels[i] = expected[i] = (uint8_t) (i / 4);
+    for (i = 0; i < 256; i++)
+      blend_reference(&expected[i * 4], color, a);
+    k->blend_span(pixels, 256, color);
+    failures += memcmp(pixels, expected, sizeof(pixels)) != 0;
+
+    for (i = 0; i < 256 * 4; i++)
+      pixels[i] = (uint8_t) (i / 4);
+    k->blend_covered(pixels, ones, 256, color);
+    failures += memcmp(pixels, expected, sizeof(pixels)) != 0;
+
+    // Pixel i is covered by i, weighting the color by a * i / 255.
+    for (i = 0; i < 256 * 4; i++)
+      pixels[i] = expected[i] = (uint8_t) (255 - i / 4);
+    for (i = 1; i < 256; i++)
+      blend_reference(&expected[i * 4], color, rounded(a * i));
+    k->blend_coverage(pixels, coverage, 256, color);
+    failures += memcmp(pixels, expected, sizeof(pixels)) != 0;
+  }
+  CHECK_INT(failures, 0);
+}
+
+// Blends span of count pixels at offset of a guarded buffer with every
+// kernel, starting from the same bytes, and checks each matches the scalar
+// version and leaves the guard alone.
+static int same_as_scalar(int op, unsigned int offset, unsigned int count,
+             const uint8_t *start, const uint8_t *mask, const uint8_t color[4]) {
+  uint8_t expected[(MAX_SPAN + 2 * GUARD) * 4];
+  uint8_t actual[(MAX_SPAN + 2 * GUARD) * 4];
+  size_t len = (size_t) (count + 2 * GUARD) * 4;
+  unsigned int i;
+  int same = 1;
+
+  for (i = 0; i < num_kernels; i++) {
+    const cpu_render_kernels *k = i ? kernels[i] : cpu_render_kernels_scalar();
+    uint8_t *out = i ? actual : expected;
+    uint8_t *span = out + (GUARD - offset % GUARD) * 4;
+
+    memcpy(out, start, len);
+    if (op == 0)
+      k->blend_span(span, count, color);
+    else if (op == 1)
+      k->blend_covered(span, mask, count, color);
+    else
+      k->blend_coverage(span, mask, count, color);
+    if (i && memcmp(actual, expected, len) != 0) {
+      fprintf(stderr, "%s differs from scalar: op %d, offset %u, %u pixels, color "
+              "%u %u %u %u\n", k->name, op, offset, count, color[0], color[1], color[2],
+              color[3]);
+      same = 0;
+    }
+  }
+  return same;
+}
+
+// Every vector version gives the bytes of the scalar one, at every length
+// and alignment, whatever the colors, masks and destination.
+static void test_bit_exact(void) {
+  uint8_t start[(MAX_SPAN + 2 * GUARD) * 4];
+  uint8_t mask[MAX_SPAN];
+  uint32_t state = 7;
+  int mismatches = 0;
+  int round;
+
+  for (round = 0; round < 20000 && mismatches < 10; round++) {
+    unsigned int count = next_random(&state) % (MAX_SPAN + 1);
+    unsigned int offset = next_random(&state) % GUARD;
+    uint8_t color[4];
+    unsigned int i;
+    int op = round % 3;
+
+    for (i = 0; i < sizeof(start); i++)
+      start[i] = (uint8_t) next_random(&state);
+    for (i = 0; i < 4; i++)
+      color[i] = (uint8_t) next_random(&state);
+    // Opaque, transparent and nearly so take their own paths.
+    switch (round / 3 % 5) {
+      case 0: color[3] = 255; break;
+      case 1: color[3] = 0; break;
+      case 2: color[3] = (uint8_t) (1 + next_random(&state) % 2); break;
+      case 3: color[3] = (uint8_t) (253 + next_random(&state) % 2); break;
+      default: break;
+    }
+    for (i = 0; i < count; i++) {
+      // Masks of all zeros, all 255 and mixes.
+      uint32_t r = next_random(&state);
+
+      mask[i] = round % 7 == 0 ? 0 : round % 7 == 1 ? 255 : (uint8_t) (r % 3 ? r : 0);
+    }
+    mismatches += !same_as_scalar(op, offset, count, start, mask, color);
+  }
+  CHECK_INT(mismatches, 0);
+}
+
+int main(void) {
+  const cpu_render_kernels *best = cpu_render_kernels_best();
+  unsigned int i;
+  int listed = 0;
+
+  num_kernels = cpu_render_kernels_available(kernels, MAX_KERNELS);
+  CHECK(num_kernels >= 1);
+  CHECK(kernels[0] == cpu_render_kernels_scalar());
+  // The renderer uses the last version listed, which is one of those tested.
+  for (i = 0; i < num_kernels; i++)
+    listed |= kernels[i] == best;
+  CHECK(listed && best == kernels[num_kernels - 1]);
+  for (i = 0; i < num_kernels; i++)
+    printf("%s%s", i ? ", " : "kernels: ", kernels[i]->name);
+  printf("\n");
+
+  test_scalar();
+  test_bit_exact();
+  return check_done("cpu-render-kernels");
+}
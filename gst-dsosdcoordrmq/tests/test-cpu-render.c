@@ -0,0 +1,285 @@
+// Copyright 2022, Kyota Tashiro, Mengheng Lee, and Latona Inc.
+// License MIT
+
+#include <pthread.h>
+#include <stdlib.h>
+#include "check.h"
+#include "cpu-render.h"
+
+// Not a multiple of the band height, with padding after every row.
+#define WIDTH 301
+#define HEIGHT 203
+#define PITCH (WIDTH * 4 + 12)
+#define MASK_SIZE 13
+#define NUM_CALLERS 3
+
+static float scores[MASK_SIZE * MASK_SIZE];
+
+static uint32_t next_random(uint32_t *state) {
+  *state = *state * 1664525u + 1013904223u;
+  return *state >> 8;
+}
+
+static int random_in(uint32_t *state, int low, int high) {
+  return low + (int) (next_random(state) % (uint32_t) (high - low + 1));
+}
+
+static void random_color(uint32_t *state, uint8_t color[4]) {
+  int i;
+
+  for (i = 0; i < 4; i++)
+    color[i] = (uint8_t) next_random(state);
+  // Opaque and fully transparent colors are the edge cases of the blend.
+  if (next_random(state) % 8 == 0)
+    color[3] = next_random(state) % 2 ? 255 : 0;
+}
+
+// Overlapping translucent boxes, masks and lines, some reaching past every
+// edge of the frame and some empty, so the order and the clipping of each
+// band show.
+static void fill_list(cpu_render_list *l, uint32_t seed, unsigned int rects,
+             unsigned int masks, unsigned int lines) {
+  uint32_t state = seed;
+  unsigned int i;
+
+  cpu_render_list_reset(l);
+  for (i = 0; i < rects; i++) {
+    cpu_render_rect *rc = cpu_render_list_add_rect(l);
+
+    rc->left = random_in(&state, -60, WIDTH + 10);
+    rc->top = random_in(&state, -60, HEIGHT + 10);
+    rc->width = random_in(&state, -2, 120);
+    rc->height = random_in(&state, -2, 120);
+    rc->border_width = (unsigned int) random_in(&state, 0, 12);
+    random_color(&state, rc->border_color);
+    rc->has_bg_color = (int) (next_random(&state) % 2);
+    random_color(&state, rc->bg_color);
+  }
+  for (i = 0; i < masks; i++) {
+    cpu_render_mask *m = cpu_render_list_add_mask(l);
+
+    m->left = random_in(&state, -40, WIDTH);
+    m->top = random_in(&state, -40, HEIGHT);
+    m->width = random_in(&state, 0, 90);
+    m->height = random_in(&state, 0, 90);
+    m->data = next_random(&state) % 16 ? scores : NULL;
+    m->mask_width = MASK_SIZE;
+    m->mask_height = MASK_SIZE;
+    m->threshold = (float) random_in(&state, 0, 10) / 10.0f;
+    random_color(&state, m->color);
+  }
+  for (i = 0; i < lines; i++) {
+    cpu_render_line *ln = cpu_render_list_add_line(l);
+
+    ln->x1 = random_in(&state, -60, WIDTH + 60);
+    ln->y1 = random_in(&state, -60, HEIGHT + 60);
+    // Axis-aligned lines and points now and then.
+    ln->x2 = next_random(&state) % 8 ? random_in(&state, -60, WIDTH + 60) : ln->x1;
+    ln->y2 = next_random(&state) % 8 ? random_in(&state, -60, HEIGHT + 60) : ln->y1;
+    ln->width = (unsigned int) random_in(&state, 0, 16);
+    random_color(&state, ln->color);
+  }
+}
+
+static void fill_frame(uint8_t *pixels, uint32_t seed) {
+  uint32_t state = seed;
+  size_t i;
+
+  for (i = 0; i < (size_t) PITCH * HEIGHT; i++)
+    pixels[i] = (uint8_t) next_random(&state);
+}
+
+static int same_frame(const uint8_t *a, const uint8_t *b) {
+  return memcmp(a, b, (size_t) PITCH * HEIGHT) == 0;
+}
+
+// Whatever the number of threads, the tiled renderer gives the bytes of the
+// serial scalar reference, padding included, frame after frame.
+static void test_threads(void) {
+  static const unsigned int thread_counts[] = {1, 2, 3, 4, 8, 16};
+  uint8_t *expected = malloc((size_t) PITCH * HEIGHT);
+  uint8_t *actual = malloc((size_t) PITCH * HEIGHT);
+  cpu_render_target reference = {expected, WIDTH, HEIGHT, PITCH};
+  cpu_render_target target = {actual, WIDTH, HEIGHT, PITCH};
+  cpu_render_list list;
+  size_t t;
+  uint32_t seed;
+
+  CHECK(expected && actual);
+  if (!expected || !actual)
+    return;
+  cpu_render_list_init(&list);
+  for (t = 0; t < sizeof(thread_counts) / sizeof(thread_counts[0]); t++) {
+    cpu_renderer r;
+    unsigned long grows;
+
+    CHECK_INT(cpu_renderer_init(&r, thread_counts[t]), thread_counts[t]);
+    for (seed = 1; seed <= 20; seed++) {
+      fill_list(&list, seed, seed * 10, seed % 5 * 4, seed * 2);
+      fill_frame(expected, seed);
+      fill_frame(actual, seed);
+      cpu_render_draw_serial(&reference, &list);
+      cpu_renderer_draw(&r, &target, &list);
+      CHECK(same_frame(actual, expected));
+    }
+    // The bins have grown to the busiest frame already.
+    grows = list.grows;
+    fill_list(&list, 20, 200, 16, 0);
+    cpu_renderer_draw(&r, &target, &list);
+    CHECK_INT(list.grows, grows);
+
+    // A frame of one band and an empty list take the shortcuts.
+    target.height = CPU_RENDER_TILE_ROWS / 2;
+    reference.height = target.height;
+    fill_frame(expected, 99);
+    fill_frame(actual, 99);
+    cpu_render_draw_serial(&reference, &list);
+    cpu_renderer_draw(&r, &target, &list);
+    CHECK(same_frame(actual, expected));
+    target.height = reference.height = HEIGHT;
+    cpu_render_list_reset(&list);
+    cpu_renderer_draw(&r, &target, &list);
+    CHECK(same_frame(actual, expected));
+    cpu_renderer_free(&r);
+  }
+  cpu_render_list_free(&list);
+  free(expected);
+  free(actual);
+}
+
+// Bounding box and number of the pixels of a cleared frame that were drawn.
+typedef struct drawn_pixels {
+  int left;
+  int top;
+  int right;
+  int bottom;
+  unsigned int count;
+} drawn_pixels;
+
+static drawn_pixels draw_line(uint8_t *pixels, int x1, int y1, int x2, int y2,
+             unsigned int width) {
+  cpu_render_target target = {pixels, WIDTH, HEIGHT, PITCH};
+  drawn_pixels d = {WIDTH, HEIGHT, -1, -1, 0};
+  cpu_render_list list;
+  cpu_render_line *ln;
+  int x, y;
+
+  memset(pixels, 0, (size_t) PITCH * HEIGHT);
+  cpu_render_list_init(&list);
+  ln = cpu_render_list_add_line(&list);
+  *ln = (cpu_render_line) {x1, y1, x2, y2, width, {255, 255, 255, 255}};
+  cpu_render_draw_serial(&target, &list);
+  cpu_render_list_free(&list);
+  for (y = 0; y < HEIGHT; y++) {
+    for (x = 0; x < WIDTH; x++) {
+      if (!pixels[(size_t) y * PITCH + (size_t) x * 4])
+        continue;
+      d.left = x < d.left ? x : d.left;
+      d.top = y < d.top ? y : d.top;
+      d.right = x > d.right ? x : d.right;
+      d.bottom = y > d.bottom ? y : d.bottom;
+      d.count++;
+    }
+  }
+  return d;
+}
+
+static void check_drawn(drawn_pixels d, int left, int top, int right, int bottom,
+             unsigned int count) {
+  CHECK_INT(d.left, left);
+  CHECK_INT(d.top, top);
+  CHECK_INT(d.right, right);
+  CHECK_INT(d.bottom, bottom);
+  CHECK_INT(d.count, count);
+}
+
+// A line covers its end points, width pixels across and half of width past
+// either end, the same whichever way round it is given.
+static void test_line_geometry(void) {
+  uint8_t *pixels = malloc((size_t) PITCH * HEIGHT);
+  drawn_pixels forth, back;
+
+  CHECK(pixels != NULL);
+  if (!pixels)
+    return;
+  check_drawn(draw_line(pixels, 10, 20, 30, 20, 1), 10, 20, 30, 20, 21);
+  check_drawn(draw_line(pixels, 10, 20, 30, 20, 3), 9, 19, 31, 21, 23 * 3);
+  check_drawn(draw_line(pixels, 30, 20, 10, 20, 3), 9, 19, 31, 21, 23 * 3);
+  check_drawn(draw_line(pixels, 50, 40, 50, 10, 2), 50, 9, 51, 40, 2 * 32);
+  check_drawn(draw_line(pixels, 50, 10, 50, 40, 2), 50, 9, 51, 40, 2 * 32);
+  check_drawn(draw_line(pixels, 7, 7, 7, 7, 1), 7, 7, 7, 7, 1);
+  check_drawn(draw_line(pixels, 7, 7, 7, 7, 4), 5, 5, 8, 8, 16);
+  // Clipped by the frame.
+  check_drawn(draw_line(pixels, -20, 5, WIDTH + 20, 5, 1), 0, 5, WIDTH - 1, 5, WIDTH);
+  check_drawn(draw_line(pixels, 10, -30, 10, -5, 4), WIDTH, HEIGHT, -1, -1, 0);
+  check_drawn(draw_line(pixels, 10, 10, 40, 40, 0), WIDTH, HEIGHT, -1, -1, 0);
+
+  // A 1 pixel diagonal steps one pixel per row.
+  check_drawn(draw_line(pixels, 10, 10, 40, 40, 1), 10, 10, 40, 40, 31);
+  forth = draw_line(pixels, 20, 30, 120, 90, 5);
+  back = draw_line(pixels, 120, 90, 20, 30, 5);
+  check_drawn(back, forth.left, forth.top, forth.right, forth.bottom, forth.count);
+  CHECK(forth.count > 100 * 5);
+  free(pixels);
+}
+
+typedef struct caller {
+  cpu_renderer *renderer;
+  uint32_t seed;
+  int same;
+} caller;
+
+static void *draw_frames(void *arg) {
+  caller *c = arg;
+  uint8_t *expected = malloc((size_t) PITCH * HEIGHT);
+  uint8_t *actual = malloc((size_t) PITCH * HEIGHT);
+  cpu_render_target reference = {expected, WIDTH, HEIGHT, PITCH};
+  cpu_render_target target = {actual, WIDTH, HEIGHT, PITCH};
+  cpu_render_list list;
+  int i;
+
+  c->same = expected && actual;
+  cpu_render_list_init(&list);
+  for (i = 0; i < 20 && c->same; i++) {
+    fill_list(&list, c->seed + (uint32_t) i, 100, 8, 20);
+    fill_frame(expected, c->seed);
+    fill_frame(actual, c->seed);
+    cpu_render_draw_serial(&reference, &list);
+    cpu_renderer_draw(c->renderer, &target, &list);
+    c->same = same_frame(actual, expected);
+  }
+  cpu_render_list_free(&list);
+  free(expected);
+  free(actual);
+  return NULL;
+}
+
+// Surface threads share one renderer, each drawing its own frame.
+static void test_callers(void) {
+  cpu_renderer r;
+  pthread_t threads[NUM_CALLERS];
+  caller callers[NUM_CALLERS];
+  int i;
+
+  CHECK_INT(cpu_renderer_init(&r, 4), 4);
+  for (i = 0; i < NUM_CALLERS; i++) {
+    callers[i] = (caller) {.renderer = &r, .seed = (uint32_t) (100 * (i + 1))};
+    CHECK_INT(pthread_create(&threads[i], NULL, draw_frames, &callers[i]), 0);
+  }
+  for (i = 0; i < NUM_CALLERS; i++) {
+    pthread_join(threads[i], NULL);
+    CHECK(callers[i].same);
+  }
+  cpu_renderer_free(&r);
+}
+
+int main(void) {
+  unsigned int i;
+
+  for (i = 0; i < MASK_SIZE * MASK_SIZE; i++)
+    scores[i] = (float) (i * 7 % 11) / 10.0f;
+  test_line_geometry();
+  test_threads();
+  test_callers();
+  return check_done("cpu-render");
+}
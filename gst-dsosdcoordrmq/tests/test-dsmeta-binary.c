@@ -0,0 +1,408 @@
+// Copyright 2022, Kyota Tashiro, Mengheng Lee, and Latona Inc.
+// License MIT
+
+#include <stdlib.h>
+#include "check.h"
+#include "dsmeta-binary.h"
+#include "label-table.h"
+
+#define MAX_OBJECTS 64
+
+static uint32_t rng = 1;
+// Keeps the reads of touch_frame.
+static volatile unsigned long sink;
+
+static uint32_t next_random(void) {
+  rng ^= rng << 13;
+  rng ^= rng >> 17;
+  rng ^= rng << 5;
+  return rng;
+}
+
+static const char *const names[] = { "person", "car", "bicycle", "road sign", "" };
+
+// One detection as the element hands it to the encoder.
+typedef struct {
+  int class_id;
+  const char *label;
+  float left;
+  float top;
+  float width;
+  float height;
+} test_object;
+
+typedef struct {
+  uint32_t source_id;
+  uint32_t frame_number;
+  uint16_t batch_id;
+  uint64_t pts;
+  test_object objects[MAX_OBJECTS];
+  unsigned int num_objects;
+} test_frame;
+
+// What the encoder makes of a coordinate.
+static int16_t bin_i16(float v) {
+  if (v < INT16_MIN)
+    return INT16_MIN;
+  if (v > INT16_MAX)
+    return INT16_MAX;
+  return (int16_t) v;
+}
+
+static uint16_t bin_u16(float v) {
+  if (v < 0)
+    return 0;
+  if (v > UINT16_MAX)
+    return UINT16_MAX;
+  return (uint16_t) v;
+}
+
+static void random_frame(test_frame *f, unsigned int num_objects) {
+  unsigned int i;
+
+  f->source_id = next_random() % 16;
+  f->frame_number = next_random();
+  f->batch_id = (uint16_t) f->source_id;
+  f->pts = next_random() % 4 ? (uint64_t) next_random() * 1000 : DSMETA_BIN_NO_PTS;
+  f->num_objects = num_objects;
+  for (i = 0; i < num_objects; i++) {
+    test_object *o = &f->objects[i];
+
+    o->class_id = (int) (next_random() % 5);
+    o->label = next_random() % 8 ? names[o->class_id] : NULL;
+    o->left = (float) (next_random() % 1920);
+    o->top = (float) (next_random() % 1080);
+    o->width = (float) (1 + next_random() % 400);
+    o->height = (float) (1 + next_random() % 400);
+  }
+}
+
+static void encode_frame(const test_frame *f, dsmeta_bin_writer *w) {
+  unsigned int i;
+
+  dsmeta_bin_writer_reset(w);
+  dsmeta_bin_begin_frame(w, f->source_id, f->frame_number, f->batch_id, f->pts);
+  for (i = 0; i < f->num_objects; i++) {
+    const test_object *o = &f->objects[i];
+
+    dsmeta_bin_add_object(w, o->class_id, o->label, o->left, o->top, o->width,
+                          o->height);
+  }
+  dsmeta_bin_end_frame(w);
+}
+
+// Decodes data as f and checks every field against it.
+static void check_frame(const void *data, size_t len, const test_frame *f) {
+  dsmeta_bin_frame frame;
+  dsmeta_bin_object object;
+  unsigned int i;
+
+  CHECK_INT(dsmeta_bin_decode_frame(data, len, &frame), 0);
+  CHECK_INT(frame.size, len);
+  CHECK_INT(frame.source_id, f->source_id);
+  CHECK_INT(frame.frame_number, f->frame_number);
+  CHECK_INT(frame.batch_id, f->batch_id);
+  CHECK(frame.pts == f->pts);
+  CHECK_INT(frame.num_objects, f->num_objects);
+  if (frame.num_objects != f->num_objects)
+    return;
+  for (i = 0; i < frame.num_objects; i++) {
+    const test_object *o = &f->objects[i];
+
+    dsmeta_bin_get_object(&frame, i, &object);
+    CHECK_INT(object.class_id, o->class_id);
+    CHECK_INT(object.left, bin_i16(o->left));
+    CHECK_INT(object.top, bin_i16(o->top));
+    CHECK_INT(object.width, bin_u16(o->width));
+    CHECK_INT(object.height, bin_u16(o->height));
+    if (!o->label) {
+      CHECK_INT(object.label_id, DSMETA_BIN_NO_LABEL);
+    } else {
+      CHECK(object.label_id < frame.num_labels);
+      if (object.label_id < frame.num_labels) {
+        CHECK_INT(frame.label_lens[object.label_id], strlen(o->label));
+        CHECK_MEM(frame.labels[object.label_id], o->label,
+                  frame.label_lens[object.label_id]);
+      }
+    }
+  }
+}
+
+// Random frames are encoded and decoded and come out as they went in, each
+// label written once however many objects carry it.
+static void test_round_trip(void) {
+  test_frame f;
+  dsmeta_bin_writer w;
+  dsmeta_bin_frame frame;
+  test_object *o;
+  int round;
+
+  dsmeta_bin_writer_init(&w);
+  for (round = 0; round < 200; round++) {
+    random_frame(&f, round % (MAX_OBJECTS + 1));
+    encode_frame(&f, &w);
+    CHECK(!w.error);
+    check_frame(w.buf, w.len, &f);
+    if (dsmeta_bin_decode_frame(w.buf, w.len, &frame) == 0)
+      CHECK(frame.num_labels <= sizeof(names) / sizeof(names[0]));
+  }
+
+  // Out of range coordinates are clamped, unknown pts and missing and empty
+  // labels survive.
+  f.source_id = UINT32_MAX;
+  f.frame_number = UINT32_MAX;
+  f.batch_id = 65535;
+  f.pts = DSMETA_BIN_NO_PTS;
+  f.num_objects = 2;
+  o = &f.objects[0];
+  *o = (test_object) {
+    .class_id = -1, .label = NULL,
+    .left = -40000.0f, .top = 40000.0f, .width = -1.0f, .height = 70000.0f};
+  o = &f.objects[1];
+  *o = (test_object) {
+    .class_id = 32767, .label = "",
+    .left = 0.9f, .top = -0.9f, .width = 65535.0f, .height = 0.0f};
+  encode_frame(&f, &w);
+  check_frame(w.buf, w.len, &f);
+
+  dsmeta_bin_writer_free(&w);
+}
+
+// Calls every accessor of a frame that decoded, so a decoder that let a
+// field point past the message is caught by AddressSanitizer.
+static unsigned long touch_frame(const dsmeta_bin_frame *frame) {
+  dsmeta_bin_object object;
+  unsigned long sum = 0;
+  unsigned int i;
+
+  for (i = 0; i < frame->num_objects; i++) {
+    dsmeta_bin_get_object(frame, i, &object);
+    sum += object.label_id + object.width;
+  }
+  for (i = 0; i < frame->num_labels; i++) {
+    if (frame->label_lens[i])
+      sum += (unsigned char) frame->labels[i][frame->label_lens[i] - 1];
+  }
+  return sum;
+}
+
+// Every cut of a frame is rejected, and flipping bytes never makes the
+// decoder read outside the message.
+static void test_fuzz_frame(void) {
+  test_frame f;
+  dsmeta_bin_writer w;
+  dsmeta_bin_frame frame;
+  unsigned long sum = 0;
+  size_t len;
+  int i;
+
+  dsmeta_bin_writer_init(&w);
+  random_frame(&f, 6);
+  encode_frame(&f, &w);
+
+  // The copies are exactly as long as the input, so reads past it trip ASan.
+  for (len = 0; len < w.len; len++) {
+    uint8_t *cut = malloc(len ? len : 1);
+
+    memcpy(cut, w.buf, len);
+    CHECK_INT(dsmeta_bin_decode_frame(cut, len, &frame), -1);
+    free(cut);
+  }
+  for (i = 0; i < 20000; i++) {
+    uint8_t *mutated = malloc(w.len);
+    int flips = 1 + (int) (next_random() % 4);
+
+    memcpy(mutated, w.buf, w.len);
+    while (flips--)
+      mutated[next_random() % w.len] ^= (uint8_t) (1u << (next_random() % 8));
+    if (dsmeta_bin_decode_frame(mutated, w.len, &frame) == 0) {
+      CHECK(frame.size <= w.len);
+      sum += touch_frame(&frame);
+    }
+    free(mutated);
+  }
+  sink = sum;
+
+  dsmeta_bin_writer_free(&w);
+}
+
+// Encodes three frames of different sizes into w as a batch; the frames
+// are kept in frames, one after the other, with their lengths in lens.
+static void build_batch(dsmeta_bin_writer *w, uint8_t *frames, size_t *lens) {
+  dsmeta_bin_writer frame;
+  size_t off = 0;
+  int i, j;
+
+  dsmeta_bin_writer_init(&frame);
+  dsmeta_bin_writer_reset(w);
+  dsmeta_bin_begin_batch(w);
+  for (i = 0; i < 3; i++) {
+    dsmeta_bin_writer_reset(&frame);
+    dsmeta_bin_begin_frame(&frame, (uint32_t) i, 100u + (uint32_t) i, (uint16_t) i,
+                           1000u * (uint64_t) i);
+    for (j = 0; j < i * 2; j++)
+      dsmeta_bin_add_object(&frame, j, j % 2 ? "Car" : "Person", 10.0 * j, 20.0, 30.0, 40.0);
+    dsmeta_bin_end_frame(&frame);
+    memcpy(frames + off, frame.buf, frame.len);
+    lens[i] = frame.len;
+    off += frame.len;
+    dsmeta_bin_add_batch_frame(w, frame.buf, frame.len);
+  }
+  dsmeta_bin_end_batch(w);
+  dsmeta_bin_writer_free(&frame);
+}
+
+// Returns the frames the batch at data decodes to, -1 when it is malformed.
+static int decode_batch(const void *data, size_t len, unsigned long *sum) {
+  dsmeta_bin_batch batch;
+  dsmeta_bin_frame frame;
+  int frames = 0;
+  int res;
+
+  if (dsmeta_bin_decode_batch(data, len, &batch) < 0)
+    return -1;
+  while ((res = dsmeta_bin_batch_next(&batch, &frame)) > 0) {
+    *sum += touch_frame(&frame);
+    frames++;
+  }
+  return res < 0 ? -1 : frames;
+}
+
+// A batch decodes to the frames that went in, a batch cut anywhere, frame
+// boundaries included, is rejected, and flipped bytes are read safely.
+static void test_batch(void) {
+  uint8_t frames[1024];
+  size_t lens[3];
+  dsmeta_bin_writer w;
+  dsmeta_bin_batch batch;
+  dsmeta_bin_frame frame;
+  unsigned long sum = 0;
+  size_t off = 0;
+  size_t len;
+  int i;
+
+  dsmeta_bin_writer_init(&w);
+  build_batch(&w, frames, lens);
+  CHECK(!w.error);
+  CHECK_INT(dsmeta_bin_decode_batch(w.buf, w.len, &batch), 0);
+  CHECK_INT(batch.num_frames, 3);
+  for (i = 0; i < 3; i++) {
+    CHECK_INT(dsmeta_bin_batch_next(&batch, &frame), 1);
+    CHECK_INT(frame.size, lens[i]);
+    CHECK_INT(frame.source_id, i);
+    CHECK_INT(frame.frame_number, 100 + i);
+    CHECK_INT(frame.batch_id, i);
+    CHECK_INT(frame.pts, 1000 * i);
+    CHECK_INT(frame.num_objects, i * 2);
+    CHECK_INT(frame.num_labels, i ? 2 : 0);
+    CHECK_MEM(frame.objects - DSMETA_BIN_HEADER_SIZE, frames + off, lens[i]);
+    off += lens[i];
+  }
+  CHECK_INT(dsmeta_bin_batch_next(&batch, &frame), 0);
+  // A frame is not a batch and the other way round.
+  CHECK_INT(dsmeta_bin_decode_frame(w.buf, w.len, &frame), -1);
+  CHECK_INT(dsmeta_bin_decode_batch(frames, lens[0], &batch), -1);
+
+  for (len = 0; len < w.len; len++) {
+    uint8_t *cut = malloc(len ? len : 1);
+
+    memcpy(cut, w.buf, len);
+    CHECK_INT(decode_batch(cut, len, &sum), -1);
+    free(cut);
+  }
+  for (i = 0; i < 20000; i++) {
+    uint8_t *mutated = malloc(w.len);
+    int flips = 1 + (int) (next_random() % 4);
+    int decoded;
+
+    memcpy(mutated, w.buf, w.len);
+    while (flips--)
+      mutated[next_random() % w.len] ^= (uint8_t) (1u << (next_random() % 8));
+    decoded = decode_batch(mutated, w.len, &sum);
+    CHECK(decoded == -1 || decoded == (int) (mutated[6] | mutated[7] << 8));
+    free(mutated);
+  }
+  sink = sum;
+
+  // An empty batch is valid and one claiming a frame it lacks is not.
+  dsmeta_bin_writer_reset(&w);
+  dsmeta_bin_begin_batch(&w);
+  dsmeta_bin_end_batch(&w);
+  CHECK_INT(decode_batch(w.buf, w.len, &sum), 0);
+  w.buf[6] = 1;
+  CHECK_INT(decode_batch(w.buf, w.len, &sum), -1);
+  dsmeta_bin_writer_free(&w);
+}
+
+// Returns the entries the dictionary at data decodes to, -1 when it is
+// malformed.
+static int decode_labels(const void *data, size_t len, unsigned long *sum) {
+  dsmeta_bin_labels labels;
+  const char *label;
+  size_t label_len;
+  int class_id;
+  int entries = 0;
+  int res;
+
+  if (dsmeta_bin_decode_labels(data, len, &labels) < 0)
+    return -1;
+  while ((res = dsmeta_bin_labels_next(&labels, &class_id, &label, &label_len)) > 0) {
+    if (label_len)
+      *sum += (unsigned char) label[label_len - 1];
+    entries++;
+  }
+  return res < 0 ? -1 : entries;
+}
+
+// The label dictionary of a label_table decodes to its classes and names,
+// and a dictionary cut anywhere, between two entries included, is rejected.
+static void test_labels(void) {
+  label_table labels;
+  dsmeta_bin_writer w;
+  dsmeta_bin_labels decoded;
+  const char *label;
+  size_t label_len;
+  unsigned long sum = 0;
+  int class_id;
+  size_t len;
+
+  label_table_init(&labels);
+  dsmeta_bin_writer_init(&w);
+  label_table_intern(&labels, 0, "Car");
+  label_table_intern(&labels, 2, "Person");
+  label_table_intern(&labels, 5, "Roadsign");
+  label_table_build_binary(&labels, &w);
+  CHECK(!w.error);
+
+  CHECK_INT(dsmeta_bin_decode_labels(w.buf, w.len, &decoded), 0);
+  CHECK_INT(decoded.num_labels, 3);
+  CHECK_INT(dsmeta_bin_labels_next(&decoded, &class_id, &label, &label_len), 1);
+  CHECK_INT(class_id, 0);
+  CHECK(label_len == 3 && memcmp(label, "Car", 3) == 0);
+  CHECK_INT(dsmeta_bin_labels_next(&decoded, &class_id, &label, &label_len), 1);
+  CHECK_INT(class_id, 2);
+  CHECK(label_len == 6 && memcmp(label, "Person", 6) == 0);
+  CHECK_INT(dsmeta_bin_labels_next(&decoded, &class_id, &label, &label_len), 1);
+  CHECK_INT(class_id, 5);
+  CHECK(label_len == 8 && memcmp(label, "Roadsign", 8) == 0);
+  CHECK_INT(dsmeta_bin_labels_next(&decoded, &class_id, &label, &label_len), 0);
+
+  for (len = 0; len < w.len; len++) {
+    uint8_t *cut = malloc(len ? len : 1);
+
+    memcpy(cut, w.buf, len);
+    CHECK_INT(decode_labels(cut, len, &sum), -1);
+    free(cut);
+  }
+  sink = sum;
+  dsmeta_bin_writer_free(&w);
+  label_table_free(&labels);
+}
+
+int main(void) {
+  test_round_trip();
+  test_fuzz_frame();
+  test_batch();
+  test_labels();
+  return check_done("dsmeta-binary");
+}
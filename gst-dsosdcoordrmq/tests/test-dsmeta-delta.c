@@ -0,0 +1,281 @@
+// Copyright 2022, Kyota Tashiro, Mengheng Lee, and Latona Inc.
+// License MIT
+
+#include <math.h>
+#include "check.h"
+#include "batch-gen.h"
+#include "dsmeta-delta.h"
+#include "dsmeta-extract.h"
+
+#define NUM_SOURCES 3
+#define MAX_IDS 4096
+#define TOLERANCE 6.0f
+#define KEYFRAME_INTERVAL 25
+
+// What a consumer knows about one tracked object, built from the binary
+// messages alone.
+typedef struct view {
+  int have;
+  int class_id;
+  float left;
+  float top;
+  float width;
+  float height;
+} view;
+
+static view views[NUM_SOURCES][MAX_IDS];
+static dsmeta_object truth[NUM_SOURCES][512];
+static size_t num_truth[NUM_SOURCES];
+
+// Applies a decoded message to the consumer's view of its source. Returns
+// the untracked objects it carried.
+static unsigned int consume(const dsmeta_bin_frame *frame) {
+  view *v = views[frame->source_id];
+  unsigned int untracked = 0;
+  unsigned int i;
+
+  if (frame->flags & DSMETA_BIN_FLAG_KEYFRAME)
+    memset(views[frame->source_id], 0, sizeof(views[frame->source_id]));
+  for (i = 0; i < frame->num_removed; i++) {
+    uint64_t id = dsmeta_bin_get_removed(frame, i);
+
+    CHECK(id < MAX_IDS && v[id].have);
+    if (id < MAX_IDS)
+      v[id].have = 0;
+  }
+  for (i = 0; i < frame->num_objects; i++) {
+    dsmeta_bin_object o;
+    uint64_t id = dsmeta_bin_get_object_id(frame, i);
+
+    if (id == DSMETA_BIN_NO_OBJECT_ID) {
+      untracked++;
+      continue;
+    }
+    CHECK(id < MAX_IDS);
+    if (id >= MAX_IDS)
+      continue;
+    dsmeta_bin_get_object(frame, i, &o);
+    v[id] = (view) {
+      .have = 1, .class_id = o.class_id,
+      .left = o.left, .top = o.top, .width = o.width, .height = o.height};
+  }
+  return untracked;
+}
+
+// The consumer's view of source s holds every tracked object of its last
+// frame, and only those, each within the tolerance of its true box plus the
+// truncation of the binary format.
+static void check_view(unsigned int s) {
+  size_t tracked = 0;
+  size_t have = 0;
+  size_t i;
+
+  for (i = 0; i < num_truth[s]; i++) {
+    const dsmeta_object *o = &truth[s][i];
+    const view *v;
+
+    if (o->object_id == DSMETA_NO_OBJECT_ID)
+      continue;
+    tracked++;
+    CHECK(o->object_id < MAX_IDS);
+    if (o->object_id >= MAX_IDS)
+      continue;
+    v = &views[s][o->object_id];
+    CHECK(v->have);
+    CHECK_INT(v->class_id, o->class_id);
+    CHECK(fabsf(v->left - o->left) <= TOLERANCE + 1.0f &&
+          fabsf(v->top - o->top) <= TOLERANCE + 1.0f &&
+          fabsf(v->width - o->width) <= TOLERANCE + 1.0f &&
+          fabsf(v->height - o->height) <= TOLERANCE + 1.0f);
+  }
+  for (i = 0; i < MAX_IDS; i++)
+    have += views[s][i].have;
+  CHECK_INT(have, tracked);
+}
+
+// Synthetic sources with moving, arriving and leaving objects are published
+// as keyframes and deltas; a consumer applying them keeps an accurate view
+// while most unmoved objects are left out.
+static void test_reconstruction(void) {
+  batch_gen_config config = {
+    .num_sources = NUM_SOURCES, .objects_per_frame = 60, .width = 1920, .height = 1080,
+    .tracked = 1, .churn_interval = 2, .seed = 9};
+  batch_gen g;
+  dsmeta_frame f;
+  dsmeta_delta d;
+  dsmeta_bin_writer w;
+  label_table labels;
+  dsmeta_bin_frame frame;
+  unsigned long grows = 0;
+  size_t full_objects = 0;
+  size_t sent_objects = 0;
+  int round;
+
+  CHECK_INT(batch_gen_init(&g, &config), 0);
+  dsmeta_frame_init(&f, 0);
+  dsmeta_delta_init(&d, TOLERANCE, KEYFRAME_INTERVAL);
+  dsmeta_bin_writer_init(&w);
+  label_table_init(&labels);
+  for (round = 0; round < 200; round++) {
+    NvDsMetaList *l_frame;
+
+    for (l_frame = batch_gen_next(&g)->frame_meta_list; l_frame; l_frame = l_frame->next) {
+      unsigned int s = ((NvDsFrameMeta *) l_frame->data)->source_id;
+      dsmeta_object *untracked;
+
+      CHECK_INT(dsmeta_frame_extract(&f, l_frame->data, &labels), 0);
+      // Objects without a tracker id go out in every message.
+      untracked = dsmeta_frame_add_object(&f);
+      *untracked = (dsmeta_object) {
+        .object_id = DSMETA_NO_OBJECT_ID, .class_id = 1, .label = "Bicycle",
+        .left = 10.0f, .top = 20.0f, .width = 30.0f, .height = 40.0f};
+      memcpy(truth[s], f.objects, f.num_objects * sizeof(*f.objects));
+      num_truth[s] = f.num_objects;
+      full_objects += f.num_objects;
+
+      CHECK_INT(dsmeta_delta_apply(&d, &f), 0);
+      CHECK_INT(f.kind, round % KEYFRAME_INTERVAL == 0 ?
+                DSMETA_FRAME_KEYFRAME : DSMETA_FRAME_DELTA);
+      sent_objects += f.num_objects;
+      dsmeta_frame_build_binary(&f, &w);
+      CHECK(!w.error);
+      CHECK_INT(dsmeta_bin_decode_frame(w.buf, w.len, &frame), 0);
+      CHECK_INT(consume(&frame), 1);
+      check_view(s);
+    }
+    if (round == KEYFRAME_INTERVAL)
+      grows = d.grows + f.grows;
+  }
+  // Most objects move slower than the tolerance, so most are left out.
+  CHECK(d.suppressed > 0);
+  CHECK(sent_objects * 2 < full_objects);
+  // The sources and their objects were allocated once the scene was known.
+  CHECK_INT(d.grows + f.grows, grows);
+
+  // After a reset every source starts over with a keyframe.
+  dsmeta_delta_reset(&d);
+  CHECK_INT(dsmeta_frame_extract(&f, batch_gen_next(&g)->frame_meta_list->data, &labels), 0);
+  CHECK_INT(dsmeta_delta_apply(&d, &f), 0);
+  CHECK_INT(f.kind, DSMETA_FRAME_KEYFRAME);
+
+  label_table_free(&labels);
+  dsmeta_bin_writer_free(&w);
+  dsmeta_delta_free(&d);
+  dsmeta_frame_free(&f);
+  batch_gen_free(&g);
+}
+
+// A box that creeps by less than the tolerance every frame is sent again
+// once it has moved further than that in total, and a class change is sent
+// even without a move.
+static void test_creep(void) {
+  dsmeta_frame f;
+  dsmeta_delta d;
+  dsmeta_object *o;
+  int sent = 0;
+  int n;
+
+  dsmeta_frame_init(&f, 0);
+  dsmeta_delta_init(&d, 2.0f, 0);
+  for (n = 0; n < 10; n++) {
+    dsmeta_frame_begin(&f, 0, n, 0, DSMETA_BIN_NO_PTS, 1);
+    o = dsmeta_frame_add_object(&f);
+    *o = (dsmeta_object) {
+      .object_id = 5, .class_id = 0, .label = "Car",
+      .left = 100.0f + n, .top = 100.0f, .width = 50.0f, .height = 50.0f};
+    CHECK_INT(dsmeta_delta_apply(&d, &f), 0);
+    CHECK_INT(f.kind, n == 0 ? DSMETA_FRAME_KEYFRAME : DSMETA_FRAME_DELTA);
+    sent += (int) f.num_objects;
+  }
+  // Sent at 100, 103, 106 and 109.
+  CHECK_INT(sent, 4);
+
+  dsmeta_frame_begin(&f, 0, 10, 0, DSMETA_BIN_NO_PTS, 1);
+  o = dsmeta_frame_add_object(&f);
+  *o = (dsmeta_object) {
+    .object_id = 5, .class_id = 2, .label = "Person",
+    .left = 109.0f, .top = 100.0f, .width = 50.0f, .height = 50.0f};
+  CHECK_INT(dsmeta_delta_apply(&d, &f), 0);
+  CHECK_INT(f.num_objects, 1);
+
+  // Gone from the next frame, it is listed as removed once.
+  dsmeta_frame_begin(&f, 0, 11, 0, DSMETA_BIN_NO_PTS, 0);
+  CHECK_INT(dsmeta_delta_apply(&d, &f), 0);
+  CHECK_INT(f.num_removed, 1);
+  CHECK_INT(f.removed[0], 5);
+  dsmeta_frame_begin(&f, 0, 12, 0, DSMETA_BIN_NO_PTS, 0);
+  CHECK_INT(dsmeta_delta_apply(&d, &f), 0);
+  CHECK_INT(f.num_removed, 0);
+
+  dsmeta_delta_free(&d);
+  dsmeta_frame_free(&f);
+}
+
+// A message that never reaches the consumer leaves its view stale. Forcing a
+// keyframe for that source alone puts the consumer right on the very next
+// frame, while the other sources carry on with deltas.
+static void test_dropped_message(void) {
+  batch_gen_config config = {
+    .num_sources = NUM_SOURCES, .objects_per_frame = 40, .width = 1920, .height = 1080,
+    .tracked = 1, .churn_interval = 2, .seed = 3};
+  batch_gen g;
+  dsmeta_frame f;
+  dsmeta_delta d;
+  dsmeta_bin_writer w;
+  label_table labels;
+  dsmeta_bin_frame frame;
+  int dropped = 0;
+  int round;
+
+  memset(views, 0, sizeof(views));
+  CHECK_INT(batch_gen_init(&g, &config), 0);
+  dsmeta_frame_init(&f, 0);
+  // No periodic keyframes, so only the forced one can repair the view.
+  dsmeta_delta_init(&d, TOLERANCE, 0);
+  dsmeta_bin_writer_init(&w);
+  label_table_init(&labels);
+  for (round = 0; round < 40; round++) {
+    NvDsMetaList *l_frame;
+
+    for (l_frame = batch_gen_next(&g)->frame_meta_list; l_frame; l_frame = l_frame->next) {
+      unsigned int s = ((NvDsFrameMeta *) l_frame->data)->source_id;
+
+      CHECK_INT(dsmeta_frame_extract(&f, l_frame->data, &labels), 0);
+      memcpy(truth[s], f.objects, f.num_objects * sizeof(*f.objects));
+      num_truth[s] = f.num_objects;
+      CHECK_INT(dsmeta_delta_apply(&d, &f), 0);
+      CHECK_INT(f.kind, round == 0 || (s == 1 && round == 21) ?
+                DSMETA_FRAME_KEYFRAME : DSMETA_FRAME_DELTA);
+      dsmeta_frame_build_binary(&f, &w);
+      CHECK(!w.error);
+      // The publisher drops the message with frame 20 of source 1 and
+      // reports it before frame 21 is built.
+      if (s == 1 && round == 20) {
+        dsmeta_delta_force_keyframe(&d, s);
+        dropped++;
+        continue;
+      }
+      CHECK_INT(dsmeta_bin_decode_frame(w.buf, w.len, &frame), 0);
+      consume(&frame);
+      check_view(s);
+    }
+  }
+  CHECK_INT(dropped, 1);
+
+  // Forcing a source that was never seen changes nothing.
+  dsmeta_delta_force_keyframe(&d, 99);
+  CHECK_INT(d.num_sources, NUM_SOURCES);
+
+  label_table_free(&labels);
+  dsmeta_bin_writer_free(&w);
+  dsmeta_delta_free(&d);
+  dsmeta_frame_free(&f);
+  batch_gen_free(&g);
+}
+
+int main(void) {
+  test_reconstruction();
+  test_creep();
+  test_dropped_message();
+  return check_done("dsmeta-delta");
+}
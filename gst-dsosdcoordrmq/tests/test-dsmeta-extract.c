@@ -0,0 +1,144 @@
+// Copyright 2022, Kyota Tashiro, Mengheng Lee, and Latona Inc.
+// License MIT
+
+#include "check.h"
+#include "batch-gen.h"
+#include "dsmeta-extract.h"
+
+// Every object of every source frame ends up in that frame's dsmeta_frame,
+// in list order and with its own source's ids.
+static void test_batch(void) {
+  batch_gen_config config = {
+    .num_sources = 4, .objects_per_frame = 300, .width = 1920, .height = 1080,
+    .tracked = 1, .churn_interval = 5, .seed = 7};
+  batch_gen g;
+  dsmeta_frame f;
+  label_table labels;
+  NvDsBatchMeta *batch;
+  NvDsMetaList *l_frame;
+  NvDsMetaList *l;
+  unsigned long grows = 0;
+  int round;
+
+  CHECK_INT(batch_gen_init(&g, &config), 0);
+  dsmeta_frame_init(&f, DSMETA_FRAME_DEFAULT_CAPACITY);
+  label_table_init(&labels);
+  for (round = 0; round < 10; round++) {
+    unsigned int frames = 0;
+
+    batch = batch_gen_next(&g);
+    for (l_frame = batch->frame_meta_list; l_frame; l_frame = l_frame->next) {
+      NvDsFrameMeta *frame_meta = l_frame->data;
+      size_t i = 0;
+
+      CHECK_INT(dsmeta_frame_extract(&f, frame_meta, &labels), 0);
+      CHECK_INT(f.source_id, frame_meta->source_id);
+      CHECK_INT(f.frame_number, round);
+      CHECK_INT(f.batch_id, frame_meta->batch_id);
+      CHECK_INT(f.pts, frame_meta->buf_pts);
+      CHECK_INT(f.kind, DSMETA_FRAME_FULL);
+      CHECK_INT(f.num_objects, 300);
+      for (l = frame_meta->obj_meta_list; l && i < f.num_objects; l = l->next, i++) {
+        NvDsObjectMeta *o = l->data;
+        dsmeta_object *d = &f.objects[i];
+
+        CHECK_INT(d->object_id, o->object_id);
+        CHECK_INT(d->class_id, o->class_id);
+        CHECK(d->left == o->rect_params.left && d->top == o->rect_params.top &&
+              d->width == o->rect_params.width && d->height == o->rect_params.height);
+        // The label is the interned one, not the meta's buffer.
+        CHECK(d->label != o->obj_label);
+        CHECK_STR(d->label, o->obj_label);
+        CHECK(d->label_json != NULL && d->label_json_len == strlen(o->obj_label) + 2);
+      }
+      frames++;
+    }
+    CHECK_INT(frames, 4);
+    if (round == 0)
+      grows = f.grows + labels.grows;
+  }
+  // The first batch grew the arrays and learnt the four labels, once.
+  CHECK_INT(f.grows + labels.grows, grows);
+  CHECK_INT(labels.count, 4);
+  CHECK_INT(f.high_water, 300);
+  label_table_free(&labels);
+  dsmeta_frame_free(&f);
+  batch_gen_free(&g);
+}
+
+// A labels file wins over obj_label, and a class the table cannot hold keeps
+// the meta's own label.
+static void test_labels(void) {
+  batch_gen_config config = {
+    .num_sources = 1, .objects_per_frame = 3, .width = 640, .height = 480, .seed = 3};
+  batch_gen g;
+  dsmeta_frame f;
+  label_table labels;
+  NvDsFrameMeta *frame_meta;
+
+  CHECK_INT(batch_gen_init(&g, &config), 0);
+  dsmeta_frame_init(&f, 0);
+  label_table_init(&labels);
+  CHECK(label_table_intern(&labels, 0, "vehicle") != NULL);
+  frame_meta = batch_gen_next(&g)->frame_meta_list->data;
+  g.objects[1].class_id = LABEL_TABLE_MAX_CLASSES;
+  g.objects[2].obj_label[0] = '\0';
+  g.objects[2].class_id = LABEL_TABLE_MAX_CLASSES + 1;
+  CHECK_INT(dsmeta_frame_extract(&f, frame_meta, &labels), 0);
+  CHECK_INT(f.num_objects, 3);
+  CHECK_STR(f.objects[0].label, "vehicle");
+  CHECK(f.objects[1].label == g.objects[1].obj_label);
+  CHECK(f.objects[1].label_json == NULL);
+  CHECK(f.objects[2].label == NULL);
+  CHECK(f.objects[2].label_json == NULL);
+  // Without a tracker every object is untracked.
+  CHECK_INT(f.objects[0].object_id, DSMETA_NO_OBJECT_ID);
+  CHECK_INT(labels.count, 1);
+  label_table_free(&labels);
+  dsmeta_frame_free(&f);
+  batch_gen_free(&g);
+}
+
+// A frame without objects still yields its ids, and the serializers agree on
+// what was extracted.
+static void test_serialize(void) {
+  batch_gen_config config = {
+    .num_sources = 2, .objects_per_frame = 0, .width = 640, .height = 480, .seed = 1};
+  batch_gen g;
+  dsmeta_frame f;
+  label_table labels;
+  json_writer w;
+  dsmeta_bin_writer b;
+  dsmeta_bin_frame d;
+  NvDsBatchMeta *batch;
+
+  CHECK_INT(batch_gen_init(&g, &config), 0);
+  dsmeta_frame_init(&f, 0);
+  label_table_init(&labels);
+  json_writer_init(&w);
+  dsmeta_bin_writer_init(&b);
+  batch_gen_next(&g);
+  batch = batch_gen_next(&g);
+  CHECK_INT(dsmeta_frame_extract(&f, batch->frame_meta_list->next->data, &labels), 0);
+  dsmeta_frame_build_json(&f, &w);
+  CHECK_STR(check_text(w.buf, w.len),
+            "{\"frameNumber\": 1, \"sourceId\": 1, \"batchId\": 1, \"pts\": 33333333, "
+            "\"inferredResult\": []}");
+  dsmeta_frame_build_binary(&f, &b);
+  CHECK_INT(dsmeta_bin_decode_frame(b.buf, b.len, &d), 0);
+  CHECK_INT(d.source_id, 1);
+  CHECK_INT(d.frame_number, 1);
+  CHECK_INT(d.num_objects, 0);
+  dsmeta_bin_writer_free(&b);
+  json_writer_free(&w);
+  label_table_free(&labels);
+  dsmeta_frame_free(&f);
+  batch_gen_free(&g);
+}
+
+int main(void) {
+  test_batch();
+  test_labels();
+  test_serialize();
+  return check_done("dsmeta-extract");
+}
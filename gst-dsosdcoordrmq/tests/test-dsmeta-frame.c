@@ -0,0 +1,224 @@
+// Copyright 2022, Kyota Tashiro, Mengheng Lee, and Latona Inc.
+// License MIT
+
+#include <stdlib.h>
+#include "check.h"
+#include "dsmeta-frame.h"
+
+static dsmeta_object *add(dsmeta_frame *f, int class_id, const char *label, float left,
+                          float top, float width, float height) {
+  dsmeta_object *o = dsmeta_frame_add_object(f);
+
+  o->object_id = DSMETA_NO_OBJECT_ID;
+  o->class_id = class_id;
+  o->label = label;
+  o->label_json = NULL;
+  o->left = left;
+  o->top = top;
+  o->width = width;
+  o->height = height;
+  return o;
+}
+
+static const char *json(const dsmeta_frame *f, json_writer *w) {
+  dsmeta_frame_build_json(f, w);
+  return w->error ? NULL : check_text(w->buf, w->len);
+}
+
+static void test_json(void) {
+  dsmeta_frame f;
+  json_writer w;
+  dsmeta_object *o;
+
+  dsmeta_frame_init(&f, 4);
+  json_writer_init(&w);
+
+  // Corners are truncated like the (int) casts of the original element.
+  dsmeta_frame_begin(&f, 3, 42, 1, 5000, 2);
+  add(&f, 2, "Person", 10.5f, 20.25f, 30.7f, 40.0f);
+  add(&f, 7, NULL, 0.0f, 0.0f, 1.0f, 2.0f);
+  CHECK_STR(json(&f, &w),
+            "{\"frameNumber\": 42, \"sourceId\": 3, \"batchId\": 1, \"pts\": 5000, "
+            "\"inferredResult\": [{\"label\": \"Person\", \"coordinate\": "
+            "{\"topLeft\": {\"x\": 10, \"y\": 20}, \"topRight\": {\"x\": 41, \"y\": 20}, "
+            "\"bottomLeft\": {\"x\": 10, \"y\": 60}, \"bottomRight\": {\"x\": 41, \"y\": 60}}}, "
+            "{\"coordinate\": {\"topLeft\": {\"x\": 0, \"y\": 0}, \"topRight\": {\"x\": 1, \"y\": 0}, "
+            "\"bottomLeft\": {\"x\": 0, \"y\": 2}, \"bottomRight\": {\"x\": 1, \"y\": 2}}}]}");
+
+  // A pre-escaped label is spliced as is and no pts means no pts key.
+  dsmeta_frame_begin(&f, 0, 7, 0, DSMETA_BIN_NO_PTS, 1);
+  o = add(&f, 0, "ignored", 1.0f, 2.0f, 3.0f, 4.0f);
+  o->label_json = "\"Car \\\"A\\\"\"";
+  o->label_json_len = strlen(o->label_json);
+  CHECK_STR(json(&f, &w),
+            "{\"frameNumber\": 7, \"sourceId\": 0, \"batchId\": 0, "
+            "\"inferredResult\": [{\"label\": \"Car \\\"A\\\"\", \"coordinate\": "
+            "{\"topLeft\": {\"x\": 1, \"y\": 2}, \"topRight\": {\"x\": 4, \"y\": 2}, "
+            "\"bottomLeft\": {\"x\": 1, \"y\": 6}, \"bottomRight\": {\"x\": 4, \"y\": 6}}}]}");
+
+  // An empty frame still has its inferredResult.
+  dsmeta_frame_begin(&f, 1, 8, 1, DSMETA_BIN_NO_PTS, 0);
+  CHECK_STR(json(&f, &w),
+            "{\"frameNumber\": 8, \"sourceId\": 1, \"batchId\": 1, \"inferredResult\": []}");
+
+  // Keyframes and deltas name their tracked objects; deltas list the removed.
+  dsmeta_frame_begin(&f, 1, 9, 0, DSMETA_BIN_NO_PTS, 2);
+  add(&f, 0, "Car", 0.0f, 0.0f, 1.0f, 1.0f)->object_id = 12;
+  add(&f, 0, "Car", 0.0f, 0.0f, 1.0f, 1.0f);
+  f.kind = DSMETA_FRAME_KEYFRAME;
+  CHECK_STR(json(&f, &w),
+            "{\"frameNumber\": 9, \"sourceId\": 1, \"batchId\": 0, \"keyframe\": true, "
+            "\"inferredResult\": [{\"objectId\": 12, \"label\": \"Car\", \"coordinate\": "
+            "{\"topLeft\": {\"x\": 0, \"y\": 0}, \"topRight\": {\"x\": 1, \"y\": 0}, "
+            "\"bottomLeft\": {\"x\": 0, \"y\": 1}, \"bottomRight\": {\"x\": 1, \"y\": 1}}}, "
+            "{\"label\": \"Car\", \"coordinate\": "
+            "{\"topLeft\": {\"x\": 0, \"y\": 0}, \"topRight\": {\"x\": 1, \"y\": 0}, "
+            "\"bottomLeft\": {\"x\": 0, \"y\": 1}, \"bottomRight\": {\"x\": 1, \"y\": 1}}}]}");
+
+  dsmeta_frame_begin(&f, 1, 10, 0, DSMETA_BIN_NO_PTS, 0);
+  f.kind = DSMETA_FRAME_DELTA;
+  f.removed = malloc(2 * sizeof(*f.removed));
+  f.removed_capacity = 2;
+  f.removed[0] = 12;
+  f.removed[1] = 13;
+  f.num_removed = 2;
+  CHECK_STR(json(&f, &w),
+            "{\"frameNumber\": 10, \"sourceId\": 1, \"batchId\": 0, \"keyframe\": false, "
+            "\"inferredResult\": [], \"removed\": [12, 13]}");
+
+  dsmeta_frame_free(&f);
+  json_writer_free(&w);
+}
+
+// Past the default capacity the array doubles, and a frame as busy as the
+// busiest one so far allocates nothing.
+static void test_growth(void) {
+  dsmeta_frame f;
+  unsigned long grows = 0;
+  int round, i;
+
+  dsmeta_frame_init(&f, DSMETA_FRAME_DEFAULT_CAPACITY);
+  CHECK_INT(f.grows, 1);
+  for (round = 0; round < 3; round++) {
+    dsmeta_frame_begin(&f, 0, round, 0, DSMETA_BIN_NO_PTS, 0);
+    for (i = 0; i < 300; i++)
+      CHECK(add(&f, i % 4, "Car", (float) i, 0.0f, 1.0f, 1.0f) != NULL);
+    if (round == 0)
+      grows = f.grows;
+  }
+  CHECK_INT(grows, 3);
+  CHECK_INT(f.grows, grows);
+  CHECK_INT(f.num_objects, 300);
+  CHECK_INT(f.high_water, 300);
+  CHECK_INT(f.capacity, 512);
+  CHECK_INT(f.objects[299].left, 299);
+
+  // The expected count grows the array once up front.
+  dsmeta_frame_begin(&f, 0, 4, 0, DSMETA_BIN_NO_PTS, 1500);
+  CHECK_INT(f.grows, grows + 1);
+  CHECK_INT(f.capacity, 2048);
+  CHECK_INT(f.high_water, 300);
+  dsmeta_frame_free(&f);
+}
+
+static void test_classes(void) {
+  static const int classes[] = {2, 0, 2, 1, 0, 2};
+  static const int sorted[] = {0, 0, 1, 2, 2, 2};
+  static const int order[] = {1, 4, 3, 0, 2, 5};
+  static const size_t runs[] = {2, 1, 3};
+  dsmeta_frame f;
+  dsmeta_frame view;
+  size_t pos = 0;
+  size_t i;
+  int n = 0;
+
+  dsmeta_frame_init(&f, 0);
+  dsmeta_frame_begin(&f, 5, 1, 2, 100, 6);
+  for (i = 0; i < 6; i++)
+    add(&f, classes[i], "x", (float) i, 0.0f, 1.0f, 1.0f);
+  f.kind = DSMETA_FRAME_KEYFRAME;
+  dsmeta_frame_sort_by_class(&f);
+  for (i = 0; i < 6; i++) {
+    CHECK_INT(f.objects[i].class_id, sorted[i]);
+    CHECK_INT(f.objects[i].left, order[i]);
+  }
+  while (dsmeta_frame_next_class(&f, &pos, &view)) {
+    CHECK(n < 3);
+    if (n >= 3)
+      break;
+    CHECK_INT(view.num_objects, runs[n]);
+    CHECK_INT(view.source_id, 5);
+    CHECK_INT(view.frame_number, 1);
+    CHECK_INT(view.kind, DSMETA_FRAME_FULL);
+    CHECK(view.objects == f.objects + pos - runs[n]);
+    n++;
+  }
+  CHECK_INT(n, 3);
+  CHECK_INT(pos, 6);
+  dsmeta_frame_free(&f);
+}
+
+static void test_binary(void) {
+  dsmeta_frame f;
+  dsmeta_bin_writer w;
+  dsmeta_bin_frame d;
+  dsmeta_bin_object o;
+
+  dsmeta_frame_init(&f, 0);
+  dsmeta_bin_writer_init(&w);
+  dsmeta_frame_begin(&f, 3, 42, 1, 5000, 3);
+  add(&f, 2, "Person", 10.5f, 20.25f, 30.7f, 40.0f);
+  add(&f, 0, "Car", -40000.0f, 0.0f, 70000.0f, 1.0f);
+  add(&f, 2, "Person", 1.0f, 2.0f, 3.0f, 4.0f);
+  dsmeta_frame_build_binary(&f, &w);
+  CHECK_INT(w.error, 0);
+  CHECK_INT(dsmeta_bin_decode_frame(w.buf, w.len, &d), 0);
+  CHECK_INT(d.size, w.len);
+  CHECK_INT(d.source_id, 3);
+  CHECK_INT(d.frame_number, 42);
+  CHECK_INT(d.batch_id, 1);
+  CHECK_INT(d.pts, 5000);
+  CHECK_INT(d.flags, 0);
+  CHECK_INT(d.num_objects, 3);
+  CHECK(d.object_ids == NULL);
+  // Labels are stored once and shared by id.
+  CHECK_INT(d.num_labels, 2);
+  dsmeta_bin_get_object(&d, 0, &o);
+  CHECK_INT(o.class_id, 2);
+  CHECK_INT(o.left, 10);
+  CHECK_INT(o.top, 20);
+  CHECK_INT(o.width, 30);
+  CHECK_INT(o.height, 40);
+  CHECK(o.label_id < d.num_labels);
+  if (o.label_id < d.num_labels) {
+    CHECK_INT(d.label_lens[o.label_id], 6);
+    CHECK_MEM(d.labels[o.label_id], "Person", 6);
+  }
+  dsmeta_bin_get_object(&d, 2, &o);
+  CHECK(o.label_id < d.num_labels);
+  dsmeta_bin_get_object(&d, 1, &o);
+  CHECK_INT(o.left, INT16_MIN);
+  CHECK_INT(o.width, UINT16_MAX);
+
+  // With a dictionary, frames carry class ids only.
+  f.class_labels = 1;
+  dsmeta_frame_build_binary(&f, &w);
+  CHECK_INT(dsmeta_bin_decode_frame(w.buf, w.len, &d), 0);
+  CHECK_INT(d.flags, DSMETA_BIN_FLAG_CLASS_LABELS);
+  CHECK_INT(d.num_labels, 0);
+  dsmeta_bin_get_object(&d, 0, &o);
+  CHECK_INT(o.label_id, DSMETA_BIN_NO_LABEL);
+  CHECK_INT(o.class_id, 2);
+  CHECK_INT(w.len, DSMETA_BIN_HEADER_SIZE + 3 * DSMETA_BIN_OBJECT_SIZE + 1);
+
+  dsmeta_frame_free(&f);
+  dsmeta_bin_writer_free(&w);
+}
+
+int main(void) {
+  test_json();
+  test_growth();
+  test_classes();
+  test_binary();
+  return check_done("dsmeta-frame");
+}
@@ -0,0 +1,450 @@
+// Copyright 2022, Kyota Tashiro, Mengheng Lee, and Latona Inc.
+// License MIT
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "batch-gen.h"
+#include "check.h"
+#include "fake-gst.h"
+#include "fake-nvll-osd.h"
+#include "fake-pango.h"
+#include "gstdsosdcoordrmq.h"
+
+#define NUM_SOURCES 4
+#define OBJECTS_PER_FRAME 4
+#define WIDTH 320
+#define HEIGHT 240
+#define NUM_BUFFERS 3
+#define CLOCK_FONT_SIZE 20
+#define CLOCK_OFFSET 4
+// The time every clock shows, in UTC, with digits of both widths of the fake
+// font.
+#define CLOCK_TIME (11 * 3600 + 10 * 60 + 1)
+#define CLOCK_TEXT "11:10:01"
+
+extern const GstPluginDesc gst_plugin_nvdsgst_dsosdcoordrmq_desc;
+
+static const fake_nvll_osd_op ops[OSD_DRAW_NUM_TYPES] = {
+  [OSD_DRAW_RECTANGLES] = FAKE_NVLL_OSD_RECTANGLES,
+  [OSD_DRAW_SEGMENT_MASKS] = FAKE_NVLL_OSD_SEGMENT_MASKS,
+  [OSD_DRAW_PUT_TEXT] = FAKE_NVLL_OSD_PUT_TEXT,
+  [OSD_DRAW_LINES] = FAKE_NVLL_OSD_LINES,
+  [OSD_DRAW_ARROWS] = FAKE_NVLL_OSD_ARROWS,
+  [OSD_DRAW_CIRCLES] = FAKE_NVLL_OSD_CIRCLES,
+};
+
+// Frame s of a batch goes to surface batch_ids[s], so a surface is only
+// found through the batch_id of its frame.
+static const guint batch_ids[NUM_SOURCES] = {2, 0, 3, 1};
+
+static NvBufSurfaceParams surface_list[NUM_SOURCES];
+static NvBufSurface surface = {
+  .batchSize = NUM_SOURCES, .numFilled = NUM_SOURCES, .surfaceList = surface_list};
+static uint8_t pixels[NUM_SOURCES][WIDTH * HEIGHT * 4];
+
+// Stands in for the C library's, so the clock always shows CLOCK_TEXT.
+time_t time(time_t *t) {
+  if (t)
+    *t = CLOCK_TIME;
+  return CLOCK_TIME;
+}
+
+static GstElement *new_element(void) {
+  GstElement *element;
+  unsigned int s;
+
+  fake_gst_reset();
+  fake_nvll_osd_reset();
+  fake_pango_reset();
+  memset(pixels, 0, sizeof(pixels));
+  for (s = 0; s < NUM_SOURCES; s++)
+    surface_list[s] = (NvBufSurfaceParams) {
+      .width = WIDTH, .height = HEIGHT, .pitch = WIDTH * 4,
+      .colorFormat = NVBUF_COLOR_FORMAT_RGBA, .dataPtr = pixels[s],
+      .planeParams = {.num_planes = 1, .pitch = {WIDTH * 4}}};
+  element = gst_element_factory_make("dsosdcoordrmq", NULL);
+  CHECK(element != NULL);
+  return element;
+}
+
+// A generator whose frame s carries s + 1 objects, one display element of
+// each kind, and batch_ids[s].
+static void init_gen(batch_gen *gen) {
+  batch_gen_config config = {.num_sources = NUM_SOURCES, .objects_per_frame = OBJECTS_PER_FRAME,
+                             .width = WIDTH, .height = HEIGHT, .tracked = 1,
+                             .display_elements = 1, .seed = 5};
+  unsigned int s, i;
+
+  CHECK_INT(batch_gen_init(gen, &config), 0);
+  for (s = 0; s < NUM_SOURCES; s++) {
+    NvDsMetaList *l = gen->frames[s].obj_meta_list;
+
+    gen->frames[s].batch_id = batch_ids[s];
+    for (i = 0; l && i < s; i++)
+      l = l->next;
+    if (l)
+      l->next = NULL;
+  }
+}
+
+// Starts element on WIDTH x HEIGHT caps and pushes NUM_BUFFERS buffers of gen.
+static void run(GstElement *element, batch_gen *gen) {
+  unsigned int i;
+
+  CHECK(fake_gst_start(element));
+  CHECK(fake_gst_set_caps(element, WIDTH, HEIGHT));
+  for (i = 0; i < NUM_BUFFERS; i++) {
+    GstBuffer *buffer = fake_gst_buffer_new_video(&surface, batch_gen_next(gen));
+
+    CHECK_INT(fake_gst_push(element, buffer), GST_FLOW_OK);
+    gst_buffer_unref(buffer);
+  }
+}
+
+// The stats field name, 0 when there is none.
+static guint64 stat(GstElement *element, const char *name) {
+  GstStructure *stats = NULL;
+  guint64 value = 0;
+
+  g_object_get(element, "stats", &stats, NULL);
+  CHECK(stats != NULL);
+  if (stats) {
+    gst_structure_get_uint64(stats, name, &value);
+    gst_structure_free(stats);
+  }
+  return value;
+}
+
+// The texts of a batch of gen and, in distinct, how many differ.
+static unsigned int count_texts(batch_gen *gen, unsigned int *distinct) {
+  const char *seen[NUM_SOURCES * (OBJECTS_PER_FRAME + 1)];
+  unsigned int texts = 0, i;
+  NvDsMetaList *f, *l;
+
+  *distinct = 0;
+  for (f = gen->batch.frame_meta_list; f; f = f->next) {
+    const NvDsFrameMeta *frame = f->data;
+
+    for (l = frame->obj_meta_list; l; l = l->next)
+      seen[texts++] = ((const NvDsObjectMeta *) l->data)->text_params.display_text;
+    seen[texts++] = ((const NvDsDisplayMeta *) frame->display_meta_list->data)
+                        ->text_params[0].display_text;
+  }
+  for (i = 0; i < texts; i++) {
+    unsigned int j = 0;
+
+    while (j < i && strcmp(seen[j], seen[i]) != 0)
+      j++;
+    *distinct += j == i;
+  }
+  return texts;
+}
+
+// Whether the call was made on one of the element's contexts.
+static int own_context(const GstDsOsdCoordRmq *osd, const void *context) {
+  guint i;
+
+  for (i = 0; i < osd->num_contexts; i++)
+    if (osd->contexts[i] == context)
+      return 1;
+  return 0;
+}
+
+// Each frame is drawn on surfaceList[batch_id], with one call per primitive
+// type handed all of the frame's primitives, whichever of threads surface
+// threads draws it, and every call of a surface on the same context of its
+// own.
+static void check_routing(unsigned int threads) {
+  GstElement *element = new_element();
+  GstDsOsdCoordRmq *osd = GST_DSOSDCOORDRMQ(element);
+  guint64 allocations;
+  unsigned int s, type, i;
+  batch_gen gen;
+
+  init_gen(&gen);
+  g_object_set(element, "process-mode", MODE_CPU, "surface-threads", threads, NULL);
+  run(element, &gen);
+  CHECK_INT(fake_gst.errors, 0);
+  CHECK_INT(fake_gst.warnings, 0);
+  CHECK_INT(osd->num_contexts, threads);
+  CHECK((osd->surface_pool != NULL) == (threads > 1));
+  CHECK_INT(fake_nvll_osd.contexts, threads);
+  CHECK_INT(fake_nvll_osd.set_params, threads);
+  CHECK_INT(fake_nvll_osd.width, WIDTH);
+
+  // Masks are off by default.
+  CHECK_INT(fake_nvll_osd.num_calls, NUM_BUFFERS * NUM_SOURCES * (OSD_DRAW_NUM_TYPES - 1));
+  for (s = 0; s < NUM_SOURCES; s++) {
+    const NvBufSurfaceParams *on = &surface_list[batch_ids[s]];
+    const int expected[OSD_DRAW_NUM_TYPES] = {(int) s + 2, 0, (int) s + 2, 1, 1, 1};
+
+    for (type = 0; type < OSD_DRAW_NUM_TYPES; type++)
+      CHECK_INT(fake_nvll_osd_calls_on(ops[type], on), expected[type] ? NUM_BUFFERS : 0);
+    for (i = 0; i < fake_nvll_osd.num_calls; i++) {
+      const fake_nvll_osd_call *call = &fake_nvll_osd.calls[i];
+
+      if (call->buf_ptr != on)
+        continue;
+      CHECK_INT(call->primitives, expected[call->op]);
+      CHECK_INT(call->mode, MODE_CPU);
+      CHECK(own_context(osd, call->context));
+    }
+  }
+  // Surfaces are drawn in order on the streaming thread.
+  if (threads == 1)
+    for (i = 0; i < fake_nvll_osd.num_calls; i++)
+      CHECK(fake_nvll_osd.calls[i].buf_ptr ==
+            &surface_list[i / (OSD_DRAW_NUM_TYPES - 1) % NUM_SOURCES]);
+  // The next call on a surface within a buffer, circles being its last, is
+  // on the same context.
+  for (i = 0; i < fake_nvll_osd.num_calls; i++) {
+    const fake_nvll_osd_call *call = &fake_nvll_osd.calls[i];
+    unsigned int next;
+
+    if (call->op == FAKE_NVLL_OSD_CIRCLES)
+      continue;
+    for (next = i + 1; next < fake_nvll_osd.num_calls; next++)
+      if (fake_nvll_osd.calls[next].buf_ptr == call->buf_ptr)
+        break;
+    CHECK(next < fake_nvll_osd.num_calls &&
+          fake_nvll_osd.calls[next].context == call->context);
+  }
+
+  CHECK_INT(stat(element, "buffers"), NUM_BUFFERS);
+  CHECK_INT(stat(element, "surfaces"), NUM_BUFFERS * NUM_SOURCES);
+  CHECK_INT(stat(element, "draw-calls"), fake_nvll_osd.num_calls);
+  CHECK_INT(stat(element, "draw-rectangles-count"), NUM_BUFFERS * NUM_SOURCES);
+  CHECK_INT(stat(element, "draw-rectangles-primitives"),
+            NUM_BUFFERS * (2 + 3 + 4 + 5));
+  CHECK_INT(stat(element, "draw-segment-masks-count"), 0);
+  CHECK_INT(stat(element, "batch-dropped"), 0);
+
+  // Batches are kept, even across a restart, so the same scene allocates
+  // nothing more.
+  allocations = stat(element, "batch-allocations");
+  CHECK(fake_gst_stop(element));
+  run(element, &gen);
+  CHECK_INT(stat(element, "batch-allocations"), allocations);
+  CHECK(fake_gst_stop(element));
+  CHECK_INT(osd->num_contexts, 0);
+  CHECK(osd->surface_pool == NULL);
+  g_object_unref(element);
+  batch_gen_free(&gen);
+}
+
+static void test_routing(void) {
+  check_routing(1);
+  check_routing(NUM_SOURCES);
+}
+
+// Surface threads only draw in CPU mode, where nvll_osd renders on the
+// calling thread; elsewhere the streaming thread draws alone.
+static void test_surface_threads_gpu_mode(void) {
+  GstElement *element = new_element();
+  GstDsOsdCoordRmq *osd = GST_DSOSDCOORDRMQ(element);
+  unsigned int i;
+  batch_gen gen;
+
+  init_gen(&gen);
+  g_object_set(element, "process-mode", MODE_GPU, "surface-threads", 4, NULL);
+  run(element, &gen);
+  CHECK_INT(fake_gst.warnings, 0);
+  CHECK_INT(osd->num_contexts, 1);
+  CHECK(osd->surface_pool == NULL);
+  for (i = 0; i < fake_nvll_osd.num_calls; i++) {
+    CHECK(fake_nvll_osd.calls[i].context == osd->contexts[0]);
+    CHECK_INT(fake_nvll_osd.calls[i].mode, MODE_GPU);
+  }
+  CHECK(fake_gst_stop(element));
+  g_object_unref(element);
+  batch_gen_free(&gen);
+}
+
+// With the CPU renderer, boxes and lines are drawn on the mapped surfaces,
+// text is left to nvll_osd in between, and every draw still counts as a
+// call.
+static void test_cpu_render(void) {
+  GstElement *element = new_element();
+  GstStructure *stats = NULL;
+  unsigned long drawn = 0;
+  guint64 misses = 0;
+  unsigned int s;
+  size_t i;
+  batch_gen gen;
+
+  init_gen(&gen);
+  g_object_set(element, "process-mode", MODE_CPU, "surface-threads", 2, "cpu-threads", 2,
+               NULL);
+  run(element, &gen);
+  CHECK_INT(fake_gst.errors, 0);
+  for (s = 0; s < NUM_SOURCES; s++) {
+    CHECK_INT(fake_nvll_osd_calls_on(FAKE_NVLL_OSD_RECTANGLES, &surface_list[s]), 0);
+    CHECK_INT(fake_nvll_osd_calls_on(FAKE_NVLL_OSD_LINES, &surface_list[s]), 0);
+    CHECK_INT(fake_nvll_osd_calls_on(FAKE_NVLL_OSD_PUT_TEXT, &surface_list[s]), NUM_BUFFERS);
+    CHECK_INT(fake_nvll_osd_calls_on(FAKE_NVLL_OSD_ARROWS, &surface_list[s]), NUM_BUFFERS);
+    CHECK(surface_list[s].mappedAddr.addr[0] == NULL);
+    for (i = 0; i < sizeof(pixels[s]); i++)
+      drawn += pixels[s][i] != 0;
+  }
+  CHECK(drawn > 0);
+  // Mapped for the boxes, then again for the lines after the text.
+  CHECK_INT(fake_nvll_osd.maps, NUM_BUFFERS * NUM_SOURCES * 2);
+  CHECK_INT(fake_nvll_osd.unmaps, fake_nvll_osd.maps);
+  CHECK_INT(stat(element, "draw-calls"), NUM_BUFFERS * NUM_SOURCES * (OSD_DRAW_NUM_TYPES - 1));
+  CHECK_INT(stat(element, "draw-lines-primitives"), NUM_BUFFERS * NUM_SOURCES);
+  g_object_get(element, "stats", &stats, NULL);
+  CHECK(stats && gst_structure_get_string(stats, "cpu-kernels") != NULL);
+  CHECK(stats && !gst_structure_get_uint64(stats, "text-cache-misses", &misses));
+  if (stats)
+    gst_structure_free(stats);
+  CHECK(fake_gst_stop(element));
+  g_object_unref(element);
+  batch_gen_free(&gen);
+}
+
+// With the text cache, text is rasterized once and blitted from then on, so
+// nvll_osd draws none and later buffers only hit the cache.
+static void test_text_cache(void) {
+  GstElement *element = new_element();
+  unsigned int texts, distinct, i;
+  batch_gen gen;
+
+  init_gen(&gen);
+  g_object_set(element, "process-mode", MODE_CPU, "surface-threads", NUM_SOURCES,
+               "cpu-threads", 1, "text-cache-size", 1 << 20, NULL);
+  CHECK(fake_gst_start(element));
+  CHECK(fake_gst_set_caps(element, WIDTH, HEIGHT));
+  for (i = 0; i < NUM_BUFFERS; i++) {
+    GstBuffer *buffer = fake_gst_buffer_new_video(&surface, batch_gen_next(&gen));
+
+    CHECK_INT(fake_gst_push(element, buffer), GST_FLOW_OK);
+    gst_buffer_unref(buffer);
+  }
+  // Labels keep their text as the objects move, and the display meta's
+  // "zone" is the same on every frame.
+  texts = count_texts(&gen, &distinct);
+  CHECK_INT(texts, 2 + 3 + 4 + 5);
+  CHECK_INT(fake_gst.errors, 0);
+  CHECK_INT(fake_nvll_osd.calls_per_op[FAKE_NVLL_OSD_PUT_TEXT], 0);
+  CHECK_INT(fake_nvll_osd.calls_per_op[FAKE_NVLL_OSD_RECTANGLES], 0);
+  CHECK_INT(stat(element, "text-cache-misses"), distinct);
+  CHECK_INT(stat(element, "text-cache-hits"), NUM_BUFFERS * texts - distinct);
+  CHECK_INT(fake_pango.shown, distinct);
+  CHECK_INT(stat(element, "put-text-primitives"), NUM_BUFFERS * texts);
+  CHECK(stat(element, "text-cache-bytes") > 0);
+  CHECK(fake_gst_stop(element));
+  g_object_unref(element);
+  batch_gen_free(&gen);
+}
+
+// A surface that cannot be mapped has its text drawn by nvll_osd, which only
+// shows the clock with the clock params of every context set, text cache or
+// not.
+static void test_clock_on_unmapped_surfaces(void) {
+  GstElement *element = new_element();
+  GstDsOsdCoordRmq *osd = GST_DSOSDCOORDRMQ(element);
+  unsigned int s;
+  batch_gen gen;
+
+  init_gen(&gen);
+  g_object_set(element, "process-mode", MODE_CPU, "surface-threads", 2, "cpu-threads", 1,
+               "text-cache-size", 1 << 20, "display-clock", TRUE, "clock-font-size", 20,
+               NULL);
+  fake_nvll_osd.fail_maps = 1;
+  run(element, &gen);
+  CHECK_INT(fake_gst.errors, 0);
+  CHECK(osd->text_cache);
+  // Once on start and again on caps.
+  CHECK_INT(fake_nvll_osd.clock_params, 2 * osd->num_contexts);
+  CHECK_INT(fake_nvll_osd.clock.font_params.font_size, 20);
+  for (s = 0; s < NUM_SOURCES; s++) {
+    CHECK_INT(fake_nvll_osd_calls_on(FAKE_NVLL_OSD_RECTANGLES, &surface_list[s]), NUM_BUFFERS);
+    CHECK_INT(fake_nvll_osd_calls_on(FAKE_NVLL_OSD_PUT_TEXT, &surface_list[s]), NUM_BUFFERS);
+  }
+  CHECK_INT(fake_nvll_osd.maps, 0);
+  CHECK_INT(fake_pango.shown, 0);
+  CHECK(fake_gst_stop(element));
+  g_object_unref(element);
+  batch_gen_free(&gen);
+}
+
+// The clock is composed from one cached run per digit and ':', so it is
+// rasterized once whatever the time, and every digit is centred in a cell as
+// wide as the widest one, which '1' is narrower than in the fake font.
+static void test_clock_glyphs(void) {
+  batch_gen_config config = {.num_sources = NUM_SOURCES, .objects_per_frame = 1,
+                             .width = WIDTH, .height = HEIGHT, .seed = 5};
+  GstElement *element = new_element();
+  unsigned int advance = fake_pango_glyph_width('0', CLOCK_FONT_SIZE);
+  unsigned int s, x, failures = 0;
+  char expected[WIDTH];
+  const char *c;
+  batch_gen gen;
+
+  memset(expected, 0, sizeof(expected));
+  for (x = CLOCK_OFFSET, c = CLOCK_TEXT; *c; c++) {
+    unsigned int width = fake_pango_glyph_width(*c, CLOCK_FONT_SIZE);
+    unsigned int cell = *c == ':' ? width : advance;
+
+    // Every column of a glyph but its last.
+    memset(expected + x + (cell - width) / 2, 1, width - 1);
+    x += cell;
+  }
+
+  CHECK_INT(batch_gen_init(&gen, &config), 0);
+  for (s = 0; s < NUM_SOURCES; s++) {
+    gen.frames[s].batch_id = batch_ids[s];
+    gen.frames[s].obj_meta_list = NULL;
+  }
+  g_object_set(element, "process-mode", MODE_CPU, "surface-threads", NUM_SOURCES,
+               "cpu-threads", 1, "text-cache-size", 1 << 20, "display-clock", TRUE,
+               "clock-font-size", CLOCK_FONT_SIZE, "x-clock-offset", CLOCK_OFFSET,
+               "y-clock-offset", CLOCK_OFFSET, NULL);
+  run(element, &gen);
+  CHECK_INT(fake_gst.errors, 0);
+  CHECK_INT(fake_nvll_osd.calls_per_op[FAKE_NVLL_OSD_PUT_TEXT], 0);
+  // The ten digits are measured on the first buffer, and ':' looked up after.
+  CHECK_INT(fake_pango.shown, 11);
+  CHECK_INT(fake_pango.glyphs, 11);
+  CHECK_INT(stat(element, "text-cache-misses"), 11);
+  CHECK_INT(stat(element, "text-cache-hits"), NUM_BUFFERS * NUM_SOURCES * CLOCK_GLYPHS - 1);
+
+  for (s = 0; s < NUM_SOURCES; s++) {
+    for (x = 0; x < WIDTH; x++) {
+      int drawn = pixels[s][((CLOCK_OFFSET + CLOCK_FONT_SIZE / 2) * WIDTH + x) * 4] != 0;
+
+      failures += drawn != expected[x];
+    }
+  }
+  CHECK_INT(failures, 0);
+  CHECK(fake_gst_stop(element));
+  g_object_unref(element);
+  batch_gen_free(&gen);
+}
+
+// Only device 0 exists, so another stops the element from starting.
+static void test_gpu_id(void) {
+  GstElement *element = new_element();
+
+  g_object_set(element, "gpu-id", 1, NULL);
+  CHECK(!fake_gst_start(element));
+  CHECK_INT(fake_gst.errors, 1);
+  CHECK_STR(fake_gst.error.text, "Unable to set device");
+  CHECK_INT(fake_nvll_osd.contexts, 0);
+  g_object_unref(element);
+}
+
+int main(void) {
+  setenv("TZ", "UTC", 1);
+  tzset();
+  CHECK(fake_gst_load_plugin(&gst_plugin_nvdsgst_dsosdcoordrmq_desc));
+  test_routing();
+  test_surface_threads_gpu_mode();
+  test_cpu_render();
+  test_text_cache();
+  test_clock_on_unmapped_surfaces();
+  test_clock_glyphs();
+  test_gpu_id();
+  return check_done("dsosdcoordrmq");
+}
@@ -0,0 +1,145 @@
+// Copyright 2022, Kyota Tashiro, Mengheng Lee, and Latona Inc.
+// License MIT
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "check.h"
+#include "dsmeta-frame.h"
+
+// The samples in Outputs were written by the jansson DOM the writer replaced,
+// before sourceId and batchId were added to the schema.
+#define NUM_SAMPLES 5
+#define ADDED_KEYS "\"sourceId\":0,\"batchId\":0,"
+
+static const char *read_sample(int n) {
+  static char text[4096];
+  char path[512];
+  FILE *file;
+  size_t len;
+
+  snprintf(path, sizeof(path), "%s/output%d.json", OUTPUTS_DIR, n);
+  file = fopen(path, "r");
+  if (!file) {
+    fprintf(stderr, "cannot open %s\n", path);
+    return NULL;
+  }
+  len = fread(text, 1, sizeof(text) - 1, file);
+  fclose(file);
+  text[len] = '\0';
+  return text;
+}
+
+// The JSON at text without the whitespace between tokens.
+static void compact(const char *text, char *out, size_t size) {
+  size_t len = 0;
+  int in_string = 0;
+
+  for (; *text && len + 1 < size; text++) {
+    if (in_string) {
+      if (*text == '\\' && text[1])
+        out[len++] = *text++;
+      else if (*text == '"')
+        in_string = 0;
+    } else if (*text == '"') {
+      in_string = 1;
+    } else if (*text == ' ' || *text == '\n' || *text == '\r' || *text == '\t') {
+      continue;
+    }
+    out[len++] = *text;
+  }
+  out[len] = '\0';
+}
+
+// Compact JSON laid out as json_dumps with no flags does it, i.e. with a
+// space after each separator.
+static void dumps_layout(const char *text, char *out, size_t size) {
+  size_t len = 0;
+  int in_string = 0;
+
+  for (; *text && len + 2 < size; text++) {
+    out[len++] = *text;
+    if (in_string) {
+      if (*text == '\\' && text[1])
+        out[len++] = *++text;
+      else if (*text == '"')
+        in_string = 0;
+    } else if (*text == '"') {
+      in_string = 1;
+    } else if (*text == ':' || *text == ',') {
+      out[len++] = ' ';
+    }
+  }
+  out[len] = '\0';
+}
+
+static void test_sample(int n, dsmeta_frame *f, json_writer *w) {
+  static char label[64];
+  char golden[4096];
+  char written[4096];
+  char expected[4096];
+  char *added;
+  int frame_number;
+  int x[4], y[4];
+  const char *text = read_sample(n);
+  dsmeta_object *o;
+
+  CHECK(text != NULL);
+  if (!text)
+    return;
+  compact(text, golden, sizeof(golden));
+  CHECK_INT(sscanf(golden,
+                   "{\"frameNumber\":%d,\"inferredResult\":[{\"label\":\"%63[^\"]\","
+                   "\"coordinate\":{\"topLeft\":{\"x\":%d,\"y\":%d},"
+                   "\"topRight\":{\"x\":%d,\"y\":%d},\"bottomLeft\":{\"x\":%d,\"y\":%d},"
+                   "\"bottomRight\":{\"x\":%d,\"y\":%d}}}]}",
+                   &frame_number, label, &x[0], &y[0], &x[1], &y[1], &x[2], &y[2], &x[3],
+                   &y[3]),
+            10);
+
+  dsmeta_frame_begin(f, 0, frame_number, 0, DSMETA_BIN_NO_PTS, 1);
+  o = dsmeta_frame_add_object(f);
+  o->object_id = DSMETA_NO_OBJECT_ID;
+  o->class_id = 2;
+  o->label = label;
+  o->label_json = NULL;
+  o->left = (float) x[0];
+  o->top = (float) y[0];
+  o->width = (float) (x[1] - x[0]);
+  o->height = (float) (y[2] - y[0]);
+  dsmeta_frame_build_json(f, w);
+  CHECK(!w->error);
+  if (w->error)
+    return;
+
+  // Byte for byte what json_dumps gave, with the two keys added since.
+  compact(check_text(w->buf, w->len), written, sizeof(written));
+  dumps_layout(written, expected, sizeof(expected));
+  CHECK_STR(check_text(w->buf, w->len), expected);
+  added = strstr(written, ADDED_KEYS);
+  CHECK(added != NULL);
+  if (added)
+    memmove(added, added + strlen(ADDED_KEYS), strlen(added + strlen(ADDED_KEYS)) + 1);
+  CHECK_STR(written, golden);
+}
+
+int main(void) {
+  dsmeta_frame f;
+  json_writer w;
+  char *buf;
+  int n;
+
+  dsmeta_frame_init(&f, 1);
+  json_writer_init(&w);
+  for (n = 1; n <= NUM_SAMPLES; n++)
+    test_sample(n, &f, &w);
+
+  // Writing the samples again reuses the buffer.
+  buf = w.buf;
+  for (n = 1; n <= NUM_SAMPLES; n++)
+    test_sample(n, &f, &w);
+  CHECK(w.buf == buf);
+
+  json_writer_free(&w);
+  dsmeta_frame_free(&f);
+  return check_done("json-golden");
+}
@@ -0,0 +1,114 @@
+// Copyright 2022, Kyota Tashiro, Mengheng Lee, and Latona Inc.
+// License MIT
+
+#include <limits.h>
+#include "check.h"
+#include "json-writer.h"
+
+// The document as a string, NULL when the writer failed.
+static const char *text(const json_writer *w) {
+  return w->error ? NULL : check_text(w->buf, w->len);
+}
+
+// Separators and nesting follow json_dumps(root, 0).
+static void test_layout(void) {
+  json_writer w;
+
+  json_writer_init(&w);
+  json_writer_begin_object(&w);
+  json_writer_key(&w, "a");
+  json_writer_int(&w, 1);
+  json_writer_key(&w, "b");
+  json_writer_begin_array(&w);
+  json_writer_int(&w, -2);
+  json_writer_bool(&w, 1);
+  json_writer_begin_object(&w);
+  json_writer_end_object(&w);
+  json_writer_begin_array(&w);
+  json_writer_end_array(&w);
+  json_writer_bool(&w, 0);
+  json_writer_end_array(&w);
+  json_writer_key(&w, "c");
+  json_writer_raw(&w, "\"raw\"", 5);
+  json_writer_end_object(&w);
+  CHECK_STR(text(&w), "{\"a\": 1, \"b\": [-2, true, {}, [], false], \"c\": \"raw\"}");
+  json_writer_free(&w);
+}
+
+static void test_integers(void) {
+  json_writer w;
+
+  json_writer_init(&w);
+  json_writer_begin_array(&w);
+  json_writer_int(&w, 0);
+  json_writer_int(&w, 9);
+  json_writer_int(&w, 10);
+  json_writer_int(&w, 99);
+  json_writer_int(&w, 100);
+  json_writer_int(&w, -7);
+  json_writer_int(&w, LLONG_MAX);
+  json_writer_int(&w, LLONG_MIN);
+  json_writer_end_array(&w);
+  CHECK_STR(text(&w), "[0, 9, 10, 99, 100, -7, 9223372036854775807, -9223372036854775808]");
+  json_writer_free(&w);
+}
+
+static void test_escaping(void) {
+  json_writer w;
+
+  json_writer_init(&w);
+  json_writer_begin_array(&w);
+  json_writer_string(&w, "say \"hi\"\\ \b\f\n\r\t\x01\x1f");
+  json_writer_string(&w, "\xe4\xba\xba");
+  json_writer_string(&w, "");
+  json_writer_end_array(&w);
+  CHECK_STR(text(&w), "[\"say \\\"hi\\\"\\\\ \\b\\f\\n\\r\\t\\u0001\\u001f\", \"\xe4\xba\xba\", \"\"]");
+  json_writer_free(&w);
+}
+
+// Once the buffer has grown to a document, writing it again allocates nothing.
+static void test_reuse(void) {
+  json_writer w;
+  unsigned long grows;
+  int i, round;
+
+  json_writer_init(&w);
+  for (round = 0; round < 2; round++) {
+    json_writer_reset(&w);
+    json_writer_begin_array(&w);
+    for (i = 0; i < 1000; i++)
+      json_writer_string(&w, "detection");
+    json_writer_end_array(&w);
+    if (round == 0)
+      grows = w.grows;
+  }
+  CHECK(grows > 0);
+  CHECK_INT(w.grows, grows);
+  CHECK_INT(w.depth, 0);
+  CHECK_INT(w.error, 0);
+  json_writer_free(&w);
+}
+
+static void test_depth_limit(void) {
+  json_writer w;
+  int i;
+
+  json_writer_init(&w);
+  for (i = 0; i < JSON_WRITER_MAX_DEPTH; i++)
+    json_writer_begin_array(&w);
+  CHECK_INT(w.error, 0);
+  json_writer_begin_array(&w);
+  CHECK_INT(w.error, 1);
+  json_writer_reset(&w);
+  CHECK_INT(w.error, 0);
+  json_writer_free(&w);
+}
+
+int main(void) {
+  test_layout();
+  test_integers();
+  test_escaping();
+  test_reuse();
+  test_depth_limit();
+  return check_done("json-writer");
+}
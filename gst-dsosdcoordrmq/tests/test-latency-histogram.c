@@ -0,0 +1,152 @@
+// Copyright 2022, Kyota Tashiro, Mengheng Lee, and Latona Inc.
+// License MIT
+
+#include "check.h"
+#include "latency-histogram.h"
+
+// Upper bound of the bucket ns falls into, read back as the median of ns and
+// a far larger sample that keeps the maximum from clamping it.
+static uint64_t bucket_upper_of(uint64_t ns) {
+  static latency_histogram h;
+  latency_summary s;
+
+  latency_histogram_init(&h);
+  latency_histogram_record(&h, ns);
+  latency_histogram_record(&h, UINT64_MAX);
+  latency_histogram_summarize(&h, &s);
+  return s.p50_ns;
+}
+
+// Below 32 ns every value has its own bucket. Past that, each power of two
+// 2^k is split into 16 buckets of 2^(k-4).
+static void test_bucket_boundaries(void) {
+  unsigned int failures = 0;
+  uint64_t v;
+  int k;
+
+  for (v = 0; v < 32; v++)
+    failures += bucket_upper_of(v) != v;
+  CHECK_INT(failures, 0);
+  CHECK_INT(bucket_upper_of(32), 33);
+  CHECK_INT(bucket_upper_of(33), 33);
+  CHECK_INT(bucket_upper_of(34), 35);
+  CHECK_INT(bucket_upper_of(1000), 1023);
+  CHECK_INT(bucket_upper_of(1024), 1087);
+
+  for (k = 5; k < 63; k++) {
+    uint64_t low = (uint64_t) 1 << k;
+    uint64_t width = low >> LATENCY_HISTOGRAM_SUB_BITS;
+    unsigned int sub;
+
+    for (sub = 0; sub < LATENCY_HISTOGRAM_SUB_BUCKETS; sub++) {
+      uint64_t first = low + sub * width;
+      uint64_t last = first + width - 1;
+
+      failures += bucket_upper_of(first) != last;
+      failures += bucket_upper_of(last) != last;
+    }
+  }
+  CHECK_INT(failures, 0);
+  // The top bucket reaches the end of the range.
+  {
+    static latency_histogram h;
+    latency_summary s;
+
+    latency_histogram_init(&h);
+    latency_histogram_record(&h, UINT64_MAX);
+    latency_histogram_record(&h, UINT64_MAX - 1);
+    latency_histogram_summarize(&h, &s);
+    CHECK(s.p50_ns == UINT64_MAX);
+    CHECK(s.max_ns == UINT64_MAX);
+  }
+}
+
+// Percentiles of 1..n ns are at or above the true value and within 1/16 of
+// it, and never above the maximum.
+static void test_percentiles(void) {
+  static const uint64_t sizes[] = {1, 2, 10, 100, 1000, 12345, 100000};
+  static latency_histogram h;
+  latency_summary s;
+  unsigned int i;
+  uint64_t v;
+
+  for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+    uint64_t n = sizes[i];
+    uint64_t p50 = (n * 50 + 99) / 100;
+    uint64_t p90 = (n * 90 + 99) / 100;
+    uint64_t p99 = (n * 99 + 99) / 100;
+
+    latency_histogram_init(&h);
+    for (v = 1; v <= n; v++)
+      latency_histogram_record(&h, v);
+    latency_histogram_summarize(&h, &s);
+    CHECK_INT(s.count, n);
+    CHECK(s.sum_ns == n * (n + 1) / 2);
+    CHECK(s.mean_ns == (n + 1) / 2);
+    CHECK(s.max_ns == n);
+    CHECK(s.p50_ns >= p50 && s.p50_ns <= p50 + p50 / 16);
+    CHECK(s.p90_ns >= p90 && s.p90_ns <= p90 + p90 / 16);
+    CHECK(s.p99_ns >= p99 && s.p99_ns <= p99 + p99 / 16);
+    CHECK(s.p99_ns <= s.max_ns);
+  }
+
+  // p99 of 100 samples is the 99th, not the 100th.
+  latency_histogram_init(&h);
+  for (v = 0; v < 99; v++)
+    latency_histogram_record(&h, 10);
+  latency_histogram_record(&h, 1000000);
+  latency_histogram_summarize(&h, &s);
+  CHECK_INT(s.p99_ns, 10);
+  CHECK_INT(s.max_ns, 1000000);
+}
+
+// A percentile that falls on 0 ns stays 0 rather than being taken for one not
+// found yet and replaced by a later bucket.
+static void test_zero_percentiles(void) {
+  static latency_histogram h;
+  latency_summary s;
+  int i;
+
+  latency_histogram_init(&h);
+  for (i = 0; i < 95; i++)
+    latency_histogram_record(&h, 0);
+  for (i = 0; i < 5; i++)
+    latency_histogram_record(&h, 5000);
+  latency_histogram_summarize(&h, &s);
+  CHECK_INT(s.p50_ns, 0);
+  CHECK_INT(s.p90_ns, 0);
+  CHECK(s.p99_ns >= 5000 && s.p99_ns <= 5000 + 5000 / 16);
+  CHECK_INT(s.mean_ns, 250);
+
+  latency_histogram_init(&h);
+  latency_histogram_summarize(&h, &s);
+  CHECK_INT(s.count, 0);
+  CHECK_INT(s.mean_ns, 0);
+  CHECK_INT(s.p50_ns, 0);
+  CHECK_INT(s.p99_ns, 0);
+  CHECK_INT(s.max_ns, 0);
+}
+
+// record_since records the elapsed time it returns.
+static void test_record_since(void) {
+  static latency_histogram h;
+  latency_summary s;
+  uint64_t start = latency_now_ns();
+  uint64_t elapsed;
+
+  latency_histogram_init(&h);
+  elapsed = latency_histogram_record_since(&h, start);
+  latency_histogram_summarize(&h, &s);
+  CHECK_INT(s.count, 1);
+  CHECK(s.sum_ns == elapsed);
+  CHECK(s.max_ns == elapsed);
+  CHECK(latency_now_ns() >= start + elapsed);
+}
+
+int main(void) {
+  test_bucket_boundaries();
+  test_percentiles();
+  test_zero_percentiles();
+  test_record_since();
+  return check_done("latency-histogram");
+}
@@ -0,0 +1,196 @@
+// Copyright 2022, Kyota Tashiro, Mengheng Lee, and Latona Inc.
+// License MIT
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "check.h"
+#include "metrics-server.h"
+
+// Enough samples to grow the text past its first 4KB.
+#define PADDING_SAMPLES 300
+
+static atomic_ulong published;
+static pthread_t main_thread;
+static atomic_int renders;
+static atomic_int renders_off_main;
+
+// What the publish path exports, read from atomics as the element does.
+static void render(metrics_text *t, void *user_data) {
+  int i;
+
+  atomic_fetch_add(&renders, 1);
+  if (!pthread_equal(pthread_self(), main_thread))
+    atomic_fetch_add(&renders_off_main, 1);
+  metrics_text_family(t, "dsmetarmq_published_total", "counter", "Frames published.");
+  metrics_text_sample(t, "dsmetarmq_published_total", user_data,
+                      (double) atomic_load(&published));
+  metrics_text_family(t, "dsmetarmq_stage_seconds", "summary", "Stage latency.");
+  metrics_text_sample(t, "dsmetarmq_stage_seconds", "stage=\"json\",quantile=\"0.99\"",
+                      0.000125);
+  metrics_text_sample(t, "dsmetarmq_stage_seconds_count", "stage=\"json\"", 12345678901.0);
+  metrics_text_family(t, "dsmetarmq_padding", "gauge", "Grows the text.");
+  for (i = 0; i < PADDING_SAMPLES; i++)
+    metrics_text_sample(t, "dsmetarmq_padding", NULL, i);
+}
+
+// Sends request to the server and returns the whole response, NUL
+// terminated, or NULL when the server could not be reached.
+static char *get(int port, const char *request) {
+  struct sockaddr_in addr;
+  size_t len = 0;
+  size_t cap = 1 << 16;
+  char *response = malloc(cap);
+  ssize_t n;
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons((uint16_t) port);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (fd < 0 || !response || connect(fd, (struct sockaddr *) &addr, sizeof(addr)) < 0 ||
+      send(fd, request, strlen(request), MSG_NOSIGNAL) < 0) {
+    if (fd >= 0)
+      close(fd);
+    free(response);
+    return NULL;
+  }
+  while (len < cap - 1 && (n = recv(fd, response + len, cap - 1 - len, 0)) > 0)
+    len += (size_t) n;
+  response[len] = '\0';
+  close(fd);
+  return response;
+}
+
+static const char *body_of(const char *response) {
+  const char *body = strstr(response, "\r\n\r\n");
+
+  return body ? body + 4 : NULL;
+}
+
+// Every line is a # HELP or # TYPE comment or a sample of the family last
+// typed, as Prometheus parses the text format. Returns the samples.
+static int check_exposition(const char *text) {
+  char family[128] = "";
+  char name[128];
+  const char *line;
+  const char *end;
+  int samples = 0;
+
+  for (line = text; *line; line = end + 1) {
+    char value[64];
+    char *rest;
+    const char *p = line;
+    size_t name_len;
+
+    end = strchr(line, '\n');
+    CHECK(end != NULL);
+    if (!end)
+      break;
+    if (strncmp(line, "# TYPE ", 7) == 0) {
+      CHECK(sscanf(line, "# TYPE %127s", family) == 1);
+      continue;
+    }
+    if (strncmp(line, "# HELP ", 7) == 0)
+      continue;
+    while (p < end && *p != '{' && *p != ' ')
+      p++;
+    name_len = (size_t) (p - line);
+    CHECK(name_len > 0 && name_len < sizeof(name));
+    if (name_len == 0 || name_len >= sizeof(name))
+      continue;
+    memcpy(name, line, name_len);
+    name[name_len] = '\0';
+    CHECK(strncmp(name, family, strlen(family)) == 0 && family[0]);
+    if (*p == '{') {
+      p = memchr(p, '}', (size_t) (end - p));
+      CHECK(p != NULL);
+      if (!p)
+        continue;
+      p++;
+    }
+    CHECK(*p == ' ');
+    CHECK(sscanf(p, " %63s", value) == 1);
+    strtod(value, &rest);
+    CHECK(rest != value && *rest == '\0');
+    samples++;
+  }
+  return samples;
+}
+
+static void test_scrape(void) {
+  metrics_server srv = {0};
+  char *response;
+  const char *body;
+  size_t content_length = 0;
+  const char *header;
+
+  main_thread = pthread_self();
+  atomic_store(&published, 42);
+  CHECK_INT(metrics_server_start(&srv, 0, render, "element=\"dsmetarmq0\""), 0);
+  CHECK(srv.port > 0);
+
+  response = get(srv.port, "GET /metrics HTTP/1.1\r\nHost: localhost\r\n\r\n");
+  CHECK(response != NULL);
+  if (response) {
+    CHECK(strncmp(response, "HTTP/1.0 200 OK\r\n", 17) == 0);
+    CHECK(strstr(response, "Content-Type: text/plain; version=0.0.4") != NULL);
+    header = strstr(response, "Content-Length: ");
+    CHECK(header && sscanf(header, "Content-Length: %zu", &content_length) == 1);
+    body = body_of(response);
+    CHECK(body && strlen(body) == content_length && content_length > 4096);
+    if (body) {
+      CHECK_INT(check_exposition(body), 3 + PADDING_SAMPLES);
+      CHECK(strstr(body, "# TYPE dsmetarmq_published_total counter\n") != NULL);
+      CHECK(strstr(body, "dsmetarmq_published_total{element=\"dsmetarmq0\"} 42\n") != NULL);
+      CHECK(strstr(body, "dsmetarmq_stage_seconds_count{stage=\"json\"} 12345678901\n") !=
+            NULL);
+    }
+    free(response);
+  }
+
+  // Every scrape renders the counters as they are now.
+  atomic_store(&published, 43);
+  response = get(srv.port, "GET / HTTP/1.0\r\n\r\n");
+  CHECK(response && strstr(response, "dsmetarmq_published_total{element=\"dsmetarmq0\"} 43\n"));
+  free(response);
+
+  response = get(srv.port, "GET /other HTTP/1.0\r\n\r\n");
+  CHECK(response && strncmp(response, "HTTP/1.0 404 Not Found\r\n", 24) == 0);
+  CHECK(response && body_of(response) && !*body_of(response));
+  free(response);
+  response = get(srv.port, "POST /metrics HTTP/1.0\r\n\r\n");
+  CHECK(response && strncmp(response, "HTTP/1.0 405 Method Not Allowed\r\n", 33) == 0);
+  free(response);
+
+  metrics_server_stop(&srv);
+  CHECK_INT(atomic_load(&renders), 2);
+  CHECK_INT(atomic_load(&renders_off_main), 2);
+}
+
+// A port in use is reported instead of being shared, and a stopped server
+// releases its port.
+static void test_port_in_use(void) {
+  metrics_server srv = {0};
+  metrics_server other = {0};
+  int port;
+
+  CHECK_INT(metrics_server_start(&srv, 0, render, NULL), 0);
+  port = srv.port;
+  CHECK_INT(metrics_server_start(&other, port, render, NULL), -1);
+  CHECK(!other.started);
+  metrics_server_stop(&srv);
+  CHECK(get(port, "GET /metrics HTTP/1.0\r\n\r\n") == NULL);
+  CHECK_INT(metrics_server_start(&other, port, render, NULL), 0);
+  metrics_server_stop(&other);
+}
+
+int main(void) {
+  test_scrape();
+  test_port_in_use();
+  return check_done("metrics-server");
+}
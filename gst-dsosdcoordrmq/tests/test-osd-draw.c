@@ -0,0 +1,268 @@
+// Copyright 2022, Kyota Tashiro, Mengheng Lee, and Latona Inc.
+// License MIT
+
+#include <stdlib.h>
+#include "check.h"
+#include "batch-gen.h"
+#include "fake-nvll-osd.h"
+#include "osd-draw.h"
+
+#define NUM_SOURCES 4
+// Well past the 1024 primitives the element used to flush at.
+#define NUM_OBJECTS 1500
+#define DISPLAY_ELEMENTS 16
+#define WIDTH 320
+#define HEIGHT 240
+
+static const fake_nvll_osd_op ops[OSD_DRAW_NUM_TYPES] = {
+  [OSD_DRAW_RECTANGLES] = FAKE_NVLL_OSD_RECTANGLES,
+  [OSD_DRAW_SEGMENT_MASKS] = FAKE_NVLL_OSD_SEGMENT_MASKS,
+  [OSD_DRAW_PUT_TEXT] = FAKE_NVLL_OSD_PUT_TEXT,
+  [OSD_DRAW_LINES] = FAKE_NVLL_OSD_LINES,
+  [OSD_DRAW_ARROWS] = FAKE_NVLL_OSD_ARROWS,
+  [OSD_DRAW_CIRCLES] = FAKE_NVLL_OSD_CIRCLES,
+};
+
+static const osd_draw_options all = {
+  .draw_bbox = 1, .draw_mask = 1, .draw_text = 1, .show_clock = 0};
+
+static NvBufSurfaceParams surface_list[NUM_SOURCES];
+static NvBufSurface surface = {
+  .batchSize = NUM_SOURCES, .numFilled = NUM_SOURCES, .surfaceList = surface_list};
+static uint8_t pixels[NUM_SOURCES][WIDTH * HEIGHT * 4];
+static osd_batch batches[NUM_SOURCES];
+static osd_draw_result results[NUM_SOURCES];
+
+// Types the tiled renderer was handed, by surface.
+static unsigned int cpu_calls[NUM_SOURCES][OSD_DRAW_NUM_TYPES];
+static int cpu_fail = OSD_DRAW_NUM_TYPES;
+
+static int cpu_draw(osd_draw_type type, const osd_batch *b, const cpu_render_target *target,
+             void *user_data) {
+  unsigned int s = (unsigned int) (uintptr_t) user_data;
+
+  CHECK(b == &batches[s]);
+  // Only ever handed the mapped surface.
+  CHECK(target->pixels == pixels[s] && surface_list[s].mappedAddr.addr[0] == pixels[s]);
+  CHECK_INT(target->width, WIDTH);
+  CHECK_INT(target->pitch, WIDTH * 4);
+  cpu_calls[s][type]++;
+  return (int) type == cpu_fail ? -1 : 0;
+}
+
+static void init_surfaces(void) {
+  unsigned int s;
+
+  for (s = 0; s < NUM_SOURCES; s++) {
+    surface_list[s] = (NvBufSurfaceParams) {
+      .width = WIDTH, .height = HEIGHT, .pitch = WIDTH * 4,
+      .colorFormat = NVBUF_COLOR_FORMAT_RGBA, .dataPtr = pixels[s],
+      .planeParams = {.num_planes = 1, .pitch = {WIDTH * 4}}};
+    osd_batch_init(&batches[s]);
+  }
+}
+
+// Collects a buffer as the element does, each frame into the batch of its
+// surface, and draws every surface with its own context.
+static void draw_buffer(NvDsBatchMeta *batch, const osd_draw_options *options) {
+  NvDsMetaList *l;
+  unsigned int s;
+
+  for (s = 0; s < NUM_SOURCES; s++)
+    osd_batch_reset(&batches[s]);
+  for (l = batch ? batch->frame_meta_list : NULL; l; l = l->next) {
+    const NvDsFrameMeta *frame_meta = l->data;
+
+    osd_draw_collect_frame(&batches[frame_meta->batch_id], frame_meta, options, NULL, NULL);
+  }
+  memset(cpu_calls, 0, sizeof(cpu_calls));
+  for (s = 0; s < NUM_SOURCES; s++)
+    osd_draw_surface(&batches[s], &surface, s, (void *) (uintptr_t) (s + 1), MODE_CPU,
+                     options, cpu_draw, (void *) (uintptr_t) s, &results[s]);
+}
+
+// Whatever the scene holds, every surface takes one call per primitive type,
+// handed all of its primitives, and the batches stop growing once they have
+// seen the busiest buffer.
+static void test_one_call_per_type(void) {
+  batch_gen_config config = {
+    .num_sources = NUM_SOURCES, .objects_per_frame = NUM_OBJECTS, .width = 1920,
+    .height = 1080, .tracked = 1, .mask_size = 8, .display_elements = DISPLAY_ELEMENTS,
+    .seed = 3};
+  const unsigned int expected[OSD_DRAW_NUM_TYPES] = {
+    NUM_OBJECTS + DISPLAY_ELEMENTS, NUM_OBJECTS, NUM_OBJECTS + DISPLAY_ELEMENTS,
+    DISPLAY_ELEMENTS, DISPLAY_ELEMENTS, DISPLAY_ELEMENTS};
+  batch_gen g;
+  unsigned long grows = 0;
+  unsigned int buffer, s, type, i;
+
+  CHECK_INT(batch_gen_init(&g, &config), 0);
+  for (buffer = 0; buffer < 3; buffer++) {
+    fake_nvll_osd_reset();
+    draw_buffer(batch_gen_next(&g), &all);
+
+    CHECK_INT(fake_nvll_osd.num_calls, NUM_SOURCES * OSD_DRAW_NUM_TYPES);
+    for (s = 0; s < NUM_SOURCES; s++) {
+      for (type = 0; type < OSD_DRAW_NUM_TYPES; type++) {
+        CHECK_INT(fake_nvll_osd_calls_on(ops[type], &surface_list[s]), 1);
+        CHECK(results[s].drawn[type]);
+        CHECK_INT(results[s].primitives[type], expected[type]);
+      }
+      CHECK_INT(results[s].failed, OSD_DRAW_NUM_TYPES);
+      CHECK_INT(batches[s].dropped, 0);
+    }
+    for (i = 0; i < fake_nvll_osd.num_calls; i++) {
+      const fake_nvll_osd_call *call = &fake_nvll_osd.calls[i];
+      unsigned int on = (unsigned int) (call->buf_ptr - surface_list);
+
+      CHECK(on < NUM_SOURCES);
+      // In draw order, on the context of the surface's thread.
+      CHECK(call->op == ops[i % OSD_DRAW_NUM_TYPES]);
+      CHECK(call->context == (void *) (uintptr_t) (on + 1));
+      CHECK_INT(call->mode, MODE_CPU);
+      CHECK_INT(call->primitives, expected[i % OSD_DRAW_NUM_TYPES]);
+    }
+    // Nothing was mapped without the tiled renderer.
+    CHECK_INT(fake_nvll_osd.maps, 0);
+    if (buffer == 0)
+      for (s = 0; s < NUM_SOURCES; s++)
+        grows += batches[s].grows;
+  }
+  for (s = 0; s < NUM_SOURCES; s++)
+    grows -= batches[s].grows;
+  CHECK_INT(grows, 0);
+  batch_gen_free(&g);
+}
+
+// Types left out by the options or with nothing to draw take no call; the
+// clock alone still takes the text call.
+static void test_options(void) {
+  batch_gen_config config = {
+    .num_sources = NUM_SOURCES, .objects_per_frame = 10, .width = 1920, .height = 1080,
+    .mask_size = 8, .seed = 4};
+  osd_draw_options options = all;
+  batch_gen g;
+  unsigned int s;
+
+  CHECK_INT(batch_gen_init(&g, &config), 0);
+  options.draw_bbox = 0;
+  options.draw_mask = 0;
+  fake_nvll_osd_reset();
+  draw_buffer(batch_gen_next(&g), &options);
+  CHECK_INT(fake_nvll_osd.calls_per_op[FAKE_NVLL_OSD_PUT_TEXT], NUM_SOURCES);
+  CHECK_INT(fake_nvll_osd.num_calls, NUM_SOURCES);
+  CHECK_INT(batches[0].num_rects, 0);
+  CHECK_INT(batches[0].num_masks, 0);
+
+  options = all;
+  options.draw_text = 0;
+  options.show_clock = 1;
+  fake_nvll_osd_reset();
+  draw_buffer(batch_gen_next(&g), &options);
+  CHECK_INT(fake_nvll_osd.calls_per_op[FAKE_NVLL_OSD_PUT_TEXT], 0);
+  CHECK_INT(fake_nvll_osd.num_calls, NUM_SOURCES * 2);
+
+  fake_nvll_osd_reset();
+  draw_buffer(NULL, &all);
+  CHECK_INT(fake_nvll_osd.num_calls, 0);
+  options = all;
+  options.show_clock = 1;
+  draw_buffer(NULL, &options);
+  CHECK_INT(fake_nvll_osd.num_calls, NUM_SOURCES);
+  for (s = 0; s < NUM_SOURCES; s++) {
+    CHECK_INT(fake_nvll_osd_calls_on(FAKE_NVLL_OSD_PUT_TEXT, &surface_list[s]), 1);
+    CHECK_INT(results[s].primitives[OSD_DRAW_PUT_TEXT], 0);
+  }
+  batch_gen_free(&g);
+}
+
+// A failed call is reported and nothing more is drawn on its surface.
+static void test_failure(void) {
+  batch_gen_config config = {
+    .num_sources = NUM_SOURCES, .objects_per_frame = 10, .width = 1920, .height = 1080,
+    .display_elements = 2, .seed = 5};
+  batch_gen g;
+  unsigned int s;
+
+  CHECK_INT(batch_gen_init(&g, &config), 0);
+  fake_nvll_osd_reset();
+  fake_nvll_osd.fail_op = FAKE_NVLL_OSD_LINES;
+  draw_buffer(batch_gen_next(&g), &all);
+  for (s = 0; s < NUM_SOURCES; s++) {
+    CHECK_INT(results[s].failed, OSD_DRAW_LINES);
+    CHECK(results[s].drawn[OSD_DRAW_PUT_TEXT] && !results[s].drawn[OSD_DRAW_LINES]);
+    CHECK_INT(fake_nvll_osd_calls_on(FAKE_NVLL_OSD_ARROWS, &surface_list[s]), 0);
+    CHECK_INT(fake_nvll_osd_calls_on(FAKE_NVLL_OSD_CIRCLES, &surface_list[s]), 0);
+  }
+  fake_nvll_osd_reset();
+  batch_gen_free(&g);
+}
+
+// With the tiled renderer boxes, masks, lines and, with the text cache, text
+// are drawn on the mapped surface, and nvll_osd draws the rest after it is
+// unmapped again.
+static void test_cpu_render(void) {
+  batch_gen_config config = {
+    .num_sources = NUM_SOURCES, .objects_per_frame = 50, .width = WIDTH, .height = HEIGHT,
+    .mask_size = 8, .display_elements = 2, .seed = 6};
+  osd_draw_options options = all;
+  batch_gen g;
+  unsigned int s, type;
+
+  CHECK_INT(batch_gen_init(&g, &config), 0);
+  options.cpu_render = 1;
+  options.text_cache = 1;
+  fake_nvll_osd_reset();
+  draw_buffer(batch_gen_next(&g), &options);
+  for (s = 0; s < NUM_SOURCES; s++) {
+    for (type = 0; type < OSD_DRAW_NUM_TYPES; type++) {
+      int cpu = type <= OSD_DRAW_LINES;
+
+      CHECK_INT(cpu_calls[s][type], cpu);
+      CHECK_INT(fake_nvll_osd_calls_on(ops[type], &surface_list[s]), !cpu);
+      CHECK(results[s].drawn[type]);
+    }
+    CHECK(surface_list[s].mappedAddr.addr[0] == NULL);
+  }
+  CHECK_INT(fake_nvll_osd.maps, NUM_SOURCES);
+  CHECK_INT(fake_nvll_osd.unmaps, NUM_SOURCES);
+
+  // Without the text cache nvll_osd draws the text in between, so the
+  // surface is mapped again for the lines.
+  options.text_cache = 0;
+  fake_nvll_osd_reset();
+  draw_buffer(batch_gen_next(&g), &options);
+  for (s = 0; s < NUM_SOURCES; s++) {
+    CHECK_INT(cpu_calls[s][OSD_DRAW_RECTANGLES], 1);
+    CHECK_INT(cpu_calls[s][OSD_DRAW_PUT_TEXT], 0);
+    CHECK_INT(cpu_calls[s][OSD_DRAW_LINES], 1);
+    CHECK_INT(fake_nvll_osd_calls_on(FAKE_NVLL_OSD_PUT_TEXT, &surface_list[s]), 1);
+    CHECK_INT(fake_nvll_osd_calls_on(FAKE_NVLL_OSD_LINES, &surface_list[s]), 0);
+  }
+  CHECK_INT(fake_nvll_osd.maps, 2 * NUM_SOURCES);
+  CHECK_INT(fake_nvll_osd.unmaps, 2 * NUM_SOURCES);
+
+  // A failure of the renderer stops the surface and still unmaps it.
+  cpu_fail = OSD_DRAW_SEGMENT_MASKS;
+  fake_nvll_osd_reset();
+  draw_buffer(batch_gen_next(&g), &options);
+  cpu_fail = OSD_DRAW_NUM_TYPES;
+  for (s = 0; s < NUM_SOURCES; s++)
+    CHECK_INT(results[s].failed, OSD_DRAW_SEGMENT_MASKS);
+  CHECK_INT(fake_nvll_osd.num_calls, 0);
+  CHECK_INT(fake_nvll_osd.unmaps, NUM_SOURCES);
+  batch_gen_free(&g);
+}
+
+int main(void) {
+  unsigned int s;
+
+  init_surfaces();
+  test_one_call_per_type();
+  test_options();
+  test_failure();
+  test_cpu_render();
+  for (s = 0; s < NUM_SOURCES; s++)
+    osd_batch_free(&batches[s]);
+  return check_done("osd-draw");
+}
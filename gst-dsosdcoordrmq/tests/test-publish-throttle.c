@@ -0,0 +1,212 @@
+// Copyright 2022, Kyota Tashiro, Mengheng Lee, and Latona Inc.
+// License MIT
+
+#include "check.h"
+#include "publish-throttle.h"
+
+#define MS 1000000ull
+// Nanoseconds between frames of a 30 fps source.
+#define FRAME_NS 33333333ull
+
+// Admits frames of source_id from now_ns on, step_ns apart, and returns how
+// many got through.
+static int admit_frames(publish_throttle *t, uint32_t source_id, int frames, uint64_t now_ns,
+             uint64_t step_ns) {
+  int admitted = 0;
+  int i;
+
+  for (i = 0; i < frames; i++)
+    admitted += publish_throttle_admit(t, source_id, now_ns + i * step_ns);
+  return admitted;
+}
+
+// Every interval-th frame of each source goes out, counting from its first,
+// however the sources interleave.
+static void test_interval(void) {
+  publish_throttle t;
+  int expected[3] = {1, 0, 0};
+  int failures = 0;
+  int i;
+
+  publish_throttle_init(&t);
+  publish_throttle_configure(&t, 3, 0, 0, 64);
+  for (i = 0; i < 30; i++) {
+    failures += publish_throttle_admit(&t, 7, i * FRAME_NS) != expected[i % 3];
+    // A second source starting later keeps its own count.
+    if (i >= 1)
+      failures += publish_throttle_admit(&t, 8, i * FRAME_NS) != expected[(i - 1) % 3];
+  }
+  CHECK_INT(failures, 0);
+  CHECK_INT(t.skipped_interval, 20 + 19);
+  CHECK_INT(t.skipped_rate, 0);
+  CHECK_INT(t.skipped_backpressure, 0);
+
+  // An interval of 0 publishes everything, and configuring again restarts
+  // the count of every source.
+  publish_throttle_configure(&t, 0, 0, 0, 64);
+  CHECK_INT(admit_frames(&t, 7, 10, 0, FRAME_NS), 10);
+  publish_throttle_configure(&t, 2, 0, 0, 64);
+  CHECK_INT(publish_throttle_admit(&t, 7, 0), 1);
+  CHECK_INT(publish_throttle_admit(&t, 7, FRAME_NS), 0);
+  publish_throttle_free(&t);
+}
+
+// max_rate holds each source to its schedule: 10 fps out of 30 fps is every
+// third frame, jitter does not lower the rate, and a source coming back after
+// a pause is published at once.
+static void test_rate(void) {
+  publish_throttle t;
+  uint64_t now = 1000 * MS;
+  int admitted;
+  int i;
+
+  publish_throttle_init(&t);
+  publish_throttle_configure(&t, 1, 10.0, 0, 64);
+  CHECK_INT(admit_frames(&t, 0, 90, now, FRAME_NS), 30);
+  CHECK_INT(t.skipped_rate, 60);
+  CHECK_INT(admit_frames(&t, 1, 90, now, FRAME_NS), 30);
+
+  // Frames arriving 10 ms late every other time still make 10 per second.
+  publish_throttle_configure(&t, 1, 10.0, 0, 64);
+  admitted = 0;
+  for (i = 0; i < 300; i++)
+    admitted += publish_throttle_admit(&t, 0, now + i * 10 * MS + (i % 2) * 10 * MS);
+  CHECK(admitted >= 29 && admitted <= 31);
+
+  // After two seconds without frames the next one goes out, and the schedule
+  // starts again from it rather than catching up.
+  publish_throttle_configure(&t, 1, 10.0, 0, 64);
+  CHECK_INT(publish_throttle_admit(&t, 0, now), 1);
+  CHECK_INT(publish_throttle_admit(&t, 0, now + 2000 * MS), 1);
+  CHECK_INT(publish_throttle_admit(&t, 0, now + 2050 * MS), 0);
+  CHECK_INT(publish_throttle_admit(&t, 0, now + 2100 * MS), 1);
+
+  // The interval applies before the rate.
+  publish_throttle_configure(&t, 2, 10.0, 0, 64);
+  CHECK_INT(admit_frames(&t, 0, 90, now, FRAME_NS), 30);
+  publish_throttle_free(&t);
+}
+
+// The factor doubles each time the queue has stayed above three quarters of
+// its depth for PUBLISH_THROTTLE_ADJUST_NS, up to the maximum, and halves
+// back once it has stayed below a quarter.
+static void test_adaptive(void) {
+  publish_throttle t;
+  uint64_t now = 0;
+  unsigned int factor;
+
+  publish_throttle_init(&t);
+  publish_throttle_configure(&t, 1, 0, 1, 64);
+  CHECK_INT(t.high_water, 48);
+  CHECK_INT(t.low_water, 16);
+
+  publish_throttle_update(&t, 48, now);
+  CHECK_INT(t.factor, 1);
+  publish_throttle_update(&t, 60, now + PUBLISH_THROTTLE_ADJUST_NS - 1);
+  CHECK_INT(t.factor, 1);
+  now += PUBLISH_THROTTLE_ADJUST_NS;
+  publish_throttle_update(&t, 50, now);
+  CHECK_INT(t.factor, 2);
+  // Every frame but each second one is skipped for backpressure.
+  CHECK_INT(admit_frames(&t, 0, 8, now, FRAME_NS), 4);
+  CHECK_INT(t.skipped_backpressure, 4);
+
+  for (factor = 4; factor <= PUBLISH_THROTTLE_MAX_FACTOR; factor *= 2) {
+    publish_throttle_update(&t, 64, now + PUBLISH_THROTTLE_ADJUST_NS / 2);
+    CHECK_INT(t.factor, factor / 2);
+    now += PUBLISH_THROTTLE_ADJUST_NS;
+    publish_throttle_update(&t, 64, now);
+    CHECK_INT(t.factor, factor);
+  }
+  now += 10 * PUBLISH_THROTTLE_ADJUST_NS;
+  publish_throttle_update(&t, 64, now);
+  CHECK_INT(t.factor, PUBLISH_THROTTLE_MAX_FACTOR);
+
+  // Dipping between the watermarks restarts the wait.
+  publish_throttle_update(&t, 10, now);
+  publish_throttle_update(&t, 30, now + PUBLISH_THROTTLE_ADJUST_NS / 2);
+  publish_throttle_update(&t, 10, now + PUBLISH_THROTTLE_ADJUST_NS);
+  CHECK_INT(t.factor, PUBLISH_THROTTLE_MAX_FACTOR);
+  now += PUBLISH_THROTTLE_ADJUST_NS;
+
+  for (factor = PUBLISH_THROTTLE_MAX_FACTOR / 2; factor >= 1; factor /= 2) {
+    now += PUBLISH_THROTTLE_ADJUST_NS;
+    publish_throttle_update(&t, 16, now);
+    CHECK_INT(t.factor, factor);
+  }
+  now += 10 * PUBLISH_THROTTLE_ADJUST_NS;
+  publish_throttle_update(&t, 0, now);
+  CHECK_INT(t.factor, 1);
+  CHECK_INT(admit_frames(&t, 1, 8, now, FRAME_NS), 8);
+
+  // Configuring again starts over at a factor of 1.
+  publish_throttle_update(&t, 64, now);
+  publish_throttle_update(&t, 64, now + PUBLISH_THROTTLE_ADJUST_NS);
+  CHECK_INT(t.factor, 2);
+  publish_throttle_configure(&t, 1, 0, 1, 64);
+  CHECK_INT(t.factor, 1);
+  publish_throttle_free(&t);
+}
+
+// Without adaptive, or without a queue to watch, the depth changes nothing.
+static void test_adaptive_off(void) {
+  publish_throttle t;
+  uint64_t now = 0;
+  int i;
+
+  publish_throttle_init(&t);
+  publish_throttle_configure(&t, 1, 0, 0, 64);
+  for (i = 0; i < 10; i++, now += PUBLISH_THROTTLE_ADJUST_NS)
+    publish_throttle_update(&t, 64, now);
+  CHECK_INT(t.factor, 1);
+
+  // A depth of 0 would put both watermarks at 0, where an empty queue
+  // counts as full.
+  publish_throttle_configure(&t, 1, 0, 1, 0);
+  CHECK_INT(t.adaptive, 0);
+  for (i = 0; i < 10; i++, now += PUBLISH_THROTTLE_ADJUST_NS)
+    publish_throttle_update(&t, 0, now);
+  CHECK_INT(t.factor, 1);
+  CHECK_INT(admit_frames(&t, 0, 8, now, FRAME_NS), 8);
+
+  // The smallest queue still adapts.
+  publish_throttle_configure(&t, 1, 0, 1, 1);
+  publish_throttle_update(&t, 1, now);
+  publish_throttle_update(&t, 1, now + PUBLISH_THROTTLE_ADJUST_NS);
+  CHECK_INT(t.factor, 2);
+  publish_throttle_free(&t);
+}
+
+// Sources past the initial table are tracked separately, and the table is
+// reused after configure.
+static void test_sources(void) {
+  publish_throttle t;
+  size_t capacity;
+  uint32_t s;
+  int failures = 0;
+
+  publish_throttle_init(&t);
+  publish_throttle_configure(&t, 2, 0, 0, 64);
+  for (s = 0; s < 100; s++)
+    failures += publish_throttle_admit(&t, s, 0) != 1;
+  for (s = 0; s < 100; s++)
+    failures += publish_throttle_admit(&t, s, FRAME_NS) != 0;
+  CHECK_INT(failures, 0);
+  CHECK_INT(t.num_sources, 100);
+  capacity = t.capacity;
+  publish_throttle_configure(&t, 2, 0, 0, 64);
+  CHECK_INT(t.num_sources, 0);
+  for (s = 0; s < 100; s++)
+    publish_throttle_admit(&t, s, 0);
+  CHECK_INT(t.capacity, capacity);
+  publish_throttle_free(&t);
+}
+
+int main(void) {
+  test_interval();
+  test_rate();
+  test_adaptive();
+  test_adaptive_off();
+  test_sources();
+  return check_done("publish-throttle");
+}
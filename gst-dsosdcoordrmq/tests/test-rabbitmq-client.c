@@ -0,0 +1,374 @@
+// Copyright 2022, Kyota Tashiro, Mengheng Lee, and Latona Inc.
+// License MIT
+
+#include <stdio.h>
+#include <time.h>
+#include "check.h"
+#include "fake-amqp.h"
+#include "rabbitmq-client.h"
+
+// Longer than a few rounds of the reconnect backoff.
+#define RECONNECT_TIMEOUT_MS 5000
+
+static rabbitmq_cli connect_client(size_t replay_depth) {
+  return new_rabbitmq_client("localhost", 5672, "/", "guest", "guest", 0, replay_depth);
+}
+
+static void sleep_ms(int ms) {
+  struct timespec ts = {ms / 1000, (ms % 1000) * 1000000L};
+
+  nanosleep(&ts, NULL);
+}
+
+// Polls as the publisher thread does until the client is connected again.
+static int poll_until_connected(rabbitmq_cli *cli) {
+  int waited;
+
+  for (waited = 0; waited < RECONNECT_TIMEOUT_MS; waited += 10) {
+    if (rabbitmq_cli_poll(cli) == 0)
+      return 0;
+    sleep_ms(10);
+  }
+  return -1;
+}
+
+static int publish(rabbitmq_cli *cli, const char *routing_key, int n) {
+  char message[32];
+  int len = snprintf(message, sizeof(message), "message %d", n);
+
+  return rabbitmq_cli_publish(cli, "test", "text/plain", routing_key, message,
+                              (size_t) len, 1);
+}
+
+// Checks that the broker got messages first to first + count - 1, in order
+// and each once, starting at its index start.
+static void check_messages(size_t start, int first, int count) {
+  fake_amqp_message message;
+  char expected[32];
+  int n;
+
+  for (n = 0; n < count; n++) {
+    snprintf(expected, sizeof(expected), "message %d", first + n);
+    CHECK_INT(fake_amqp_get(start + (size_t) n, &message), 0);
+    CHECK_STR(check_text(message.body, message.len), expected);
+  }
+}
+
+// Messages published while the broker is unreachable are kept and go out in
+// order, ahead of newer ones, once the client gets through.
+static void test_replay_before_connect(void) {
+  rabbitmq_cli cli;
+  fake_amqp_message message;
+  int n;
+
+  fake_amqp_reset();
+  fake_amqp_set_up(0);
+  cli = connect_client(16);
+  CHECK_INT(cli.state, RABBITMQ_CLI_DISCONNECTED);
+  for (n = 0; n < 5; n++)
+    CHECK_INT(publish(&cli, NULL, n), RABBITMQ_CLI_BUFFERED);
+  CHECK_INT(cli.replay_count, 5);
+  CHECK_INT(fake_amqp_count(), 0);
+  CHECK_INT(cli.delivered, 0);
+
+  fake_amqp_set_up(1);
+  CHECK_INT(poll_until_connected(&cli), 0);
+  CHECK_INT(publish(&cli, NULL, 5), AMQP_STATUS_OK);
+  CHECK_INT(fake_amqp_count(), 6);
+  check_messages(0, 0, 6);
+  CHECK_INT(fake_amqp_get(0, &message), 0);
+  CHECK_STR(message.routing_key, "test");
+  CHECK_STR(message.content_type, "text/plain");
+  CHECK_INT(cli.replay_count, 0);
+  CHECK_INT(cli.connects, 1);
+  CHECK_INT(cli.dropped, 0);
+  CHECK_INT(cli.delivered, 6);
+  CHECK_INT(fake_amqp.queue_declares, 1);
+  rabbitmq_cli_close(&cli);
+}
+
+// A connection that drops mid-stream is re-established with the queue
+// declared again, and nothing is lost or sent twice.
+static void test_reconnect(void) {
+  rabbitmq_cli cli;
+  fake_amqp_message message;
+  int n;
+
+  fake_amqp_reset();
+  cli = connect_client(16);
+  CHECK_INT(cli.state, RABBITMQ_CLI_CONNECTED);
+  for (n = 0; n < 3; n++)
+    CHECK_INT(publish(&cli, "key", n), AMQP_STATUS_OK);
+
+  fake_amqp_set_up(0);
+  for (n = 3; n < 6; n++)
+    CHECK_INT(publish(&cli, "key", n), RABBITMQ_CLI_BUFFERED);
+  CHECK_INT(cli.state, RABBITMQ_CLI_DISCONNECTED);
+  CHECK_INT(cli.disconnects, 1);
+
+  fake_amqp_set_up(1);
+  CHECK_INT(poll_until_connected(&cli), 0);
+  CHECK_INT(publish(&cli, "key", 6), AMQP_STATUS_OK);
+  CHECK_INT(fake_amqp_count(), 7);
+  check_messages(0, 0, 7);
+  CHECK_INT(fake_amqp_get(2, &message), 0);
+  CHECK_INT(message.connection, 1);
+  CHECK_INT(fake_amqp_get(3, &message), 0);
+  CHECK_INT(message.connection, 2);
+  CHECK_STR(message.routing_key, "key");
+  CHECK_INT(cli.connects, 2);
+  CHECK_INT(fake_amqp.queue_declares, 2);
+  rabbitmq_cli_close(&cli);
+}
+
+// The connection breaking under a publish keeps that message too.
+static void test_break_during_publish(void) {
+  rabbitmq_cli cli;
+  fake_amqp_message message;
+  int n;
+
+  fake_amqp_reset();
+  cli = connect_client(16);
+  CHECK_INT(publish(&cli, NULL, 0), AMQP_STATUS_OK);
+  pthread_mutex_lock(&fake_amqp_lock);
+  fake_amqp.fail_after = 2;
+  pthread_mutex_unlock(&fake_amqp_lock);
+  for (n = 1; n < 5; n++)
+    publish(&cli, NULL, n);
+  CHECK_INT(poll_until_connected(&cli), 0);
+  CHECK_INT(fake_amqp_count(), 5);
+  check_messages(0, 0, 5);
+  CHECK_INT(fake_amqp_get(3, &message), 0);
+  CHECK_INT(message.connection, 2);
+  CHECK_INT(cli.disconnects, 1);
+  rabbitmq_cli_close(&cli);
+}
+
+// A full replay ring drops its oldest messages and counts them.
+static void test_replay_depth(void) {
+  rabbitmq_cli cli;
+  int n;
+
+  fake_amqp_reset();
+  fake_amqp_set_up(0);
+  cli = connect_client(3);
+  for (n = 0; n < 5; n++)
+    CHECK_INT(publish(&cli, NULL, n), RABBITMQ_CLI_BUFFERED);
+  CHECK_INT(cli.replay_count, 3);
+  CHECK_INT(cli.dropped, 2);
+
+  fake_amqp_set_up(1);
+  CHECK_INT(poll_until_connected(&cli), 0);
+  CHECK_INT(fake_amqp_count(), 3);
+  check_messages(0, 2, 3);
+  rabbitmq_cli_close(&cli);
+
+  // Without a replay ring, messages are dropped while disconnected.
+  fake_amqp_reset();
+  fake_amqp_set_up(0);
+  cli = connect_client(0);
+  CHECK_INT(publish(&cli, NULL, 0), -1);
+  CHECK_INT(cli.dropped, 1);
+  rabbitmq_cli_close(&cli);
+}
+
+// The preamble goes out first on every connection, replayed messages
+// included.
+static void test_preamble(void) {
+  rabbitmq_cli cli;
+  fake_amqp_message message;
+
+  fake_amqp_reset();
+  cli = connect_client(16);
+  CHECK_INT(rabbitmq_cli_set_preamble(&cli, "application/x-dsmeta", "labels", "dict", 4), 0);
+  CHECK_INT(publish(&cli, NULL, 0), AMQP_STATUS_OK);
+  fake_amqp_set_up(0);
+  CHECK_INT(publish(&cli, NULL, 1), RABBITMQ_CLI_BUFFERED);
+  fake_amqp_set_up(1);
+  CHECK_INT(poll_until_connected(&cli), 0);
+
+  CHECK_INT(fake_amqp_count(), 4);
+  CHECK_INT(fake_amqp_get(0, &message), 0);
+  CHECK_STR(check_text(message.body, message.len), "dict");
+  CHECK_STR(message.routing_key, "labels");
+  check_messages(1, 0, 1);
+  CHECK_INT(fake_amqp_get(2, &message), 0);
+  CHECK_STR(check_text(message.body, message.len), "dict");
+  CHECK_INT(message.connection, 2);
+  check_messages(3, 1, 1);
+  rabbitmq_cli_close(&cli);
+}
+
+// Polls until every message in flight is settled.
+static int poll_until_settled(rabbitmq_cli *cli) {
+  int waited;
+
+  for (waited = 0; waited < RECONNECT_TIMEOUT_MS; waited += 10) {
+    if (rabbitmq_cli_poll(cli) == 0 && cli->inflight_count == 0 && cli->replay_count == 0)
+      return 0;
+    sleep_ms(10);
+  }
+  return -1;
+}
+
+// Index of the first message with body "message n" from index start on, -1
+// when there is none.
+static long find_message(size_t start, int n) {
+  fake_amqp_message message;
+  char expected[32];
+  size_t i;
+
+  snprintf(expected, sizeof(expected), "message %d", n);
+  for (i = start; fake_amqp_get(i, &message) == 0; i++) {
+    if (message.len == strlen(expected) && memcmp(message.body, expected, message.len) == 0)
+      return (long) i;
+  }
+  return -1;
+}
+
+// Every message is acked, with no more than the window in flight at a time.
+static void test_confirms(void) {
+  rabbitmq_cli cli;
+  fake_amqp_message message;
+  int n;
+
+  fake_amqp_reset();
+  cli = connect_client(16);
+  CHECK_INT(rabbitmq_cli_enable_confirms(&cli, 4, 1000), 0);
+  for (n = 0; n < 10; n++) {
+    CHECK_INT(publish(&cli, NULL, n), AMQP_STATUS_OK);
+    CHECK(cli.inflight_count <= 4);
+  }
+  CHECK_INT(poll_until_settled(&cli), 0);
+  CHECK_INT(cli.confirmed, 10);
+  CHECK_INT(cli.retried, 0);
+  CHECK_INT(fake_amqp.acks, 10);
+  CHECK_INT(fake_amqp_count(), 10);
+  check_messages(0, 0, 10);
+  CHECK_INT(fake_amqp_get(9, &message), 0);
+  CHECK_INT(message.tag, 10);
+  rabbitmq_cli_close(&cli);
+}
+
+// Nacked messages are sent again, ahead of the messages published after
+// the nack arrived, until they are acked.
+static void test_nack(void) {
+  rabbitmq_cli cli;
+  long retry;
+  int n;
+
+  fake_amqp_reset();
+  pthread_mutex_lock(&fake_amqp_lock);
+  fake_amqp.nack_next = 2;
+  pthread_mutex_unlock(&fake_amqp_lock);
+  cli = connect_client(16);
+  CHECK_INT(rabbitmq_cli_enable_confirms(&cli, 4, 1000), 0);
+  for (n = 0; n < 10; n++)
+    CHECK_INT(publish(&cli, NULL, n), AMQP_STATUS_OK);
+  CHECK_INT(poll_until_settled(&cli), 0);
+
+  CHECK_INT(cli.confirmed, 10);
+  CHECK_INT(cli.nacked, 2);
+  CHECK_INT(cli.retried, 2);
+  CHECK_INT(fake_amqp.nacks, 2);
+  CHECK_INT(fake_amqp_count(), 12);
+  // The first two were nacked once the window filled, before message 4 went.
+  for (n = 0; n < 2; n++) {
+    retry = find_message((size_t) find_message(0, n) + 1, n);
+    CHECK(retry > 0 && retry < find_message(0, 4));
+  }
+  for (n = 2; n < 10; n++)
+    CHECK(find_message(0, n) >= 0 && find_message((size_t) find_message(0, n) + 1, n) < 0);
+  rabbitmq_cli_close(&cli);
+}
+
+// A message not confirmed in time counts as a dead connection; whatever was
+// in flight is sent again on the next one.
+static void test_confirm_timeout(void) {
+  rabbitmq_cli cli;
+  fake_amqp_message message;
+
+  fake_amqp_reset();
+  pthread_mutex_lock(&fake_amqp_lock);
+  fake_amqp.hold_confirms = 1;
+  pthread_mutex_unlock(&fake_amqp_lock);
+  cli = connect_client(16);
+  CHECK_INT(rabbitmq_cli_enable_confirms(&cli, 4, 50), 0);
+  CHECK_INT(publish(&cli, NULL, 0), AMQP_STATUS_OK);
+  CHECK_INT(publish(&cli, NULL, 1), AMQP_STATUS_OK);
+  sleep_ms(60);
+  CHECK_INT(rabbitmq_cli_poll(&cli), -1);
+  CHECK_INT(cli.state, RABBITMQ_CLI_DISCONNECTED);
+  CHECK_INT(cli.replay_count, 2);
+
+  pthread_mutex_lock(&fake_amqp_lock);
+  fake_amqp.hold_confirms = 0;
+  pthread_mutex_unlock(&fake_amqp_lock);
+  CHECK_INT(poll_until_settled(&cli), 0);
+  CHECK_INT(cli.confirmed, 2);
+  CHECK_INT(cli.retried, 2);
+  CHECK_INT(fake_amqp_count(), 4);
+  check_messages(2, 0, 2);
+  CHECK_INT(fake_amqp_get(3, &message), 0);
+  CHECK_INT(message.connection, 2);
+  rabbitmq_cli_close(&cli);
+}
+
+// A message counts as delivered once sent or, with confirms on, once acked,
+// with the count it was published with. Buffering it or sending the
+// preamble counts for nothing.
+static void test_delivered(void) {
+  rabbitmq_cli cli;
+
+  fake_amqp_reset();
+  fake_amqp_set_up(0);
+  cli = connect_client(16);
+  CHECK_INT(rabbitmq_cli_set_preamble(&cli, "text/plain", NULL, "dict", 4), 0);
+  CHECK_INT(rabbitmq_cli_publish(&cli, "test", "text/plain", NULL, "batch", 5, 3),
+            RABBITMQ_CLI_BUFFERED);
+  CHECK_INT(rabbitmq_cli_publish(&cli, "test", "text/plain", NULL, "batch 2", 7, 4),
+            RABBITMQ_CLI_BUFFERED);
+  CHECK_INT(cli.delivered, 0);
+  CHECK_INT(cli.delivered_messages, 0);
+  CHECK_INT(cli.delivered_bytes, 0);
+
+  fake_amqp_set_up(1);
+  CHECK_INT(poll_until_connected(&cli), 0);
+  CHECK_INT(fake_amqp_count(), 3);
+  CHECK_INT(cli.delivered, 7);
+  CHECK_INT(cli.delivered_messages, 2);
+  CHECK_INT(cli.delivered_bytes, 12);
+  rabbitmq_cli_close(&cli);
+
+  fake_amqp_reset();
+  pthread_mutex_lock(&fake_amqp_lock);
+  fake_amqp.hold_confirms = 1;
+  pthread_mutex_unlock(&fake_amqp_lock);
+  cli = connect_client(16);
+  CHECK_INT(rabbitmq_cli_enable_confirms(&cli, 4, 1000), 0);
+  CHECK_INT(rabbitmq_cli_publish(&cli, "test", "text/plain", NULL, "batch", 5, 3),
+            AMQP_STATUS_OK);
+  CHECK_INT(rabbitmq_cli_poll(&cli), 0);
+  CHECK_INT(cli.delivered, 0);
+  pthread_mutex_lock(&fake_amqp_lock);
+  fake_amqp.hold_confirms = 0;
+  pthread_mutex_unlock(&fake_amqp_lock);
+  CHECK_INT(poll_until_settled(&cli), 0);
+  CHECK_INT(cli.delivered, 3);
+  CHECK_INT(cli.delivered_messages, 1);
+  rabbitmq_cli_close(&cli);
+}
+
+int main(void) {
+  test_replay_before_connect();
+  test_reconnect();
+  test_break_during_publish();
+  test_replay_depth();
+  test_preamble();
+  test_confirms();
+  test_nack();
+  test_confirm_timeout();
+  test_delivered();
+  fake_amqp_reset();
+  return check_done("rabbitmq-client");
+}
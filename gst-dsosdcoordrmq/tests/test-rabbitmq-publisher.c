@@ -0,0 +1,320 @@
+// Copyright 2022, Kyota Tashiro, Mengheng Lee, and Latona Inc.
+// License MIT
+
+#include <stdio.h>
+#include <time.h>
+#include "check.h"
+#include "fake-amqp.h"
+#include "rabbitmq-publisher.h"
+
+#define FLUSH_TIMEOUT_MS 5000
+
+static rabbitmq_publisher_config base_config(void) {
+  rabbitmq_publisher_config config = {
+    .hostname = "localhost", .port = 5672, .vhost = "/", .user = "guest",
+    .pass = "guest", .queuename = "test", .content_type = "application/json",
+    .replay_depth = 64, .depth = 64, .policy = PAYLOAD_RING_BLOCK,
+    .batch_max_frames = 1, .linger_ms = 10000};
+
+  return config;
+}
+
+static void enqueue_frame(rabbitmq_publisher *pub, const char *routing_key, int n) {
+  char payload[64];
+  int len = snprintf(payload, sizeof(payload), "{\"frameNumber\": %d}", n);
+
+  CHECK_INT(rabbitmq_publisher_enqueue(pub, 0, routing_key, payload, (size_t) len), 0);
+}
+
+static void sleep_ms(int ms) {
+  struct timespec ts = {ms / 1000, (ms % 1000) * 1000000L};
+
+  nanosleep(&ts, NULL);
+}
+
+static void enqueue_source(rabbitmq_publisher *pub, uint32_t source_id) {
+  char payload[64];
+  int len = snprintf(payload, sizeof(payload), "{\"sourceId\": %u}", source_id);
+
+  CHECK_INT(rabbitmq_publisher_enqueue(pub, source_id, NULL, payload, (size_t) len), 0);
+}
+
+static const char *body(size_t i) {
+  fake_amqp_message message;
+
+  if (fake_amqp_get(i, &message) < 0)
+    return NULL;
+  return check_text(message.body, message.len);
+}
+
+// Frames go out in JSON arrays of batch_max_frames, the last one flushed
+// short, and the counters tell frames from messages.
+static void test_json_array(void) {
+  rabbitmq_publisher_config config = base_config();
+  rabbitmq_publisher pub = {0};
+  rabbitmq_publisher_stats stats;
+  fake_amqp_message message;
+  int n;
+
+  fake_amqp_reset();
+  config.batch_max_frames = 4;
+  CHECK_INT(rabbitmq_publisher_start(&pub, &config), 0);
+  for (n = 0; n < 10; n++)
+    enqueue_frame(&pub, NULL, n);
+  CHECK_INT(rabbitmq_publisher_flush(&pub, FLUSH_TIMEOUT_MS), 0);
+
+  CHECK_INT(fake_amqp_count(), 3);
+  CHECK_STR(body(0), "[{\"frameNumber\": 0}, {\"frameNumber\": 1}, "
+                     "{\"frameNumber\": 2}, {\"frameNumber\": 3}]");
+  CHECK_STR(body(1), "[{\"frameNumber\": 4}, {\"frameNumber\": 5}, "
+                     "{\"frameNumber\": 6}, {\"frameNumber\": 7}]");
+  CHECK_STR(body(2), "[{\"frameNumber\": 8}, {\"frameNumber\": 9}]");
+  CHECK_INT(fake_amqp_get(0, &message), 0);
+  CHECK_STR(message.routing_key, "test");
+  CHECK_STR(message.content_type, "application/json");
+
+  rabbitmq_publisher_get_stats(&pub, &stats);
+  CHECK_INT(stats.published, 10);
+  CHECK_INT(stats.messages, 3);
+  CHECK_INT(stats.failed, 0);
+  rabbitmq_publisher_stop(&pub);
+}
+
+// No batch grows past batch_max_bytes, and every frame is in one of them,
+// in order.
+static void test_max_bytes(void) {
+  rabbitmq_publisher_config config = base_config();
+  rabbitmq_publisher pub = {0};
+  char expected[64];
+  size_t i;
+  int frame = 0;
+  int n;
+
+  fake_amqp_reset();
+  config.batch_max_frames = 100;
+  config.batch_max_bytes = 64;
+  CHECK_INT(rabbitmq_publisher_start(&pub, &config), 0);
+  for (n = 0; n < 20; n++)
+    enqueue_frame(&pub, NULL, n);
+  CHECK_INT(rabbitmq_publisher_flush(&pub, FLUSH_TIMEOUT_MS), 0);
+
+  CHECK(fake_amqp_count() > 1);
+  for (i = 0; i < fake_amqp_count(); i++) {
+    const char *text = body(i);
+    const char *p;
+
+    CHECK(text && strlen(text) <= config.batch_max_bytes);
+    if (!text)
+      continue;
+    for (p = text; (p = strchr(p, '{')); p++) {
+      snprintf(expected, sizeof(expected), "{\"frameNumber\": %d}", frame++);
+      CHECK(strncmp(p, expected, strlen(expected)) == 0);
+    }
+  }
+  CHECK_INT(frame, 20);
+  rabbitmq_publisher_stop(&pub);
+}
+
+// A frame with another routing key closes the open batch.
+static void test_routing_key(void) {
+  rabbitmq_publisher_config config = base_config();
+  rabbitmq_publisher pub = {0};
+  fake_amqp_message message;
+
+  fake_amqp_reset();
+  config.batch_max_frames = 8;
+  CHECK_INT(rabbitmq_publisher_start(&pub, &config), 0);
+  enqueue_frame(&pub, "source.0", 0);
+  enqueue_frame(&pub, "source.0", 1);
+  enqueue_frame(&pub, "source.1", 2);
+  enqueue_frame(&pub, "source.0", 3);
+  CHECK_INT(rabbitmq_publisher_flush(&pub, FLUSH_TIMEOUT_MS), 0);
+
+  CHECK_INT(fake_amqp_count(), 3);
+  CHECK_STR(body(0), "[{\"frameNumber\": 0}, {\"frameNumber\": 1}]");
+  CHECK_INT(fake_amqp_get(0, &message), 0);
+  CHECK_STR(message.routing_key, "source.0");
+  CHECK_STR(body(1), "[{\"frameNumber\": 2}]");
+  CHECK_INT(fake_amqp_get(1, &message), 0);
+  CHECK_STR(message.routing_key, "source.1");
+  CHECK_STR(body(2), "[{\"frameNumber\": 3}]");
+  rabbitmq_publisher_stop(&pub);
+}
+
+// A batch that does not fill up goes out once its first frame has waited
+// linger_ms, without a flush.
+static void test_linger(void) {
+  rabbitmq_publisher_config config = base_config();
+  rabbitmq_publisher pub = {0};
+
+  fake_amqp_reset();
+  config.batch_max_frames = 100;
+  config.linger_ms = 20;
+  CHECK_INT(rabbitmq_publisher_start(&pub, &config), 0);
+  enqueue_frame(&pub, NULL, 0);
+  enqueue_frame(&pub, NULL, 1);
+  enqueue_frame(&pub, NULL, 2);
+  CHECK_INT(fake_amqp_wait_for(1, FLUSH_TIMEOUT_MS), 0);
+  CHECK_STR(body(0), "[{\"frameNumber\": 0}, {\"frameNumber\": 1}, {\"frameNumber\": 2}]");
+  rabbitmq_publisher_stop(&pub);
+}
+
+// Binary frames are coalesced into DSMETA_BIN_BATCH records that decode to
+// the frames that were enqueued.
+static void test_dsmeta_bin(void) {
+  rabbitmq_publisher_config config = base_config();
+  rabbitmq_publisher pub = {0};
+  dsmeta_bin_writer w;
+  dsmeta_bin_batch batch;
+  dsmeta_bin_frame frame;
+  size_t i;
+  uint32_t next = 0;
+  int n;
+
+  fake_amqp_reset();
+  config.content_type = DSMETA_BIN_CONTENT_TYPE;
+  config.batch_format = RABBITMQ_BATCH_DSMETA_BIN;
+  config.batch_max_frames = 2;
+  CHECK_INT(rabbitmq_publisher_start(&pub, &config), 0);
+  dsmeta_bin_writer_init(&w);
+  for (n = 0; n < 5; n++) {
+    dsmeta_bin_writer_reset(&w);
+    dsmeta_bin_begin_frame(&w, 0, (uint32_t) n, 0, DSMETA_BIN_NO_PTS);
+    dsmeta_bin_add_object(&w, n, "Car", n, n, 10, 10);
+    dsmeta_bin_end_frame(&w);
+    CHECK_INT(rabbitmq_publisher_enqueue(&pub, 0, NULL, (const char *) w.buf, w.len), 0);
+  }
+  CHECK_INT(rabbitmq_publisher_flush(&pub, FLUSH_TIMEOUT_MS), 0);
+
+  CHECK_INT(fake_amqp_count(), 3);
+  for (i = 0; i < fake_amqp_count(); i++) {
+    fake_amqp_message message;
+    int res;
+
+    CHECK_INT(fake_amqp_get(i, &message), 0);
+    CHECK_STR(message.content_type, DSMETA_BIN_CONTENT_TYPE);
+    CHECK_INT(dsmeta_bin_decode_batch(message.body, message.len, &batch), 0);
+    CHECK_INT(batch.num_frames, i < 2 ? 2 : 1);
+    while ((res = dsmeta_bin_batch_next(&batch, &frame)) > 0) {
+      dsmeta_bin_object object;
+
+      CHECK_INT(frame.frame_number, next);
+      CHECK_INT(frame.num_objects, 1);
+      dsmeta_bin_get_object(&frame, 0, &object);
+      CHECK_INT(object.class_id, next);
+      next++;
+    }
+    CHECK_INT(res, 0);
+  }
+  CHECK_INT(next, 5);
+  dsmeta_bin_writer_free(&w);
+  rabbitmq_publisher_stop(&pub);
+}
+
+// Frames kept for replay while the broker is down are not published until
+// the client gets them out.
+static void test_broker_down(void) {
+  rabbitmq_publisher_config config = base_config();
+  rabbitmq_publisher pub = {0};
+  rabbitmq_publisher_stats stats;
+  int n;
+
+  fake_amqp_reset();
+  fake_amqp_set_up(0);
+  config.batch_max_frames = 2;
+  CHECK_INT(rabbitmq_publisher_start(&pub, &config), 0);
+  for (n = 0; n < 5; n++)
+    enqueue_frame(&pub, NULL, n);
+  CHECK_INT(rabbitmq_publisher_flush(&pub, FLUSH_TIMEOUT_MS), 0);
+  rabbitmq_publisher_get_stats(&pub, &stats);
+  CHECK_INT(stats.published, 0);
+  CHECK_INT(stats.messages, 0);
+  CHECK_INT(stats.bytes, 0);
+  CHECK_INT(stats.failed, 0);
+  CHECK_INT(fake_amqp_count(), 0);
+
+  fake_amqp_set_up(1);
+  CHECK_INT(fake_amqp_wait_for(3, FLUSH_TIMEOUT_MS), 0);
+  // The thread mirrors the client's counters before it answers a flush.
+  CHECK_INT(rabbitmq_publisher_flush(&pub, FLUSH_TIMEOUT_MS), 0);
+  rabbitmq_publisher_get_stats(&pub, &stats);
+  CHECK_INT(stats.published, 5);
+  CHECK_INT(stats.messages, 3);
+  CHECK_INT(stats.failed, 0);
+  rabbitmq_publisher_stop(&pub);
+}
+
+// A payload drop-oldest discards is reported for its own source, once. A
+// message lost after leaving the queue is reported for every source, as a
+// batch can hold frames of any of them.
+static void test_take_dropped(void) {
+  rabbitmq_publisher_config config = base_config();
+  rabbitmq_publisher pub = {0};
+  int waited;
+  uint32_t s;
+
+  fake_amqp_reset();
+  pthread_mutex_lock(&fake_amqp_lock);
+  fake_amqp.hold_confirms = 1;
+  pthread_mutex_unlock(&fake_amqp_lock);
+  config.depth = 2;
+  config.policy = PAYLOAD_RING_DROP_OLDEST;
+  config.confirm = 1;
+  config.confirm_window = 1;
+  config.confirm_timeout_ms = 1000;
+  CHECK_INT(rabbitmq_publisher_start(&pub, &config), 0);
+  for (s = 1; s <= 5; s++)
+    CHECK_INT(rabbitmq_publisher_take_dropped(&pub, s), 0);
+
+  // The first payload fills the confirm window, so the thread stalls on the
+  // second once it has taken it off the queue.
+  enqueue_source(&pub, 1);
+  CHECK_INT(fake_amqp_wait_for(1, FLUSH_TIMEOUT_MS), 0);
+  enqueue_source(&pub, 2);
+  for (waited = 0; waited < FLUSH_TIMEOUT_MS && rabbitmq_publisher_queue_depth(&pub) > 0;
+       waited += 1)
+    sleep_ms(1);
+  enqueue_source(&pub, 3);
+  enqueue_source(&pub, 4);
+  enqueue_source(&pub, 5);
+  CHECK_INT(rabbitmq_publisher_queue_depth(&pub), 2);
+  CHECK_INT(rabbitmq_publisher_take_dropped(&pub, 3), 1);
+  CHECK_INT(rabbitmq_publisher_take_dropped(&pub, 3), 0);
+  CHECK_INT(rabbitmq_publisher_take_dropped(&pub, 1), 0);
+  CHECK_INT(rabbitmq_publisher_take_dropped(&pub, 2), 0);
+  CHECK_INT(rabbitmq_publisher_take_dropped(&pub, 4), 0);
+  CHECK_INT(rabbitmq_publisher_take_dropped(&pub, 5), 0);
+  pthread_mutex_lock(&fake_amqp_lock);
+  fake_amqp.hold_confirms = 0;
+  pthread_mutex_unlock(&fake_amqp_lock);
+  rabbitmq_publisher_stop(&pub);
+
+  // Without a replay ring, a message the broker is not there for is lost.
+  fake_amqp_reset();
+  fake_amqp_set_up(0);
+  config = base_config();
+  config.replay_depth = 0;
+  CHECK_INT(rabbitmq_publisher_start(&pub, &config), 0);
+  CHECK_INT(rabbitmq_publisher_take_dropped(&pub, 1), 0);
+  CHECK_INT(rabbitmq_publisher_take_dropped(&pub, 2), 0);
+  enqueue_source(&pub, 1);
+  CHECK_INT(rabbitmq_publisher_flush(&pub, FLUSH_TIMEOUT_MS), 0);
+  CHECK_INT(rabbitmq_publisher_take_dropped(&pub, 1), 1);
+  CHECK_INT(rabbitmq_publisher_take_dropped(&pub, 2), 1);
+  CHECK_INT(rabbitmq_publisher_take_dropped(&pub, 1), 0);
+  // A source seen only now has nothing to recover from.
+  CHECK_INT(rabbitmq_publisher_take_dropped(&pub, 3), 0);
+  rabbitmq_publisher_stop(&pub);
+}
+
+int main(void) {
+  test_json_array();
+  test_max_bytes();
+  test_routing_key();
+  test_linger();
+  test_dsmeta_bin();
+  test_broker_down();
+  test_take_dropped();
+  fake_amqp_reset();
+  return check_done("rabbitmq-publisher");
+}
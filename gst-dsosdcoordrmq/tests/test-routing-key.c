@@ -0,0 +1,225 @@
+// Copyright 2022, Kyota Tashiro, Mengheng Lee, and Latona Inc.
+// License MIT
+
+#include <stdio.h>
+#include "check.h"
+#include "dsmeta-frame.h"
+#include "fake-amqp.h"
+#include "publisher-pool.h"
+#include "routing-key.h"
+
+#define FLUSH_TIMEOUT_MS 5000
+#define NUM_SHARDS 3
+#define NUM_SOURCES 6
+#define NUM_FRAMES 20
+
+static const char *labels[] = {"Car", "Person", "Traffic light"};
+static const char *keys[] = {"Car", "Person", "Traffic_light"};
+
+static const char *render(const char *text, uint32_t source_id, int class_id,
+             const char *label) {
+  static char out[ROUTING_KEY_MAX + 1];
+  routing_key_template t;
+
+  if (routing_key_parse(&t, text) < 0)
+    return NULL;
+  CHECK_INT(routing_key_render(&t, out, source_id, class_id, label), strlen(out));
+  return out;
+}
+
+static void test_template(void) {
+  routing_key_template t;
+  char text[ROUTING_KEY_MAX + 2];
+  char label[300];
+  char out[ROUTING_KEY_MAX + 1];
+  int i;
+
+  CHECK_STR(render("cam.{source_id}.{label}", 3, 2, "Traffic light"), "cam.3.Traffic_light");
+  CHECK_STR(render("{label}", 0, 0, "a.b*c#d e"), "a_b_c_d_e");
+  CHECK_STR(render("cam.{source_id}.{label}", 3, 2, NULL), "cam.3.unknown");
+  CHECK_STR(render("cam.{source_id}.{label}", 3, 2, ""), "cam.3.unknown");
+  CHECK_STR(render("class.{class_id}", 4294967295u, -1, "Car"), "class.-1");
+  CHECK_STR(render("{source_id}", 4294967295u, 0, NULL), "4294967295");
+  CHECK_STR(render("frames", 1, 0, NULL), "frames");
+  CHECK_STR(render("", 1, 0, NULL), "");
+  CHECK(render("{{label}}", 1, 0, "Car") == NULL);
+
+  // Only templates that depend on the class split frames by class.
+  CHECK_INT(routing_key_parse(&t, "cam.{source_id}"), 0);
+  CHECK_INT(t.per_class, 0);
+  CHECK_INT(routing_key_parse(&t, "cam.{class_id}"), 0);
+  CHECK_INT(t.per_class, 1);
+  CHECK_INT(routing_key_parse(&t, "cam.{label}"), 0);
+  CHECK_INT(t.per_class, 1);
+
+  CHECK_INT(routing_key_parse(&t, "cam.{camera}"), -1);
+  CHECK_INT(routing_key_parse(&t, "cam.{source_id"), -1);
+  CHECK_INT(routing_key_parse(&t, "cam.{"), -1);
+  memset(text, 'a', sizeof(text) - 1);
+  text[sizeof(text) - 1] = '\0';
+  CHECK_INT(routing_key_parse(&t, text), -1);
+  text[ROUTING_KEY_MAX] = '\0';
+  CHECK_INT(routing_key_parse(&t, text), 0);
+  text[0] = '\0';
+  for (i = 0; i <= ROUTING_KEY_MAX_PARTS; i++)
+    strcat(text, "{label}");
+  CHECK_INT(routing_key_parse(&t, text), -1);
+
+  // Keys longer than AMQP allows are cut, never overrun.
+  memset(label, 'x', sizeof(label) - 1);
+  label[sizeof(label) - 1] = '\0';
+  CHECK_INT(routing_key_parse(&t, "cam.{source_id}.{label}.{class_id}"), 0);
+  CHECK_INT(routing_key_render(&t, out, 7, 1, label), ROUTING_KEY_MAX);
+  CHECK_INT(strlen(out), ROUTING_KEY_MAX);
+  CHECK(strncmp(out, "cam.7.xxx", 9) == 0);
+}
+
+// Publishes a frame as the element does: one message per class when the key
+// depends on the class. Each body names the source, frame and class of every
+// object it carries.
+static void publish_frame(publisher_pool *pool, const routing_key_template *t,
+             dsmeta_frame *f) {
+  char key[ROUTING_KEY_MAX + 1];
+  char payload[256];
+  dsmeta_frame view;
+  size_t pos = 0;
+
+  dsmeta_frame_sort_by_class(f);
+  while (dsmeta_frame_next_class(f, &pos, &view)) {
+    int len = snprintf(payload, sizeof(payload), "%u %d", view.source_id, view.frame_number);
+    size_t i;
+
+    for (i = 0; i < view.num_objects; i++)
+      len += snprintf(payload + len, sizeof(payload) - (size_t) len, " %d",
+                      view.objects[i].class_id);
+    routing_key_render(t, key, view.source_id, view.objects[0].class_id,
+                       view.objects[0].label);
+    CHECK_INT(publisher_pool_enqueue(pool, view.source_id, key, payload, (size_t) len), 0);
+  }
+}
+
+// Frames go to a topic exchange, split by class under keys rendered from the
+// template, and the label dictionary goes first on every connection under its
+// own key. No queue is declared; consumers bind their own.
+static void test_exchange(void) {
+  rabbitmq_publisher_config config = {
+    .hostname = "localhost", .port = 5672, .vhost = "/", .user = "guest",
+    .pass = "guest", .queuename = "unused", .exchange = "frames",
+    .content_type = "text/plain", .replay_depth = 64, .depth = 256,
+    .policy = PAYLOAD_RING_BLOCK, .batch_max_frames = 1, .linger_ms = 10000};
+  publisher_pool pool = {0};
+  routing_key_template t;
+  dsmeta_frame f;
+  int last[NUM_SOURCES];
+  int classes_seen[NUM_SOURCES] = {0};
+  unsigned long connection_of[NUM_SOURCES] = {0};
+  int opened[NUM_SHARDS + 1] = {0};
+  unsigned long preambles = 0;
+  size_t i;
+  int n;
+
+  fake_amqp_reset();
+  CHECK_INT(routing_key_parse(&t, "cam.{source_id}.{label}"), 0);
+  CHECK_INT(publisher_pool_start(&pool, NUM_SHARDS, &config), 0);
+  CHECK_INT(publisher_pool_set_preamble(&pool, "labels", "dictionary", 10), 0);
+  dsmeta_frame_init(&f, 0);
+  for (n = 0; n < NUM_FRAMES; n++) {
+    uint32_t s;
+
+    for (s = 0; s < NUM_SOURCES; s++) {
+      int k;
+
+      // Classes interleaved, and one of them missing from every frame.
+      dsmeta_frame_begin(&f, s, n, 0, DSMETA_BIN_NO_PTS, 6);
+      for (k = 0; k < 6; k++) {
+        int class_id = k % 3;
+        dsmeta_object *o;
+
+        if (class_id == (int) (s + (uint32_t) n) % 3)
+          continue;
+        o = dsmeta_frame_add_object(&f);
+        CHECK(o != NULL);
+        *o = (dsmeta_object) {
+          .object_id = DSMETA_NO_OBJECT_ID, .class_id = class_id, .label = labels[class_id],
+          .left = k, .top = k, .width = 10, .height = 10};
+      }
+      publish_frame(&pool, &t, &f);
+    }
+  }
+  CHECK_INT(publisher_pool_flush(&pool, FLUSH_TIMEOUT_MS), 0);
+
+  pthread_mutex_lock(&fake_amqp_lock);
+  CHECK_INT(fake_amqp.exchange_declares, NUM_SHARDS);
+  CHECK_STR(fake_amqp.exchange, "frames");
+  CHECK_STR(fake_amqp.exchange_type, "topic");
+  CHECK_INT(fake_amqp.queue_declares, 0);
+  pthread_mutex_unlock(&fake_amqp_lock);
+
+  for (n = 0; n < NUM_SOURCES; n++)
+    last[n] = -1;
+  CHECK_INT(fake_amqp_count(), NUM_SHARDS + NUM_SOURCES * NUM_FRAMES * 2);
+  for (i = 0; i < fake_amqp_count(); i++) {
+    fake_amqp_message message;
+    char expected[64];
+    unsigned int source_id;
+    int frame_number;
+    int class_id;
+    int offset;
+    const char *p;
+
+    CHECK_INT(fake_amqp_get(i, &message), 0);
+    CHECK_STR(message.exchange, "frames");
+    CHECK(message.connection >= 1 && message.connection <= NUM_SHARDS);
+    if (message.connection < 1 || message.connection > NUM_SHARDS)
+      continue;
+    // The dictionary is the first message of every connection.
+    if (!opened[message.connection]) {
+      CHECK_STR(message.routing_key, "labels");
+      CHECK_STR(check_text(message.body, message.len), "dictionary");
+      opened[message.connection] = 1;
+      preambles++;
+      continue;
+    }
+    p = check_text(message.body, message.len);
+    CHECK(sscanf(p, "%u %d%n", &source_id, &frame_number, &offset) == 2);
+    CHECK(source_id < NUM_SOURCES);
+    if (source_id >= NUM_SOURCES)
+      continue;
+    // A source's frames arrive in order over one connection, with its
+    // classes in ascending order within a frame.
+    if (!connection_of[source_id])
+      connection_of[source_id] = message.connection;
+    CHECK_INT(message.connection, connection_of[source_id]);
+    CHECK(sscanf(p + offset, " %d", &class_id) == 1);
+    CHECK(class_id >= 0 && class_id < 3);
+    if (class_id < 0 || class_id >= 3)
+      continue;
+    if (frame_number != last[source_id]) {
+      CHECK_INT(frame_number, last[source_id] + 1);
+      last[source_id] = frame_number;
+      classes_seen[source_id] = 0;
+    }
+    CHECK(class_id >= classes_seen[source_id]);
+    classes_seen[source_id] = class_id + 1;
+    CHECK(class_id != (int) (source_id + (unsigned int) frame_number) % 3);
+    snprintf(expected, sizeof(expected), "cam.%u.%s", source_id, keys[class_id]);
+    CHECK_STR(message.routing_key, expected);
+    // Every object of the message has the class of its key.
+    snprintf(expected, sizeof(expected), "%u %d %d %d", source_id, frame_number, class_id,
+             class_id);
+    CHECK_STR(p, expected);
+  }
+  CHECK_INT(preambles, NUM_SHARDS);
+  for (n = 0; n < NUM_SOURCES; n++)
+    CHECK_INT(last[n], NUM_FRAMES - 1);
+
+  dsmeta_frame_free(&f);
+  publisher_pool_stop(&pool);
+}
+
+int main(void) {
+  test_template();
+  test_exchange();
+  fake_amqp_reset();
+  return check_done("routing-key");
+}
@@ -0,0 +1,280 @@
+// Copyright 2022, Kyota Tashiro, Mengheng Lee, and Latona Inc.
+// License MIT
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "check.h"
+#include "text-atlas.h"
+
+#define FONT "Serif"
+
+static const uint8_t RED[4] = {255, 0, 0, 255};
+static const uint8_t BLUE[4] = {0, 0, 255, 255};
+
+// Adds a released run of width x height.
+static const text_atlas_entry *add(text_atlas *a, const char *text, unsigned int width,
+                                   unsigned int height) {
+  text_atlas_entry *e = text_atlas_add(a, FONT, 12, text, width, height, width);
+
+  CHECK(e != NULL);
+  if (e)
+    text_atlas_release(a, e);
+  return e;
+}
+
+// Whether text is cached, without holding it.
+static int cached(text_atlas *a, const char *text) {
+  const text_atlas_entry *e = text_atlas_find(a, FONT, 12, text);
+
+  if (!e)
+    return 0;
+  text_atlas_release(a, e);
+  return 1;
+}
+
+// The texts from the most to the least recently used, joined by spaces.
+static const char *lru_order(const text_atlas *a) {
+  static char out[256];
+  const text_atlas_entry *e;
+  size_t len = 0;
+
+  out[0] = '\0';
+  for (e = a->lru_first; e && len < sizeof(out); e = e->lru_next)
+    len += (size_t) snprintf(out + len, sizeof(out) - len, "%s%s", len ? " " : "", e->text);
+  return out;
+}
+
+// A run is found by font, size and text together.
+static void test_find(void) {
+  text_atlas a;
+  const text_atlas_entry *e;
+
+  text_atlas_init(&a, 1 << 20);
+  CHECK(text_atlas_find(&a, FONT, 12, "car") == NULL);
+  add(&a, "car", 20, 10);
+  e = text_atlas_find(&a, FONT, 12, "car");
+  CHECK(e != NULL);
+  if (e) {
+    CHECK_STR(e->text, "car");
+    CHECK_STR(e->font, FONT);
+    CHECK_INT(e->width, 20);
+    CHECK_INT(e->height, 10);
+    text_atlas_release(&a, e);
+  }
+  CHECK(text_atlas_find(&a, FONT, 13, "car") == NULL);
+  CHECK(text_atlas_find(&a, "Sans", 12, "car") == NULL);
+  CHECK(text_atlas_find(&a, FONT, 12, "ca") == NULL);
+  CHECK_INT(a.hits, 1);
+  CHECK_INT(a.misses, 4);
+  CHECK_INT(a.count, 1);
+  text_atlas_free(&a);
+}
+
+// Adding and finding both make a run the most recently used.
+static void test_lru_order(void) {
+  text_atlas a;
+
+  text_atlas_init(&a, 1 << 20);
+  add(&a, "a", 4, 4);
+  add(&a, "b", 4, 4);
+  add(&a, "c", 4, 4);
+  CHECK_STR(lru_order(&a), "c b a");
+  CHECK(cached(&a, "a"));
+  CHECK_STR(lru_order(&a), "a c b");
+  CHECK(cached(&a, "b"));
+  CHECK_STR(lru_order(&a), "b a c");
+  CHECK(a.lru_last && a.lru_last->lru_next == NULL);
+  CHECK(a.lru_first && a.lru_first->lru_prev == NULL);
+  text_atlas_free(&a);
+}
+
+// The least recently used runs make room for a new one, which keeps the
+// atlas within max_bytes; a run bigger than the budget is not added.
+static void test_eviction(void) {
+  text_atlas a;
+  const text_atlas_entry *e;
+  size_t bytes;
+
+  text_atlas_init(&a, 1 << 20);
+  e = add(&a, "a", 8, 8);
+  bytes = e ? e->bytes : 0;
+  CHECK(bytes >= 8 * 8);
+  text_atlas_free(&a);
+
+  text_atlas_init(&a, 3 * bytes);
+  add(&a, "a", 8, 8);
+  add(&a, "b", 8, 8);
+  add(&a, "c", 8, 8);
+  CHECK_INT(a.bytes, 3 * bytes);
+  CHECK_INT(a.evictions, 0);
+  CHECK(cached(&a, "a"));
+  add(&a, "d", 8, 8);
+  CHECK_INT(a.evictions, 1);
+  CHECK_INT(a.count, 3);
+  CHECK_INT(a.bytes, 3 * bytes);
+  CHECK_STR(lru_order(&a), "d a c");
+  CHECK(!cached(&a, "b"));
+
+  // Twice the size takes two runs out.
+  add(&a, "e", 8, 16);
+  CHECK_INT(a.evictions, 3);
+  CHECK_STR(lru_order(&a), "e d");
+  CHECK(a.bytes <= a.max_bytes);
+
+  CHECK(text_atlas_add(&a, FONT, 12, "f", 64, 64, 64) == NULL);
+  CHECK_INT(a.dropped, 1);
+  CHECK(text_atlas_add(&a, FONT, 12, "g", 8, 8, 4) == NULL);
+  CHECK_INT(a.dropped, 2);
+  CHECK_STR(lru_order(&a), "e d");
+  text_atlas_free(&a);
+}
+
+// An evicted run still held stays readable, off the atlas and its budget,
+// and the last release frees it; AddressSanitizer catches a use after free
+// or a leak.
+static void test_evict_held(void) {
+  text_atlas a;
+  text_atlas_entry *held;
+  const text_atlas_entry *again;
+  size_t bytes;
+  unsigned int i;
+
+  text_atlas_init(&a, 1 << 20);
+  bytes = add(&a, "a", 8, 8) ? a.bytes : 0;
+  text_atlas_free(&a);
+
+  text_atlas_init(&a, bytes);
+  held = text_atlas_add(&a, FONT, 12, "a", 8, 8, 8);
+  CHECK(held != NULL);
+  if (!held)
+    return;
+  for (i = 0; i < 64; i++)
+    held->coverage[i] = (uint8_t) i;
+  again = text_atlas_find(&a, FONT, 12, "a");
+  CHECK(again == held);
+  CHECK_INT(held->refs, 2);
+
+  add(&a, "b", 8, 8);
+  CHECK_INT(a.evictions, 1);
+  CHECK_INT(a.count, 1);
+  CHECK_INT(a.bytes, bytes);
+  CHECK(held->evicted);
+  CHECK(!cached(&a, "a"));
+  for (i = 0; i < 64; i++)
+    CHECK_INT(held->coverage[i], i);
+
+  text_atlas_release(&a, held);
+  CHECK_INT(held->refs, 1);
+  CHECK_INT(held->coverage[63], 63);
+  text_atlas_release(&a, again);
+
+  // Releasing a run that is still cached keeps it.
+  CHECK(cached(&a, "b"));
+  CHECK(cached(&a, "b"));
+  text_atlas_free(&a);
+}
+
+// The buckets double once there are as many runs as buckets, and every run
+// is still found after they did.
+static void test_bucket_growth(void) {
+  text_atlas a;
+  char text[16];
+  unsigned int i, found = 0;
+
+  text_atlas_init(&a, 1 << 24);
+  for (i = 0; i < 200; i++) {
+    snprintf(text, sizeof(text), "label %u", i);
+    add(&a, text, 4, 2);
+  }
+  CHECK_INT(a.count, 200);
+  CHECK_INT(a.grows, 3);
+  CHECK_INT(a.num_buckets, 256);
+  for (i = 0; i < 200; i++) {
+    snprintf(text, sizeof(text), "label %u", i);
+    found += (unsigned int) cached(&a, text);
+  }
+  CHECK_INT(found, 200);
+  CHECK_INT(a.hits, 200);
+  CHECK_INT(a.evictions, 0);
+  text_atlas_free(&a);
+}
+
+// The pixel at x, y of t is color, or untouched when color is NULL.
+static int pixel_is(const cpu_render_target *t, int x, int y, const uint8_t *color) {
+  static const uint8_t untouched[4] = {0};
+  const uint8_t *p = t->pixels + (size_t) y * t->pitch + (size_t) x * 4;
+
+  return memcmp(p, color ? color : untouched, 4) == 0;
+}
+
+// Blits the run at x, y onto a cleared target and checks every pixel against
+// the run's coverage, which is a checkerboard, and the bg box under it.
+static void check_blit(const cpu_render_kernels *k, const cpu_render_target *t,
+                       const text_atlas_entry *e, int x, int y, const uint8_t *bg_color) {
+  int px, py, failures = 0;
+
+  memset(t->pixels, 0, (size_t) t->height * t->pitch);
+  text_atlas_blit(k, t, e, x, y, RED, bg_color);
+  for (py = 0; py < (int) t->height; py++) {
+    for (px = 0; px < (int) t->width; px++) {
+      int cx = px - x, cy = py - y;
+      int inside = cx >= 0 && cy >= 0 && cx < (int) e->width && cy < (int) e->height;
+      const uint8_t *expected = !inside ? NULL
+                                : e->coverage[cy * e->stride + cx] ? RED
+                                                                  : bg_color;
+
+      failures += !pixel_is(t, px, py, expected);
+    }
+    for (px = (int) t->width * 4; px < (int) t->pitch; px++)
+      failures += t->pixels[(size_t) py * t->pitch + px] != 0;
+  }
+  if (failures)
+    fprintf(stderr, "blit at %d, %d with%s bg: %d pixels wrong\n", x, y, bg_color ? "" : "out",
+            failures);
+  CHECK_INT(failures, 0);
+}
+
+// A run hanging over any edge of the target only draws what is inside, and
+// one wholly outside draws nothing. The target rows are padded and its
+// buffer is exact, so AddressSanitizer catches a write past either.
+static void test_blit_clipping(void) {
+  const cpu_render_kernels *k = cpu_render_kernels_best();
+  static const int offsets[][2] = {{2, 1},  {-2, -1}, {6, 4},  {-3, 3},  {5, -2},
+                                   {-4, 0}, {8, 0},   {0, -3}, {0, 6},   {-10, -10}};
+  cpu_render_target t = {NULL, 8, 6, 8 * 4 + 12};
+  text_atlas a;
+  text_atlas_entry *e;
+  unsigned int i;
+  int row, col;
+
+  t.pixels = malloc((size_t) t.height * t.pitch);
+  CHECK(t.pixels != NULL);
+  text_atlas_init(&a, 1 << 20);
+  e = text_atlas_add(&a, FONT, 12, "run", 4, 3, 7);
+  CHECK(e != NULL);
+  if (!t.pixels || !e) {
+    free(t.pixels);
+    return;
+  }
+  for (row = 0; row < 3; row++)
+    for (col = 0; col < 4; col++)
+      e->coverage[row * e->stride + col] = (row + col) % 2 ? 0 : 255;
+
+  for (i = 0; i < sizeof(offsets) / sizeof(offsets[0]); i++) {
+    check_blit(k, &t, e, offsets[i][0], offsets[i][1], NULL);
+    check_blit(k, &t, e, offsets[i][0], offsets[i][1], BLUE);
+  }
+  text_atlas_release(&a, e);
+  text_atlas_free(&a);
+  free(t.pixels);
+}
+
+int main(void) {
+  test_find();
+  test_lru_order();
+  test_eviction();
+  test_evict_held();
+  test_bucket_growth();
+  test_blit_clipping();
+  return check_done("text-atlas");
+}